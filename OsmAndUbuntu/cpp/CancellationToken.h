@@ -0,0 +1,21 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QAtomicInt>
+#include <IQueryController.h>
+
+// Shared between task and whoever may supersede it. Core checks it while loading objects,
+// rasterizing and calculating routes, so cancelled work stops early instead of running to the end.
+class CancellationToken : public OsmAnd::IQueryController
+{
+private:
+    QAtomicInt cancelled;
+public:
+    CancellationToken() : cancelled(0) {}
+    virtual ~CancellationToken() {}
+
+    void cancel() { cancelled.storeRelease(1); }
+    virtual bool isAborted() const { return cancelled.loadAcquire() != 0; }
+};
+
+#endif // CANCELLATIONTOKEN_H
@@ -0,0 +1,81 @@
+#include <QMutexLocker>
+
+#include "FrameBuffers.h"
+
+FrameBuffers::FrameBuffers() : front(-1), back(-1) {
+    for(int i = 0; i < MinBuffers; i++) {
+        buffers.push_back(std::shared_ptr<Buffer>(new Buffer()));
+    }
+}
+
+void FrameBuffers::releaseBuffer(void* info) {
+    std::shared_ptr<Buffer>* buffer = static_cast<std::shared_ptr<Buffer>*>(info);
+    (*buffer)->readers.deref();
+    delete buffer;
+}
+
+bool FrameBuffers::beginFrame(int width, int height, SkBitmap& target) {
+    if(width <= 0 || height <= 0) {
+        return false;
+    }
+    std::shared_ptr<Buffer> buffer;
+    {
+        QMutexLocker lock(&mutex);
+        back = -1;
+        for(int i = 0; i < buffers.size(); i++) {
+            if(i == front || buffers[i]->readers.load() > 0) {
+                continue;
+            }
+            // Surface of same size needs no allocation
+            if(back < 0 || (buffers[i]->width == width && buffers[i]->height == height)) {
+                back = i;
+            }
+        }
+        // Readers hold all other surfaces, frame must not be lost
+        if(back < 0) {
+            buffers.push_back(std::shared_ptr<Buffer>(new Buffer()));
+            back = buffers.size() - 1;
+        }
+        buffer = buffers[back];
+    }
+
+    if(buffer->width != width || buffer->height != height) {
+        buffer->pixels.resize(static_cast<size_t>(width) * height);
+        buffer->width = width;
+        buffer->height = height;
+    }
+    target.setConfig(SkBitmap::kARGB_8888_Config, width, height, width * sizeof(uint32_t));
+    target.setPixels(buffer->pixels.data());
+    return true;
+}
+
+void FrameBuffers::publishFrame(const OsmAnd::AreaI& bbox31) {
+    QMutexLocker lock(&mutex);
+    if(back < 0) {
+        return;
+    }
+    buffers[back]->bbox31 = bbox31;
+    front = back;
+    back = -1;
+}
+
+QImage FrameBuffers::acquireFront(OsmAnd::AreaI* bbox31) {
+    QMutexLocker lock(&mutex);
+    if(front < 0) {
+        return QImage();
+    }
+    auto buffer = buffers[front];
+    buffer->readers.ref();
+    if(bbox31) {
+        *bbox31 = buffer->bbox31;
+    }
+    // Skia 32-bit pixels are premultiplied BGRA in memory on little-endian, same as this format
+    return QImage(reinterpret_cast<const uchar*>(buffer->pixels.data()), buffer->width, buffer->height,
+                  buffer->width * sizeof(uint32_t), QImage::Format_ARGB32_Premultiplied,
+                  &FrameBuffers::releaseBuffer, new std::shared_ptr<Buffer>(buffer));
+}
+
+bool FrameBuffers::isFrontPresent() {
+    QMutexLocker lock(&mutex);
+    return front >= 0;
+}
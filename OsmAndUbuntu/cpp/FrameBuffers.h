@@ -0,0 +1,54 @@
+#ifndef FRAMEBUFFERS_H
+#define FRAMEBUFFERS_H
+
+#include <memory>
+#include <vector>
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <SkBitmap.h>
+#include <OsmAndCore.h>
+
+// Pool of pixel surfaces (at least triple-buffered) passing rendered frames from rasterizer to QML
+// without copies. Writer draws into a surface that is neither front nor read by anyone and publishes
+// it by swapping front index; readers get QImage over front surface pixels that keeps surface out of
+// reuse until last copy of that QImage is gone. Single writer, any number of readers.
+class FrameBuffers
+{
+private:
+    struct Buffer {
+        std::vector<uint32_t> pixels;
+        int width;
+        int height;
+        OsmAnd::AreaI bbox31;
+        // Count of live QImages sharing pixels, released from QImage cleanup function. Each QImage
+        // also owns reference to buffer, so pixels outlive FrameBuffers if image does.
+        QAtomicInt readers;
+
+        Buffer() : width(0), height(0) {}
+    };
+
+    QMutex mutex;
+    QList< std::shared_ptr<Buffer> > buffers;
+    int front;
+    int back;
+
+    static void releaseBuffer(void* info);
+public:
+    static const int MinBuffers = 3;
+
+    FrameBuffers();
+
+    // Points target to pixels of free surface of given size; buffer is allocated only when
+    // there is no free one or its size differs. Target must not be used after publishFrame().
+    bool beginFrame(int width, int height, SkBitmap& target);
+    // Frame started by beginFrame() becomes front one
+    void publishFrame(const OsmAnd::AreaI& bbox31);
+    // Returns null image if nothing was published yet
+    QImage acquireFront(OsmAnd::AreaI* bbox31);
+    bool isFrontPresent();
+};
+
+#endif // FRAMEBUFFERS_H
@@ -1,20 +1,44 @@
 #include "MainApplicationSettings.h"
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
 #include <QString>
+#include <QMutexLocker>
 #include <iostream>
 #include <strstream>
 #include <sstream>
 #include <OsmAndCore.h>
-#include <ObfReader.h>
 #include <Utilities.h>
+#include <Logging.h>
+
+#include "ObfRegistry.h"
+
+static const quint32 DescriptionsMagic = 0x4F424644; // 'OBFD'
+// 2: descriptions made from header index
+static const quint32 DescriptionsVersion = 2;
 
 MainApplicationSettings::MainApplicationSettings(QObject *parent) :
     QObject(parent)
 {
     app = OsmAnd::OsmAndApplication::getAndInitializeApplication();
+    // Pre-warm batch must leave room for file selected by user
+    describePool.setMaxThreadCount(2);
+    QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    cacheDir.mkpath(".");
+    descriptionsPath = cacheDir.absoluteFilePath("obf-descriptions.cache");
+    loadDescriptions();
+    connect(this, SIGNAL(filesListed(QString, QStringList)), this, SLOT(onFilesListed(QString, QStringList)), Qt::QueuedConnection);
     reloadFiles();
 }
 
+MainApplicationSettings::~MainApplicationSettings() {
+    describePool.clear();
+    describePool.waitForDone();
+}
+
 
 QString MainApplicationSettings::getOsmandDirectiory() {
 
@@ -50,91 +74,186 @@ std::string formatBounds(uint32_t left, uint32_t right, uint32_t top, uint32_t b
 
 
 
-void dump(std::ostream &output, const QString& filePath)
+const char* sectionTypeName(ObfHeaderIndex::SectionType type)
 {
-    std::shared_ptr<QFile> file(new QFile(filePath));
-    if(!file->exists())
-    {
-        output << "Binary OsmAnd index " << qPrintable(filePath) << " was not found." << std::endl;
-        return;
-    }
-
-    if(!file->open(QIODevice::ReadOnly))
-    {
-        output << "Failed to open file " << qPrintable(file->fileName()) << std::endl;
-        return;
+    switch(type) {
+    case ObfHeaderIndex::SectionType::Map:
+        return "Map";
+    case ObfHeaderIndex::SectionType::Routing:
+        return "Routing";
+    case ObfHeaderIndex::SectionType::Poi:
+        return "Poi";
+    case ObfHeaderIndex::SectionType::Address:
+        return "Address";
+    case ObfHeaderIndex::SectionType::Transport:
+        return "Transport";
     }
+    return "unknown";
+}
 
-    OsmAnd::ObfReader obfMap(file);
-    output << "Binary index " << qPrintable(file->fileName().split('/').last()) << " version = " << obfMap.version << std::endl;
+void dump(std::ostream &output, const QString& fileName, const ObfHeaderIndex::File& file)
+{
+    output << "Binary index " << qPrintable(fileName) << " version = " << file.version << std::endl;
     int idx = 1;
-    for(auto itSection = obfMap.sections.begin(); itSection != obfMap.sections.end(); ++itSection, idx++)
+    for(auto itSection = file.sections.begin(); itSection != file.sections.end(); ++itSection, idx++)
     {
-        OsmAnd::ObfSection* section = *itSection;
-
-        std::string sectionType = "unknown";
-        if(dynamic_cast<OsmAnd::ObfMapSection*>(section))
-            sectionType = "Map";
-        else if(dynamic_cast<OsmAnd::ObfTransportSection*>(section))
-            sectionType = "Transport";
-        else if(dynamic_cast<OsmAnd::ObfRoutingSection*>(section))
-            sectionType = "Routing";
-        else if(dynamic_cast<OsmAnd::ObfPoiSection*>(section))
-            sectionType = "Poi";
-        else if(dynamic_cast<OsmAnd::ObfAddressSection*>(section))
-            sectionType = "Address";
-
-        output << idx << ". " << sectionType << " data " << section->name.toStdString() << " - " << formatSize( section->length ) << std::endl;
-
-        if(dynamic_cast<OsmAnd::ObfTransportSection*>(section))
+        const ObfHeaderIndex::Section& section = *itSection;
+        output << idx << ". " << sectionTypeName(section.type) << " data " << section.name.toStdString() << " - "
+               << formatSize(static_cast<uint32_t>(section.length)) << std::endl;
+        if(section.minZoom >= 0)
         {
-            auto transportSection = dynamic_cast<OsmAnd::ObfTransportSection*>(section);
-            int sh = (31 - OsmAnd::ObfTransportSection::StopZoom);
-            output << "    Bounds " << formatBounds(transportSection->_left << sh, transportSection->_right << sh, transportSection->_top << sh, transportSection->_bottom << sh) << std::endl;
+            output << "    Zooms " << section.minZoom << " - " << section.maxZoom << std::endl;
         }
-        else if(dynamic_cast<OsmAnd::ObfRoutingSection*>(section))
+        if(section.hasBbox)
         {
-            auto routingSection = dynamic_cast<OsmAnd::ObfRoutingSection*>(section);
-            double lonLeft = 180;
-            double lonRight = -180;
-            double latTop = -90;
-            double latBottom = 90;
-            for(auto itSubsection = routingSection->_subsections.begin(); itSubsection != routingSection->_subsections.end(); ++itSubsection)
-            {
-                auto subsection = itSubsection->get();
+            output << "    Bounds " << formatBounds(section.bbox31.left, section.bbox31.right, section.bbox31.top, section.bbox31.bottom) << std::endl;
+        }
+    }
+}
 
-                lonLeft = std::min(lonLeft, OsmAnd::Utilities::get31LongitudeX(subsection->area31.left));
-                lonRight = std::max(lonRight, OsmAnd::Utilities::get31LongitudeX(subsection->area31.right));
-                latTop = std::max(latTop, OsmAnd::Utilities::get31LatitudeY(subsection->area31.top));
-                latBottom = std::min(latBottom, OsmAnd::Utilities::get31LatitudeY(subsection->area31.bottom));
+
+// Describes files from their headers kept by registry index, so no file is opened or parsed for it
+// and no reader is created. Cache is written once for the whole batch.
+class DescribeFilesTask : public QRunnable
+{
+    MainApplicationSettings* settings;
+    QString directory;
+    QStringList fileNames;
+public:
+    DescribeFilesTask(MainApplicationSettings* settings, const QString& directory, const QStringList& fileNames) :
+        settings(settings), directory(directory), fileNames(fileNames) {
+    }
+
+    void run()
+    {
+        auto index = ObfRegistry::instance()->obtainIndex(directory);
+        bool described = false;
+        for(QString fileName : fileNames) {
+            const QString key = MainApplicationSettings::descriptionKey(directory, fileName);
+            {
+                // Same file may be queued by pre-warm and by selection
+                QMutexLocker lock(&settings->descriptionsMutex);
+                if(settings->descriptions.contains(key) || settings->describing.contains(key)) {
+                    continue;
+                }
+                settings->describing.insert(key);
             }
-            output << "    Bounds " << formatGeoBounds(lonLeft, lonRight, latTop, latBottom) << std::endl;
-        }
-        else if(dynamic_cast<OsmAnd::ObfMapSection*>(section))
-        {
-            auto mapSection = dynamic_cast<OsmAnd::ObfMapSection*>(section);
-            int levelIdx = 1;
-            for(auto itLevel = mapSection->mapLevels.begin(); itLevel != mapSection->mapLevels.end(); ++itLevel, levelIdx++)
+            std::ostringstream s;
+            ObfHeaderIndex::File file;
+            if(index->getFile(QDir(directory).absoluteFilePath(fileName), file)) {
+                dump(s, fileName, file);
+            } else {
+                s << "Binary OsmAnd index " << qPrintable(fileName) << " was not found." << std::endl;
+            }
+            QString description(s.str().c_str());
             {
-                auto level = itLevel->get();
-                output << "  " << idx << "." << levelIdx << " Map level minZoom = " << level->minZoom << ", maxZoom = " << level->maxZoom << ", size = ";
-                output << formatSize(level->length );
-                output << std::endl;
-                output << "      Bounds " << formatBounds(level->area31.left, level->area31.right, level->area31.top, level->area31.bottom) << std::endl;
+                QMutexLocker lock(&settings->descriptionsMutex);
+                settings->describing.remove(key);
+                settings->descriptions.insert(key, description);
             }
+            described = true;
+            emit settings->fileDescribed(fileName, description);
+        }
+        if(described) {
+            settings->saveDescriptions();
+        }
+    }
+};
+
+// Refreshes registry index of directory, which opens new or changed files, so it must not
+// run on GUI thread. Listing is handed back to GUI thread by filesListed().
+class ListFilesTask : public QRunnable
+{
+    MainApplicationSettings* settings;
+    QString directory;
+public:
+    ListFilesTask(MainApplicationSettings* settings, const QString& directory) :
+        settings(settings), directory(directory) {
+    }
 
+    void run()
+    {
+        QStringList fileNames = ObfRegistry::instance()->getFiles(directory);
+        {
+            QMutexLocker lock(&settings->descriptionsMutex);
+            if(settings->listedDirectory != directory) {
+                return;
+            }
         }
+        settings->refreshDescriptions(directory, fileNames);
+        emit settings->filesListed(directory, fileNames);
     }
+};
+
+QString MainApplicationSettings::descriptionKey(const QString& directory, const QString& fileName) {
+    QFileInfo info(QDir(directory).absoluteFilePath(fileName));
+    return info.absoluteFilePath() + "|" + QString::number(info.size()) + "|" +
+            QString::number(info.lastModified().toMSecsSinceEpoch());
+}
 
-    file->close();
+void MainApplicationSettings::scheduleDescriptions(const QString& directory, const QStringList& fileNames, int priority) {
+    describePool.start(new DescribeFilesTask(this, directory, fileNames), priority);
 }
 
+void MainApplicationSettings::loadDescriptions() {
+    QFile file(descriptionsPath);
+    if(!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream in(&file);
+    quint32 magic, version;
+    in >> magic >> version;
+    if(magic != DescriptionsMagic || version != DescriptionsVersion) {
+        return;
+    }
+    QHash<QString, QString> loaded;
+    in >> loaded;
+    if(in.status() == QDataStream::Ok) {
+        QMutexLocker lock(&descriptionsMutex);
+        descriptions = loaded;
+    }
+}
+
+void MainApplicationSettings::saveDescriptions() {
+    QMutexLocker saveLock(&saveMutex);
+    QHash<QString, QString> snapshot;
+    {
+        QMutexLocker lock(&descriptionsMutex);
+        snapshot = descriptions;
+    }
+    // Old cache stays in place until new one is complete
+    QSaveFile file(descriptionsPath);
+    if(!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out << DescriptionsMagic << DescriptionsVersion << snapshot;
+    if(out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+    }
+    if(!file.commit()) {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to save file descriptions to '%s': %s\n",
+                          qPrintable(descriptionsPath), qPrintable(file.errorString()));
+    }
+}
 
 QString MainApplicationSettings::describeFile(int index)
 {
-    std::ostringstream s;
-    dump(s, app->getSettings()->APPLICATION_DIRECTORY.get().toString() + "/"+getFiles()[index]);
-    return QString(s.str().c_str());
+    if(index < 0 || index >= files.size()) {
+        return "";
+    }
+    const QString directory = app->getSettings()->APPLICATION_DIRECTORY.get().toString();
+    const QString key = descriptionKey(directory, files[index]);
+    {
+        QMutexLocker lock(&descriptionsMutex);
+        auto itDescription = descriptions.find(key);
+        if(itDescription != descriptions.end()) {
+            return *itDescription;
+        }
+    }
+    // Ahead of pre-warm queue
+    scheduleDescriptions(directory, QStringList() << files[index], 1);
+    return "Reading " + files[index] + "...";
 }
 
 void MainApplicationSettings::setOsmandDirectiory(QString directory) {
@@ -143,15 +262,56 @@ void MainApplicationSettings::setOsmandDirectiory(QString directory) {
 }
 
 void MainApplicationSettings::reloadFiles(){
-    this->files.clear();
     QString d = app->getSettings()->APPLICATION_DIRECTORY.get().toString();
-    if(d != "") {
-        QDir dir(d);
-        QStringList files = dir.entryList();
-        for(QString it : files) {
-            if(it.endsWith(".obf")) {
-                this->files.append(it);
+
+    // Pre-warm is for listed files only, previous directory's queue is dropped
+    describePool.clear();
+    {
+        QMutexLocker lock(&descriptionsMutex);
+        listedDirectory = d;
+    }
+    // Ahead of any description
+    describePool.start(new ListFilesTask(this, d), 2);
+}
+
+void MainApplicationSettings::onFilesListed(QString directory, QStringList fileNames) {
+    {
+        QMutexLocker lock(&descriptionsMutex);
+        if(listedDirectory != directory) {
+            return;
+        }
+    }
+    this->files = fileNames;
+    emit filesChanged();
+}
+
+void MainApplicationSettings::refreshDescriptions(const QString& d, const QStringList& fileNames) {
+    QSet<QString> keys;
+    QStringList missing;
+    for(QString it : fileNames) {
+        keys.insert(descriptionKey(d, it));
+    }
+    bool pruned = false;
+    {
+        QMutexLocker lock(&descriptionsMutex);
+        for(auto itDescription = descriptions.begin(); itDescription != descriptions.end(); ) {
+            if(keys.contains(itDescription.key())) {
+                ++itDescription;
+            } else {
+                itDescription = descriptions.erase(itDescription);
+                pruned = true;
             }
         }
+        for(QString it : fileNames) {
+            if(!descriptions.contains(descriptionKey(d, it))) {
+                missing.append(it);
+            }
+        }
+    }
+    if(pruned) {
+        saveDescriptions();
+    }
+    if(!missing.isEmpty()) {
+        scheduleDescriptions(d, missing, 0);
     }
 }
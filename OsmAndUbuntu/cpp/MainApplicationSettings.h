@@ -2,6 +2,10 @@
 #define APPLICATIONDATA_H
 #include <QObject>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
 #include <OsmAndApplication.h>
 
 class MainApplicationSettings : public QObject
@@ -9,18 +13,45 @@ class MainApplicationSettings : public QObject
     Q_OBJECT
 private:
     std::shared_ptr<OsmAnd::OsmAndApplication> app;
+
+    // File descriptions keyed by path, size and modification time, persisted in cache directory
+    // so unchanged files are never parsed again for them
+    QMutex descriptionsMutex;
+    QHash<QString, QString> descriptions;
+    QSet<QString> describing;
+    // Directory of the latest reload, listings of previous ones are dropped
+    QString listedDirectory;
+    QString descriptionsPath;
+    QMutex saveMutex;
+    QThreadPool describePool;
+
+    static QString descriptionKey(const QString& directory, const QString& fileName);
+    void scheduleDescriptions(const QString& directory, const QStringList& fileNames, int priority);
+    void loadDescriptions();
+    void saveDescriptions();
+    void refreshDescriptions(const QString& directory, const QStringList& fileNames);
+
+    friend class DescribeFilesTask;
+    friend class ListFilesTask;
 public:
     explicit MainApplicationSettings(QObject *parent = 0);
+    virtual ~MainApplicationSettings();
+    // Lists files and describes new or changed ones in background, filesChanged() follows
     void reloadFiles();
     Q_INVOKABLE void setOsmandDirectiory(QString);
     Q_INVOKABLE QString getOsmandDirectiory();
     Q_INVOKABLE QStringList getFiles() { return files; }
+    // Never blocks: returns cached description, or placeholder and fileDescribed() follows
     Q_INVOKABLE QString describeFile(int index);
     QStringList files;
 
 signals:
-    
-public slots:
+    void fileDescribed(QString fileName, QString description);
+    void filesChanged();
+    void filesListed(QString directory, QStringList fileNames);
+
+private slots:
+    void onFilesListed(QString directory, QStringList fileNames);
 
 };
 #endif // APPLICATIONDATA_H
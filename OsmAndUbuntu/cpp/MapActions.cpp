@@ -1,4 +1,5 @@
 #include <ctime>
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <ostream>
@@ -6,16 +7,11 @@
 
 #include <QFile>
 #include <QDir>
+#include <QMutexLocker>
 
 
-#include <SkDevice.h>
-
 #include <Utilities.h>
 #include <ObfReader.h>
-#include <Rasterizer.h>
-#include <RasterizerContext.h>
-#include <RasterizationStyles.h>
-#include <RasterizationStyle.h>
 #include <RasterizationStyleEvaluator.h>
 #include <RoutePlannerContext.h>
 #include <RoutePlanner.h>
@@ -23,100 +19,33 @@
 
 #include "MapActions.h"
 #include "MapLayersData.h"
+#include "ObfRegistry.h"
 
 
 
 
 MapActions::MapActions(MapLayersData* d, QObject *parent) :
-    data(d), QObject(parent), app(OsmAnd::OsmAndApplication::getAndInitializeApplication())
+    data(d), QObject(parent), app(OsmAnd::OsmAndApplication::getAndInitializeApplication()),
+    activeTasks(0), rasterizationZoom(0), rasterizationStyle("default"), composeQueued(0)
 {
+    rasterizationBbox.left = rasterizationBbox.right = rasterizationBbox.top = rasterizationBbox.bottom = 0;
 }
 
 bool MapActions::isActivityRunning() {
-    if(pseudoCounter > threadPool.activeThreadCount()) {
-        pseudoCounter = threadPool.activeThreadCount();
-    }
-    return pseudoCounter > 0  && threadPool.activeThreadCount() > 0;
+    return activeTasks.load() > 0 || tileRasterizer.getPendingCount() > 0;
 }
 
-class RunRouteRasterization : public QRunnable
+class RunComposition : public QRunnable
 {
-    std::shared_ptr<OsmAnd::OsmAndApplication> app;
-    OsmAnd::AreaI bbox;
-    uint32_t zoom;
-    MapLayersData* data;
-    MapActions* actions;
+    MapActions* a;
 public:
-    RunRouteRasterization(std::shared_ptr<OsmAnd::OsmAndApplication> app, OsmAnd::AreaI bbox, uint32_t zoom,
-                          MapLayersData* d, MapActions* a) :
-        app(app), bbox(bbox), zoom(zoom), data(d),actions(a) {
-
+    RunComposition(MapActions* a) : a(a) {
     }
-    
-    void run()
-    {
-        bool is32bit = true;
-        float tileSide = 256;
-
-        OsmAnd::RasterizationStyles stylesCollection;
-        std::shared_ptr<OsmAnd::RasterizationStyle> style;
-        stylesCollection.obtainStyle("default", style);
-
-        QList< std::shared_ptr<OsmAnd::ObfReader> > obfData;
-        QString d = app->getSettings()->APPLICATION_DIRECTORY.get().toString();
-        if(d != "") {
-            QDir dir(d);
-            QStringList files = dir.entryList();
-            for(QString it : files) {
-                if(it.endsWith(".obf")) {
-                    std::shared_ptr<QFile> qf(new QFile(dir.absolutePath() + "/" + it));
-                    std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(qf));
-                    obfData.push_back(obfReader);
-                }
-            }
-        }
 
-        // Collect all map objects (this should be replaced by something like RasterizerViewport/RasterizerContext)
-        QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects;
-        OsmAnd::QueryFilter filter;
-        filter._bbox31 = &bbox;
-        filter._zoom = &zoom;
-        for(auto itObf = obfData.begin(); itObf != obfData.end(); ++itObf)
-        {
-            auto obf = *itObf;
-
-            for(auto itMapSection = obf->mapSections.begin(); itMapSection != obf->mapSections.end(); ++itMapSection)
-            {
-                auto mapSection = *itMapSection;
-
-                OsmAnd::ObfMapSection::loadMapObjects(obf.get(), mapSection.get(), &mapObjects, &filter, nullptr);
-            }
-        }
-
-        // Allocate render target
-        SkBitmap renderSurface;
-        const auto pixelWidth = (bbox.right >> (31 - zoom + 8)) - (bbox.left >> (31 - zoom + 8));
-        const auto pixelHeight = (bbox.top >> (31 - zoom + 8)) - (bbox.bottom >> (31 - zoom + 8));
-        renderSurface.setConfig(is32bit ? SkBitmap::kARGB_8888_Config : SkBitmap::kRGB_565_Config, pixelWidth, pixelHeight);
-        if(!renderSurface.allocPixels())
-        {
-            return;
-        }
-        SkDevice renderTarget(renderSurface);
-        // Create render canvas
-        SkCanvas canvas(&renderTarget);
-
-        // Perform actual rendering
-        OsmAnd::RasterizerContext rasterizerContext(style);
-        OsmAnd::AreaD dbox;
-        dbox.left = OsmAnd::Utilities::get31LongitudeX(bbox.left);
-        dbox.right = OsmAnd::Utilities::get31LongitudeX(bbox.right);
-        dbox.top = OsmAnd::Utilities::get31LatitudeY(bbox.top);
-        dbox.bottom = OsmAnd::Utilities::get31LatitudeY(bbox.bottom);
-        //OsmAnd::Rasterizer::rasterize(rasterizerContext, true, canvas, dbox, zoom, tileSide, mapObjects, OsmAnd::PointI(), nullptr);
-        data->setRenderedImage(renderSurface, bbox);
-        actions->taskFinished();
-        emit data->mapNeedsToRefresh(QString(""));
+    void run() {
+        a->composeQueued.store(0);
+        a->composeRasterization(true);
+        a->taskFinished();
     }
 };
 
@@ -125,61 +54,46 @@ class RunRouteCalculation : public QRunnable
 public:
     MapLayersData* data;
     MapActions* a;
-    RunRouteCalculation(MapLayersData* d, MapActions* a) : data(d), a(a) {
+    std::shared_ptr<CancellationToken> token;
+    RunRouteCalculation(MapLayersData* d, MapActions* a, std::shared_ptr<CancellationToken> token) :
+        data(d), a(a), token(token) {
     }
 
     void run() {
         QString s = runMsg();
-        emit data->mapNeedsToRefresh(s);
-    }
-
-    bool parseRouteConfiguration(QString& appDir, std::shared_ptr<OsmAnd::RoutingConfiguration> routingConfig) {
-        QFile configFile(appDir +"/routing.xml");
-        if(!configFile.exists())
-        {
-            return false;
-        }
-        configFile.open(QIODevice::ReadOnly | QIODevice::Text);
-        if(!OsmAnd::RoutingConfiguration::parseConfiguration(&configFile, *routingConfig.get()))
-        {
-            return false;
+        a->taskFinished();
+        // Superseded route neither replaces the route nor reports anything
+        if(!token->isAborted()) {
+            emit data->mapNeedsToRefresh(s);
         }
-        configFile.close();
-        return true;
     }
 
     QString runMsg()
     {
         auto app = OsmAnd::OsmAndApplication::getAndInitializeApplication();
-        QList< std::shared_ptr<OsmAnd::ObfReader> > obfData;
         QString d = app->getSettings()->APPLICATION_DIRECTORY.get().toString();
         float slat = app->getSettings()->START_LATITUDE.get().toFloat();
         float slon = app->getSettings()->START_LONGITUDE.get().toFloat();
         float tlat = app->getSettings()->TARGET_LATITUDE.get().toFloat();
         float tlon = app->getSettings()->TARGET_LONGITUDE.get().toFloat();
-        if(d != "") {
-            QDir dir(d);
-            QStringList files = dir.entryList();
-            for(QString it : files) {
-                if(it.endsWith(".obf")) {
-                    std::shared_ptr<QFile> qf(new QFile(dir.absolutePath() + "/" + it));
-                    std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(qf));
-                    obfData.push_back(obfReader);
-                }
-            }
+        // Calculations run one at a time over readers of their own, rasterization is not blocked by them
+        QMutexLocker calculationLock(a->routingCache.getCalculationMutex());
+        if(token->isAborted()) {
+            return "";
         }
-        std::shared_ptr<OsmAnd::RoutingConfiguration> routingConfig(new OsmAnd::RoutingConfiguration);
-        if(!parseRouteConfiguration(d, routingConfig)) {
-            OsmAnd::RoutingConfiguration::loadDefault(*routingConfig);
+        auto files = ObfRegistry::instance()->obtainIndex(d)->getFiles();
+        // Warm context of previous calculation
+        auto plannerContext = a->routingCache.obtainContext(d, files, QString("car"));
+        if(!plannerContext) {
+            return "No routing data";
         }
-        OsmAnd::RoutePlannerContext plannerContext(obfData, routingConfig, QString("car"), false);
         std::shared_ptr<OsmAnd::Model::Road> startRoad;
-        if(!OsmAnd::RoutePlanner::findClosestRoadPoint(&plannerContext, slat, slon, &startRoad))
+        if(!OsmAnd::RoutePlanner::findClosestRoadPoint(plannerContext.get(), slat, slon, &startRoad))
         {
             return "Failed to find road near start point";
         }
         std::shared_ptr<OsmAnd::Model::Road> endRoad;
-        if(!OsmAnd::RoutePlanner::findClosestRoadPoint(&plannerContext, tlat, tlon, &endRoad))
+        if(!OsmAnd::RoutePlanner::findClosestRoadPoint(plannerContext.get(), tlat, tlon, &endRoad))
         {
             return "Failed to find road near end point";
         }
@@ -188,9 +102,13 @@ public:
         points.push_back(std::pair<double, double>(tlat, tlon));
 
         auto routeCalculationStart = std::chrono::steady_clock::now();
-        OsmAnd::RouteCalculationResult route = OsmAnd::RoutePlanner::calculateRoute(&plannerContext, points, false, nullptr);
+        OsmAnd::RouteCalculationResult route = OsmAnd::RoutePlanner::calculateRoute(plannerContext.get(), points, false, token.get());
         auto routeCalculationFinish = std::chrono::steady_clock::now();
 
+        if(token->isAborted()) {
+            a->routingCache.discardContext();
+            return "";
+        }
         if(route.warnMessage != "") {
             return "Route is not found ; " + route.warnMessage ;
         }
@@ -198,17 +116,87 @@ public:
         os << "Route in " << std::chrono::duration<double, std::milli> (routeCalculationFinish - routeCalculationStart).count() << " ms ";
         os << route.list.length() << " segments ";
         data->setRoute(route.list);
-        a->taskFinished();
         return QString(os.str().c_str());
     }
 };
 
 void MapActions::calculateRoute(){
-    start(new RunRouteCalculation(data, this));
+    std::shared_ptr<CancellationToken> token(new CancellationToken());
+    {
+        QMutexLocker lock(&routeMutex);
+        if(routeToken) {
+            routeToken->cancel();
+        }
+        routeToken = token;
+    }
+    start(new RunRouteCalculation(data, this, token));
 }
 
 void MapActions::runRasterization(OsmAnd::AreaI bbox, uint32_t zoom){
-    if(!isActivityRunning()) {
-        start(new RunRouteRasterization(app, bbox, zoom, data, this));
+    QString style;
+    {
+        QMutexLocker lock(&rasterizationMutex);
+        rasterizationBbox = bbox;
+        rasterizationZoom = zoom;
+        style = rasterizationStyle;
+    }
+    QString d = app->getSettings()->APPLICATION_DIRECTORY.get().toString();
+    // Tiles still pending for previous viewport are not started again, the rest of them is cancelled
+    tileRasterizer.requestTiles(threadPool, d, bbox, zoom, style, [this](const RasterTileId& tile) {
+        OsmAnd::AreaI tileBbox = TileRasterizer::getTileBBox31(tile.x, tile.y, tile.zoom);
+        QMutexLocker lock(&rasterizationMutex);
+        bool visible = tile.zoom == rasterizationZoom &&
+                tileBbox.left < rasterizationBbox.right && tileBbox.right > rasterizationBbox.left &&
+                tileBbox.top < std::max(rasterizationBbox.top, rasterizationBbox.bottom) &&
+                tileBbox.bottom > std::min(rasterizationBbox.top, rasterizationBbox.bottom);
+        lock.unlock();
+        if(visible) {
+            requestComposition();
+        }
+    });
+    // Cached part of viewport is ready right away for image requested after this call
+    composeRasterization(false);
+}
+
+void MapActions::rasterizeTiles(QRectF tiles, int zoom){
+    const double tileSize31 = static_cast<double>(1u << (31 - zoom));
+    OsmAnd::AreaI bbox;
+    bbox.left = static_cast<int32_t>(std::max(0.0, tiles.left() * tileSize31));
+    bbox.top = static_cast<int32_t>(std::max(0.0, tiles.top() * tileSize31));
+    bbox.right = static_cast<int32_t>(std::min(2147483647.0, tiles.right() * tileSize31));
+    bbox.bottom = static_cast<int32_t>(std::min(2147483647.0, tiles.bottom() * tileSize31));
+    runRasterization(bbox, zoom);
+}
+
+void MapActions::requestComposition(){
+    // Ahead of queued tiles, so viewport fills in progressively
+    if(composeQueued.testAndSetOrdered(0, 1)) {
+        start(new RunComposition(this), 1);
+    }
+}
+
+void MapActions::composeRasterization(bool notify){
+    // Tiles finish on several workers at once, viewport image is replaced by one of them at a time
+    QMutexLocker composeLock(&composeMutex);
+    OsmAnd::AreaI bbox;
+    uint32_t zoom;
+    QString style;
+    {
+        QMutexLocker lock(&rasterizationMutex);
+        bbox = rasterizationBbox;
+        zoom = rasterizationZoom;
+        style = rasterizationStyle;
+    }
+    // Tiles are drawn straight into free surface of the frame buffers that QML reads from
+    int width, height;
+    TileRasterizer::getPixelSize(bbox, zoom, width, height);
+    SkBitmap surface;
+    if(!data->beginRenderedImage(width, height, surface)) {
+        return;
+    }
+    tileRasterizer.compose(bbox, zoom, style, surface);
+    data->publishRenderedImage(bbox);
+    if(notify) {
+        emit data->mapNeedsToRefresh(QString(""));
     }
 }
@@ -4,9 +4,15 @@
 #include <QObject>
 #include <ObfReader.h>
 #include <QThreadPool>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QRectF>
 #include <OsmAndApplication.h>
 
 #include "MapLayersData.h"
+#include "TileRasterizer.h"
+#include "CancellationToken.h"
+#include "RoutingContextCache.h"
 
 
 
@@ -17,20 +23,42 @@ private:
     std::shared_ptr<OsmAnd::OsmAndApplication> app;
     MapLayersData* data;
     QThreadPool threadPool;
-    int pseudoCounter;
+    // Route calculations and compositions queued or running
+    QAtomicInt activeTasks;
+    TileRasterizer tileRasterizer;
+    // Viewport of last rasterization request, tiles finished for other viewports are not composed
+    QMutex rasterizationMutex;
+    OsmAnd::AreaI rasterizationBbox;
+    uint32_t rasterizationZoom;
+    QString rasterizationStyle;
+    // Set from the moment composition is queued until it starts, so tiles finished meanwhile are
+    // coalesced into it and tile finished after it started queues another one
+    QAtomicInt composeQueued;
+    QMutex composeMutex;
+    // Only the latest route is calculated, previous one is cancelled
+    QMutex routeMutex;
+    std::shared_ptr<CancellationToken> routeToken;
+    RoutingContextCache routingCache;
 
-    void start(QRunnable *r) {pseudoCounter++; threadPool.start(r);}
+    void start(QRunnable *r, int priority = 0) {activeTasks.ref(); threadPool.start(r, priority);}
     // This method is called to let UI know that there is know active threads
-    void taskFinished() {pseudoCounter--;}
+    void taskFinished() {activeTasks.deref();}
+    void requestComposition();
+    // Notifies UI unless called from UI request itself
+    void composeRasterization(bool notify);
 
 
     friend class RunRouteCalculation;
-    friend class RunRouteRasterization;
+    friend class RunComposition;
 public:
     explicit MapActions(MapLayersData* d, QObject *parent = 0);
 
     Q_INVOKABLE void calculateRoute();
+    // Rasterizes tiles of bbox not cached yet, viewport image is recomposed as they get ready.
+    // Pending tiles of previous requests outside of bbox are cancelled, so only the newest viewport is rendered
     void runRasterization(OsmAnd::AreaI bbox, uint32_t zoom);
+    // Same for tile rectangle of map view (MapViewAdapter::getTiles())
+    Q_INVOKABLE void rasterizeTiles(QRectF tiles, int zoom);
     Q_INVOKABLE bool isActivityRunning();
     
 
@@ -1,46 +1,57 @@
 #include "MapLayersData.h"
 #include "Utilities.h"
+#include <QMutexLocker>
 
-MapLayersData::MapLayersData(QObject *) : app(OsmAnd::OsmAndApplication::getAndInitializeApplication()),
-    lastRenderedImage(nullptr)
+MapLayersData::MapLayersData(QObject *) : app(OsmAnd::OsmAndApplication::getAndInitializeApplication())
 {
 
 }
 
-QImage* MapLayersData::getRenderedImage(OsmAnd::AreaI* bbox) {
-    if(lastRenderedImage == nullptr) {
-        return lastRenderedImage;
+void MapLayersData::setRoute(QList< std::shared_ptr<OsmAnd::RouteSegment> >& r)
+{
+    // Simplified levels are computed here, on calculation thread
+    std::shared_ptr<const RouteGeometry> geometry(new RouteGeometry(r));
+    QMutexLocker lock(&routeMutex);
+    route = geometry;
+}
+
+std::shared_ptr<const RouteGeometry> MapLayersData::getRoute() {
+    QMutexLocker lock(&routeMutex);
+    return route;
+}
+
+bool MapLayersData::isRoutePresent() {
+    auto r = getRoute();
+    return r && !r->isEmpty();
+}
+
+int MapLayersData::getRouteInstructionLength() {
+    auto r = getRoute();
+    return r ? r->getInstructions().size() : 0;
+}
+
+float MapLayersData::getRouteInstructionLat(int i) {
+    auto r = getRoute();
+    if(!r || i >= static_cast<int>(r->getInstructions().size())) {
+        return 0;
     }
-    *bbox = this->lastRenderedBox;
-    return lastRenderedImage;
+    return OsmAnd::Utilities::get31LatitudeY(r->getPoints()[r->getInstructions()[i].pointIndex].y);
 }
 
-void MapLayersData::setRenderedImage(SkBitmap& bmp, OsmAnd::AreaI bbox) {
-    if(lastRenderedImage != nullptr) {
-        delete lastRenderedImage;
+float MapLayersData::getRouteInstructionLon(int i) {
+    auto r = getRoute();
+    if(!r || i >= static_cast<int>(r->getInstructions().size())) {
+        return 0;
     }
-    lastRenderedImage = new QImage(bmp.width(), bmp.height(), QImage::Format_ARGB32);
-    void* pixels = bmp.getPixels();
-    memcpy(lastRenderedImage->bits(), pixels, bmp.getSize());
-    lastRenderedBox = bbox;
+    return OsmAnd::Utilities::get31LongitudeX(r->getPoints()[r->getInstructions()[i].pointIndex].x);
 }
 
-void MapLayersData::setRoute(QList< std::shared_ptr<OsmAnd::RouteSegment> >& r)
-{
-    this->route.clear();
-    for(std::shared_ptr<OsmAnd::RouteSegment> rt : r) {
-        int k = rt->startPointIndex;
-        while(k != rt->endPointIndex) {
-            this->route.append(OsmAnd::PointF(OsmAnd::Utilities::get31LongitudeX(rt->road->points[k].x),
-                                              OsmAnd::Utilities::get31LatitudeY(rt->road->points[k].y)));
-            if(k == rt->startPointIndex) {
-                this->routeText.append(rt->description);
-            } else {
-                this->routeText.append("");
-            }
-            k = k > rt->endPointIndex? k - 1 : k + 1;
-        }
+QString MapLayersData::getRouteInstructionText(int i) {
+    auto r = getRoute();
+    if(!r || i >= static_cast<int>(r->getInstructions().size())) {
+        return "";
     }
+    return r->getInstructions()[i].text;
 }
 
 void MapLayersData::setMapLatLonZoom(double lat,double lon,int zoom) {
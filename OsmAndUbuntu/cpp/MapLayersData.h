@@ -7,6 +7,11 @@
 #include <OsmAndApplication.h>
 #include <RouteSegment.h>
 
+#include <QMutex>
+
+#include "FrameBuffers.h"
+#include "RouteGeometry.h"
+
 
 
 class MapLayersData: public QObject
@@ -14,18 +19,21 @@ class MapLayersData: public QObject
     Q_OBJECT
 private:
     std::shared_ptr<OsmAnd::OsmAndApplication> app;
-    QList< OsmAnd::PointF > route;
-    QList< QString > routeText;
-    QImage* lastRenderedImage;
-    OsmAnd::AreaI lastRenderedBox;
+    // Replaced as a whole by route calculation thread
+    QMutex routeMutex;
+    std::shared_ptr<const RouteGeometry> route;
+    FrameBuffers renderedFrames;
 signals:
     void mapNeedsToRefresh(QString message);
 public:
     explicit MapLayersData(QObject *parent = 0);
 
     void setRoute(QList< std::shared_ptr<OsmAnd::RouteSegment> >& r);
-    QImage* getRenderedImage(OsmAnd::AreaI* bbox) ;
-    void setRenderedImage(SkBitmap& bmp, OsmAnd::AreaI bbox);
+    // Rendered map is drawn directly to target and shown to QML once published, no pixels are copied
+    bool beginRenderedImage(int width, int height, SkBitmap& target) {return renderedFrames.beginFrame(width, height, target);}
+    void publishRenderedImage(OsmAnd::AreaI bbox) {renderedFrames.publishFrame(bbox);}
+    QImage getRenderedImage(OsmAnd::AreaI* bbox) {return renderedFrames.acquireFront(bbox);}
+    bool isRenderedImagePresent() {return renderedFrames.isFrontPresent();}
 
 
     Q_INVOKABLE int getMapZoom();
@@ -33,10 +41,14 @@ public:
     Q_INVOKABLE double getMapLongitude();
     Q_INVOKABLE void setMapLatLonZoom(double,double,int);
 
-    Q_INVOKABLE int getRoutePointLength() { return route.size();}
-    Q_INVOKABLE float getRoutePointLat(int i) {return route[i].y; }
-    Q_INVOKABLE float getRoutePointLon(int i) {return route[i].x; }
-    Q_INVOKABLE QString getRoutePointText(int i) {return routeText[i]; }
+    // Snapshot of current route, drawn by RouteLayer
+    std::shared_ptr<const RouteGeometry> getRoute();
+    Q_INVOKABLE bool isRoutePresent();
+    // Turn instructions, their points are present at every zoom
+    Q_INVOKABLE int getRouteInstructionLength();
+    Q_INVOKABLE float getRouteInstructionLat(int i);
+    Q_INVOKABLE float getRouteInstructionLon(int i);
+    Q_INVOKABLE QString getRouteInstructionText(int i);
 
 
     Q_INVOKABLE bool isTargetPresent();
@@ -1,11 +1,13 @@
 #include "MapViewLayer.h"
+#include <QMutexLocker>
 #include <QPainter>
 #include <qmath.h>
 #include <OsmAndMapTileSource.h>
+#include <Utilities.h>
 
-MapViewLayer::MapViewLayer(MapViewAdapter* adapter, QObject *parent) : QQuickImageProvider(QQuickImageProvider::Image),
+MapViewLayer::MapViewLayer(MapViewAdapter* adapter, MapLayersData* data, QObject *parent) : QQuickImageProvider(QQuickImageProvider::Image),
     adapter(adapter), QObject(parent), app(OsmAnd::OsmAndApplication::getAndInitializeApplication()),
-    rasterLayer(new OsmAnd::OsmAndRasterMapLayer(app))
+    rasterLayer(new OsmAnd::OsmAndRasterMapLayer(app)), data(data), offlineMap(false)
 {
     adapter->getMapView()->addLayer(rasterLayer);
     rasterLayer->setTileSource(OsmAnd::MapTileSource::kMapnik);
@@ -13,6 +15,19 @@ MapViewLayer::MapViewLayer(MapViewAdapter* adapter, QObject *parent) : QQuickIma
 
 
 QImage MapViewLayer::requestImage(const QString &id, QSize *size, const QSize &requestedSize) {
+    if(offlineMap) {
+        // Image shares pixels of published frame, which is not reused until image is released
+        OsmAnd::AreaI bbox;
+        QImage frame = data->getRenderedImage(&bbox);
+        if(!frame.isNull()) {
+            if(size) {
+                *size = frame.size();
+            }
+            QMutexLocker lock(&idsMutex);
+            renderedIds[id] = bbox;
+            return frame;
+        }
+    }
     OsmAnd::MapPoint tl, br;
     SkBitmap* bmp = rasterLayer->getBitmap(&tl, &br);
     if(bmp != nullptr) {
@@ -20,9 +35,62 @@ QImage MapViewLayer::requestImage(const QString &id, QSize *size, const QSize &r
             size->setWidth(bmp->width());
             size->setHeight(bmp->height());
         }
+        QMutexLocker lock(&idsMutex);
         ids[id] = std::pair<OsmAnd::MapPoint, OsmAnd::MapPoint>(tl, br);
+        lock.unlock();
         QImage mg = QImage((uchar*)bmp->getPixels(), bmp->width(), bmp->height(), bmp->rowBytes(), QImage::Format_ARGB32);
         return mg;
     }
     return QImage();
 }
+
+int MapViewLayer::pixelX(int32_t x31, int32_t y31) {
+    return adapter->getRotatedMapXForPoint(OsmAnd::Utilities::get31LatitudeY(y31), OsmAnd::Utilities::get31LongitudeX(x31));
+}
+
+int MapViewLayer::pixelY(int32_t x31, int32_t y31) {
+    return adapter->getRotatedMapYForPoint(OsmAnd::Utilities::get31LatitudeY(y31), OsmAnd::Utilities::get31LongitudeX(x31));
+}
+
+bool MapViewLayer::isRendered(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    return renderedIds.contains(id);
+}
+
+void MapViewLayer::releaseImage(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    renderedIds.remove(id);
+    ids.remove(id);
+}
+
+int MapViewLayer::left(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    if(renderedIds.contains(id)) {
+        return pixelX(renderedIds[id].left, renderedIds[id].top);
+    }
+    return ids.value(id).first.pixel().x;
+}
+
+int MapViewLayer::top(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    if(renderedIds.contains(id)) {
+        return pixelY(renderedIds[id].left, renderedIds[id].top);
+    }
+    return ids.value(id).first.pixel().y;
+}
+
+int MapViewLayer::right(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    if(renderedIds.contains(id)) {
+        return pixelX(renderedIds[id].right, renderedIds[id].bottom);
+    }
+    return ids.value(id).second.pixel().x;
+}
+
+int MapViewLayer::bottom(const QString& id) {
+    QMutexLocker lock(&idsMutex);
+    if(renderedIds.contains(id)) {
+        return pixelY(renderedIds[id].right, renderedIds[id].bottom);
+    }
+    return ids.value(id).second.pixel().y;
+}
@@ -4,8 +4,10 @@
 #include <QObject>
 #include <QImage>
 #include <QMap>
+#include <QMutex>
 #include <QQuickImageProvider>
 #include "MapViewAdapter.h"
+#include "MapLayersData.h"
 #include <OsmAndRasterMapLayer.h>
 
 class MapViewLayer : public QObject, public QQuickImageProvider
@@ -16,14 +18,29 @@ class MapViewLayer : public QObject, public QQuickImageProvider
     std::shared_ptr<OsmAnd::OsmAndApplication> app;
     std::shared_ptr<OsmAnd::OsmAndRasterMapLayer> rasterLayer;
     QMap<QString, std::pair<OsmAnd::MapPoint, OsmAnd::MapPoint> > ids;
+    // Images served from map rasterized from OBF files, by their 31-coordinates bbox
+    MapLayersData* data;
+    bool offlineMap;
+    QMap<QString, OsmAnd::AreaI> renderedIds;
+    // Images are requested from loader thread and placed from GUI thread
+    QMutex idsMutex;
+
+    int pixelX(int32_t x31, int32_t y31);
+    int pixelY(int32_t x31, int32_t y31);
 public:
-    explicit MapViewLayer(MapViewAdapter* adapter, QObject *parent = 0);
+    explicit MapViewLayer(MapViewAdapter* adapter, MapLayersData* data, QObject *parent = 0);
     virtual QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
 
-    Q_INVOKABLE int left(const QString& id) { return ids[id].first.pixel().x; }
-    Q_INVOKABLE int top(const QString& id) { return ids[id].first.pixel().y; }
-    Q_INVOKABLE int right(const QString& id) { return ids[id].second.pixel().x; }
-    Q_INVOKABLE int bottom(const QString& id) { return ids[id].second.pixel().y; }
+    Q_INVOKABLE void setOfflineMap(bool o) { offlineMap = o; }
+    Q_INVOKABLE bool isOfflineMap() { return offlineMap; }
+    Q_INVOKABLE bool isRendered(const QString& id);
+    // Forgets placement of image that was unloaded
+    Q_INVOKABLE void releaseImage(const QString& id);
+
+    Q_INVOKABLE int left(const QString& id);
+    Q_INVOKABLE int top(const QString& id);
+    Q_INVOKABLE int right(const QString& id);
+    Q_INVOKABLE int bottom(const QString& id);
 };
 
 #endif // MAPVIEWLAYER_H
@@ -0,0 +1,75 @@
+#include <QDir>
+#include <QStandardPaths>
+#include <QMutexLocker>
+
+#include "ObfRegistry.h"
+
+ObfRegistry::ObfRegistry(QObject *parent) :
+    QObject(parent), dirty(true)
+{
+    QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    cacheDir.mkpath(".");
+    index.reset(new ObfHeaderIndex(cacheDir.absoluteFilePath(ObfHeaderIndex::defaultIndexFilename)));
+    connect(&watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged(QString)));
+}
+
+ObfRegistry* ObfRegistry::instance() {
+    static ObfRegistry registry;
+    return &registry;
+}
+
+void ObfRegistry::watch(const QString& dir) {
+    if(!watcher.directories().isEmpty()) {
+        watcher.removePaths(watcher.directories());
+    }
+    if(dir != "") {
+        watcher.addPath(dir);
+    }
+}
+
+void ObfRegistry::directoryChanged(const QString& path) {
+    QMutexLocker scopeLock(&mutex);
+    if(path == directory) {
+        dirty = true;
+    }
+}
+
+void ObfRegistry::refreshIfNeeded(const QString& dir) {
+    if(!dirty && dir == directory) {
+        return;
+    }
+    if(dir != directory) {
+        // Watcher is not thread-safe, it is updated from its own thread
+        QMetaObject::invokeMethod(this, "watch", Qt::QueuedConnection, Q_ARG(QString, dir));
+    }
+    directory = dir;
+    dirty = false;
+
+    files.clear();
+    QStringList paths;
+    if(dir != "") {
+        QDir d(dir);
+        QStringList entries = d.entryList();
+        for(QString it : entries) {
+            if(it.endsWith(".obf")) {
+                files.append(it);
+                paths.append(d.absolutePath() + "/" + it);
+            }
+        }
+    }
+    // Unchanged files keep their headers and open readers
+    index->refresh(paths);
+}
+
+std::shared_ptr<ObfHeaderIndex> ObfRegistry::obtainIndex(const QString& dir) {
+    QMutexLocker scopeLock(&mutex);
+    refreshIfNeeded(dir);
+    return index;
+}
+
+QStringList ObfRegistry::getFiles(const QString& dir) {
+    QMutexLocker scopeLock(&mutex);
+    refreshIfNeeded(dir);
+    return files;
+}
+
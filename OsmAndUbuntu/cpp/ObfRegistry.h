@@ -0,0 +1,43 @@
+#ifndef OBFREGISTRY_H
+#define OBFREGISTRY_H
+
+#include <QObject>
+#include <QMutex>
+#include <QStringList>
+#include <QFileSystemWatcher>
+#include <ObfReader.h>
+
+#include "ObfHeaderIndex.h"
+
+// Process-wide registry of OBF files in application directory, shared by map rasterization,
+// route calculation and file description. It keeps header index with parsed section metadata
+// and open readers; directory is listed and index refreshed only when another directory is
+// asked for or the watched one changes on disk, so requests do no file opening or parsing.
+class ObfRegistry : public QObject
+{
+    Q_OBJECT
+private:
+    QMutex mutex;
+    QFileSystemWatcher watcher;
+    std::shared_ptr<ObfHeaderIndex> index;
+    QString directory;
+    QStringList files;
+    bool dirty;
+
+    explicit ObfRegistry(QObject *parent = 0);
+    // Called with mutex held
+    void refreshIfNeeded(const QString& dir);
+
+private slots:
+    void watch(const QString& dir);
+    void directoryChanged(const QString& path);
+
+public:
+    // Instance lives in thread that first asked for it, which must be GUI thread
+    static ObfRegistry* instance();
+
+    std::shared_ptr<ObfHeaderIndex> obtainIndex(const QString& dir);
+    QStringList getFiles(const QString& dir);
+};
+
+#endif // OBFREGISTRY_H
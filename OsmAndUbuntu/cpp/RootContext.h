@@ -18,7 +18,7 @@ private :
     MapViewLayer mapViewLayer;
 public:
     explicit RootContext(QObject *parent = 0) :
-        mapActions(&mapLayerData), mapViewLayer(&mapViewAdapter) {
+        mapActions(&mapLayerData), mapViewLayer(&mapViewAdapter, &mapLayerData) {
     }
     virtual ~RootContext() {}
 
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "RouteGeometry.h"
+
+RouteGeometry::RouteGeometry(const QList< std::shared_ptr<OsmAnd::RouteSegment> >& segments) {
+    for(std::shared_ptr<OsmAnd::RouteSegment> rt : segments) {
+        int k = rt->startPointIndex;
+        while(k != rt->endPointIndex) {
+            appendPoint(rt->road->points[k]);
+            if(k == rt->startPointIndex && rt->description != "") {
+                Instruction instruction = {static_cast<uint32_t>(points.size() - 1), rt->description};
+                instructions.push_back(instruction);
+            }
+            k = k > rt->endPointIndex? k - 1 : k + 1;
+        }
+    }
+    if(!segments.isEmpty()) {
+        appendPoint(segments.last()->road->points[segments.last()->endPointIndex]);
+    }
+    computeLevels();
+}
+
+RouteGeometry::RouteGeometry(const std::vector<OsmAnd::PointI>& points, const std::vector<Instruction>& instructions) :
+    points(points), instructions(instructions) {
+    computeLevels();
+}
+
+void RouteGeometry::appendPoint(const OsmAnd::PointI& p) {
+    // Segments are joined at the same point
+    if(points.empty() || points.back().x != p.x || points.back().y != p.y) {
+        points.push_back(p);
+    }
+}
+
+// Distance from p to segment a-b
+static double segmentDistance(const OsmAnd::PointI& p, const OsmAnd::PointI& a, const OsmAnd::PointI& b) {
+    const double dx = static_cast<double>(b.x) - a.x;
+    const double dy = static_cast<double>(b.y) - a.y;
+    double px = static_cast<double>(p.x) - a.x;
+    double py = static_cast<double>(p.y) - a.y;
+    const double length2 = dx * dx + dy * dy;
+    if(length2 > 0) {
+        const double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / length2));
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return std::sqrt(px * px + py * py);
+}
+
+void RouteGeometry::computeLevels() {
+    levels.clear();
+    if(points.empty()) {
+        return;
+    }
+    const uint32_t count = points.size();
+    std::vector<double> importance(count, 0.0);
+
+    // Ends of route and instruction points split it into ranges simplified independently
+    std::vector<uint32_t> anchors;
+    anchors.push_back(0);
+    for(auto itInstruction = instructions.begin(); itInstruction != instructions.end(); ++itInstruction) {
+        anchors.push_back(itInstruction->pointIndex);
+    }
+    anchors.push_back(count - 1);
+    std::sort(anchors.begin(), anchors.end());
+    anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+
+    struct Range {
+        uint32_t first;
+        uint32_t last;
+        double parentImportance;
+    };
+    std::vector<Range> stack;
+    for(size_t i = 0; i < anchors.size(); i++) {
+        importance[anchors[i]] = DBL_MAX;
+        if(i > 0) {
+            Range range = {anchors[i - 1], anchors[i], DBL_MAX};
+            stack.push_back(range);
+        }
+    }
+    // Iterative Douglas-Peucker over whole range, recording where each point would be dropped
+    while(!stack.empty()) {
+        const Range range = stack.back();
+        stack.pop_back();
+        if(range.last - range.first < 2) {
+            continue;
+        }
+        uint32_t farthest = range.first + 1;
+        double maxDistance = -1.0;
+        for(uint32_t i = range.first + 1; i < range.last; i++) {
+            const double d = segmentDistance(points[i], points[range.first], points[range.last]);
+            if(d > maxDistance) {
+                maxDistance = d;
+                farthest = i;
+            }
+        }
+        // Point can't outlive the one that split its range, otherwise levels would not nest
+        const double value = std::min(maxDistance, range.parentImportance);
+        importance[farthest] = value;
+        Range left = {range.first, farthest, value};
+        Range right = {farthest, range.last, value};
+        stack.push_back(left);
+        stack.push_back(right);
+    }
+
+    // One pixel of zoom in 31-coordinates is tolerance of its level
+    for(int zoom = MinZoom; zoom <= MaxZoom; zoom++) {
+        const double tolerance = static_cast<double>(1u << (31 - 8 - zoom));
+        std::vector<uint32_t> level;
+        for(uint32_t i = 0; i < count; i++) {
+            if(importance[i] >= tolerance) {
+                level.push_back(i);
+            }
+        }
+        const bool complete = level.size() == count;
+        levels.push_back(std::move(level));
+        // Finer levels would be the same
+        if(complete) {
+            break;
+        }
+    }
+}
+
+const std::vector<uint32_t>& RouteGeometry::getLevel(int zoom) const {
+    static const std::vector<uint32_t> empty;
+    if(levels.empty()) {
+        return empty;
+    }
+    const int idx = std::max(0, std::min(static_cast<int>(levels.size()) - 1, zoom - MinZoom));
+    return levels[idx];
+}
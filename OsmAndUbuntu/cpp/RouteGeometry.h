@@ -0,0 +1,48 @@
+#ifndef ROUTEGEOMETRY_H
+#define ROUTEGEOMETRY_H
+
+#include <vector>
+#include <memory>
+
+#include <QList>
+#include <QString>
+#include <OsmAndCore.h>
+#include <RouteSegment.h>
+
+// Route polyline stored once in 31-coordinates with per-zoom simplified levels.
+// Every point gets Douglas-Peucker importance (deviation at which it is dropped, clamped by
+// its parent's so levels nest), a zoom level keeps points more important than one pixel of it.
+// Turn instructions are sparse list of point indices, those points are kept at every zoom.
+class RouteGeometry
+{
+public:
+    static const int MinZoom = 1;
+    static const int MaxZoom = 21;
+
+    struct Instruction {
+        uint32_t pointIndex;
+        QString text;
+    };
+
+private:
+    std::vector<OsmAnd::PointI> points;
+    std::vector<Instruction> instructions;
+    // Indices of points kept at zoom, levels[zoom - MinZoom]
+    std::vector< std::vector<uint32_t> > levels;
+
+    void appendPoint(const OsmAnd::PointI& p);
+    void computeLevels();
+public:
+    explicit RouteGeometry(const QList< std::shared_ptr<OsmAnd::RouteSegment> >& segments);
+    // Route of points given directly, instruction indices must be within points
+    RouteGeometry(const std::vector<OsmAnd::PointI>& points, const std::vector<Instruction>& instructions);
+
+    bool isEmpty() const { return points.empty(); }
+    const std::vector<OsmAnd::PointI>& getPoints() const { return points; }
+    const std::vector<Instruction>& getInstructions() const { return instructions; }
+    int getLevelsCount() const { return levels.size(); }
+    // Point indices to draw at zoom, zooms out of levels range are clamped
+    const std::vector<uint32_t>& getLevel(int zoom) const;
+};
+
+#endif // ROUTEGEOMETRY_H
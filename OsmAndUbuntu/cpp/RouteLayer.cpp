@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QSGGeometryNode>
+#include <QSGTransformNode>
+#include <QSGFlatColorMaterial>
+#include <Utilities.h>
+
+#include "RouteLayer.h"
+
+RouteLayer::RouteLayer(QQuickItem *parent) : QQuickItem(parent), layersData(nullptr), mapView(nullptr),
+    color(0, 0, 230, 204), lineWidth(6), builtZoom(-1), builtScale(0), styleChanged(false)
+{
+    setFlag(QQuickItem::ItemHasContents, true);
+}
+
+QPointF RouteLayer::screenPoint(int32_t x31, int32_t y31) {
+    const double lat = OsmAnd::Utilities::get31LatitudeY(y31);
+    const double lon = OsmAnd::Utilities::get31LongitudeX(x31);
+    return QPointF(mapView->getRotatedMapXForPoint(lat, lon), mapView->getRotatedMapYForPoint(lat, lon));
+}
+
+// Miter longer than this many half widths is replaced by bevel
+static const double MiterLimit = 2.0;
+
+// Unit normal of segment a-b, fallback if segment has no length
+static QPointF segmentNormal(const QPointF& a, const QPointF& b, const QPointF& fallback) {
+    const QPointF d = b - a;
+    const double length = std::sqrt(d.x() * d.x() + d.y() * d.y());
+    if(length <= 0) {
+        return fallback;
+    }
+    return QPointF(-d.y() / length, d.x() / length);
+}
+
+// Triangle strip of ribbon along polyline: pair of vertices across line at every point, mitered
+// at joins, two pairs (one per segment) where turn is too sharp for miter
+static void buildRibbon(const std::vector<QPointF>& line, double halfWidth, std::vector<QPointF>& strip) {
+    strip.clear();
+    if(line.size() < 2) {
+        return;
+    }
+    std::vector<QPointF> normals(line.size() - 1);
+    QPointF normal(0, 1);
+    for(size_t i = 0; i + 1 < line.size(); i++) {
+        normal = segmentNormal(line[i], line[i + 1], normal);
+        normals[i] = normal;
+    }
+    for(size_t i = 0; i < line.size(); i++) {
+        const QPointF& p = line[i];
+        const QPointF& in = normals[i > 0 ? i - 1 : 0];
+        const QPointF& out = normals[i < normals.size() ? i : normals.size() - 1];
+        QPointF miter = in + out;
+        const double miterLength = std::sqrt(miter.x() * miter.x() + miter.y() * miter.y());
+        const double cosine = miterLength / 2;
+        if(cosine * MiterLimit >= 1.0) {
+            miter *= halfWidth / (miterLength * cosine);
+            strip.push_back(p + miter);
+            strip.push_back(p - miter);
+        } else {
+            strip.push_back(p + in * halfWidth);
+            strip.push_back(p - in * halfWidth);
+            strip.push_back(p + out * halfWidth);
+            strip.push_back(p - out * halfWidth);
+        }
+    }
+}
+
+QSGNode* RouteLayer::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*) {
+    // GUI thread is blocked while this runs on render thread, so reading map view is safe
+    std::shared_ptr<const RouteGeometry> route;
+    if(layersData != nullptr && mapView != nullptr) {
+        route = layersData->getRoute();
+    }
+    if(!route || route->isEmpty()) {
+        delete oldNode;
+        builtRoute.reset();
+        return nullptr;
+    }
+    const int zoom = mapView->getZoom();
+
+    QSGTransformNode* transformNode = static_cast<QSGTransformNode*>(oldNode);
+    QSGGeometryNode* geometryNode;
+    if(transformNode == nullptr) {
+        transformNode = new QSGTransformNode();
+        geometryNode = new QSGGeometryNode();
+        QSGGeometry* geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 0);
+        geometry->setDrawingMode(GL_TRIANGLE_STRIP);
+        geometryNode->setGeometry(geometry);
+        geometryNode->setFlag(QSGNode::OwnsGeometry);
+        QSGFlatColorMaterial* material = new QSGFlatColorMaterial();
+        geometryNode->setMaterial(material);
+        geometryNode->setFlag(QSGNode::OwnsMaterial);
+        transformNode->appendChildNode(geometryNode);
+        builtRoute.reset();
+        styleChanged = true;
+    } else {
+        geometryNode = static_cast<QSGGeometryNode*>(transformNode->firstChild());
+    }
+
+    const auto& points = route->getPoints();
+    const auto& origin = points.front();
+    const double tileSize31 = static_cast<double>(1u << (31 - zoom));
+    // Map view projection is affine in 31-coordinates: sample it at origin and at points far enough
+    // along both axes (towards the middle of the world) that integer pixels don't skew it
+    const int32_t basis = static_cast<int32_t>(std::min<double>(64.0 * tileSize31, 1 << 28));
+    const int32_t bx = origin.x < (1 << 30) ? basis : -basis;
+    const int32_t by = origin.y < (1 << 30) ? basis : -basis;
+    const double basisTiles = basis / tileSize31;
+    const QPointF s0 = screenPoint(origin.x, origin.y);
+    const QPointF sx = (screenPoint(origin.x + bx, origin.y) - s0) / (bx > 0 ? basisTiles : -basisTiles);
+    const QPointF sy = (screenPoint(origin.x, origin.y + by) - s0) / (by > 0 ? basisTiles : -basisTiles);
+
+    // Width is given in pixels, so ribbon in tile units follows scale of map view, which stays put
+    // while zoom does, except for rounding
+    const double scale = std::sqrt(sx.x() * sx.x() + sx.y() * sx.y());
+    bool rebuild = route != builtRoute || zoom != builtZoom || std::fabs(scale - builtScale) > builtScale * 0.01;
+    if(styleChanged) {
+        static_cast<QSGFlatColorMaterial*>(geometryNode->material())->setColor(color);
+        geometryNode->markDirty(QSGNode::DirtyMaterial);
+        styleChanged = false;
+        rebuild = true;
+    }
+    if(rebuild && scale > 0) {
+        const auto& level = route->getLevel(zoom);
+        std::vector<QPointF> line;
+        line.reserve(level.size());
+        for(size_t i = 0; i < level.size(); i++) {
+            const auto& p = points[level[i]];
+            line.push_back(QPointF((static_cast<double>(p.x) - origin.x) / tileSize31, (static_cast<double>(p.y) - origin.y) / tileSize31));
+        }
+        std::vector<QPointF> strip;
+        buildRibbon(line, lineWidth / 2 / scale, strip);
+
+        QSGGeometry* geometry = geometryNode->geometry();
+        geometry->allocate(strip.size());
+        QSGGeometry::Point2D* vertices = geometry->vertexDataAsPoint2D();
+        for(size_t i = 0; i < strip.size(); i++) {
+            vertices[i].set(strip[i].x(), strip[i].y());
+        }
+        geometryNode->markDirty(QSGNode::DirtyGeometry);
+        builtRoute = route;
+        builtZoom = zoom;
+        builtScale = scale;
+    }
+
+    transformNode->setMatrix(QMatrix4x4(sx.x(), sy.x(), 0, s0.x(),
+                                        sx.y(), sy.y(), 0, s0.y(),
+                                        0, 0, 1, 0,
+                                        0, 0, 0, 1));
+    return transformNode;
+}
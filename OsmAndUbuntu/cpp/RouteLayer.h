@@ -0,0 +1,49 @@
+#ifndef ROUTELAYER_H
+#define ROUTELAYER_H
+
+#include <QQuickItem>
+#include <QColor>
+
+#include "MapLayersData.h"
+#include "MapViewAdapter.h"
+
+// Draws route as one scene graph triangle strip, a ribbon of line width in pixels with mitered
+// joins (beveled at sharp turns). Vertices of simplified level are kept in tile units around first
+// route point and rebuilt only when route, zoom, width or map scale changes; moving or rotating map
+// only replaces matrix of transform node, sampled from the map view itself.
+class RouteLayer : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QObject* layersData READ getLayersData WRITE setLayersData)
+    Q_PROPERTY(QObject* mapView READ getMapView WRITE setMapView)
+    Q_PROPERTY(QColor color READ getColor WRITE setColor)
+    Q_PROPERTY(qreal lineWidth READ getLineWidth WRITE setLineWidth)
+private:
+    MapLayersData* layersData;
+    MapViewAdapter* mapView;
+    QColor color;
+    qreal lineWidth;
+
+    std::shared_ptr<const RouteGeometry> builtRoute;
+    int builtZoom;
+    // Pixels per tile unit the ribbon was built for
+    double builtScale;
+    bool styleChanged;
+
+    QPointF screenPoint(int32_t x31, int32_t y31);
+protected:
+    virtual QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*);
+public:
+    explicit RouteLayer(QQuickItem *parent = 0);
+
+    QObject* getLayersData() { return layersData; }
+    void setLayersData(QObject* d) { layersData = qobject_cast<MapLayersData*>(d); update(); }
+    QObject* getMapView() { return mapView; }
+    void setMapView(QObject* v) { mapView = qobject_cast<MapViewAdapter*>(v); update(); }
+    QColor getColor() { return color; }
+    void setColor(QColor c) { color = c; styleChanged = true; update(); }
+    qreal getLineWidth() { return lineWidth; }
+    void setLineWidth(qreal w) { lineWidth = w; styleChanged = true; update(); }
+};
+
+#endif // ROUTELAYER_H
@@ -0,0 +1,106 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include "RoutingContextCache.h"
+
+RoutingContextCache::RoutingContextCache() : configSize(-1), configModified(-1) {
+    counters.configurationParses = 0;
+    counters.contextsCreated = 0;
+    counters.contextsReused = 0;
+    counters.readersOpened = 0;
+}
+
+std::shared_ptr<OsmAnd::RoutingConfiguration> RoutingContextCache::obtainConfigurationLocked(const QString& appDir) {
+    const QString path = appDir + "/routing.xml";
+    QFileInfo info(path);
+    const qint64 size = info.exists() ? info.size() : -1;
+    const qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+    if(config && path == configPath && size == configSize && modified == configModified) {
+        return config;
+    }
+
+    std::shared_ptr<OsmAnd::RoutingConfiguration> routingConfig(new OsmAnd::RoutingConfiguration);
+    QFile configFile(path);
+    bool parsed = false;
+    if(configFile.exists() && configFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        parsed = OsmAnd::RoutingConfiguration::parseConfiguration(&configFile, *routingConfig.get());
+        configFile.close();
+    }
+    if(!parsed) {
+        routingConfig.reset(new OsmAnd::RoutingConfiguration);
+        OsmAnd::RoutingConfiguration::loadDefault(*routingConfig);
+    }
+    counters.configurationParses++;
+    config = routingConfig;
+    configPath = path;
+    configSize = size;
+    configModified = modified;
+    return config;
+}
+
+std::shared_ptr<OsmAnd::RoutingConfiguration> RoutingContextCache::obtainConfiguration(const QString& appDir) {
+    QMutexLocker lock(&mutex);
+    return obtainConfigurationLocked(appDir);
+}
+
+QMutex* RoutingContextCache::getCalculationMutex() {
+    return &calculationMutex;
+}
+
+std::shared_ptr<OsmAnd::RoutePlannerContext> RoutingContextCache::obtainContext(const QString& appDir,
+    const QList<ObfHeaderIndex::File>& files, const QString& vehicle) {
+    QMutexLocker lock(&mutex);
+    // Unchanged files keep their readers, so context built over them stays valid
+    QMap<QString, SourceFile> usedFiles;
+    QList< std::shared_ptr<OsmAnd::ObfReader> > sources;
+    for(auto itFile = files.begin(); itFile != files.end(); ++itFile) {
+        bool hasRouting = false;
+        for(auto itSection = itFile->sections.begin(); itSection != itFile->sections.end(); ++itSection) {
+            hasRouting = hasRouting || itSection->type == ObfHeaderIndex::SectionType::Routing;
+        }
+        if(!hasRouting) {
+            continue;
+        }
+        auto itSource = sourceFiles.find(itFile->path);
+        if(itSource == sourceFiles.end() || itSource->size != itFile->size || itSource->modified != itFile->modified) {
+            SourceFile source;
+            source.size = itFile->size;
+            source.modified = itFile->modified;
+            source.reader.reset(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(itFile->path))));
+            itSource = sourceFiles.insert(itFile->path, source);
+            counters.readersOpened++;
+        }
+        usedFiles.insert(itFile->path, *itSource);
+        sources.push_back(itSource->reader);
+    }
+    sourceFiles.swap(usedFiles);
+    if(sources.isEmpty()) {
+        return std::shared_ptr<OsmAnd::RoutePlannerContext>();
+    }
+
+    auto routingConfig = obtainConfigurationLocked(appDir);
+    if(context && contextConfig == routingConfig && contextVehicle == vehicle && contextSources == sources) {
+        counters.contextsReused++;
+        return context;
+    }
+    context.reset(new OsmAnd::RoutePlannerContext(sources, routingConfig, vehicle, false));
+    contextSources = sources;
+    contextConfig = routingConfig;
+    contextVehicle = vehicle;
+    counters.contextsCreated++;
+    return context;
+}
+
+void RoutingContextCache::discardContext() {
+    QMutexLocker lock(&mutex);
+    context.reset();
+    contextSources.clear();
+    contextConfig.reset();
+}
+
+RoutingContextCache::Counters RoutingContextCache::getCounters() {
+    QMutexLocker lock(&mutex);
+    return counters;
+}
@@ -0,0 +1,71 @@
+#ifndef ROUTINGCONTEXTCACHE_H
+#define ROUTINGCONTEXTCACHE_H
+
+#include <memory>
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <ObfReader.h>
+#include <RoutePlannerContext.h>
+#include <RoutingConfiguration.h>
+
+#include "ObfHeaderIndex.h"
+
+// Keeps parsed routing.xml and planner context between route calculations. Configuration is
+// parsed again only when file size or modification time changes; context (with road data it has
+// loaded) is reused while readers, configuration and vehicle stay the same, so recalculation
+// after moving start or target runs on warm data. Router reads through its own readers, not the
+// registry ones shared with rasterization, so a long calculation never blocks tile rendering.
+// Those readers and the context are used by one calculation at a time, under calculation mutex.
+class RoutingContextCache
+{
+public:
+    struct Counters {
+        int configurationParses;
+        int contextsCreated;
+        int contextsReused;
+        int readersOpened;
+    };
+
+private:
+    struct SourceFile {
+        qint64 size;
+        qint64 modified;
+        std::shared_ptr<OsmAnd::ObfReader> reader;
+    };
+
+    QMutex mutex;
+    QMutex calculationMutex;
+    QString configPath;
+    qint64 configSize;
+    qint64 configModified;
+    std::shared_ptr<OsmAnd::RoutingConfiguration> config;
+
+    // Readers of files with routing sections, reopened when file changes
+    QMap<QString, SourceFile> sourceFiles;
+    QList< std::shared_ptr<OsmAnd::ObfReader> > contextSources;
+    QString contextVehicle;
+    std::shared_ptr<OsmAnd::RoutingConfiguration> contextConfig;
+    std::shared_ptr<OsmAnd::RoutePlannerContext> context;
+    Counters counters;
+
+    // Called with mutex held
+    std::shared_ptr<OsmAnd::RoutingConfiguration> obtainConfigurationLocked(const QString& appDir);
+public:
+    RoutingContextCache();
+
+    std::shared_ptr<OsmAnd::RoutingConfiguration> obtainConfiguration(const QString& appDir);
+    // Held for the whole calculation that uses context
+    QMutex* getCalculationMutex();
+    // Context over routing sections of given files, empty if none of them has any
+    std::shared_ptr<OsmAnd::RoutePlannerContext> obtainContext(const QString& appDir,
+        const QList<ObfHeaderIndex::File>& files, const QString& vehicle);
+    // Context of interrupted calculation may be left half-way, next one starts clean
+    void discardContext();
+
+    Counters getCounters();
+};
+
+#endif // ROUTINGCONTEXTCACHE_H
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include <QMutexLocker>
+#include <SkDevice.h>
+#include <SkCanvas.h>
+
+#include <Logging.h>
+#include <Utilities.h>
+#include <ObfReader.h>
+#include <Rasterizer.h>
+#include <RasterizerContext.h>
+
+#include "TileRasterizer.h"
+#include "ObfRegistry.h"
+
+class RasterizeTileTask : public QRunnable
+{
+    TileRasterizer* rasterizer;
+    RasterTileId tile;
+    std::shared_ptr<CancellationToken> token;
+    QString obfDirectory;
+    TileRasterizer::TileReadyCallback callback;
+public:
+    RasterizeTileTask(TileRasterizer* r, const RasterTileId& tile, const std::shared_ptr<CancellationToken>& token,
+                      const QString& obfDirectory, TileRasterizer::TileReadyCallback callback) :
+        rasterizer(r), tile(tile), token(token), obfDirectory(obfDirectory), callback(callback) {
+    }
+
+    void run()
+    {
+        std::shared_ptr<SkBitmap> bitmap;
+        if(!token->isAborted()) {
+            auto style = rasterizer->obtainStyle(tile.style);
+            if(!style || !rasterize(style, bitmap)) {
+                bitmap.reset();
+            }
+        }
+        if(rasterizer->tileRasterized(tile, token, bitmap) && bitmap) {
+            callback(tile);
+        }
+    }
+
+    bool rasterize(const std::shared_ptr<OsmAnd::RasterizationStyle>& style, std::shared_ptr<SkBitmap>& bitmap)
+    {
+        auto bbox = TileRasterizer::getTileBBox31(tile.x, tile.y, tile.zoom);
+        uint32_t zoom = tile.zoom;
+
+        QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects;
+        OsmAnd::QueryFilter filter;
+        filter._bbox31 = &bbox;
+        filter._zoom = &zoom;
+        // Only files whose map sections cover this tile at its zoom are touched
+        auto obfData = ObfRegistry::instance()->obtainIndex(obfDirectory)->obtainReaders(bbox, ObfHeaderIndex::SectionType::Map, zoom);
+        for(auto itObf = obfData.begin(); itObf != obfData.end() && !token->isAborted(); ++itObf)
+        {
+            auto obf = itObf->obfReader;
+            QMutexLocker obfLock(itObf->mutex.get());
+
+            for(auto itMapSection = obf->mapSections.begin(); itMapSection != obf->mapSections.end(); ++itMapSection)
+            {
+                OsmAnd::ObfMapSection::loadMapObjects(obf.get(), itMapSection->get(), &mapObjects, &filter, token.get());
+            }
+        }
+        if(token->isAborted())
+        {
+            return false;
+        }
+
+        bitmap.reset(new SkBitmap());
+        bitmap->setConfig(SkBitmap::kARGB_8888_Config, TileRasterizer::TileSize, TileRasterizer::TileSize);
+        if(!bitmap->allocPixels())
+        {
+            return false;
+        }
+        bitmap->eraseColor(SK_ColorTRANSPARENT);
+        SkDevice renderTarget(*bitmap);
+        SkCanvas canvas(&renderTarget);
+
+        OsmAnd::RasterizerContext rasterizerContext(style);
+        OsmAnd::AreaD dbox;
+        dbox.left = OsmAnd::Utilities::get31LongitudeX(bbox.left);
+        dbox.right = OsmAnd::Utilities::get31LongitudeX(bbox.right);
+        dbox.top = OsmAnd::Utilities::get31LatitudeY(bbox.top);
+        dbox.bottom = OsmAnd::Utilities::get31LatitudeY(bbox.bottom);
+        if(!OsmAnd::Rasterizer::rasterize(rasterizerContext, true, canvas, dbox, zoom, TileRasterizer::TileSize, mapObjects, OsmAnd::PointI(), token.get()))
+        {
+            if(token->isAborted())
+            {
+                return false;
+            }
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to rasterize tile %dx%d@%d\n", tile.x, tile.y, tile.zoom);
+            return false;
+        }
+        return true;
+    }
+};
+
+// Inclusive range of tiles covering bbox31, which may have top and bottom in either order
+static void getTileRange(const OsmAnd::AreaI& bbox31, uint32_t zoom, int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) {
+    const auto shift = 31 - zoom;
+    const auto maxTile = static_cast<int32_t>((1u << zoom) - 1);
+    x0 = std::max(0, bbox31.left >> shift);
+    x1 = std::min(maxTile, std::max(bbox31.left, bbox31.right - 1) >> shift);
+    y0 = std::max(0, std::min(bbox31.top, bbox31.bottom) >> shift);
+    y1 = std::min(maxTile, std::max(bbox31.top, bbox31.bottom - 1) >> shift);
+}
+
+TileRasterizer::TileRasterizer(int minCapacity) : minCapacity(minCapacity), tiles(minCapacity) {
+}
+
+OsmAnd::AreaI TileRasterizer::getTileBBox31(int32_t x, int32_t y, uint32_t zoom) {
+    const auto shift = 31 - zoom;
+    OsmAnd::AreaI bbox;
+    bbox.left = x << shift;
+    bbox.top = y << shift;
+    bbox.right = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(x + 1) << shift, INT_MAX));
+    bbox.bottom = static_cast<int32_t>(std::min<int64_t>(static_cast<int64_t>(y + 1) << shift, INT_MAX));
+    return bbox;
+}
+
+std::shared_ptr<OsmAnd::RasterizationStyle> TileRasterizer::obtainStyle(const QString& name) {
+    // Called from worker thread only, per-thread data is deleted when pool expires the thread
+    if(!threadStyles.hasLocalData()) {
+        threadStyles.setLocalData(new ThreadStyles());
+    }
+    auto styles = threadStyles.localData();
+    auto itStyle = styles->byName.find(name);
+    if(itStyle != styles->byName.end()) {
+        return *itStyle;
+    }
+    std::shared_ptr<OsmAnd::RasterizationStyle> style;
+    if(!styles->collection.obtainStyle(name, style)) {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to resolve style '%s'\n", qPrintable(name));
+        style.reset();
+    }
+    styles->byName.insert(name, style);
+    return style;
+}
+
+bool TileRasterizer::tileRasterized(const RasterTileId& tile, const std::shared_ptr<CancellationToken>& token,
+                                    const std::shared_ptr<SkBitmap>& bitmap) {
+    QMutexLocker lock(&mutex);
+    // Cancelled tile may be pending again with another task
+    auto itPending = pending.find(tile);
+    if(itPending != pending.end() && *itPending == token) {
+        pending.erase(itPending);
+    }
+    if(token->isAborted()) {
+        return false;
+    }
+    if(bitmap) {
+        tiles.insert(tile, bitmap);
+    }
+    return true;
+}
+
+int TileRasterizer::requestTiles(QThreadPool& pool, const QString& obfDirectory, const OsmAnd::AreaI& bbox31, uint32_t zoom,
+                                 const QString& style, TileReadyCallback callback) {
+    int32_t x0, y0, x1, y1;
+    getTileRange(bbox31, zoom, x0, y0, x1, y1);
+    // Tiles closer to the center of viewport go first
+    const auto cx = (x0 + x1) / 2;
+    const auto cy = (y0 + y1) / 2;
+    QList< std::pair<int32_t, RasterTileId> > missing;
+    QList< std::shared_ptr<CancellationToken> > tokens;
+    {
+        QMutexLocker lock(&mutex);
+        // Ring keeps tiles just scrolled out, second copy keeps previous viewport for zooming back.
+        // Shrinking on resize evicts least recently used tiles only.
+        const int ringTiles = (x1 - x0 + 3) * (y1 - y0 + 3);
+        tiles.setCapacity(std::max(minCapacity, 2 * ringTiles));
+        for(auto itPending = pending.begin(); itPending != pending.end(); ) {
+            const auto& tile = itPending.key();
+            if(tile.zoom != zoom || tile.style != style || tile.x < x0 || tile.x > x1 || tile.y < y0 || tile.y > y1) {
+                (*itPending)->cancel();
+                itPending = pending.erase(itPending);
+            } else {
+                ++itPending;
+            }
+        }
+        for(int32_t y = y0; y <= y1; y++) {
+            for(int32_t x = x0; x <= x1; x++) {
+                RasterTileId tile = {x, y, zoom, style};
+                // Cached tiles in viewport are marked as recently used
+                if(!tiles.touch(tile) && !pending.contains(tile)) {
+                    missing.push_back(std::make_pair(std::abs(x - cx) + std::abs(y - cy), tile));
+                }
+            }
+        }
+        std::stable_sort(missing.begin(), missing.end(),
+            [](const std::pair<int32_t, RasterTileId>& l, const std::pair<int32_t, RasterTileId>& r) { return l.first < r.first; });
+        for(auto itTile = missing.begin(); itTile != missing.end(); ++itTile) {
+            std::shared_ptr<CancellationToken> token(new CancellationToken());
+            pending.insert(itTile->second, token);
+            tokens.push_back(token);
+        }
+    }
+    for(int i = 0; i < missing.size(); i++) {
+        pool.start(new RasterizeTileTask(this, missing[i].second, tokens[i], obfDirectory, callback));
+    }
+    return missing.size();
+}
+
+void TileRasterizer::getPixelSize(const OsmAnd::AreaI& bbox31, uint32_t zoom, int& width, int& height) {
+    // 31-coordinates to pixels of this zoom
+    const auto shift = 31 - zoom - 8;
+    width = (bbox31.right >> shift) - (bbox31.left >> shift);
+    height = (std::max(bbox31.top, bbox31.bottom) >> shift) - (std::min(bbox31.top, bbox31.bottom) >> shift);
+}
+
+int TileRasterizer::compose(const OsmAnd::AreaI& bbox31, uint32_t zoom, const QString& style, SkBitmap& surface) {
+    const auto shift = 31 - zoom - 8;
+    const auto pixelLeft = bbox31.left >> shift;
+    const auto pixelTop = std::min(bbox31.top, bbox31.bottom) >> shift;
+    surface.eraseColor(SK_ColorTRANSPARENT);
+
+    int32_t x0, y0, x1, y1;
+    getTileRange(bbox31, zoom, x0, y0, x1, y1);
+    // Bitmaps are never modified once cached, so drawing happens without lock
+    QList< std::pair<RasterTileId, std::shared_ptr<SkBitmap> > > available;
+    int missing = 0;
+    {
+        QMutexLocker lock(&mutex);
+        for(int32_t y = y0; y <= y1; y++) {
+            for(int32_t x = x0; x <= x1; x++) {
+                RasterTileId tile = {x, y, zoom, style};
+                auto cachedTile = tiles.peek(tile);
+                if(cachedTile) {
+                    available.push_back(std::make_pair(tile, *cachedTile));
+                } else {
+                    missing++;
+                }
+            }
+        }
+    }
+
+    SkDevice renderTarget(surface);
+    SkCanvas canvas(&renderTarget);
+    for(auto itTile = available.begin(); itTile != available.end(); ++itTile) {
+        canvas.drawBitmap(*itTile->second,
+                          SkIntToScalar(itTile->first.x * TileSize - pixelLeft),
+                          SkIntToScalar(itTile->first.y * TileSize - pixelTop));
+    }
+    return missing;
+}
+
+int TileRasterizer::getPendingCount() {
+    QMutexLocker lock(&mutex);
+    return pending.size();
+}
+
+void TileRasterizer::clear() {
+    QMutexLocker lock(&mutex);
+    tiles.clear();
+}
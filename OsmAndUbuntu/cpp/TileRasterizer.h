@@ -0,0 +1,86 @@
+#ifndef TILERASTERIZER_H
+#define TILERASTERIZER_H
+
+#include <functional>
+#include <memory>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <SkBitmap.h>
+#include <OsmAndCore.h>
+#include <RasterizationStyles.h>
+#include <RasterizationStyle.h>
+
+#include "CancellationToken.h"
+#include "LruCache.h"
+
+struct RasterTileId {
+    int32_t x;
+    int32_t y;
+    uint32_t zoom;
+    QString style;
+
+    bool operator==(const RasterTileId& other) const {
+        return x == other.x && y == other.y && zoom == other.zoom && style == other.style;
+    }
+};
+
+inline uint qHash(const RasterTileId& tile) {
+    return qHash(tile.style) ^ (uint(tile.x) * 31u) ^ (uint(tile.y) * 131071u) ^ (tile.zoom << 27);
+}
+
+// Rasterizes OBF map data in fixed 256px tiles, each tile as separate task on thread pool.
+// Tiles are cached by (x, y, zoom, style), so moving viewport rasterizes only newly exposed
+// tiles and viewport image is composed from cached ones. Cache capacity follows size of the
+// requested viewport, so large or high-DPI views do not evict their own tiles.
+class TileRasterizer
+{
+public:
+    typedef std::function<void (const RasterTileId& tile)> TileReadyCallback;
+    static const int TileSize = 256;
+
+private:
+    QMutex mutex;
+    const int minCapacity;
+    LruCache<RasterTileId, std::shared_ptr<SkBitmap> > tiles;
+    // Queued or running tiles with their tokens
+    QHash<RasterTileId, std::shared_ptr<CancellationToken> > pending;
+
+    // Resolved style keeps evaluation state, so each worker thread resolves and uses its own
+    struct ThreadStyles {
+        OsmAnd::RasterizationStyles collection;
+        QHash<QString, std::shared_ptr<OsmAnd::RasterizationStyle> > byName;
+    };
+    QThreadStorage<ThreadStyles*> threadStyles;
+
+    std::shared_ptr<OsmAnd::RasterizationStyle> obtainStyle(const QString& name);
+    // Returns false if tile was cancelled meanwhile, then bitmap is not cached
+    bool tileRasterized(const RasterTileId& tile, const std::shared_ptr<CancellationToken>& token,
+                        const std::shared_ptr<SkBitmap>& bitmap);
+
+    friend class RasterizeTileTask;
+public:
+    explicit TileRasterizer(int minCapacity = 128);
+
+    static OsmAnd::AreaI getTileBBox31(int32_t x, int32_t y, uint32_t zoom);
+    static void getPixelSize(const OsmAnd::AreaI& bbox31, uint32_t zoom, int& width, int& height);
+
+    // Starts rasterization of tiles covering bbox31 that are neither cached nor already pending,
+    // and cancels pending tiles outside of it (queued ones are skipped, running ones stop in core).
+    // Callback is invoked from worker thread once tile is in cache. Returns count of started tiles.
+    // Cache is resized to hold twice the viewport with one ring of tiles around it, but not below minCapacity.
+    int requestTiles(QThreadPool& pool, const QString& obfDirectory, const OsmAnd::AreaI& bbox31, uint32_t zoom,
+                     const QString& style, TileReadyCallback callback);
+    // Draws cached tiles covering bbox31 to surface with pixels of getPixelSize() size.
+    // Returns count of tiles that are not rasterized yet (left transparent).
+    int compose(const OsmAnd::AreaI& bbox31, uint32_t zoom, const QString& style, SkBitmap& surface);
+
+    int getPendingCount();
+    void clear();
+};
+
+#endif // TILERASTERIZER_H
@@ -3,9 +3,11 @@
 #include <QQuickView>
 #include <QtQml/QQmlContext>
 #include <QtQml/QQmlEngine>
+#include <QtQml/qqml.h>
 #include <stdio.h>
 #include <QObject>
 #include "RootContext.h"
+#include "RouteLayer.h"
 
 class QQuickImageProviderWrapper : public QQuickImageProvider {
 public:
@@ -27,6 +29,7 @@ int main(int argc, char *argv[])
 
     //With this we can add the c++ Object to the QML file
     r->createProperties(view->rootContext());
+    qmlRegisterType<RouteLayer>("OsmAnd", 1, 0, "RouteLayer");
 
     //Resolve the relativ path to the absolute path (at runtime)
     const QString qmlFilePath= QString::fromLatin1("%1/%2").arg(QCoreApplication::applicationDirPath(), "qml/main.qml");
@@ -10,7 +10,13 @@ SOURCES +=  cpp/main.cpp \
     cpp/MapLayersData.cpp \
     cpp/MapActions.cpp \
     cpp/MapViewAdapter.cpp \
-    cpp/MapViewLayer.cpp
+    cpp/MapViewLayer.cpp \
+    cpp/ObfRegistry.cpp \
+    cpp/TileRasterizer.cpp \
+    cpp/FrameBuffers.cpp \
+    cpp/RouteGeometry.cpp \
+    cpp/RouteLayer.cpp \
+    cpp/RoutingContextCache.cpp
 
 QMAKE_CXXFLAGS +=-std=c++11 -DSK_ALLOW_STATIC_GLOBAL_INITIALIZERS=0 \
         -DSK_RELEASE -DSK_CPU_LENDIAN
@@ -22,7 +28,14 @@ HEADERS  += \
     cpp/MapActions.h \
     cpp/RootContext.h \
     cpp/MapViewAdapter.h \
-    cpp/MapViewLayer.h
+    cpp/MapViewLayer.h \
+    cpp/ObfRegistry.h \
+    cpp/TileRasterizer.h \
+    cpp/FrameBuffers.h \
+    cpp/CancellationToken.h \
+    cpp/RouteGeometry.h \
+    cpp/RouteLayer.h \
+    cpp/RoutingContextCache.h
 
 
 SKIA_PATCHED = $$PWD/../../core/externals/skia/upstream.patched/
@@ -43,6 +56,9 @@ DEPENDPATH += $$PWD/../../../../usr/lib \
               $$PWD/../../core/include \
               $$PWD/../../core/include/native \
               $$PWD/../../core/protos
+#Code shared with other tools
+include(../common/common.pri)
+
 #Path to "other files" in this case the QML-Files
 OTHER_FILES += \
     qml/main.qml\
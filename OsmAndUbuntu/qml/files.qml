@@ -32,12 +32,17 @@ Page {
         width: units.gu(15);
         onClicked: {
             applicationData.setOsmandDirectiory(text_input1.text);
-            reloadList();
         }
     }
     ListModel {
         id: groupedModel
     }
+    Connections {
+        target: applicationData
+        onFilesChanged: {
+            reloadList();
+        }
+    }
     Rectangle {
         anchors.top : text_input1.bottom
         anchors.topMargin: units.gu(2);
@@ -108,6 +113,14 @@ Page {
                             x:  parent.x + units.gu(1)
                             text: applicationData.describeFile(groupedList.currentIndex);
                         }
+                        Connections {
+                            target: applicationData
+                            onFileDescribed: {
+                                if(fileName === applicationData.getFiles()[groupedList.currentIndex]) {
+                                    textItemSingle.text = description;
+                                }
+                            }
+                        }
                     }
                     Scrollbar {
                         flickableItem: textItem
@@ -3,6 +3,7 @@ import Ubuntu.Components 0.1
 import Ubuntu.Components.ListItems 0.1 as ListItem
 import Ubuntu.Components.Popups 0.1
 import QtQuick.Window 2.0
+import OsmAnd 1.0
 
 
 Page {
@@ -32,24 +33,22 @@ Page {
 
             var l  = mapViewLayer.left(imgToDraw);
             var t  = mapViewLayer.top(imgToDraw);
-            context.drawImage(imgToDraw, l - mapMargin, t - mapMargin, canvas.width + 2 * mapMargin,
-                              canvas.height + 2 * mapMargin);
-
-            context.save();
-            drawRouteLayer(context);
-            context.restore();
-
-            context.save();
-            drawTargetLocation(context);
-            context.restore();
+            if(mapViewLayer.isRendered(imgToDraw)) {
+                // Rasterized from OBF: tile-aligned image, larger than canvas
+                context.drawImage(imgToDraw, l, t, mapViewLayer.right(imgToDraw) - l,
+                                  mapViewLayer.bottom(imgToDraw) - t);
+            } else {
+                context.drawImage(imgToDraw, l - mapMargin, t - mapMargin, canvas.width + 2 * mapMargin,
+                                  canvas.height + 2 * mapMargin);
+            }
 
-            context.save();
-            drawStartLocation(context);
-            context.restore();
+            routeLayer.update();
+            overlay.requestPaint();
         }
 
         onImageLoaded:  {
             canvas.unloadImage(imgToDraw, 0, 0);
+            mapViewLayer.releaseImage(imgToDraw);
             imgToDraw = nimgToDraw;
             canvas.requestPaint();
         }
@@ -70,6 +69,38 @@ Page {
             mapLayerData.setMapLatLonZoom(mapViewAdapter.getLat(), mapViewAdapter.getLon(), mapViewAdapter.getZoom());
         }
 
+        // Map image is drawn by canvas itself, route goes above it and below labels of overlay
+        RouteLayer {
+            id: routeLayer
+            anchors.fill: parent
+            layersData: mapLayerData
+            mapView: mapViewAdapter
+            color: Qt.rgba(0, 0, 0.9, 0.8)
+            lineWidth: 6
+        }
+
+        Canvas {
+            id: overlay
+            anchors.fill: parent
+            antialiasing: true;
+            onPaint: {
+                var context = overlay.getContext("2d");
+                context.clearRect(0, 0, overlay.width, overlay.height);
+
+                context.save();
+                drawRouteInstructions(context);
+                context.restore();
+
+                context.save();
+                drawTargetLocation(context);
+                context.restore();
+
+                context.save();
+                drawStartLocation(context);
+                context.restore();
+            }
+        }
+
         ActivityIndicator {
             id: activity;
             anchors.right: parent.right
@@ -101,6 +132,18 @@ Page {
             }
         }
 
+        Button {
+            id : offline
+            text : 'O'
+            anchors.top: parent.top
+            anchors.right: rotLeft.left
+            anchors.margins: units.gu(1)
+            onClicked: {
+                mapViewLayer.setOfflineMap(!mapViewLayer.isOfflineMap());
+                refreshMap(true);
+            }
+        }
+
         Button {
             id : zoomIn
             color: "green"
@@ -146,6 +189,8 @@ Page {
                     mouse.accepted =false;
                 } else if(rcontains(rotRight, mouse.x, mouse.y)) {
                     mouse.accepted =false;
+                } else if(rcontains(offline, mouse.x, mouse.y)) {
+                    mouse.accepted =false;
                 } else {
                     mouse.accepted = true;
                     px = mouse.x;
@@ -201,6 +246,10 @@ Page {
                         onClicked: {
                             mapLayerData.setTargetLatLon(lat, lon);
                             PopupUtils.close(popover)
+                            // Recalculated on warm routing context, superseding one still running
+                            if(mapLayerData.isRoutePresent()) {
+                                mapActions.calculateRoute();
+                            }
                             refreshMap(true);
                         }
                     }
@@ -216,6 +265,10 @@ Page {
                         onClicked: {
                             mapLayerData.setStartLatLon(lat, lon);
                             PopupUtils.close(popover)
+                            // Recalculated on warm routing context, superseding one still running
+                            if(mapLayerData.isRoutePresent()) {
+                                mapActions.calculateRoute();
+                            }
                             refreshMap(true);
                         }
                     }
@@ -260,11 +313,13 @@ Page {
 
     function refreshMapMessage(msg) {
         if(msg) console.log(msg);
-        refreshMap(true);
+        refreshMap(true, true);
     }
 
-    function refreshMap(force) {
-
+    function refreshMap(force, rendered) {
+        if(mapViewLayer.isOfflineMap() && !rendered) {
+            mapActions.rasterizeTiles(mapViewAdapter.getTiles(), mapViewAdapter.getZoom());
+        }
         activity.running = mapActions.isActivityRunning();
         if(canvas.nimgToDraw === canvas.imgToDraw || force) {
             canvas.counter ++;
@@ -277,38 +332,18 @@ Page {
     }
 
 
-    function drawRouteLayer(context) {
-        if(mapLayerData.getRoutePointLength() >  0) {
-            context.strokeStyle = Qt.rgba(0, 0,0.9,0.8);
-            context.lineWidth = 6;
-            context.beginPath();
-            for(var i = 0; i < mapLayerData.getRoutePointLength(); i++) {
-                var lat = mapLayerData.getRoutePointLat(i);
-                var lon = mapLayerData.getRoutePointLon(i);
-                var x = mapViewAdapter.getRotatedMapXForPoint(lat, lon);
-                var y = mapViewAdapter.getRotatedMapYForPoint(lat, lon);
-                if(i == 0) {
-                    context.moveTo(x, y);
-                } else {
-                    context.lineTo(x, y);
-                }
-            }
-            context.stroke();
-            context.beginPath();
+    function drawRouteInstructions(context) {
+        if(mapViewAdapter.getZoom() > 15) {
             context.lineWidth = 1;
             context.strokeStyle = Qt.rgba(0, 0,0,1);
-            if(mapViewAdapter.getZoom() > 15) {
-                for(var i = 0; i < mapLayerData.getRoutePointLength(); i++) {
-                    var txt = mapLayerData.getRoutePointText(i);
-                    if(txt != "") {
-                        var lat = mapLayerData.getRoutePointLat(i);
-                        var lon = mapLayerData.getRoutePointLon(i);
-                        var x = mapViewAdapter.getRotatedMapXForPoint(lat, lon);
-                        var y = mapViewAdapter.getRotatedMapYForPoint(lat, lon);
-                        context.strokeText(txt, x, y);
-                        context.fillText(txt, x, y);
-                    }
-                }
+            for(var i = 0; i < mapLayerData.getRouteInstructionLength(); i++) {
+                var txt = mapLayerData.getRouteInstructionText(i);
+                var lat = mapLayerData.getRouteInstructionLat(i);
+                var lon = mapLayerData.getRouteInstructionLon(i);
+                var x = mapViewAdapter.getRotatedMapXForPoint(lat, lon);
+                var y = mapViewAdapter.getRotatedMapYForPoint(lat, lon);
+                context.strokeText(txt, x, y);
+                context.fillText(txt, x, y);
             }
         }
     }
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "RouteGeometry.h"
+
+// Self-check of RouteGeometry on synthetic route: levels nest, keep route ends and instruction
+// points, and every dropped point stays within one pixel of its zoom from simplified polyline.
+
+namespace {
+
+const uint32_t RoutePoints = 200000;
+const uint32_t InstructionEvery = 5000;
+
+int failures = 0;
+
+void check(bool condition, const char* message, int zoom) {
+    if(!condition) {
+        std::printf("FAILED at zoom %d: %s\n", zoom, message);
+        failures++;
+    }
+}
+
+// Winding road of random small steps, deterministic for repeatable timings
+std::vector<OsmAnd::PointI> makeRoute() {
+    std::vector<OsmAnd::PointI> points;
+    points.reserve(RoutePoints);
+    uint32_t seed = 12345;
+    double x = 1200000000.0;
+    double y = 700000000.0;
+    double heading = 0.0;
+    for(uint32_t i = 0; i < RoutePoints; i++) {
+        seed = seed * 1103515245u + 12345u;
+        heading += ((seed >> 16) % 2001 - 1000) / 10000.0;
+        x += std::cos(heading) * 400.0;
+        y += std::sin(heading) * 400.0;
+        OsmAnd::PointI p;
+        p.x = static_cast<int32_t>(x);
+        p.y = static_cast<int32_t>(y);
+        points.push_back(p);
+    }
+    return points;
+}
+
+double segmentDistance(const OsmAnd::PointI& p, const OsmAnd::PointI& a, const OsmAnd::PointI& b) {
+    const double dx = static_cast<double>(b.x) - a.x;
+    const double dy = static_cast<double>(b.y) - a.y;
+    double px = static_cast<double>(p.x) - a.x;
+    double py = static_cast<double>(p.y) - a.y;
+    const double length2 = dx * dx + dy * dy;
+    if(length2 > 0) {
+        const double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / length2));
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return std::sqrt(px * px + py * py);
+}
+
+}
+
+int main() {
+    const std::vector<OsmAnd::PointI> points = makeRoute();
+    std::vector<RouteGeometry::Instruction> instructions;
+    for(uint32_t i = InstructionEvery / 2; i < RoutePoints; i += InstructionEvery) {
+        RouteGeometry::Instruction instruction = {i, "turn"};
+        instructions.push_back(instruction);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    RouteGeometry geometry(points, instructions);
+    const double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("Built %d levels of %u points in %.1f ms\n", geometry.getLevelsCount(), RoutePoints, buildTime);
+
+    const std::vector<uint32_t>* previous = nullptr;
+    for(int zoom = RouteGeometry::MinZoom; zoom < RouteGeometry::MinZoom + geometry.getLevelsCount(); zoom++) {
+        const std::vector<uint32_t>& level = geometry.getLevel(zoom);
+        std::printf("Zoom %d: %u points\n", zoom, static_cast<uint32_t>(level.size()));
+
+        check(!level.empty() && level.front() == 0 && level.back() == RoutePoints - 1, "route ends are dropped", zoom);
+        check(std::is_sorted(level.begin(), level.end()), "indices are not ordered", zoom);
+        for(auto itInstruction = instructions.begin(); itInstruction != instructions.end(); ++itInstruction) {
+            check(std::binary_search(level.begin(), level.end(), itInstruction->pointIndex), "instruction point is dropped", zoom);
+        }
+        if(previous) {
+            check(std::includes(level.begin(), level.end(), previous->begin(), previous->end()), "levels do not nest", zoom);
+        }
+
+        const double tolerance = static_cast<double>(1u << (31 - 8 - zoom));
+        double maxDeviation = 0.0;
+        for(size_t i = 1; i < level.size(); i++) {
+            for(uint32_t k = level[i - 1] + 1; k < level[i]; k++) {
+                maxDeviation = std::max(maxDeviation, segmentDistance(points[k], points[level[i - 1]], points[level[i]]));
+            }
+        }
+        check(maxDeviation <= tolerance, "dropped point deviates by more than one pixel", zoom);
+        previous = &level;
+    }
+    const int lastZoom = RouteGeometry::MinZoom + geometry.getLevelsCount() - 1;
+    check(lastZoom == RouteGeometry::MaxZoom || geometry.getLevel(lastZoom).size() == RoutePoints,
+          "finest level is incomplete", lastZoom);
+
+    std::printf(failures ? "%d checks failed\n" : "All checks passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+# Self-checks of application code that needs no map data, run by 'make check'
+QT -= gui
+CONFIG += console testcase
+CONFIG -= app_bundle
+TARGET = route-geometry-check
+
+SOURCES += RouteGeometryCheck.cpp \
+    ../cpp/RouteGeometry.cpp
+
+HEADERS += ../cpp/RouteGeometry.h
+
+QMAKE_CXXFLAGS += -std=c++11
+
+INCLUDEPATH += $$PWD/../../../core/include \
+               $$PWD/../../../core/include/native \
+               $$PWD/../cpp
+
+unix:!macx:
+LIBS += -L$$PWD/../../../binaries/linux/i686/Debug/ -lOsmAndCore
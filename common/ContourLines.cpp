@@ -0,0 +1,283 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "ContourLines.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <SkCanvas.h>
+#include <SkPaint.h>
+#include <SkPath.h>
+
+namespace
+{
+    const int MaxLevelsPerGrid = 4096;
+
+    // Edges of cell, corners being
+    //   a b
+    //   d c
+    enum Edge
+    {
+        TopEdge,    // a-b
+        RightEdge,  // b-c
+        BottomEdge, // d-c
+        LeftEdge,   // a-d
+    };
+
+    inline bool isValid(float height)
+    {
+        return height > ContourLines::NoData && height == height;
+    }
+
+    inline float crossing(float from, float to, float level)
+    {
+        return (level - from) / (to - from);
+    }
+
+    struct Cell
+    {
+        int x;
+        int y;
+        float a;
+        float b;
+        float c;
+        float d;
+
+        void point(Edge edge, float level, float& px, float& py) const
+        {
+            switch(edge)
+            {
+            case TopEdge:
+                px = x + crossing(a, b, level);
+                py = static_cast<float>(y);
+                break;
+            case RightEdge:
+                px = static_cast<float>(x + 1);
+                py = y + crossing(b, c, level);
+                break;
+            case BottomEdge:
+                px = x + crossing(d, c, level);
+                py = static_cast<float>(y + 1);
+                break;
+            case LeftEdge:
+                px = static_cast<float>(x);
+                py = y + crossing(a, d, level);
+                break;
+            }
+        }
+
+        void segment(Edge from, Edge to, float level, std::vector<float>& segments) const
+        {
+            float x0, y0, x1, y1;
+            point(from, level, x0, y0);
+            point(to, level, x1, y1);
+            segments.push_back(x0);
+            segments.push_back(y0);
+            segments.push_back(x1);
+            segments.push_back(y1);
+        }
+    };
+}
+
+size_t ContourLines::Isolines::segmentsCount() const
+{
+    size_t count = 0;
+    for(auto itLevel = levels.begin(); itLevel != levels.end(); ++itLevel)
+        count += itLevel->segments.size() / 4;
+    return count;
+}
+
+float ContourLines::intervalForZoom(int zoom)
+{
+    if(zoom >= 14)
+        return 10.0f;
+    if(zoom == 13)
+        return 20.0f;
+    if(zoom == 12)
+        return 50.0f;
+    if(zoom >= 10)
+        return 100.0f;
+    return 200.0f;
+}
+
+void ContourLines::extract(
+    const float* heights, size_t rowStride, int width, int height,
+    float interval,
+    Isolines& isolines)
+{
+    isolines.interval = interval;
+    isolines.levels.clear();
+    if(width < 2 || height < 2 || interval <= 0.0f)
+        return;
+
+    float minHeight = std::numeric_limits<float>::max();
+    float maxHeight = -std::numeric_limits<float>::max();
+    for(int y = 0; y < height; y++)
+    {
+        const auto row = heights + y * rowStride;
+        for(int x = 0; x < width; x++)
+        {
+            if(!isValid(row[x]))
+                continue;
+            minHeight = std::min(minHeight, row[x]);
+            maxHeight = std::max(maxHeight, row[x]);
+        }
+    }
+    if(minHeight > maxHeight)
+        return;
+
+    const auto firstLevel = static_cast<int>(std::ceil(minHeight / interval));
+    const auto lastLevel = std::min(static_cast<int>(std::floor(maxHeight / interval)), firstLevel + MaxLevelsPerGrid - 1);
+    if(lastLevel < firstLevel)
+        return;
+    isolines.levels.resize(lastLevel - firstLevel + 1);
+    for(int levelIdx = firstLevel; levelIdx <= lastLevel; levelIdx++)
+    {
+        auto& level = isolines.levels[levelIdx - firstLevel];
+        level.elevation = levelIdx * interval;
+        level.major = (levelIdx % MajorEvery) == 0;
+    }
+
+    Cell cell;
+    for(int y = 0; y < height - 1; y++)
+    {
+        const auto top = heights + y * rowStride;
+        const auto bottom = top + rowStride;
+        cell.y = y;
+
+        for(int x = 0; x < width - 1; x++)
+        {
+            cell.x = x;
+            cell.a = top[x];
+            cell.b = top[x + 1];
+            cell.c = bottom[x + 1];
+            cell.d = bottom[x];
+            if(!isValid(cell.a) || !isValid(cell.b) || !isValid(cell.c) || !isValid(cell.d))
+                continue;
+
+            const auto cellMin = std::min(std::min(cell.a, cell.b), std::min(cell.c, cell.d));
+            const auto cellMax = std::max(std::max(cell.a, cell.b), std::max(cell.c, cell.d));
+            const auto fromLevel = std::max(static_cast<int>(std::ceil(cellMin / interval)), firstLevel);
+            const auto toLevel = std::min(static_cast<int>(std::floor(cellMax / interval)), lastLevel);
+
+            for(int levelIdx = fromLevel; levelIdx <= toLevel; levelIdx++)
+            {
+                const auto level = levelIdx * interval;
+                const auto caseIdx =
+                    (cell.a >= level ? 8 : 0) |
+                    (cell.b >= level ? 4 : 0) |
+                    (cell.c >= level ? 2 : 0) |
+                    (cell.d >= level ? 1 : 0);
+                auto& segments = isolines.levels[levelIdx - firstLevel].segments;
+
+                switch(caseIdx)
+                {
+                case 0:
+                case 15:
+                    break;
+                case 1:
+                case 14:
+                    cell.segment(LeftEdge, BottomEdge, level, segments);
+                    break;
+                case 2:
+                case 13:
+                    cell.segment(BottomEdge, RightEdge, level, segments);
+                    break;
+                case 3:
+                case 12:
+                    cell.segment(LeftEdge, RightEdge, level, segments);
+                    break;
+                case 4:
+                case 11:
+                    cell.segment(TopEdge, RightEdge, level, segments);
+                    break;
+                case 6:
+                case 9:
+                    cell.segment(TopEdge, BottomEdge, level, segments);
+                    break;
+                case 7:
+                case 8:
+                    cell.segment(LeftEdge, TopEdge, level, segments);
+                    break;
+                case 5:
+                case 10:
+                    {
+                        // Saddle: corners that are above level are connected through center if center is above too
+                        const auto centerAbove = (cell.a + cell.b + cell.c + cell.d) * 0.25f >= level;
+                        const auto cutOffAC = (caseIdx == 5) == centerAbove;
+                        if(cutOffAC)
+                        {
+                            cell.segment(LeftEdge, TopEdge, level, segments);
+                            cell.segment(RightEdge, BottomEdge, level, segments);
+                        }
+                        else
+                        {
+                            cell.segment(TopEdge, RightEdge, level, segments);
+                            cell.segment(BottomEdge, LeftEdge, level, segments);
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    isolines.levels.erase(
+        std::remove_if(isolines.levels.begin(), isolines.levels.end(),
+            [](const Level& level)
+            {
+                return level.segments.empty();
+            }),
+        isolines.levels.end());
+}
+
+void ContourLines::draw(SkCanvas& canvas, const Isolines& isolines, float scale, float offsetX, float offsetY)
+{
+    // Minor and major lines go to two paths, so whole tile is two draw calls
+    SkPath minorPath;
+    SkPath majorPath;
+    for(auto itLevel = isolines.levels.begin(); itLevel != isolines.levels.end(); ++itLevel)
+    {
+        auto& path = itLevel->major ? majorPath : minorPath;
+        const auto& segments = itLevel->segments;
+        for(size_t idx = 0; idx + 3 < segments.size(); idx += 4)
+        {
+            path.moveTo(offsetX + segments[idx + 0] * scale, offsetY + segments[idx + 1] * scale);
+            path.lineTo(offsetX + segments[idx + 2] * scale, offsetY + segments[idx + 3] * scale);
+        }
+    }
+
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setStyle(SkPaint::kStroke_Style);
+    paint.setStrokeCap(SkPaint::kRound_Cap);
+
+    paint.setColor(SkColorSetARGB(0x90, 0x9B, 0x5A, 0x1E));
+    paint.setStrokeWidth(1.0f);
+    canvas.drawPath(minorPath, paint);
+
+    paint.setColor(SkColorSetARGB(0xD0, 0x9B, 0x5A, 0x1E));
+    paint.setStrokeWidth(1.8f);
+    canvas.drawPath(majorPath, paint);
+}
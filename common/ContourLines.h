@@ -0,0 +1,74 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __CONTOUR_LINES_H_
+#define __CONTOUR_LINES_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+class SkCanvas;
+
+// Contour lines (isolines) extracted from heightmap grid with marching squares, replacing
+// contours baked into OBFs by obf-generation/contours. Grid is walked row by row, so each
+// height is read from memory once per pair of rows, and all levels crossing a cell are
+// handled while cell is hot. Saddles are resolved by value in cell center.
+namespace ContourLines
+{
+    // Same as baked contours: heights below this are voids in SRTM data
+    const float NoData = -32768.0f;
+
+    // Every this many levels contour is major (e.g. 100m lines among 20m ones)
+    const int MajorEvery = 5;
+
+    struct Level
+    {
+        float elevation;
+        bool major;
+
+        // Segments as x0, y0, x1, y1 in grid coordinates
+        std::vector<float> segments;
+    };
+
+    struct Isolines
+    {
+        float interval;
+        std::vector<Level> levels;
+
+        size_t segmentsCount() const;
+    };
+
+    // Contour interval in meters suitable for zoom, denser when zoomed in
+    float intervalForZoom(int zoom);
+
+    // Heights are in meters, rowStride is in floats
+    void extract(
+        const float* heights, size_t rowStride, int width, int height,
+        float interval,
+        Isolines& isolines);
+
+    // Draws isolines, grid point (x, y) is placed at (offsetX + x * scale, offsetY + y * scale)
+    void draw(SkCanvas& canvas, const Isolines& isolines, float scale, float offsetX, float offsetY);
+}
+
+#endif // __CONTOUR_LINES_H_
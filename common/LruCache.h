@@ -0,0 +1,162 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __LRU_CACHE_H_
+#define __LRU_CACHE_H_
+
+#include <climits>
+#include <list>
+
+#include <QHash>
+
+// Values by key with least recently used entries evicted above capacity. Lookup, touch,
+// insert and removal are O(1). Key needs operator== and qHash(). Not thread-safe, owners
+// guard it with their own mutex. Owners that bound something else than count of entries
+// (e.g. bytes) leave capacity unlimited and evict through leastRecentKey() themselves.
+template<typename Key, typename Value>
+class LruCache
+{
+private:
+    typedef std::list<Key> Order;
+
+    struct Entry
+    {
+        Value value;
+        typename Order::iterator position;
+    };
+
+    int _capacity;
+    // Least recently used first
+    Order _order;
+    QHash<Key, Entry> _entries;
+
+    void evict(int& evicted)
+    {
+        while(_entries.size() > _capacity)
+        {
+            _entries.remove(_order.front());
+            _order.pop_front();
+            evicted++;
+        }
+    }
+public:
+    explicit LruCache(int capacity = INT_MAX)
+        : _capacity(capacity)
+    {
+    }
+
+    int capacity() const
+    {
+        return _capacity;
+    }
+
+    // Evicts least recently used entries above new capacity. Returns count of evicted entries.
+    int setCapacity(int capacity)
+    {
+        int evicted = 0;
+        _capacity = capacity;
+        evict(evicted);
+        return evicted;
+    }
+
+    int size() const
+    {
+        return _entries.size();
+    }
+
+    bool isEmpty() const
+    {
+        return _entries.isEmpty();
+    }
+
+    bool contains(const Key& key) const
+    {
+        return _entries.contains(key);
+    }
+
+    // Value of key marked as most recently used, nullptr if there is none
+    Value* touch(const Key& key)
+    {
+        const auto itEntry = _entries.find(key);
+        if(itEntry == _entries.end())
+            return nullptr;
+        _order.splice(_order.end(), _order, itEntry->position);
+        return &itEntry->value;
+    }
+
+    // Value of key without changing its place, nullptr if there is none
+    const Value* peek(const Key& key) const
+    {
+        const auto itEntry = _entries.constFind(key);
+        if(itEntry == _entries.constEnd())
+            return nullptr;
+        return &itEntry->value;
+    }
+
+    // Inserts or replaces value as most recently used, then evicts least recently used
+    // entries above capacity. Returns count of evicted entries.
+    int insert(const Key& key, const Value& value)
+    {
+        int evicted = 0;
+        auto itEntry = _entries.find(key);
+        if(itEntry != _entries.end())
+        {
+            itEntry->value = value;
+            _order.splice(_order.end(), _order, itEntry->position);
+            return evicted;
+        }
+
+        Entry entry;
+        entry.value = value;
+        entry.position = _order.insert(_order.end(), key);
+        _entries.insert(key, entry);
+        evict(evicted);
+        return evicted;
+    }
+
+    // Removes entry, handing its value over if requested. Returns false if there was none.
+    bool take(const Key& key, Value* value = nullptr)
+    {
+        const auto itEntry = _entries.find(key);
+        if(itEntry == _entries.end())
+            return false;
+        if(value)
+            *value = itEntry->value;
+        _order.erase(itEntry->position);
+        _entries.erase(itEntry);
+        return true;
+    }
+
+    // Key of least recently used entry, cache must not be empty
+    const Key& leastRecentKey() const
+    {
+        return _order.front();
+    }
+
+    void clear()
+    {
+        _entries.clear();
+        _order.clear();
+    }
+};
+
+#endif // __LRU_CACHE_H_
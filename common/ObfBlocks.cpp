@@ -0,0 +1,813 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObfBlocks.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+
+#if defined(Q_OS_WIN)
+#   include <windows.h>
+#endif
+
+namespace
+{
+    using namespace ObfBlocks;
+
+    const qint64 CopyChunkSize = 1024 * 1024;
+
+    // Records block field whose tag was just read, device is left at its end
+    bool readBlock(QIODevice& device, qint64 tagOffset, int wireType, int run, int group, SectionBlocks& blocks)
+    {
+        qint64 length;
+        if(!isLengthDelimited(wireType) || !readLength(device, wireType, length))
+            return false;
+        Block block;
+        block.offset = tagOffset;
+        block.headerLength = device.pos() - tagOffset;
+        block.length = block.headerLength + length;
+        block.run = run;
+        block.group = group;
+        block.hasBbox = false;
+        block.bbox31.left = block.bbox31.right = block.bbox31.top = block.bbox31.bottom = 0;
+        blocks.blocks.push_back(block);
+        return device.seek(tagOffset + block.length);
+    }
+
+    bool readShift(QIODevice& device, qint64 base, int group, const OsmAnd::AreaI* bbox31, SectionBlocks& blocks)
+    {
+        Reference reference;
+        reference.position = device.pos();
+        reference.base = base;
+        reference.group = group;
+        reference.hasBbox = bbox31 != nullptr;
+        if(bbox31)
+            reference.bbox31 = *bbox31;
+        else
+            reference.bbox31.left = reference.bbox31.right = reference.bbox31.top = reference.bbox31.bottom = 0;
+        if(!readFixed32(device, reference.value))
+            return false;
+        blocks.references.push_back(reference);
+        return true;
+    }
+
+    // Map and routing boxes: sint32 bounds relative to parent, shift to data relative to
+    // contents of box, children boxes
+    bool readBoxTree(QIODevice& device, qint64 end, const OsmAnd::AreaI& parent, int group,
+        int shiftField, int boxesField, SectionBlocks& blocks)
+    {
+        const auto base = device.pos();
+        OsmAnd::AreaI bbox31 = parent;
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field >= 1 && field <= 4 && wireType == WireVarint)
+            {
+                uint64_t value;
+                if(!readVarint(device, value))
+                    return false;
+                const auto delta = decodeZigZag(value);
+                if(field == 1)
+                    bbox31.left = parent.left + delta;
+                else if(field == 2)
+                    bbox31.right = parent.right + delta;
+                else if(field == 3)
+                    bbox31.top = parent.top + delta;
+                else
+                    bbox31.bottom = parent.bottom + delta;
+            }
+            else if(field == shiftField && wireType == WireFixed32)
+            {
+                if(!readShift(device, base, group, &bbox31, blocks))
+                    return false;
+            }
+            else if(field == boxesField && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto childEnd = device.pos() + length;
+                if(!readBoxTree(device, childEnd, bbox31, group, shiftField, boxesField, blocks) || !device.seek(childEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readMapLevel(QIODevice& device, qint64 end, int level, SectionBlocks& blocks)
+    {
+        OsmAnd::AreaI bbox31;
+        bbox31.left = bbox31.right = bbox31.top = bbox31.bottom = 0;
+        bool inRun = false;
+        while(device.pos() < end)
+        {
+            const auto tagOffset = device.pos();
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == MapLevelBlocks)
+            {
+                if(!inRun)
+                    blocks.runsCount++;
+                inRun = true;
+                if(!readBlock(device, tagOffset, wireType, blocks.runsCount - 1, level, blocks))
+                    return false;
+                continue;
+            }
+            inRun = false;
+            if(field >= MapLevelLeft && field <= MapLevelBottom && wireType == WireVarint)
+            {
+                uint64_t value;
+                if(!readVarint(device, value))
+                    return false;
+                const auto coordinate = static_cast<int32_t>(value);
+                if(field == MapLevelLeft)
+                    bbox31.left = coordinate;
+                else if(field == MapLevelRight)
+                    bbox31.right = coordinate;
+                else if(field == MapLevelTop)
+                    bbox31.top = coordinate;
+                else
+                    bbox31.bottom = coordinate;
+            }
+            else if(field == MapLevelBoxes && isLengthDelimited(wireType))
+            {
+                // Root boxes are relative to bounds of level, which precede them
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto boxEnd = device.pos() + length;
+                if(!readBoxTree(device, boxEnd, bbox31, 0, MapBoxShiftToData, MapBoxBoxes, blocks) || !device.seek(boxEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readMapSection(QIODevice& device, qint64 end, SectionBlocks& blocks)
+    {
+        int level = 0;
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == MapIndexLevels && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto levelEnd = device.pos() + length;
+                if(!readMapLevel(device, levelEnd, level++, blocks) || !device.seek(levelEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readRoutingSection(QIODevice& device, qint64 end, SectionBlocks& blocks)
+    {
+        bool inRun = false;
+        while(device.pos() < end)
+        {
+            const auto tagOffset = device.pos();
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == RoutingIndexBlocks)
+            {
+                if(!inRun)
+                    blocks.runsCount++;
+                inRun = true;
+                if(!readBlock(device, tagOffset, wireType, blocks.runsCount - 1, 0, blocks))
+                    return false;
+                continue;
+            }
+            inRun = false;
+            if((field == RoutingIndexRootBoxes || field == RoutingIndexBasemapBoxes) && isLengthDelimited(wireType))
+            {
+                // Root boxes have no parent, so their deltas are absolute
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto boxEnd = device.pos() + length;
+                OsmAnd::AreaI origin;
+                origin.left = origin.right = origin.top = origin.bottom = 0;
+                const int group = field == RoutingIndexBasemapBoxes ? 1 : 0;
+                if(!readBoxTree(device, boxEnd, origin, group, RouteBoxShiftToData, RouteBoxBoxes, blocks) || !device.seek(boxEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // POI boxes and name index atoms shift to data relative to contents of section
+    bool readPoiBoxes(QIODevice& device, qint64 end, qint64 base, SectionBlocks& blocks)
+    {
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == PoiBoxShiftToData && wireType == WireFixed32)
+            {
+                if(!readShift(device, base, 0, nullptr, blocks))
+                    return false;
+            }
+            else if(field == PoiBoxSubBoxes && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto childEnd = device.pos() + length;
+                if(!readPoiBoxes(device, childEnd, base, blocks) || !device.seek(childEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readPoiNameIndex(QIODevice& device, qint64 end, qint64 base, int depth, SectionBlocks& blocks)
+    {
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            // Name index -> data -> atoms
+            const auto nestedField = depth == 0 ? PoiNameIndexData : PoiNameIndexDataAtoms;
+            if(depth < 2 && field == nestedField && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto nestedEnd = device.pos() + length;
+                if(!readPoiNameIndex(device, nestedEnd, base, depth + 1, blocks) || !device.seek(nestedEnd))
+                    return false;
+            }
+            else if(depth == 2 && field == PoiNameIndexAtomShiftTo && wireType == WireFixed32)
+            {
+                if(!readShift(device, base, 0, nullptr, blocks))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Tile of POI data block is the first fields of its contents
+    void readPoiDataTile(QIODevice& device, Block& block)
+    {
+        const auto end = block.offset + block.length;
+        if(!device.seek(block.offset + block.headerLength))
+            return;
+        uint32_t zoom = 0, x = 0, y = 0;
+        int fieldsRead = 0;
+        while(device.pos() < end && fieldsRead < 3)
+        {
+            int field, wireType;
+            uint64_t value;
+            if(!readTag(device, field, wireType) || wireType != WireVarint || !readVarint(device, value))
+                return;
+            if(field == PoiDataZoom)
+                zoom = static_cast<uint32_t>(value);
+            else if(field == PoiDataX)
+                x = static_cast<uint32_t>(value);
+            else if(field == PoiDataY)
+                y = static_cast<uint32_t>(value);
+            else
+                return;
+            fieldsRead++;
+        }
+        if(fieldsRead != 3 || zoom > 31)
+            return;
+        const auto shift = 31 - zoom;
+        block.group = static_cast<int>(zoom);
+        block.hasBbox = true;
+        block.bbox31.left = static_cast<int32_t>(x << shift);
+        block.bbox31.top = static_cast<int32_t>(y << shift);
+        block.bbox31.right = static_cast<int32_t>(((x + 1) << shift) - 1);
+        block.bbox31.bottom = static_cast<int32_t>(((y + 1) << shift) - 1);
+    }
+
+    bool readPoiSection(QIODevice& device, qint64 contentOffset, qint64 end, SectionBlocks& blocks)
+    {
+        bool inRun = false;
+        while(device.pos() < end)
+        {
+            const auto tagOffset = device.pos();
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == PoiIndexData)
+            {
+                if(!inRun)
+                    blocks.runsCount++;
+                inRun = true;
+                if(!readBlock(device, tagOffset, wireType, blocks.runsCount - 1, 0, blocks))
+                    return false;
+                continue;
+            }
+            inRun = false;
+            if((field == PoiIndexBoxes || field == PoiIndexNameIndex) && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto nestedEnd = device.pos() + length;
+                const auto ok = field == PoiIndexBoxes
+                    ? readPoiBoxes(device, nestedEnd, contentOffset, blocks)
+                    : readPoiNameIndex(device, nestedEnd, contentOffset, 0, blocks);
+                if(!ok || !device.seek(nestedEnd))
+                    return false;
+            }
+            else if(!skipField(device, wireType))
+            {
+                return false;
+            }
+        }
+
+        for(auto itBlock = blocks.blocks.begin(); itBlock != blocks.blocks.end(); ++itBlock)
+            readPoiDataTile(device, *itBlock);
+        return true;
+    }
+
+    bool readSectionName(QIODevice& device, Section& section)
+    {
+        const int nameField = section.type == SectionType::Map ? MapIndexName
+            : (section.type == SectionType::Routing ? RoutingIndexName : PoiIndexName);
+        int field, wireType;
+        if(section.contentOffset >= section.end || !readTag(device, field, wireType))
+            return false;
+        if(field != nameField || wireType != WireLengthDelimited)
+            return true;
+        uint64_t length;
+        if(!readVarint(device, length) || length > 64 * 1024)
+            return false;
+        section.name = QString::fromUtf8(device.read(static_cast<qint64>(length)));
+        return true;
+    }
+}
+
+bool ObfBlocks::readVarint(QIODevice& device, uint64_t& value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64; shift += 7)
+    {
+        char byte;
+        if(!device.getChar(&byte))
+            return false;
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(byte) & 0x7F) << shift;
+        if((static_cast<uint8_t>(byte) & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ObfBlocks::writeVarint(QIODevice& device, uint64_t value)
+{
+    char bytes[10];
+    int size = 0;
+    do
+    {
+        bytes[size] = static_cast<char>(value & 0x7F);
+        value >>= 7;
+        if(value != 0)
+            bytes[size] |= static_cast<char>(0x80);
+        size++;
+    } while(value != 0);
+    return device.write(bytes, size) == size;
+}
+
+bool ObfBlocks::readTag(QIODevice& device, int& field, int& wireType)
+{
+    uint64_t tag;
+    if(!readVarint(device, tag))
+        return false;
+    field = static_cast<int>(tag >> 3);
+    wireType = static_cast<int>(tag & 7);
+    return true;
+}
+
+bool ObfBlocks::isLengthDelimited(int wireType)
+{
+    return wireType == WireLengthDelimited || wireType == WireFixed32LengthDelimited;
+}
+
+bool ObfBlocks::readFixed32(QIODevice& device, uint32_t& value)
+{
+    uint8_t bytes[4];
+    if(device.read(reinterpret_cast<char*>(bytes), 4) != 4)
+        return false;
+    value = (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    return true;
+}
+
+bool ObfBlocks::writeFixed32(QIODevice& device, uint32_t value)
+{
+    const char bytes[4] = {
+        static_cast<char>(value >> 24),
+        static_cast<char>(value >> 16),
+        static_cast<char>(value >> 8),
+        static_cast<char>(value)
+    };
+    return device.write(bytes, 4) == 4;
+}
+
+bool ObfBlocks::readLength(QIODevice& device, int wireType, qint64& length)
+{
+    if(wireType == WireFixed32LengthDelimited)
+    {
+        uint32_t value;
+        if(!readFixed32(device, value))
+            return false;
+        length = value;
+        return true;
+    }
+    uint64_t value;
+    if(wireType != WireLengthDelimited || !readVarint(device, value))
+        return false;
+    length = static_cast<qint64>(value);
+    return true;
+}
+
+bool ObfBlocks::skipField(QIODevice& device, int wireType)
+{
+    uint64_t value;
+    qint64 length;
+    switch(wireType)
+    {
+    case WireVarint:
+        return readVarint(device, value);
+    case WireFixed64:
+        return device.seek(device.pos() + 8);
+    case WireLengthDelimited:
+    case WireFixed32LengthDelimited:
+        return readLength(device, wireType, length) && device.seek(device.pos() + length);
+    case WireFixed32:
+        return device.seek(device.pos() + 4);
+    }
+    return false;
+}
+
+int ObfBlocks::varintSize(uint64_t value)
+{
+    int size = 1;
+    while(value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+ObfBlocks::MessageReader::MessageReader()
+    : _data(nullptr)
+    , _end(nullptr)
+{
+}
+
+ObfBlocks::MessageReader::MessageReader(const char* data, qint64 size)
+    : _data(reinterpret_cast<const uint8_t*>(data))
+    , _end(reinterpret_cast<const uint8_t*>(data) + size)
+{
+}
+
+bool ObfBlocks::MessageReader::atEnd() const
+{
+    return _data >= _end;
+}
+
+bool ObfBlocks::MessageReader::readVarint(uint64_t& value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64 && _data < _end; shift += 7)
+    {
+        const uint8_t byte = *_data++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ObfBlocks::MessageReader::readTag(int& field, int& wireType)
+{
+    uint64_t tag;
+    if(!readVarint(tag))
+        return false;
+    field = static_cast<int>(tag >> 3);
+    wireType = static_cast<int>(tag & 7);
+    return true;
+}
+
+bool ObfBlocks::MessageReader::readFixed32(uint32_t& value)
+{
+    if(_end - _data < 4)
+        return false;
+    value = (static_cast<uint32_t>(_data[0]) << 24) | (_data[1] << 16) | (_data[2] << 8) | _data[3];
+    _data += 4;
+    return true;
+}
+
+bool ObfBlocks::MessageReader::readMessage(MessageReader& message, int wireType)
+{
+    uint64_t length;
+    if(wireType == WireFixed32LengthDelimited)
+    {
+        uint32_t fixedLength;
+        if(!readFixed32(fixedLength))
+            return false;
+        length = fixedLength;
+    }
+    else if(wireType != WireLengthDelimited || !readVarint(length))
+    {
+        return false;
+    }
+    if(length > static_cast<uint64_t>(_end - _data))
+        return false;
+    message = MessageReader(reinterpret_cast<const char*>(_data), static_cast<qint64>(length));
+    _data += length;
+    return true;
+}
+
+bool ObfBlocks::MessageReader::readString(QString& value, int wireType)
+{
+    MessageReader message;
+    if(!readMessage(message, wireType))
+        return false;
+    value = QString::fromUtf8(reinterpret_cast<const char*>(message._data), static_cast<int>(message._end - message._data));
+    return true;
+}
+
+bool ObfBlocks::MessageReader::skip(int wireType)
+{
+    uint64_t value;
+    uint32_t fixedValue;
+    MessageReader message;
+    switch(wireType)
+    {
+    case WireVarint:
+        return readVarint(value);
+    case WireFixed64:
+        if(_end - _data < 8)
+            return false;
+        _data += 8;
+        return true;
+    case WireLengthDelimited:
+    case WireFixed32LengthDelimited:
+        return readMessage(message, wireType);
+    case WireFixed32:
+        return readFixed32(fixedValue);
+    }
+    return false;
+}
+
+bool ObfBlocks::readStructure(QIODevice& device, std::vector<Section>& sections, QString& error)
+{
+    sections.clear();
+    if(!device.seek(0))
+    {
+        error = "Failed to read OBF";
+        return false;
+    }
+    const auto size = device.size();
+    while(device.pos() < size)
+    {
+        Section section;
+        section.offset = device.pos();
+        if(!readTag(device, section.field, section.wireType))
+        {
+            error = QString("Broken OBF structure at %1").arg(section.offset);
+            return false;
+        }
+        if(!isLengthDelimited(section.wireType))
+        {
+            // Version and its confirmation
+            if(!skipField(device, section.wireType))
+            {
+                error = QString("Broken OBF structure at %1").arg(section.offset);
+                return false;
+            }
+            continue;
+        }
+        qint64 length;
+        if(!readLength(device, section.wireType, length) || device.pos() + length > size)
+        {
+            error = QString("Broken OBF section at %1").arg(section.offset);
+            return false;
+        }
+        section.contentOffset = device.pos();
+        section.end = section.contentOffset + length;
+        if(section.field == StructureMapIndex)
+            section.type = SectionType::Map;
+        else if(section.field == StructureRoutingIndex)
+            section.type = SectionType::Routing;
+        else if(section.field == StructurePoiIndex)
+            section.type = SectionType::Poi;
+        else
+            section.type = SectionType::Other;
+        if(section.type != SectionType::Other)
+            readSectionName(device, section);
+        sections.push_back(section);
+        if(!device.seek(section.end))
+        {
+            error = QString("Broken OBF section at %1").arg(section.offset);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ObfBlocks::readSectionBlocks(QIODevice& device, const Section& section, SectionBlocks& blocks, QString& error)
+{
+    blocks.blocks.clear();
+    blocks.references.clear();
+    blocks.runsCount = 0;
+    if(!device.seek(section.contentOffset))
+    {
+        error = "Failed to read OBF";
+        return false;
+    }
+
+    bool ok = false;
+    if(section.type == SectionType::Map)
+        ok = readMapSection(device, section.end, blocks);
+    else if(section.type == SectionType::Routing)
+        ok = readRoutingSection(device, section.end, blocks);
+    else if(section.type == SectionType::Poi)
+        ok = readPoiSection(device, section.contentOffset, section.end, blocks);
+    if(!ok)
+    {
+        error = QString("Broken %1 section '%2' at %3").arg(sectionTypeName(section.type)).arg(section.name).arg(section.offset);
+        return false;
+    }
+
+    // Map and routing blocks are placed where box referring to them is
+    for(auto itReference = blocks.references.begin(); itReference != blocks.references.end(); ++itReference)
+    {
+        if(!itReference->hasBbox)
+            continue;
+        const auto blockIdx = findBlock(blocks.blocks, itReference->target());
+        if(blockIdx < 0 || blocks.blocks[blockIdx].hasBbox)
+            continue;
+        auto& block = blocks.blocks[blockIdx];
+        block.hasBbox = true;
+        block.bbox31 = itReference->bbox31;
+        if(section.type == SectionType::Routing)
+            block.group = itReference->group;
+    }
+    return true;
+}
+
+int ObfBlocks::findBlock(const std::vector<Block>& blocks, qint64 position)
+{
+    auto itBlock = std::upper_bound(blocks.begin(), blocks.end(), position,
+        [](qint64 value, const Block& block) { return value < block.offset; });
+    if(itBlock == blocks.begin())
+        return -1;
+    --itBlock;
+    if(position >= itBlock->offset + itBlock->length)
+        return -1;
+    return static_cast<int>(itBlock - blocks.begin());
+}
+
+bool ObfBlocks::resolveTargetOffset(const SectionBlocks& blocks, qint64& targetOffset, QString& error)
+{
+    targetOffset = -1;
+    for(auto itReference = blocks.references.begin(); itReference != blocks.references.end(); ++itReference)
+    {
+        const auto blockIdx = findBlock(blocks.blocks, itReference->target());
+        if(blockIdx < 0)
+        {
+            error = QString("shift at %1 points outside of data blocks").arg(itReference->position);
+            return false;
+        }
+        const auto& block = blocks.blocks[blockIdx];
+        const auto offset = itReference->target() - block.offset;
+        if(offset > block.headerLength || (targetOffset >= 0 && offset != targetOffset))
+        {
+            error = QString("shift at %1 points into contents of block at %2").arg(itReference->position).arg(block.offset);
+            return false;
+        }
+        targetOffset = offset;
+    }
+    if(targetOffset < 0)
+        targetOffset = 0;
+    return true;
+}
+
+bool ObfBlocks::copyRange(QIODevice& input, qint64 inputOffset, QIODevice& output, qint64 outputOffset, qint64 length)
+{
+    if(!input.seek(inputOffset) || !output.seek(outputOffset))
+        return false;
+    while(length > 0)
+    {
+        const auto chunk = input.read(std::min(length, CopyChunkSize));
+        if(chunk.isEmpty() || output.write(chunk) != chunk.size())
+            return false;
+        length -= chunk.size();
+    }
+    return true;
+}
+
+bool ObfBlocks::replaceFile(const QString& path, const QString& targetPath)
+{
+#if defined(Q_OS_WIN)
+    const auto nativePath = QDir::toNativeSeparators(path);
+    const auto nativeTargetPath = QDir::toNativeSeparators(targetPath);
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(nativePath.utf16()), reinterpret_cast<const wchar_t*>(nativeTargetPath.utf16()),
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    // rename() replaces existing target atomically
+    return std::rename(QFile::encodeName(path).constData(), QFile::encodeName(targetPath).constData()) == 0;
+#endif
+}
+
+uint64_t ObfBlocks::hilbertIndex(uint32_t x31, uint32_t y31)
+{
+    const uint32_t n = 1u << 16;
+    uint32_t x = x31 >> 15;
+    uint32_t y = y31 >> 15;
+    uint64_t index = 0;
+    for(uint32_t s = n / 2; s > 0; s /= 2)
+    {
+        const uint32_t rx = (x & s) ? 1 : 0;
+        const uint32_t ry = (y & s) ? 1 : 0;
+        index += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // Rotate quadrant so that curve stays continuous
+        if(ry == 0)
+        {
+            if(rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+const char* ObfBlocks::sectionTypeName(SectionType type)
+{
+    switch(type)
+    {
+    case SectionType::Map:
+        return "map";
+    case SectionType::Routing:
+        return "routing";
+    case SectionType::Poi:
+        return "POI";
+    default:
+        return "other";
+    }
+}
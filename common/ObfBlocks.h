@@ -0,0 +1,278 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBF_BLOCKS_H_
+#define __OBF_BLOCKS_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <QIODevice>
+#include <QString>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Common.h>
+
+// Walks OBF structure down to encoded data blocks of map, routing and POI sections without
+// decoding their contents. Blocks are reachable only through fixed32 shifts stored in box trees
+// (and POI name index), so knowing both blocks and references to them is enough to move blocks
+// around while keeping file readable.
+namespace ObfBlocks
+{
+    // Fields of OsmAndStructure, see OBF.proto
+    enum
+    {
+        StructureVersion = 1,
+        StructureTransportIndex = 4,
+        StructureMapIndex = 6,
+        StructureAddressIndex = 7,
+        StructurePoiIndex = 8,
+        StructureRoutingIndex = 9,
+        StructureVersionConfirm = 32,
+    };
+
+    // Fields of section messages
+    enum
+    {
+        MapIndexName = 2,
+        MapIndexRules = 4,
+        MapIndexLevels = 5,
+        MapLevelMaxZoom = 1,
+        MapLevelMinZoom = 2,
+        MapLevelLeft = 3,
+        MapLevelRight = 4,
+        MapLevelTop = 5,
+        MapLevelBottom = 6,
+        MapLevelBoxes = 7,
+        MapLevelBlocks = 15,
+        MapBoxLeft = 1,
+        MapBoxRight = 2,
+        MapBoxTop = 3,
+        MapBoxBottom = 4,
+        MapBoxShiftToData = 5,
+        MapBoxBoxes = 7,
+
+        RoutingIndexName = 1,
+        RoutingIndexRules = 2,
+        RoutingIndexRootBoxes = 3,
+        RoutingIndexBasemapBoxes = 4,
+        RoutingIndexBlocks = 5,
+        RouteBoxLeft = 1,
+        RouteBoxRight = 2,
+        RouteBoxTop = 3,
+        RouteBoxBottom = 4,
+        RouteBoxShiftToData = 5,
+        RouteBoxBoxes = 7,
+
+        PoiIndexName = 1,
+        PoiIndexBoundaries = 2,
+        PoiIndexCategoriesTable = 3,
+        PoiIndexNameIndex = 4,
+        PoiIndexBoxes = 6,
+        PoiIndexData = 9,
+        PoiBoxSubBoxes = 10,
+        PoiBoxShiftToData = 14,
+        PoiNameIndexData = 5,
+        PoiNameIndexDataAtoms = 3,
+        PoiNameIndexAtomShiftTo = 14,
+        PoiDataZoom = 1,
+        PoiDataX = 2,
+        PoiDataY = 3,
+        PoiDataAtoms = 5,
+        PoiCategoryTableCategory = 1,
+        PoiCategoryTableSubcategories = 3,
+        PoiAtomDx = 2,
+        PoiAtomDy = 3,
+        PoiAtomCategories = 4,
+        PoiAtomName = 6,
+        PoiAtomNameEn = 7,
+        PoiAtomId = 8,
+
+        AddressIndexName = 1,
+        AddressIndexCities = 6,
+        CitiesIndexType = 2,
+        CitiesIndexCities = 5,
+        CitiesIndexBlocks = 7,
+        CityName = 2,
+        CityNameEn = 3,
+        CityX = 5,
+        CityY = 6,
+        CityBlockShiftToCity = 4,
+        CityBlockStreets = 12,
+        StreetName = 1,
+        StreetNameEn = 2,
+        StreetX = 3,
+        StreetY = 4,
+        StreetBuildings = 12,
+        BuildingName = 1,
+        BuildingNameEn = 2,
+        BuildingName2 = 3,
+        BuildingX = 7,
+        BuildingY = 8,
+        BuildingX2 = 9,
+        BuildingY2 = 10,
+
+        TransportIndexName = 1,
+    };
+
+    // Types of CitiesIndex
+    enum
+    {
+        CitiesTypeCities = 1,
+        CitiesTypePostcodes = 2,
+        CitiesTypeVillages = 3,
+    };
+
+    // OBF protobuf adds wire type for messages prefixed by big-endian fixed32 length
+    enum
+    {
+        WireVarint = 0,
+        WireFixed64 = 1,
+        WireLengthDelimited = 2,
+        WireFixed32 = 5,
+        WireFixed32LengthDelimited = 6,
+    };
+
+    bool readVarint(QIODevice& device, uint64_t& value);
+    bool writeVarint(QIODevice& device, uint64_t value);
+    bool readTag(QIODevice& device, int& field, int& wireType);
+    bool isLengthDelimited(int wireType);
+    // Fixed32 values of OBF (lengths and shifts) are big-endian
+    bool readFixed32(QIODevice& device, uint32_t& value);
+    bool writeFixed32(QIODevice& device, uint32_t value);
+    // Length prefix of field with given wire type
+    bool readLength(QIODevice& device, int wireType, qint64& length);
+    bool skipField(QIODevice& device, int wireType);
+    int varintSize(uint64_t value);
+    inline int32_t decodeZigZag(uint64_t value)
+    {
+        return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    // Message already read into memory, for decoding contents of blocks
+    class MessageReader
+    {
+    public:
+        MessageReader();
+        MessageReader(const char* data, qint64 size);
+
+        bool atEnd() const;
+        bool readVarint(uint64_t& value);
+        bool readTag(int& field, int& wireType);
+        bool readFixed32(uint32_t& value);
+        // Nested message or string with length prefix of given wire type
+        bool readMessage(MessageReader& message, int wireType);
+        bool readString(QString& value, int wireType);
+        bool skip(int wireType);
+
+    private:
+        const uint8_t* _data;
+        const uint8_t* _end;
+    };
+
+    enum class SectionType
+    {
+        Map,
+        Routing,
+        Poi,
+        Other,
+    };
+
+    // Top-level field of OsmAndStructure
+    struct Section
+    {
+        SectionType type;
+        int field;
+        int wireType;
+        // Offset of field tag and end of its contents
+        qint64 offset;
+        qint64 end;
+        // Offset of contents, after length prefix
+        qint64 contentOffset;
+        QString name;
+    };
+
+    struct Block
+    {
+        // Offset of field tag, length covers tag, length prefix and contents
+        qint64 offset;
+        qint64 length;
+        qint64 headerLength;
+        // Blocks of one run are adjacent in file, nothing else lies between them
+        int run;
+        // Map level, routing tree (0 - detailed, 1 - basemap) or POI zoom
+        int group;
+        bool hasBbox;
+        OsmAnd::AreaI bbox31;
+    };
+
+    // Fixed32 field holding position of block as shift from base
+    struct Reference
+    {
+        qint64 position;
+        qint64 base;
+        uint32_t value;
+        // Routing tree of referring box, otherwise 0
+        int group;
+        // Box that refers to block, if any
+        bool hasBbox;
+        OsmAnd::AreaI bbox31;
+
+        qint64 target() const { return base + value; }
+    };
+
+    struct SectionBlocks
+    {
+        // In file order
+        std::vector<Block> blocks;
+        std::vector<Reference> references;
+        int runsCount;
+    };
+
+    // Reads top-level sections, their contents are skipped
+    bool readStructure(QIODevice& device, std::vector<Section>& sections, QString& error);
+
+    // Collects blocks and references of map, routing or POI section, bbox of block is taken
+    // from its own header (POI) or from first box referring to it (map, routing)
+    bool readSectionBlocks(QIODevice& device, const Section& section, SectionBlocks& blocks, QString& error);
+
+    // Index of block that contains position, -1 if none
+    int findBlock(const std::vector<Block>& blocks, qint64 position);
+
+    // Offset of reference targets within their blocks, all references of section must agree
+    // and point into block header. Returns false if they don't, section then can't be relaid out.
+    bool resolveTargetOffset(const SectionBlocks& blocks, qint64& targetOffset, QString& error);
+
+    // Copies byte range between devices in bounded chunks
+    bool copyRange(QIODevice& input, qint64 inputOffset, QIODevice& output, qint64 outputOffset, qint64 length);
+
+    // Atomically replaces target by file at path, old target stays intact on failure. For outputs
+    // that are read back and verified before they are published, which QSaveFile does not allow.
+    bool replaceFile(const QString& path, const QString& targetPath);
+
+    // Position along Hilbert curve of order 16 over 31-coordinates
+    uint64_t hilbertIndex(uint32_t x31, uint32_t y31);
+
+    const char* sectionTypeName(SectionType type);
+}
+
+#endif // __OBF_BLOCKS_H_
@@ -0,0 +1,692 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "ObfHeaderIndex.h"
+
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+#include <OsmAndCore/Logging.h>
+
+#include "ObfBlocks.h"
+
+const QString ObfHeaderIndex::defaultIndexFilename("obf-headers.idx");
+
+namespace
+{
+    using namespace ObfBlocks;
+
+    const uint32_t IndexMagic = 0x4948424F; // "OBHI"
+    // 2: files that failed to scan are stored too
+    const uint32_t FormatVersion = 2;
+
+    bool readString(QIODevice& device, int wireType, QString& value)
+    {
+        qint64 length;
+        if(!readLength(device, wireType, length) || length > 64 * 1024)
+            return false;
+        const auto data = device.read(length);
+        if(data.size() != static_cast<int>(length))
+            return false;
+        value = QString::fromUtf8(data);
+        return true;
+    }
+
+    void uniteBbox(ObfHeaderIndex::Section& section, const OsmAnd::AreaI& bbox31)
+    {
+        if(!section.hasBbox)
+        {
+            section.bbox31 = bbox31;
+            section.hasBbox = true;
+            return;
+        }
+        section.bbox31.left = std::min(section.bbox31.left, bbox31.left);
+        section.bbox31.top = std::min(section.bbox31.top, bbox31.top);
+        section.bbox31.right = std::max(section.bbox31.right, bbox31.right);
+        section.bbox31.bottom = std::max(section.bbox31.bottom, bbox31.bottom);
+    }
+
+    inline bool intersects(const OsmAnd::AreaI& a, const OsmAnd::AreaI& b)
+    {
+        return !(a.right < b.left || b.right < a.left || a.bottom < b.top || b.bottom < a.top);
+    }
+
+    // Reads fields 1-4 of a box message up to end, coordinates are decoded by caller
+    bool readBox(QIODevice& device, qint64 end, bool zigZag, OsmAnd::AreaI& bbox31)
+    {
+        int fieldsRead = 0;
+        while(device.pos() < end && fieldsRead < 4)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field < 1 || field > 4 || wireType != WireVarint)
+                break;
+            uint64_t value;
+            if(!readVarint(device, value))
+                return false;
+            const auto coordinate = zigZag ? decodeZigZag(value) : static_cast<int32_t>(value);
+            if(field == 1)
+                bbox31.left = coordinate;
+            else if(field == 2)
+                bbox31.right = coordinate;
+            else if(field == 3)
+                bbox31.top = coordinate;
+            else
+                bbox31.bottom = coordinate;
+            fieldsRead++;
+        }
+        return fieldsRead == 4;
+    }
+
+    // Each reader reads only what is needed to place section on map and stops at first field it
+    // does not expect, section end is then reached by seek
+    bool readMapSection(QIODevice& device, qint64 end, ObfHeaderIndex::Section& section)
+    {
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == MapIndexName)
+            {
+                if(!readString(device, wireType, section.name))
+                    return false;
+            }
+            else if(field == MapIndexRules)
+            {
+                if(!skipField(device, wireType))
+                    return false;
+            }
+            else if(field == MapIndexLevels)
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto levelEnd = device.pos() + length;
+
+                int minZoom = -1;
+                int maxZoom = -1;
+                OsmAnd::AreaI bbox31;
+                int boundsRead = 0;
+                while(device.pos() < levelEnd)
+                {
+                    int levelField, levelWireType;
+                    if(!readTag(device, levelField, levelWireType))
+                        return false;
+                    if(levelField < MapLevelMaxZoom || levelField > MapLevelBottom || levelWireType != WireVarint)
+                        break;
+                    uint64_t value;
+                    if(!readVarint(device, value))
+                        return false;
+                    if(levelField == MapLevelMaxZoom)
+                        maxZoom = static_cast<int>(value);
+                    else if(levelField == MapLevelMinZoom)
+                        minZoom = static_cast<int>(value);
+                    else
+                    {
+                        const auto coordinate = static_cast<int32_t>(value);
+                        if(levelField == MapLevelLeft)
+                            bbox31.left = coordinate;
+                        else if(levelField == MapLevelRight)
+                            bbox31.right = coordinate;
+                        else if(levelField == MapLevelTop)
+                            bbox31.top = coordinate;
+                        else
+                            bbox31.bottom = coordinate;
+                        boundsRead++;
+                    }
+                }
+                if(boundsRead == 4)
+                    uniteBbox(section, bbox31);
+                if(minZoom >= 0)
+                    section.minZoom = section.minZoom < 0 ? minZoom : std::min(section.minZoom, minZoom);
+                if(maxZoom >= 0)
+                    section.maxZoom = std::max(section.maxZoom, maxZoom);
+
+                if(!device.seek(levelEnd))
+                    return false;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool readRoutingSection(QIODevice& device, qint64 end, ObfHeaderIndex::Section& section)
+    {
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == RoutingIndexName)
+            {
+                if(!readString(device, wireType, section.name))
+                    return false;
+            }
+            else if(field == RoutingIndexRules)
+            {
+                if(!skipField(device, wireType))
+                    return false;
+            }
+            else if(field == RoutingIndexRootBoxes || field == RoutingIndexBasemapBoxes)
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto boxEnd = device.pos() + length;
+
+                // Root boxes have no parent, so their deltas are absolute
+                OsmAnd::AreaI bbox31;
+                if(readBox(device, boxEnd, true, bbox31))
+                    uniteBbox(section, bbox31);
+
+                if(!device.seek(boxEnd))
+                    return false;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool readPoiSection(QIODevice& device, qint64 end, ObfHeaderIndex::Section& section)
+    {
+        while(device.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(device, field, wireType))
+                return false;
+            if(field == PoiIndexName)
+            {
+                if(!readString(device, wireType, section.name))
+                    return false;
+            }
+            else if(field == PoiIndexBoundaries)
+            {
+                qint64 length;
+                if(!readLength(device, wireType, length))
+                    return false;
+                const auto boxEnd = device.pos() + length;
+
+                OsmAnd::AreaI bbox31;
+                if(readBox(device, boxEnd, false, bbox31))
+                    uniteBbox(section, bbox31);
+
+                if(!device.seek(boxEnd))
+                    return false;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool readNamedSection(QIODevice& device, qint64 end, int nameField, ObfHeaderIndex::Section& section)
+    {
+        if(device.pos() >= end)
+            return true;
+
+        int field, wireType;
+        if(!readTag(device, field, wireType))
+            return false;
+        if(field == nameField)
+            return readString(device, wireType, section.name);
+        return true;
+    }
+
+    void writeFile(QDataStream& stream, const ObfHeaderIndex::File& file)
+    {
+        stream << file.path << file.size << file.modified << static_cast<qint32>(file.version) << static_cast<quint32>(file.sections.size());
+        for(auto itSection = file.sections.begin(); itSection != file.sections.end(); ++itSection)
+        {
+            const auto& section = *itSection;
+            stream << static_cast<qint32>(section.type) << section.name << section.offset << section.length << section.hasBbox
+                << section.bbox31.left << section.bbox31.top << section.bbox31.right << section.bbox31.bottom
+                << static_cast<qint32>(section.minZoom) << static_cast<qint32>(section.maxZoom);
+        }
+    }
+
+    bool readFile(QDataStream& stream, ObfHeaderIndex::File& file)
+    {
+        qint32 fileVersion;
+        quint32 sectionsCount;
+        stream >> file.path >> file.size >> file.modified >> fileVersion >> sectionsCount;
+        file.version = fileVersion;
+        for(quint32 sectionIdx = 0; sectionIdx < sectionsCount && stream.status() == QDataStream::Ok; sectionIdx++)
+        {
+            ObfHeaderIndex::Section section;
+            qint32 type, minZoom, maxZoom;
+            stream >> type >> section.name >> section.offset >> section.length >> section.hasBbox
+                >> section.bbox31.left >> section.bbox31.top >> section.bbox31.right >> section.bbox31.bottom
+                >> minZoom >> maxZoom;
+            section.type = static_cast<ObfHeaderIndex::SectionType>(type);
+            section.minZoom = minZoom;
+            section.maxZoom = maxZoom;
+            file.sections.push_back(section);
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool isSameFile(const ObfHeaderIndex::File& file, const QFileInfo& fileInfo)
+    {
+        return file.size == fileInfo.size() && file.modified == fileInfo.lastModified().toMSecsSinceEpoch();
+    }
+}
+
+class ObfHeaderIndex::ScanTask : public QRunnable
+{
+    const QString _path;
+    File* const _file;
+    char* const _ok;
+public:
+    ScanTask(const QString& path, File* file, char* ok)
+        : _path(path)
+        , _file(file)
+        , _ok(ok)
+    {
+    }
+
+    void run()
+    {
+        *_ok = ObfHeaderIndex::scanFile(_path, *_file);
+    }
+};
+
+ObfHeaderIndex::ObfHeaderIndex(const QString& indexPath)
+    : _indexPath(indexPath)
+{
+    _counters.files = 0;
+    _counters.sections = 0;
+    _counters.scannedOnRefresh = 0;
+    _counters.reusedOnRefresh = 0;
+    _counters.failedFiles = 0;
+    _counters.skippedFailedOnRefresh = 0;
+    _counters.openReaders = 0;
+    _counters.lastRefreshTime = 0.0f;
+}
+
+ObfHeaderIndex::~ObfHeaderIndex()
+{
+}
+
+bool ObfHeaderIndex::scanFile(const QString& path, File& file)
+{
+    QFile device(path);
+    if(!device.open(QIODevice::ReadOnly))
+        return false;
+
+    const QFileInfo fileInfo(path);
+    file.path = fileInfo.absoluteFilePath();
+    file.size = fileInfo.size();
+    file.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+    file.version = -1;
+    file.sections.clear();
+
+    // Version is first field of OsmAndStructure
+    int field, wireType;
+    uint64_t version;
+    if(!readTag(device, field, wireType) || field != StructureVersion || wireType != WireVarint || !readVarint(device, version))
+        return false;
+    file.version = static_cast<int>(version);
+
+    std::vector<ObfBlocks::Section> structure;
+    QString error;
+    if(!readStructure(device, structure, error))
+        return false;
+
+    for(auto itStructure = structure.begin(); itStructure != structure.end(); ++itStructure)
+    {
+        const auto& structureSection = *itStructure;
+        Section section;
+        section.hasBbox = false;
+        section.bbox31.left = section.bbox31.top = section.bbox31.right = section.bbox31.bottom = 0;
+        section.minZoom = -1;
+        section.maxZoom = -1;
+        section.offset = structureSection.contentOffset;
+        section.length = structureSection.end - structureSection.contentOffset;
+        if(!device.seek(section.offset))
+            return false;
+
+        bool ok = false;
+        if(structureSection.field == StructureMapIndex)
+        {
+            section.type = SectionType::Map;
+            ok = readMapSection(device, structureSection.end, section);
+        }
+        else if(structureSection.field == StructureRoutingIndex)
+        {
+            section.type = SectionType::Routing;
+            ok = readRoutingSection(device, structureSection.end, section);
+        }
+        else if(structureSection.field == StructurePoiIndex)
+        {
+            section.type = SectionType::Poi;
+            ok = readPoiSection(device, structureSection.end, section);
+        }
+        else if(structureSection.field == StructureAddressIndex)
+        {
+            section.type = SectionType::Address;
+            ok = readNamedSection(device, structureSection.end, AddressIndexName, section);
+        }
+        else if(structureSection.field == StructureTransportIndex)
+        {
+            section.type = SectionType::Transport;
+            ok = readNamedSection(device, structureSection.end, TransportIndexName, section);
+        }
+        else
+        {
+            continue;
+        }
+        if(!ok)
+            return false;
+
+        file.sections.push_back(section);
+    }
+
+    return true;
+}
+
+bool ObfHeaderIndex::loadIndex(QMap<QString, File>& files, QMap<QString, File>& failedFiles) const
+{
+    QFile indexFile(_indexPath);
+    if(!indexFile.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&indexFile);
+    quint32 magic, version, count, failedCount;
+    stream >> magic >> version >> count;
+    if(stream.status() != QDataStream::Ok || magic != IndexMagic || version != FormatVersion)
+        return false;
+
+    for(quint32 fileIdx = 0; fileIdx < count; fileIdx++)
+    {
+        File file;
+        if(!readFile(stream, file))
+            return false;
+        files.insert(file.path, file);
+    }
+    stream >> failedCount;
+    for(quint32 fileIdx = 0; fileIdx < failedCount && stream.status() == QDataStream::Ok; fileIdx++)
+    {
+        File file;
+        if(!readFile(stream, file))
+            return false;
+        failedFiles.insert(file.path, file);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool ObfHeaderIndex::saveIndex(const QMap<QString, File>& files, const QMap<QString, File>& failedFiles) const
+{
+    // Old index stays in place until new one is complete
+    QSaveFile indexFile(_indexPath);
+    if(!indexFile.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&indexFile);
+    stream << static_cast<quint32>(IndexMagic) << static_cast<quint32>(FormatVersion) << static_cast<quint32>(files.size());
+    for(auto itFile = files.begin(); itFile != files.end(); ++itFile)
+        writeFile(stream, *itFile);
+    stream << static_cast<quint32>(failedFiles.size());
+    for(auto itFile = failedFiles.begin(); itFile != failedFiles.end(); ++itFile)
+        writeFile(stream, *itFile);
+    if(stream.status() != QDataStream::Ok)
+    {
+        indexFile.cancelWriting();
+        return false;
+    }
+    return indexFile.commit();
+}
+
+void ObfHeaderIndex::refresh(const QStringList& paths)
+{
+    QMutexLocker refreshLock(&_refreshMutex);
+    const auto refreshStart = std::chrono::high_resolution_clock::now();
+
+    QMap<QString, File> known;
+    QMap<QString, File> knownFailed;
+    {
+        QMutexLocker scopeLock(&_mutex);
+        known = _files;
+        knownFailed = _failedFiles;
+    }
+    // First refresh of process starts from persisted index
+    if(known.isEmpty() && knownFailed.isEmpty() && !loadIndex(known, knownFailed))
+    {
+        known.clear();
+        knownFailed.clear();
+    }
+
+    // Unchanged files are matched by stat only, files that failed to scan are not retried
+    // until they change
+    QMap<QString, File> files;
+    QMap<QString, File> failedFiles;
+    QStringList changed;
+    for(auto itPath = paths.begin(); itPath != paths.end(); ++itPath)
+    {
+        const QFileInfo fileInfo(*itPath);
+        const auto path = fileInfo.absoluteFilePath();
+        const auto itKnown = known.find(path);
+        const auto itKnownFailed = knownFailed.find(path);
+        if(itKnown != known.end() && isSameFile(*itKnown, fileInfo))
+            files.insert(path, *itKnown);
+        else if(itKnownFailed != knownFailed.end() && isSameFile(*itKnownFailed, fileInfo))
+            failedFiles.insert(path, *itKnownFailed);
+        else
+            changed.push_back(path);
+    }
+    const auto reusedCount = files.size();
+    const auto skippedFailedCount = failedFiles.size();
+
+    std::vector<File> scanned(changed.size());
+    std::vector<char> scannedOk(changed.size(), 0);
+    if(!changed.isEmpty())
+    {
+        // Headers are few small reads scattered over file, so more threads than cores pay off on disks too
+        QThreadPool scanThreadPool;
+        scanThreadPool.setMaxThreadCount(std::max(4, QThread::idealThreadCount() * 2));
+        for(int idx = 0; idx < changed.size(); idx++)
+            scanThreadPool.start(new ScanTask(changed[idx], &scanned[idx], &scannedOk[idx]));
+        scanThreadPool.waitForDone();
+    }
+    for(int idx = 0; idx < changed.size(); idx++)
+    {
+        if(scannedOk[idx])
+        {
+            files.insert(scanned[idx].path, scanned[idx]);
+            continue;
+        }
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to read OBF header of '%s'\n", qPrintable(changed[idx]));
+
+        // Only stat is kept, so that unchanged broken file is skipped next time
+        const QFileInfo fileInfo(changed[idx]);
+        File failedFile;
+        failedFile.path = changed[idx];
+        failedFile.size = fileInfo.size();
+        failedFile.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        failedFile.version = -1;
+        failedFiles.insert(failedFile.path, failedFile);
+    }
+
+    const auto indexChanged = !changed.isEmpty() || files.size() != known.size() || failedFiles.size() != knownFailed.size();
+    const auto snapshot = files;
+    const auto failedSnapshot = failedFiles;
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        // Readers of removed and changed files are dropped, queries in flight keep theirs
+        for(auto itReader = _readers.begin(); itReader != _readers.end(); )
+        {
+            const auto itFile = files.find(itReader.key());
+            if(itFile == files.end() || changed.contains(itReader.key()))
+                itReader = _readers.erase(itReader);
+            else
+                ++itReader;
+        }
+        _files.swap(files);
+        _failedFiles.swap(failedFiles);
+
+        _counters.files = _files.size();
+        _counters.sections = 0;
+        for(auto itFile = _files.begin(); itFile != _files.end(); ++itFile)
+            _counters.sections += itFile->sections.size();
+        _counters.scannedOnRefresh = changed.size();
+        _counters.reusedOnRefresh = reusedCount;
+        _counters.failedFiles = _failedFiles.size();
+        _counters.skippedFailedOnRefresh = skippedFailedCount;
+        _counters.openReaders = _readers.size();
+        _counters.lastRefreshTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - refreshStart).count();
+    }
+
+    if(indexChanged && !saveIndex(snapshot, failedSnapshot))
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to save OBF header index '%s'\n", qPrintable(_indexPath));
+}
+
+QList<ObfHeaderIndex::File> ObfHeaderIndex::getFiles() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    return _files.values();
+}
+
+bool ObfHeaderIndex::getFile(const QString& path, File& file) const
+{
+    const auto absolutePath = QFileInfo(path).absoluteFilePath();
+    QMutexLocker scopeLock(&_mutex);
+
+    const auto itFile = _files.find(absolutePath);
+    if(itFile == _files.end())
+        return false;
+    file = *itFile;
+    return true;
+}
+
+QList<ObfHeaderIndex::Reader> ObfHeaderIndex::obtainReaders(const OsmAnd::AreaI& bbox31, SectionType type, int zoom)
+{
+    // Keyed by path, so that readers always come in the same order and may be locked together
+    QMap<QString, Reader> readers;
+    QStringList toOpen;
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        for(auto itFile = _files.begin(); itFile != _files.end(); ++itFile)
+        {
+            bool matches = false;
+            for(auto itSection = itFile->sections.begin(); itSection != itFile->sections.end() && !matches; ++itSection)
+            {
+                const auto& section = *itSection;
+                if(section.type != type)
+                    continue;
+                if(section.hasBbox && !intersects(section.bbox31, bbox31))
+                    continue;
+                if(zoom >= 0 && section.minZoom >= 0 && (zoom < section.minZoom || zoom > section.maxZoom))
+                    continue;
+                matches = true;
+            }
+            if(!matches)
+                continue;
+
+            const auto itReader = _readers.find(itFile.key());
+            if(itReader != _readers.end())
+                readers.insert(itFile.key(), *itReader);
+            else
+                toOpen.push_back(itFile.key());
+        }
+    }
+
+    // Full parse of file header is done without lock, concurrent open of same file is resolved on insert
+    for(auto itPath = toOpen.begin(); itPath != toOpen.end(); ++itPath)
+    {
+        const auto reader = obtainReader(*itPath);
+        if(reader.obfReader)
+            readers.insert(*itPath, reader);
+    }
+
+    return readers.values();
+}
+
+QList<ObfHeaderIndex::Reader> ObfHeaderIndex::obtainReaders(SectionType type)
+{
+    OsmAnd::AreaI world31;
+    world31.left = 0;
+    world31.top = 0;
+    world31.right = std::numeric_limits<int32_t>::max();
+    world31.bottom = std::numeric_limits<int32_t>::max();
+    return obtainReaders(world31, type);
+}
+
+ObfHeaderIndex::Reader ObfHeaderIndex::obtainReader(const QString& path)
+{
+    const auto absolutePath = QFileInfo(path).absoluteFilePath();
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        if(!_files.contains(absolutePath))
+            return Reader();
+        const auto itReader = _readers.find(absolutePath);
+        if(itReader != _readers.end())
+            return *itReader;
+    }
+
+    Reader reader;
+    reader.path = absolutePath;
+    reader.obfReader.reset(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(absolutePath))));
+    reader.mutex.reset(new QMutex());
+
+    QMutexLocker scopeLock(&_mutex);
+
+    if(!_files.contains(absolutePath))
+        return Reader();
+    const auto itReader = _readers.find(absolutePath);
+    if(itReader != _readers.end())
+        return *itReader;
+    _readers.insert(absolutePath, reader);
+    _counters.openReaders = _readers.size();
+    return reader;
+}
+
+ObfHeaderIndex::Counters ObfHeaderIndex::getCounters() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    return _counters;
+}
@@ -0,0 +1,150 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __OBF_HEADER_INDEX_H_
+#define __OBF_HEADER_INDEX_H_
+
+#include <stdint.h>
+#include <memory>
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Data/ObfReader.h>
+
+// Index of OBF files built from their section headers only, persisted between runs.
+//
+// Building ObfReader parses every section of file, which for directory of regional maps
+// takes seconds. Here only top-level section headers are read (names, map levels with
+// their zooms and bounds, routing root boxes, POI bounds), new or changed files are
+// scanned in parallel, and the result is stored in small file keyed by path, size and
+// modification time, so unchanged files are not even opened on next start. Files that
+// fail to scan are remembered the same way and are not retried until they change.
+// ObfReader of a file is created only when query first touches bounds of its section
+// of requested type, and is kept open for following queries.
+class ObfHeaderIndex
+{
+public:
+    static const QString defaultIndexFilename;
+
+    enum class SectionType
+    {
+        Map,
+        Routing,
+        Poi,
+        Address,
+        Transport,
+    };
+
+    struct Section
+    {
+        SectionType type;
+        QString name;
+        qint64 offset;
+        qint64 length;
+        // Sections which have no bounds in header match any query
+        bool hasBbox;
+        OsmAnd::AreaI bbox31;
+        // Zooms covered by map levels, -1 for other sections
+        int minZoom;
+        int maxZoom;
+    };
+
+    struct File
+    {
+        QString path;
+        qint64 size;
+        qint64 modified;
+        int version;
+        QList<Section> sections;
+    };
+
+    // ObfReader reads through single file handle, so queries on it must be serialized
+    struct Reader
+    {
+        // Absolute path of file
+        QString path;
+        std::shared_ptr<OsmAnd::ObfReader> obfReader;
+        std::shared_ptr<QMutex> mutex;
+    };
+
+    struct Counters
+    {
+        int files;
+        int sections;
+        int scannedOnRefresh;
+        int reusedOnRefresh;
+        // Files whose header could not be read, they are rescanned only once changed
+        int failedFiles;
+        int skippedFailedOnRefresh;
+        int openReaders;
+        float lastRefreshTime;
+    };
+
+private:
+    const QString _indexPath;
+
+    QMutex _refreshMutex;
+    mutable QMutex _mutex;
+    QMap<QString, File> _files;
+    // Size and modification time of files that failed to scan
+    QMap<QString, File> _failedFiles;
+    QMap<QString, Reader> _readers;
+    Counters _counters;
+
+    class ScanTask;
+
+    bool loadIndex(QMap<QString, File>& files, QMap<QString, File>& failedFiles) const;
+    bool saveIndex(const QMap<QString, File>& files, const QMap<QString, File>& failedFiles) const;
+public:
+    ObfHeaderIndex(const QString& indexPath);
+    virtual ~ObfHeaderIndex();
+
+    // Brings index in line with given files: scans headers of new and changed ones
+    // in parallel, forgets removed ones and persists index if anything changed
+    void refresh(const QStringList& paths);
+
+    // Reads section headers of single file
+    static bool scanFile(const QString& path, File& file);
+
+    QList<File> getFiles() const;
+    // Headers of single indexed file, false if file is not in index
+    bool getFile(const QString& path, File& file) const;
+
+    // Readers of files that have section of given type intersecting bbox (and for map
+    // sections, with level for zoom, unless zoom is -1). Readers are opened on first use
+    // and come ordered by path, so several of them can be locked without deadlock.
+    QList<Reader> obtainReaders(const OsmAnd::AreaI& bbox31, SectionType type, int zoom = -1);
+    // Readers of all files that have section of given type
+    QList<Reader> obtainReaders(SectionType type);
+    // Reader of single indexed file, empty if file is not in index
+    Reader obtainReader(const QString& path);
+
+    Counters getCounters() const;
+};
+
+#endif // __OBF_HEADER_INDEX_H_
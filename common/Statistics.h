@@ -0,0 +1,47 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __STATISTICS_H_
+#define __STATISTICS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Statistics
+{
+    // Nearest-rank percentile (0..100) of samples, 0 if there are none. Samples are taken by
+    // value and sorted, so callers may pass them in any order.
+    inline double percentile(std::vector<double> samples, double percent)
+    {
+        if(samples.empty())
+            return 0.0;
+        std::sort(samples.begin(), samples.end());
+        auto rank = static_cast<size_t>(std::ceil(percent / 100.0 * samples.size()));
+        if(rank > 0)
+            rank--;
+        return samples[std::min(rank, samples.size() - 1)];
+    }
+}
+
+#endif // __STATISTICS_H_
@@ -0,0 +1,48 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TextNormalization.h"
+
+QString TextNormalization::normalize(const QString& text)
+{
+    const auto decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString result;
+    result.reserve(decomposed.size());
+    bool pendingSpace = false;
+    for(auto itChar = decomposed.begin(); itChar != decomposed.end(); ++itChar)
+    {
+        const QChar c = *itChar;
+        if(c.isMark())
+            continue;
+        if(!c.isLetterOrNumber())
+        {
+            pendingSpace = true;
+            continue;
+        }
+        if(pendingSpace && !result.isEmpty())
+            result.append(' ');
+        pendingSpace = false;
+        result.append(c.toLower());
+    }
+    return result;
+}
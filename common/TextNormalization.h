@@ -0,0 +1,36 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __TEXT_NORMALIZATION_H_
+#define __TEXT_NORMALIZATION_H_
+
+#include <QString>
+
+// Names as tools compare them, so that index built by one tool and queries of another agree
+namespace TextNormalization
+{
+    // Lowercase words of letters and digits without diacritics, joined by single spaces
+    QString normalize(const QString& text);
+}
+
+#endif // __TEXT_NORMALIZATION_H_
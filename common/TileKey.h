@@ -0,0 +1,68 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TILE_KEY_H_
+#define __TILE_KEY_H_
+
+#include <stdint.h>
+
+#include <QHash>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+
+// Tile and its zoom as key of QHash or LruCache
+struct TileKey
+{
+    int32_t x;
+    int32_t y;
+    int zoom;
+
+    static TileKey make(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom)
+    {
+        TileKey key;
+        key.x = tileId.x;
+        key.y = tileId.y;
+        key.zoom = static_cast<int>(zoom);
+        return key;
+    }
+
+    OsmAnd::TileId tileId() const
+    {
+        OsmAnd::TileId tileId;
+        tileId.x = x;
+        tileId.y = y;
+        return tileId;
+    }
+
+    bool operator==(const TileKey& that) const
+    {
+        return x == that.x && y == that.y && zoom == that.zoom;
+    }
+};
+
+inline uint qHash(const TileKey& key)
+{
+    return qHash((static_cast<quint64>(static_cast<uint32_t>(key.x)) << 32) | static_cast<uint32_t>(key.y)) ^ static_cast<uint>(key.zoom);
+}
+
+#endif // __TILE_KEY_H_
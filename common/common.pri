@@ -0,0 +1,17 @@
+# Code shared by several tools, for qmake projects. CMake builds it as OsmAndToolsCommon library.
+SOURCES += \
+    $$PWD/ObfBlocks.cpp \
+    $$PWD/ObfHeaderIndex.cpp \
+    $$PWD/ContourLines.cpp \
+    $$PWD/TextNormalization.cpp
+
+HEADERS += \
+    $$PWD/ObfBlocks.h \
+    $$PWD/ObfHeaderIndex.h \
+    $$PWD/LruCache.h \
+    $$PWD/TileKey.h \
+    $$PWD/Statistics.h \
+    $$PWD/ContourLines.h \
+    $$PWD/TextNormalization.h
+
+INCLUDEPATH += $$PWD
@@ -0,0 +1,534 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VariantsRasterizer.h"
+
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include <SkBitmap.h>
+#include <SkCanvas.h>
+#include <SkDevice.h>
+#include <SkImageEncoder.h>
+
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Data/ObfReader.h>
+#include <OsmAndCore/Data/ObfMapSection.h>
+#include <OsmAndCore/Map/Rasterizer.h>
+#include <OsmAndCore/Map/RasterizerContext.h>
+#include <OsmAndCore/Map/RasterizationStyles.h>
+#include <OsmAndCore/Map/RasterizationStyle.h>
+#include <OsmAndCore/Map/HeightmapTileProvider.h>
+#include <OsmAndCore/Map/IMapElevationDataProvider.h>
+
+#include "ContourLines.h"
+
+namespace
+{
+    // Heightmap tile that is not delivered in time is left without contours
+    const std::chrono::seconds ElevationTileTimeout(30);
+}
+
+VariantsRasterizer::Configuration::Configuration()
+    : zoom(15)
+    , tileSide(256)
+    , is32bit(false)
+    , verbose(false)
+    , threads(0)
+    , contours(false)
+{
+    bbox.left = bbox.right = bbox.top = bbox.bottom = 0.0;
+}
+
+bool VariantsRasterizer::isMultiVariantRequest(const QStringList& args)
+{
+    int stylesCount = 0;
+    int densitiesCount = 0;
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-style="))
+            stylesCount += arg.mid(strlen("-style=")).split(',', QString::SkipEmptyParts).size();
+        else if(arg.startsWith("-density="))
+            densitiesCount += arg.mid(strlen("-density=")).split(',', QString::SkipEmptyParts).size();
+        else if(arg == "-contours")
+            return true;
+    }
+    return stylesCount > 1 || densitiesCount > 1;
+}
+
+bool VariantsRasterizer::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    bool wasObfRootSpecified = false;
+    bool wasHeightsDirSpecified = false;
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-stylesPath="))
+        {
+            auto path = arg.mid(strlen("-stylesPath="));
+            QDir dir(path);
+            if(!dir.exists())
+            {
+                error = "Style directory '" + path + "' does not exist";
+                return false;
+            }
+
+            OsmAnd::Utilities::findFiles(dir, QStringList() << "*.render.xml", cfg.styleFiles);
+        }
+        else if(arg.startsWith("-style="))
+        {
+            // Same style given twice would write the same output files twice
+            const auto names = arg.mid(strlen("-style=")).split(',', QString::SkipEmptyParts);
+            for(auto itName = names.begin(); itName != names.end(); ++itName)
+            {
+                if(!cfg.styleNames.contains(*itName, Qt::CaseInsensitive))
+                    cfg.styleNames.push_back(*itName);
+            }
+        }
+        else if(arg.startsWith("-density="))
+        {
+            const auto values = arg.mid(strlen("-density=")).split(',', QString::SkipEmptyParts);
+            for(auto itValue = values.begin(); itValue != values.end(); ++itValue)
+            {
+                bool ok = false;
+                const auto density = itValue->toFloat(&ok);
+                if(!ok || density <= 0.0f)
+                {
+                    error = "Invalid density '" + *itValue + "'";
+                    return false;
+                }
+                if(!cfg.densities.contains(density))
+                    cfg.densities.push_back(density);
+            }
+        }
+        else if(arg.startsWith("-obfsDir="))
+        {
+            QDir obfRoot(arg.mid(strlen("-obfsDir=")));
+            if(!obfRoot.exists())
+            {
+                error = "OBF directory does not exist";
+                return false;
+            }
+            OsmAnd::Utilities::findFiles(obfRoot, QStringList() << "*.obf", cfg.obfFiles);
+            wasObfRootSpecified = true;
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else if(arg == "-32bit")
+        {
+            cfg.is32bit = true;
+        }
+        else if(arg.startsWith("-zoom="))
+        {
+            cfg.zoom = arg.mid(strlen("-zoom=")).toUInt();
+        }
+        else if(arg.startsWith("-tileSide="))
+        {
+            cfg.tileSide = arg.mid(strlen("-tileSide=")).toUInt();
+        }
+        else if(arg.startsWith("-threads="))
+        {
+            cfg.threads = arg.mid(strlen("-threads=")).toInt();
+        }
+        else if(arg.startsWith("-bbox="))
+        {
+            auto values = arg.mid(strlen("-bbox=")).split(",");
+            if(values.size() != 4)
+            {
+                error = "Invalid bbox '" + arg.mid(strlen("-bbox=")) + "'";
+                return false;
+            }
+            cfg.bbox.left = values[0].toDouble();
+            cfg.bbox.top = values[1].toDouble();
+            cfg.bbox.right = values[2].toDouble();
+            cfg.bbox.bottom = values[3].toDouble();
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.output = arg.mid(strlen("-output="));
+        }
+        else if(arg == "-contours")
+        {
+            cfg.contours = true;
+        }
+        else if(arg.startsWith("-heightsDir="))
+        {
+            cfg.heightsDir = QDir(arg.mid(strlen("-heightsDir=")));
+            if(!cfg.heightsDir.exists())
+            {
+                error = "Heights directory does not exist";
+                return false;
+            }
+            wasHeightsDirSpecified = true;
+        }
+    }
+    if(!wasObfRootSpecified)
+        OsmAnd::Utilities::findFiles(QDir::current(), QStringList() << "*.obf", cfg.obfFiles);
+
+    if(cfg.styleNames.isEmpty())
+    {
+        error = "At least one style is required";
+        return false;
+    }
+    if(cfg.densities.isEmpty())
+        cfg.densities.push_back(1.0f);
+    if(cfg.contours && !wasHeightsDirSpecified)
+    {
+        error = "Contour lines require heights directory";
+        return false;
+    }
+    if(cfg.output.isEmpty())
+    {
+        error = "Output path is required to rasterize several variants or contour lines";
+        return false;
+    }
+    if(cfg.zoom > 31 || cfg.tileSide == 0)
+    {
+        error = "Invalid zoom or tile side";
+        return false;
+    }
+
+    return true;
+}
+
+QString VariantsRasterizer::variantOutputPath(const Configuration& cfg, const QString& styleName, float density)
+{
+    const QFileInfo outputInfo(cfg.output);
+    // Only last suffix is the format, dots before it belong to name
+    auto suffix = outputInfo.suffix();
+    if(suffix.isEmpty())
+        suffix = "png";
+    const auto fileName = QString("%1.%2@%3x.%4")
+        .arg(outputInfo.completeBaseName())
+        .arg(styleName)
+        .arg(density)
+        .arg(suffix);
+    return outputInfo.dir().absoluteFilePath(fileName);
+}
+
+namespace VariantsRasterizer
+{
+    struct Variant
+    {
+        QString styleName;
+        float density;
+    };
+
+    // Parsed style keeps evaluation state and is not safe to share between threads, so every
+    // rasterizing thread resolves its own instances. Collection owns its styles and has to outlive them.
+    struct Styles
+    {
+        OsmAnd::RasterizationStyles collection;
+        QHash< QString, std::shared_ptr<OsmAnd::RasterizationStyle> > byName;
+    };
+
+    static bool resolveStyles(const Configuration& cfg, Styles& styles, std::ostream* output)
+    {
+        for(auto itStyleFile = cfg.styleFiles.begin(); itStyleFile != cfg.styleFiles.end(); ++itStyleFile)
+        {
+            auto styleFile = *itStyleFile;
+
+            if(!styles.collection.registerStyle(*styleFile) && output)
+                *output << "Failed to parse metadata of '" << styleFile->fileName().toStdString() << "' or duplicate style" << std::endl;
+        }
+        for(auto itStyleName = cfg.styleNames.begin(); itStyleName != cfg.styleNames.end(); ++itStyleName)
+        {
+            std::shared_ptr<OsmAnd::RasterizationStyle> style;
+            if(!styles.collection.obtainStyle(*itStyleName, style))
+            {
+                if(output)
+                    *output << "Failed to resolve style '" << itStyleName->toStdString() << "'" << std::endl;
+                return false;
+            }
+            styles.byName.insert(*itStyleName, style);
+        }
+        return true;
+    }
+
+    // Isolines of one heightmap tile and where its grid starts in output image (at density 1)
+    struct ContourTile
+    {
+        ContourLines::Isolines isolines;
+        float scale;
+        float offsetX;
+        float offsetY;
+    };
+
+    static bool obtainElevationTile(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+    {
+        if(provider->obtainTileImmediate(tileId, zoom, tile) && tile)
+            return true;
+
+        struct Pending
+        {
+            Pending()
+                : delivered(false)
+            {
+            }
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            bool delivered;
+            std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+        };
+        const std::shared_ptr<Pending> pending(new Pending());
+        provider->obtainTileDeffered(tileId, zoom,
+            [pending](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+            {
+                std::lock_guard<std::mutex> scopeLock(pending->mutex);
+                if(success)
+                    pending->tile = tile;
+                pending->delivered = true;
+                pending->condition.notify_all();
+            });
+
+        // Pending state is shared with callback, which may arrive after timeout
+        std::unique_lock<std::mutex> scopeLock(pending->mutex);
+        const auto delivered = pending->condition.wait_for(scopeLock, ElevationTileTimeout,
+            [pending]()
+            {
+                return pending->delivered;
+            });
+        if(!delivered)
+            return false;
+        tile = pending->tile;
+        return static_cast<bool>(tile);
+    }
+
+    // Extracts isolines of all heightmap tiles covering area, shared by all variants
+    static void extractContours(const Configuration& cfg, const OsmAnd::AreaD& area, QList<ContourTile>& contours)
+    {
+        std::shared_ptr<OsmAnd::IMapTileProvider> heightmapProvider(new OsmAnd::HeightmapTileProvider(
+            cfg.heightsDir, cfg.heightsDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+
+        const auto areaLeft = OsmAnd::Utilities::getTileNumberX(cfg.zoom, area.left);
+        const auto areaTop = OsmAnd::Utilities::getTileNumberY(cfg.zoom, area.top);
+        const auto left = static_cast<int32_t>(std::floor(areaLeft));
+        const auto top = static_cast<int32_t>(std::floor(areaTop));
+        const auto right = static_cast<int32_t>(std::floor(OsmAnd::Utilities::getTileNumberX(cfg.zoom, area.right)));
+        const auto bottom = static_cast<int32_t>(std::floor(OsmAnd::Utilities::getTileNumberY(cfg.zoom, area.bottom)));
+        const auto zoom = static_cast<OsmAnd::ZoomLevel>(cfg.zoom);
+        const auto interval = ContourLines::intervalForZoom(cfg.zoom);
+
+        for(int32_t y = top; y <= bottom; y++)
+        {
+            for(int32_t x = left; x <= right; x++)
+            {
+                OsmAnd::TileId tileId;
+                tileId.x = x;
+                tileId.y = y;
+                std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+                if(!obtainElevationTile(heightmapProvider, tileId, zoom, tile))
+                    continue;
+                const auto heights = std::static_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(tile);
+                if(heights->width < 2)
+                    continue;
+
+                ContourTile contourTile;
+                ContourLines::extract(
+                    reinterpret_cast<const float*>(heights->data), heights->rowLength / sizeof(float), heights->width, heights->height,
+                    interval,
+                    contourTile.isolines);
+                contourTile.scale = static_cast<float>(cfg.tileSide) / (heights->width - 1);
+                contourTile.offsetX = static_cast<float>((x - areaLeft) * cfg.tileSide);
+                contourTile.offsetY = static_cast<float>((y - areaTop) * cfg.tileSide);
+                contours.push_back(contourTile);
+            }
+        }
+    }
+
+    static bool rasterizeVariant(
+        const Configuration& cfg,
+        const Variant& variant,
+        const std::shared_ptr<OsmAnd::RasterizationStyle>& style,
+        const OsmAnd::AreaD& area,
+        const QList< std::shared_ptr<OsmAnd::Model::MapObject> >& sharedMapObjects,
+        const QList<ContourTile>& contours,
+        QString& outputPath)
+    {
+        // Each variant works on its own shallow copy of shared list, map objects themselves are not modified
+        QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects(sharedMapObjects);
+
+        const auto tilesCountX = std::fabs(
+            OsmAnd::Utilities::getTileNumberX(cfg.zoom, area.right) - OsmAnd::Utilities::getTileNumberX(cfg.zoom, area.left));
+        const auto tilesCountY = std::fabs(
+            OsmAnd::Utilities::getTileNumberY(cfg.zoom, area.bottom) - OsmAnd::Utilities::getTileNumberY(cfg.zoom, area.top));
+        const auto basePixelWidth = static_cast<int>(std::ceil(tilesCountX * cfg.tileSide));
+        const auto basePixelHeight = static_cast<int>(std::ceil(tilesCountY * cfg.tileSide));
+
+        // Density is applied as canvas scale, so geometry, strokes, text and icons grow together
+        SkBitmap renderSurface;
+        renderSurface.setConfig(cfg.is32bit ? SkBitmap::kARGB_8888_Config : SkBitmap::kRGB_565_Config,
+            static_cast<int>(std::ceil(basePixelWidth * variant.density)),
+            static_cast<int>(std::ceil(basePixelHeight * variant.density)));
+        if(!renderSurface.allocPixels())
+            return false;
+        SkDevice renderTarget(renderSurface);
+        SkCanvas canvas(&renderTarget);
+        canvas.scale(variant.density, variant.density);
+
+        OsmAnd::RasterizerContext rasterizerContext(style);
+        if(!OsmAnd::Rasterizer::rasterize(rasterizerContext, true, canvas, area, cfg.zoom, cfg.tileSide, mapObjects, OsmAnd::PointI(), nullptr))
+            return false;
+        for(auto itContourTile = contours.begin(); itContourTile != contours.end(); ++itContourTile)
+            ContourLines::draw(canvas, itContourTile->isolines, itContourTile->scale, itContourTile->offsetX, itContourTile->offsetY);
+
+        outputPath = variantOutputPath(cfg, variant.styleName, variant.density);
+        return SkImageEncoder::EncodeFile(outputPath.toLocal8Bit().constData(), renderSurface, SkImageEncoder::kPNG_Type, 100);
+    }
+}
+
+bool VariantsRasterizer::rasterize(std::ostream& output, const Configuration& cfg)
+{
+    // Resolve all styles up front, so that unknown style fails the run before decoding
+    Styles mainThreadStyles;
+    if(!resolveStyles(cfg, mainThreadStyles, &output))
+        return false;
+    QList<Variant> variants;
+    for(auto itStyleName = cfg.styleNames.begin(); itStyleName != cfg.styleNames.end(); ++itStyleName)
+    {
+        for(auto itDensity = cfg.densities.begin(); itDensity != cfg.densities.end(); ++itDensity)
+        {
+            Variant variant;
+            variant.styleName = *itStyleName;
+            variant.density = *itDensity;
+            variants.push_back(variant);
+        }
+    }
+
+    // Read and decode map objects once for all variants
+    const auto decodeStart = std::chrono::steady_clock::now();
+    OsmAnd::AreaI bbox31;
+    bbox31.left = OsmAnd::Utilities::get31TileNumberX(cfg.bbox.left);
+    bbox31.right = OsmAnd::Utilities::get31TileNumberX(cfg.bbox.right);
+    bbox31.top = OsmAnd::Utilities::get31TileNumberY(cfg.bbox.top);
+    bbox31.bottom = OsmAnd::Utilities::get31TileNumberY(cfg.bbox.bottom);
+    uint32_t zoom = cfg.zoom;
+
+    QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects;
+    OsmAnd::QueryFilter filter;
+    filter._bbox31 = &bbox31;
+    filter._zoom = &zoom;
+    for(auto itObf = cfg.obfFiles.begin(); itObf != cfg.obfFiles.end(); ++itObf)
+    {
+        auto obfFile = *itObf;
+        std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(obfFile->absoluteFilePath()))));
+
+        for(auto itMapSection = obfReader->mapSections.begin(); itMapSection != obfReader->mapSections.end(); ++itMapSection)
+        {
+            auto mapSection = *itMapSection;
+
+            OsmAnd::ObfMapSection::loadMapObjects(obfReader.get(), mapSection.get(), &mapObjects, &filter, nullptr);
+        }
+    }
+    const auto decodeFinish = std::chrono::steady_clock::now();
+    if(cfg.verbose)
+    {
+        output << "Decoded " << mapObjects.size() << " map objects from " << cfg.obfFiles.size() << " OBF(s) in "
+            << std::chrono::duration<double, std::milli>(decodeFinish - decodeStart).count() << " ms" << std::endl;
+    }
+
+    QList<ContourTile> contours;
+    if(cfg.contours)
+    {
+        extractContours(cfg, cfg.bbox, contours);
+        const auto contoursFinish = std::chrono::steady_clock::now();
+        if(cfg.verbose)
+        {
+            output << "Extracted contour lines of " << contours.size() << " heightmap tile(s) in "
+                << std::chrono::duration<double, std::milli>(contoursFinish - decodeFinish).count() << " ms" << std::endl;
+        }
+    }
+
+    // Rasterize every variant from the shared data
+    auto threadsCount = cfg.threads > 0 ? cfg.threads : static_cast<int>(std::thread::hardware_concurrency());
+    if(threadsCount <= 0)
+        threadsCount = 1;
+    threadsCount = std::min(threadsCount, variants.size());
+
+    std::atomic<int> nextVariantIdx(0);
+    std::atomic<bool> allSucceeded(true);
+    std::mutex outputMutex;
+    const auto worker = [&](const Styles& styles)
+    {
+        for(;;)
+        {
+            const auto variantIdx = nextVariantIdx.fetch_add(1);
+            if(variantIdx >= variants.size())
+                return;
+            const auto& variant = variants[variantIdx];
+
+            const auto variantStart = std::chrono::steady_clock::now();
+            QString outputPath;
+            const auto ok = rasterizeVariant(cfg, variant, styles.byName.value(variant.styleName), cfg.bbox, mapObjects, contours, outputPath);
+            const auto variantFinish = std::chrono::steady_clock::now();
+            if(!ok)
+                allSucceeded = false;
+
+            std::lock_guard<std::mutex> scopeLock(outputMutex);
+            if(!ok)
+            {
+                output << "Failed to rasterize style '" << variant.styleName.toStdString() << "' at density " << variant.density << std::endl;
+            }
+            else if(cfg.verbose)
+            {
+                output << "Rasterized '" << outputPath.toStdString() << "' in "
+                    << std::chrono::duration<double, std::milli>(variantFinish - variantStart).count() << " ms" << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int threadIdx = 1; threadIdx < threadsCount; threadIdx++)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            Styles threadStyles;
+            if(resolveStyles(cfg, threadStyles, nullptr))
+                worker(threadStyles);
+            else
+                allSucceeded = false;
+        }));
+    }
+    worker(mainThreadStyles);
+    for(auto itThread = threads.begin(); itThread != threads.end(); ++itThread)
+        itThread->join();
+
+    return allSucceeded;
+}
@@ -0,0 +1,76 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __VARIANTS_RASTERIZER_H_
+#define __VARIANTS_RASTERIZER_H_
+
+#include <stdint.h>
+#include <memory>
+#include <ostream>
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QFileInfo>
+#include <QDir>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Common.h>
+
+namespace VariantsRasterizer
+{
+    // Configuration of a run that rasterizes the same area with several styles and densities.
+    // Map data is read and decoded only once, each (style, density) pair is one "variant".
+    struct Configuration
+    {
+        Configuration();
+
+        QList< std::shared_ptr<QFileInfo> > styleFiles;
+        QStringList styleNames;
+        QList<float> densities;
+        QList< std::shared_ptr<QFileInfo> > obfFiles;
+        OsmAnd::AreaD bbox;
+        uint32_t zoom;
+        uint32_t tileSide;
+        bool is32bit;
+        bool verbose;
+        QString output;
+        int threads;
+
+        // Contour lines extracted from heightmaps in heightsDir are drawn over map
+        bool contours;
+        QDir heightsDir;
+    };
+
+    // Returns true if arguments request more than one style or density, or contour lines,
+    // so rasterization should go through this tool instead of EyePiece.
+    bool isMultiVariantRequest(const QStringList& args);
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Output path of single variant: "image.png" becomes "image.<style>@<density>x.png"
+    QString variantOutputPath(const Configuration& cfg, const QString& styleName, float density);
+
+    bool rasterize(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __VARIANTS_RASTERIZER_H_
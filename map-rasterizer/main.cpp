@@ -35,6 +35,8 @@
 
 #include <OsmAndCoreUtils/EyePiece.h>
 
+#include "VariantsRasterizer.h"
+
 void printUsage(std::string warning = std::string());
 
 int main(int argc, char* argv[])
@@ -47,13 +49,24 @@ int main(int argc, char* argv[])
 #   endif
 #endif
 
-    OsmAnd::EyePiece::Configuration cfg;
-
     QString error;
     QStringList args;
     for (int idx = 1; idx < argc; idx++)
         args.push_back(argv[idx]);
 
+    // Several styles or densities are rasterized from single decode pass
+    if(VariantsRasterizer::isMultiVariantRequest(args))
+    {
+        VariantsRasterizer::Configuration variantsCfg;
+        if(!VariantsRasterizer::parseCommandLineArguments(args, variantsCfg, error))
+        {
+            printUsage(error.toStdString());
+            return -1;
+        }
+        return VariantsRasterizer::rasterize(std::cout, variantsCfg) ? 0 : -1;
+    }
+
+    OsmAnd::EyePiece::Configuration cfg;
     if(!OsmAnd::EyePiece::parseCommandLineArguments(args, cfg, error))
     {
         printUsage(error.toStdString());
@@ -70,19 +83,28 @@ void printUsage(std::string warning)
     std::cout << "EyePiece is console utility to rasterize OsmAnd map tile." << std::endl;
     std::cout << std::endl << "Usage: eyepiece -stylesPath=path/to/styles1";
     std::cout << " [-stylesPath=path/to/styles2]";
-    std::cout << " -style=style";
+    std::cout << " -style=style[,style2]";
+    std::cout << " [-style=style3]";
     std::cout << " [-obfsDir=path/to/obf/collection]";
     std::cout << " [-verbose]";
     std::cout << " [-dumpRules]";
     std::cout << " [-zoom=15]";
     std::cout << " [-32bit]";
     std::cout << " [-tileSide=256]";
-    std::cout << " [-density=1.0]";
+    std::cout << " [-density=1.0[,2.0]]";
+    std::cout << " [-density=3.0]";
+    std::cout << " [-threads=N]";
     std::cout << " [-bbox=LeftLon,TopLat,RightLon,BottomLan]";
     std::cout << " [-output=path/to/image.png]";
     std::cout << " [-map]";
     std::cout << " [-text]";
     std::cout << " [-icons]";
+    std::cout << " [-contours -heightsDir=path/to/heightmaps]";
     std::cout << std::endl;
+    std::cout << "\tSeveral styles and/or densities produce one image per variant named 'image.<style>@<density>x.png'," << std::endl;
+    std::cout << "\tmap data is decoded once and variants are rasterized in parallel on 'threads' threads (all cores by default)." << std::endl;
+    std::cout << "\tIn this mode '-output' is required and '-map', '-text', '-icons', '-dumpRules' are ignored." << std::endl;
+    std::cout << "\t'-contours' draws contour lines extracted from heightmaps over map, interval depends on zoom;" << std::endl;
+    std::cout << "\tit is handled by the same mode." << std::endl;
 }
 
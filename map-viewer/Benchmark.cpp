@@ -0,0 +1,488 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "Benchmark.h"
+
+#include <stdlib.h>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+#if defined(OSMAND_BIRD_HEADLESS_SUPPORTED)
+#   include <EGL/egl.h>
+#   include <EGL/eglext.h>
+#endif
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "Statistics.h"
+
+Benchmark::Script::Script()
+    : windowWidth(800)
+    , windowHeight(600)
+    , rasterProvider(3)
+    , warmupFrames(0)
+    , stallThreshold(50.0)
+{
+}
+
+bool Benchmark::loadScript(const QString& path, Script& script, QString& error)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        error = "Failed to open benchmark script '" + path + "'";
+        return false;
+    }
+    QJsonParseError parseError;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    file.close();
+    if(document.isNull() || !document.isObject())
+    {
+        error = "Failed to parse benchmark script '" + path + "': " + parseError.errorString();
+        return false;
+    }
+
+    const auto root = document.object();
+    script.windowWidth = root.value("windowWidth").toDouble(script.windowWidth);
+    script.windowHeight = root.value("windowHeight").toDouble(script.windowHeight);
+    script.rasterProvider = root.value("rasterProvider").toDouble(script.rasterProvider);
+    script.warmupFrames = root.value("warmupFrames").toDouble(script.warmupFrames);
+    script.stallThreshold = root.value("stallThreshold").toDouble(script.stallThreshold);
+
+    const auto keyframes = root.value("keyframes").toArray();
+    for(auto itKeyframe = keyframes.begin(); itKeyframe != keyframes.end(); ++itKeyframe)
+    {
+        const auto value = (*itKeyframe).toObject();
+        const auto target31 = value.value("target31").toArray();
+        if(target31.size() != 2)
+        {
+            error = "Keyframe without valid 'target31'";
+            return false;
+        }
+
+        Keyframe keyframe;
+        keyframe.target31.x = static_cast<int32_t>(target31.at(0).toDouble());
+        keyframe.target31.y = static_cast<int32_t>(target31.at(1).toDouble());
+        keyframe.zoom = value.value("zoom").toDouble(script.keyframes.isEmpty() ? 10.0 : script.keyframes.last().zoom);
+        keyframe.azimuth = value.value("azimuth").toDouble(script.keyframes.isEmpty() ? 0.0 : script.keyframes.last().azimuth);
+        keyframe.elevationAngle = value.value("elevationAngle").toDouble(script.keyframes.isEmpty() ? 90.0 : script.keyframes.last().elevationAngle);
+        // First keyframe is starting pose, there is nothing to move from
+        keyframe.frames = value.value("frames").toDouble(script.keyframes.isEmpty() ? 0 : 60);
+        script.keyframes.push_back(keyframe);
+    }
+    if(script.keyframes.isEmpty())
+    {
+        error = "Benchmark script has no keyframes";
+        return false;
+    }
+
+    return true;
+}
+
+#if defined(OSMAND_BIRD_HEADLESS_SUPPORTED)
+namespace Benchmark
+{
+    struct HeadlessContext
+    {
+        HeadlessContext()
+            : display(EGL_NO_DISPLAY)
+            , surface(EGL_NO_SURFACE)
+            , context(EGL_NO_CONTEXT)
+        {
+        }
+
+        EGLDisplay display;
+        EGLSurface surface;
+        EGLContext context;
+    };
+
+    static bool createHeadlessContext(int width, int height, HeadlessContext& headless, QString& error)
+    {
+        // Respect explicit environment, otherwise ask Mesa for llvmpipe without window system
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+        if(getenv("DISPLAY") == nullptr)
+            setenv("EGL_PLATFORM", "surfaceless", 0);
+
+        headless.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if(headless.display == EGL_NO_DISPLAY)
+        {
+            error = "No EGL display";
+            return false;
+        }
+        EGLint major, minor;
+        if(!eglInitialize(headless.display, &major, &minor))
+        {
+            error = "Failed to initialize EGL";
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configsCount = 0;
+        if(!eglChooseConfig(headless.display, configAttribs, &config, 1, &configsCount) || configsCount == 0)
+        {
+            error = "No suitable EGL config for offscreen OpenGL";
+            return false;
+        }
+
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, width,
+            EGL_HEIGHT, height,
+            EGL_NONE
+        };
+        headless.surface = eglCreatePbufferSurface(headless.display, config, pbufferAttribs);
+        if(headless.surface == EGL_NO_SURFACE)
+        {
+            error = "Failed to create EGL pbuffer surface";
+            return false;
+        }
+
+        // Same context version as interactive mode (see glutInitContextVersion)
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+            EGL_CONTEXT_MINOR_VERSION_KHR, 0,
+            EGL_NONE
+        };
+        headless.context = eglCreateContext(headless.display, config, EGL_NO_CONTEXT, contextAttribs);
+        if(headless.context == EGL_NO_CONTEXT)
+        {
+            error = "Failed to create EGL OpenGL 3.0 context";
+            return false;
+        }
+        if(!eglMakeCurrent(headless.display, headless.surface, headless.surface, headless.context))
+        {
+            error = "Failed to activate EGL context";
+            return false;
+        }
+
+        glewExperimental = GL_TRUE;
+#if defined(GLEW_EGL)
+        // GLEW built for EGL resolves everything through eglGetProcAddress
+        const auto glewStatus = glewInit();
+#else
+        // glewInit() of GLX build of GLEW also initializes GLX and fails without X display
+        // (GLEW_ERROR_NO_GLX_DISPLAY), while only GL entry points are needed on EGL context
+        const auto glewStatus = glewContextInit();
+#endif
+        if(glewStatus != GLEW_OK)
+        {
+            error = "Failed to initialize GLEW on EGL context";
+            return false;
+        }
+        (void)glGetError();
+
+        return true;
+    }
+
+    static void releaseHeadlessContext(HeadlessContext& headless)
+    {
+        if(headless.display == EGL_NO_DISPLAY)
+            return;
+
+        eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(headless.context != EGL_NO_CONTEXT)
+            eglDestroyContext(headless.display, headless.context);
+        if(headless.surface != EGL_NO_SURFACE)
+            eglDestroySurface(headless.display, headless.surface);
+        eglTerminate(headless.display);
+        headless = HeadlessContext();
+    }
+}
+#else
+namespace Benchmark
+{
+    struct HeadlessContext
+    {
+    };
+
+    static bool createHeadlessContext(int width, int height, HeadlessContext& headless, QString& error)
+    {
+        error = "Headless rendering is not supported: bird was built without EGL";
+        return false;
+    }
+
+    static void releaseHeadlessContext(HeadlessContext& headless)
+    {
+    }
+}
+#endif // defined(OSMAND_BIRD_HEADLESS_SUPPORTED)
+
+namespace Benchmark
+{
+    static float interpolateAngle(float from, float to, float t)
+    {
+        auto delta = std::fmod(to - from, 360.0f);
+        if(delta > 180.0f)
+            delta -= 360.0f;
+        else if(delta < -180.0f)
+            delta += 360.0f;
+        return from + delta * t;
+    }
+
+    static void applyCamera(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer, const Keyframe& from, const Keyframe& to, float t)
+    {
+        OsmAnd::PointI target31;
+        target31.x = static_cast<int32_t>(from.target31.x + (static_cast<int64_t>(to.target31.x) - from.target31.x) * t);
+        target31.y = static_cast<int32_t>(from.target31.y + (static_cast<int64_t>(to.target31.y) - from.target31.y) * t);
+
+        renderer->setTarget(target31);
+        renderer->setZoom(from.zoom + (to.zoom - from.zoom) * t);
+        renderer->setAzimuth(interpolateAngle(from.azimuth, to.azimuth, t));
+        renderer->setElevationAngle(from.elevationAngle + (to.elevationAngle - from.elevationAngle) * t);
+    }
+
+    struct FrameSample
+    {
+        double frameTime;
+        uint64_t tilesUploaded;
+        uint64_t bytesUploaded;
+        int uploadBacklog;
+        int visibleTiles;
+    };
+}
+
+bool Benchmark::run(
+    const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+    const Script& script,
+    const QMap<int, std::shared_ptr<InstrumentedTileProvider> >& providers,
+    const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& prefetchingProviders,
+    TilePrefetcher& prefetcher,
+    const std::shared_ptr<MapObjectsCache>& mapObjectsCache,
+    const std::shared_ptr<UploadScheduler>& uploadScheduler,
+    std::ostream& output,
+    const QString& reportPath)
+{
+    HeadlessContext headless;
+    QString error;
+    if(!createHeadlessContext(script.windowWidth, script.windowHeight, headless, error))
+    {
+        output << error.toStdString() << std::endl;
+        releaseHeadlessContext(headless);
+        return false;
+    }
+    output << "Benchmark on '" << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "' ("
+        << reinterpret_cast<const char*>(glGetString(GL_VERSION)) << ")" << std::endl;
+
+    OsmAnd::AreaI viewport;
+    viewport.top = 0;
+    viewport.left = 0;
+    viewport.bottom = script.windowHeight;
+    viewport.right = script.windowWidth;
+    renderer->frameRequestCallback = []()
+    {
+        // Frames are driven by script, not by renderer requests
+    };
+    renderer->setWindowSize(OsmAnd::PointI(script.windowWidth, script.windowHeight));
+    renderer->setViewport(viewport);
+    renderer->setFogColor(1.0f, 1.0f, 1.0f);
+    applyCamera(renderer, script.keyframes.first(), script.keyframes.first(), 0.0f);
+    renderer->initializeRendering();
+    glViewport(0, 0, script.windowWidth, script.windowHeight);
+
+    const auto takeTilesUploaded = [&providers]() -> uint64_t
+    {
+        uint64_t count = 0;
+        for(auto itProvider = providers.begin(); itProvider != providers.end(); ++itProvider)
+        {
+            if(*itProvider)
+                count += (*itProvider)->takeDeliveredSinceFrame();
+        }
+        return count;
+    };
+    const auto renderOneFrame = [&]() -> FrameSample
+    {
+        FrameSample sample;
+
+        const auto frameStart = std::chrono::high_resolution_clock::now();
+        if(uploadScheduler)
+            uploadScheduler->beforeProcessRendering(renderer);
+        sample.tilesUploaded = takeTilesUploaded();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const auto processStart = std::chrono::high_resolution_clock::now();
+        renderer->processRendering();
+        if(uploadScheduler)
+        {
+            uploadScheduler->processRenderingDone(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - processStart).count());
+            const auto counters = uploadScheduler->getCounters();
+            sample.bytesUploaded = counters.lastFrameBytes;
+            sample.uploadBacklog = counters.backlogTiles;
+        }
+        else
+        {
+            sample.bytesUploaded = 0;
+            sample.uploadBacklog = 0;
+        }
+        renderer->renderFrame();
+        glFinish();
+        const auto frameFinish = std::chrono::high_resolution_clock::now();
+        prefetcher.update(renderer, prefetchingProviders);
+
+        sample.frameTime = std::chrono::duration<double, std::milli>(frameFinish - frameStart).count();
+        sample.visibleTiles = renderer->visibleTiles.size();
+        return sample;
+    };
+
+    for(int frameIdx = 0; frameIdx < script.warmupFrames; frameIdx++)
+        renderOneFrame();
+
+    std::vector<FrameSample> samples;
+    for(int keyframeIdx = 0; keyframeIdx < script.keyframes.size(); keyframeIdx++)
+    {
+        const auto& to = script.keyframes[keyframeIdx];
+        const auto& from = script.keyframes[keyframeIdx > 0 ? keyframeIdx - 1 : 0];
+        for(int frameIdx = 1; frameIdx <= to.frames; frameIdx++)
+        {
+            applyCamera(renderer, from, to, static_cast<float>(frameIdx) / to.frames);
+            samples.push_back(renderOneFrame());
+        }
+    }
+
+    renderer->releaseRendering();
+    releaseHeadlessContext(headless);
+
+    if(samples.empty())
+    {
+        output << "Benchmark script produced no frames" << std::endl;
+        return false;
+    }
+
+    std::vector<double> frameTimes;
+    double totalTime = 0.0;
+    uint64_t totalTilesUploaded = 0;
+    uint64_t maxTilesUploaded = 0;
+    uint64_t maxBytesUploaded = 0;
+    int maxUploadBacklog = 0;
+    int stallsCount = 0;
+    for(auto itSample = samples.begin(); itSample != samples.end(); ++itSample)
+    {
+        frameTimes.push_back(itSample->frameTime);
+        totalTime += itSample->frameTime;
+        totalTilesUploaded += itSample->tilesUploaded;
+        maxTilesUploaded = std::max(maxTilesUploaded, itSample->tilesUploaded);
+        maxBytesUploaded = std::max(maxBytesUploaded, itSample->bytesUploaded);
+        maxUploadBacklog = std::max(maxUploadBacklog, itSample->uploadBacklog);
+        if(itSample->frameTime > script.stallThreshold)
+            stallsCount++;
+    }
+    std::sort(frameTimes.begin(), frameTimes.end());
+    const auto p50 = Statistics::percentile(frameTimes, 50.0);
+    const auto p95 = Statistics::percentile(frameTimes, 95.0);
+    const auto p99 = Statistics::percentile(frameTimes, 99.0);
+    const auto tilesPerFrame = static_cast<double>(totalTilesUploaded) / samples.size();
+
+    output << "Frames                 : " << samples.size() << " in " << totalTime << " ms" << std::endl;
+    output << "Frame time p50/p95/p99 : " << p50 << " / " << p95 << " / " << p99 << " ms (max " << frameTimes.back() << " ms)" << std::endl;
+    output << "Tiles uploaded         : " << totalTilesUploaded << " total, " << tilesPerFrame << " per frame, " << maxTilesUploaded << " max" << std::endl;
+    if(uploadScheduler)
+    {
+        const auto counters = uploadScheduler->getCounters();
+        output << "Scheduled uploads      : " << counters.releasedBytes / (1024 * 1024) << " MB total, " << maxBytesUploaded / 1024 << " KB max per frame, "
+            << maxUploadBacklog << " tiles max backlog, " << counters.budgetBytes / 1024 << " KB final budget" << std::endl;
+    }
+    output << "Stalls (> " << script.stallThreshold << " ms)     : " << stallsCount << std::endl;
+
+    PrefetchingTileProvider::Counters prefetchTotals = {};
+    for(auto itProvider = prefetchingProviders.begin(); itProvider != prefetchingProviders.end(); ++itProvider)
+    {
+        if(!*itProvider)
+            continue;
+        const auto counters = (*itProvider)->getCounters();
+        prefetchTotals.issued += counters.issued;
+        prefetchTotals.completed += counters.completed;
+        prefetchTotals.hits += counters.hits;
+        prefetchTotals.lateHits += counters.lateHits;
+        prefetchTotals.evictedUnused += counters.evictedUnused;
+    }
+    output << "Prefetch               : " << prefetchTotals.issued << " issued, " << prefetchTotals.hitRate() * 100.0 << "% hit rate" << std::endl;
+
+    MapObjectsCache::Counters mapDataCounters = {};
+    if(mapObjectsCache)
+    {
+        mapDataCounters = mapObjectsCache->getCounters();
+        output << "Map data cache         : " << mapDataCounters.hitRate() * 100.0 << "% hit rate, " << mapDataCounters.evictions << " evicted, "
+            << mapDataCounters.residentBytes / (1024 * 1024) << "/" << mapDataCounters.budgetBytes / (1024 * 1024) << " MB resident" << std::endl;
+    }
+
+    if(!reportPath.isEmpty())
+    {
+        QJsonObject report;
+        report.insert("frames", static_cast<double>(samples.size()));
+        report.insert("totalTime", totalTime);
+        report.insert("frameTimeP50", p50);
+        report.insert("frameTimeP95", p95);
+        report.insert("frameTimeP99", p99);
+        report.insert("frameTimeMax", frameTimes.back());
+        report.insert("tilesUploaded", static_cast<double>(totalTilesUploaded));
+        report.insert("tilesUploadedPerFrame", tilesPerFrame);
+        report.insert("tilesUploadedMax", static_cast<double>(maxTilesUploaded));
+        report.insert("bytesUploadedMax", static_cast<double>(maxBytesUploaded));
+        report.insert("uploadBacklogMax", maxUploadBacklog);
+        report.insert("stallThreshold", script.stallThreshold);
+        report.insert("stalls", stallsCount);
+        report.insert("prefetchIssued", static_cast<double>(prefetchTotals.issued));
+        report.insert("prefetchHitRate", prefetchTotals.hitRate());
+        report.insert("mapDataHits", static_cast<double>(mapDataCounters.hits));
+        report.insert("mapDataMisses", static_cast<double>(mapDataCounters.misses));
+        report.insert("mapDataEvictions", static_cast<double>(mapDataCounters.evictions));
+        report.insert("mapDataResidentBytes", static_cast<double>(mapDataCounters.residentBytes));
+
+        QJsonArray frames;
+        for(auto itSample = samples.begin(); itSample != samples.end(); ++itSample)
+        {
+            QJsonObject frame;
+            frame.insert("frameTime", itSample->frameTime);
+            frame.insert("tilesUploaded", static_cast<double>(itSample->tilesUploaded));
+            frame.insert("bytesUploaded", static_cast<double>(itSample->bytesUploaded));
+            frame.insert("uploadBacklog", itSample->uploadBacklog);
+            frame.insert("visibleTiles", itSample->visibleTiles);
+            frames.append(frame);
+        }
+        report.insert("perFrame", frames);
+
+        QFile reportFile(reportPath);
+        if(!reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            output << "Failed to write benchmark report '" << reportPath.toStdString() << "'" << std::endl;
+            return false;
+        }
+        reportFile.write(QJsonDocument(report).toJson());
+        reportFile.close();
+    }
+
+    return true;
+}
@@ -0,0 +1,99 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __BENCHMARK_H_
+#define __BENCHMARK_H_
+
+#include <stdint.h>
+#include <memory>
+#include <ostream>
+
+#include <QString>
+#include <QList>
+#include <QMap>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+#include "InstrumentedTileProvider.h"
+#include "PrefetchingTileProvider.h"
+#include "TilePrefetcher.h"
+#include "MapObjectsCache.h"
+#include "UploadScheduler.h"
+
+// Headless scripted fly-through. Script is JSON:
+// {
+//     "windowWidth": 800, "windowHeight": 600,
+//     "rasterProvider": 3,
+//     "warmupFrames": 0,
+//     "stallThreshold": 50.0,
+//     "keyframes": [
+//         { "target31": [1102430866, 704978668], "zoom": 12.5, "azimuth": 0.0, "elevationAngle": 90.0, "frames": 0 },
+//         { "target31": [1102830866, 704978668], "zoom": 14.0, "azimuth": 45.0, "elevationAngle": 30.0, "frames": 120 }
+//     ]
+// }
+// "frames" of a keyframe is count of frames spent moving to it from previous keyframe, 60 by
+// default and 0 for the first keyframe.
+// "rasterProvider" is index of provider as in interactive mode, vector maps (3) by default so that
+// results do not depend on network. Online providers are served only from tiles pack in benchmark.
+namespace Benchmark
+{
+    struct Keyframe
+    {
+        OsmAnd::PointI target31;
+        float zoom;
+        float azimuth;
+        float elevationAngle;
+        int frames;
+    };
+
+    struct Script
+    {
+        Script();
+
+        int windowWidth;
+        int windowHeight;
+        int rasterProvider;
+        int warmupFrames;
+        double stallThreshold;
+        QList<Keyframe> keyframes;
+    };
+
+    bool loadScript(const QString& path, Script& script, QString& error);
+
+    // Renders script offscreen through EGL pbuffer. Unless overridden by environment,
+    // Mesa is asked for software rasterizer (llvmpipe) and surfaceless platform,
+    // so no GPU or X server is needed.
+    bool run(
+        const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+        const Script& script,
+        const QMap<int, std::shared_ptr<InstrumentedTileProvider> >& providers,
+        const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& prefetchingProviders,
+        TilePrefetcher& prefetcher,
+        const std::shared_ptr<MapObjectsCache>& mapObjectsCache,
+        const std::shared_ptr<UploadScheduler>& uploadScheduler,
+        std::ostream& output,
+        const QString& reportPath);
+}
+
+#endif // __BENCHMARK_H_
@@ -0,0 +1,304 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "ComputedHillshadeTileProvider.h"
+
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+
+#include <QMutexLocker>
+#include <QtMath>
+
+#include <SkBitmap.h>
+#include <SkColorPriv.h>
+
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Map/IMapElevationDataProvider.h>
+
+namespace
+{
+    inline float sampleAt(const OsmAnd::IMapElevationDataProvider::Tile& tile, int x, int y)
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(tile.data) + y * tile.rowLength)[x];
+    }
+}
+
+ComputedHillshadeTileProvider::State::State(int cacheCapacity_)
+    : cache(cacheCapacity_)
+    , heights(HeightsCacheCapacity)
+    , computed(0)
+    , cacheHits(0)
+    , lastComputeTime(0.0)
+{
+}
+
+ComputedHillshadeTileProvider::Gathering::Gathering()
+    : remaining(9)
+{
+}
+
+ComputedHillshadeTileProvider::ComputedHillshadeTileProvider(
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+    const HillshadeKernel::Parameters& parameters,
+    int cacheCapacity)
+    : _heightmapProvider(heightmapProvider)
+    , _parameters(parameters)
+    , _state(new State(cacheCapacity))
+{
+}
+
+ComputedHillshadeTileProvider::~ComputedHillshadeTileProvider()
+{
+}
+
+bool ComputedHillshadeTileProvider::shadeElevationTile(
+    const Neighbourhood& elevationTiles,
+    const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+    const HillshadeKernel::Parameters& parameters,
+    HillshadeKernel::Implementation implementation,
+    QByteArray& alpha, uint32_t& size)
+{
+    const auto heights = std::dynamic_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(elevationTiles[4]);
+    if(!heights || heights->width < 2 || heights->width != heights->height)
+        return false;
+    size = heights->width;
+
+    std::shared_ptr<OsmAnd::IMapElevationDataProvider::Tile> neighbours[9];
+    for(int idx = 0; idx < 9; idx++)
+    {
+        neighbours[idx] = std::dynamic_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(elevationTiles[idx]);
+        if(neighbours[idx] && (neighbours[idx]->width != size || neighbours[idx]->height != size))
+            neighbours[idx].reset();
+    }
+
+    // Grid padded by one sample. Adjacent tiles share their border samples, so padding is the
+    // second sample from edge of neighbour; without neighbour the edge sample is repeated.
+    const int side = static_cast<int>(size);
+    const int paddedSide = side + 2;
+    std::vector<float> padded(paddedSide * paddedSide);
+    for(int y = 0; y < side; y++)
+    {
+        const auto row = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(heights->data) + y * heights->rowLength);
+        std::copy(row, row + side, padded.begin() + (y + 1) * paddedSide + 1);
+    }
+    for(int y = -1; y <= side; y++)
+    {
+        const auto step = (y < 0 || y == side) ? 1 : side + 1;
+        for(int x = -1; x <= side; x += step)
+        {
+            const auto dx = x < 0 ? -1 : (x == side ? 1 : 0);
+            const auto dy = y < 0 ? -1 : (y == side ? 1 : 0);
+            const auto& neighbour = neighbours[(dy + 1) * 3 + dx + 1];
+            float value;
+            if(neighbour)
+                value = sampleAt(*neighbour, dx < 0 ? side - 2 : (dx > 0 ? 1 : x), dy < 0 ? side - 2 : (dy > 0 ? 1 : y));
+            else
+                value = sampleAt(*heights, std::min(std::max(x, 0), side - 1), std::min(std::max(y, 0), side - 1));
+            padded[(y + 1) * paddedSide + x + 1] = value;
+        }
+    }
+
+    // Samples are spaced equally in Mercator, so cell is square with side taken at tile center latitude
+    const auto zoomLevel = static_cast<int>(zoom);
+    const auto tileSize31 = std::ldexp(1.0, 31 - zoomLevel);
+    const auto latitude = OsmAnd::Utilities::get31LatitudeY(static_cast<int32_t>((tileId.y + 0.5) * tileSize31));
+    const auto tileSizeInMeters = 40075016.686 * std::cos(qDegreesToRadians(latitude)) / std::ldexp(1.0, zoomLevel);
+    const auto cellSize = static_cast<float>(tileSizeInMeters / std::max(1u, size - 1));
+
+    alpha.resize(size * size);
+    HillshadeKernel::compute(
+        padded.data() + paddedSide + 1, paddedSide, size, size,
+        cellSize, cellSize,
+        parameters,
+        reinterpret_cast<uint8_t*>(alpha.data()), size,
+        implementation);
+    return true;
+}
+
+std::shared_ptr<OsmAnd::IMapTileProvider::Tile> ComputedHillshadeTileProvider::createTile(const Shading& shading)
+{
+    // Each request gets own bitmap, since renderer may release tile data after upload
+    auto bitmap = new SkBitmap();
+    bitmap->setConfig(SkBitmap::kARGB_8888_Config, shading.size, shading.size);
+    if(!bitmap->allocPixels())
+    {
+        delete bitmap;
+        return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>();
+    }
+
+    const auto alpha = reinterpret_cast<const uint8_t*>(shading.alpha.constData());
+    for(uint32_t y = 0; y < shading.size; y++)
+    {
+        auto pixels = bitmap->getAddr32(0, y);
+        for(uint32_t x = 0; x < shading.size; x++)
+            pixels[x] = SkPackARGB32(alpha[y * shading.size + x], 0, 0, 0);
+    }
+
+    return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(
+        new OsmAnd::IMapBitmapTileProvider::Tile(bitmap, OsmAnd::IMapBitmapTileProvider::AlphaChannelData::Present));
+}
+
+bool ComputedHillshadeTileProvider::obtainCached(const std::shared_ptr<State>& state, const TileKey& key, Shading& shading)
+{
+    QMutexLocker scopeLock(&state->mutex);
+
+    const auto cached = state->cache.touch(key);
+    if(!cached)
+        return false;
+
+    shading = *cached;
+    state->cacheHits++;
+    return true;
+}
+
+void ComputedHillshadeTileProvider::computeAndCache(
+    const std::shared_ptr<State>& state, const HillshadeKernel::Parameters& parameters,
+    const TileKey& key, const Neighbourhood& elevationTiles,
+    Shading& shading)
+{
+    const auto computeStart = std::chrono::high_resolution_clock::now();
+    if(!shadeElevationTile(elevationTiles, key.tileId(), static_cast<OsmAnd::ZoomLevel>(key.zoom), parameters, HillshadeKernel::bestImplementation(), shading.alpha, shading.size))
+    {
+        shading.alpha.clear();
+        return;
+    }
+    const auto computeFinish = std::chrono::high_resolution_clock::now();
+
+    QMutexLocker scopeLock(&state->mutex);
+
+    state->computed++;
+    state->lastComputeTime = std::chrono::duration<double, std::milli>(computeFinish - computeStart).count();
+    state->cache.insert(key, shading);
+}
+
+void ComputedHillshadeTileProvider::tileGathered(const std::shared_ptr<Gathering>& gathering, int idx, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile)
+{
+    {
+        QMutexLocker scopeLock(&gathering->mutex);
+
+        gathering->tiles[idx] = elevationTile;
+        if(--gathering->remaining > 0)
+            return;
+    }
+
+    // Shading is computed on thread that delivered last tile of neighbourhood
+    std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+    if(gathering->tiles[4])
+    {
+        Shading shading;
+        computeAndCache(gathering->state, gathering->parameters, gathering->key, gathering->tiles, shading);
+        if(!shading.alpha.isEmpty())
+            tile = createTile(shading);
+    }
+    gathering->readyCallback(gathering->key.tileId(), static_cast<OsmAnd::ZoomLevel>(gathering->key.zoom), tile, static_cast<bool>(tile));
+}
+
+ComputedHillshadeTileProvider::Counters ComputedHillshadeTileProvider::getCounters() const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    Counters counters;
+    counters.computed = _state->computed;
+    counters.cacheHits = _state->cacheHits;
+    counters.lastComputeTime = _state->lastComputeTime;
+    return counters;
+}
+
+uint32_t ComputedHillshadeTileProvider::getTileSize() const
+{
+    return _heightmapProvider->getTileSize();
+}
+
+bool ComputedHillshadeTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    // Only cached shading is served on caller (render) thread, misses are computed in deferred path
+    Shading shading;
+    if(!obtainCached(_state, key, shading))
+        return false;
+
+    tile = createTile(shading);
+    return static_cast<bool>(tile);
+}
+
+void ComputedHillshadeTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    Shading shading;
+    if(obtainCached(_state, key, shading))
+    {
+        const auto tile = createTile(shading);
+        readyCallback(tileId, zoom, tile, static_cast<bool>(tile));
+        return;
+    }
+
+    std::shared_ptr<Gathering> gathering(new Gathering());
+    gathering->state = _state;
+    gathering->parameters = _parameters;
+    gathering->key = key;
+    gathering->readyCallback = readyCallback;
+
+    // Elevation tile and its 8 neighbours, columns wrap around antimeridian
+    const auto tilesPerSide = 1 << static_cast<int>(zoom);
+    for(int idx = 0; idx < 9; idx++)
+    {
+        OsmAnd::TileId neighbourId;
+        neighbourId.x = (static_cast<int>(tileId.x) + idx % 3 - 1 + tilesPerSide) % tilesPerSide;
+        neighbourId.y = static_cast<int>(tileId.y) + idx / 3 - 1;
+        if(neighbourId.y < 0 || neighbourId.y >= tilesPerSide)
+        {
+            tileGathered(gathering, idx, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>());
+            continue;
+        }
+
+        const auto neighbourKey = TileKey::make(neighbourId, zoom);
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile> cached;
+        {
+            QMutexLocker scopeLock(&_state->mutex);
+
+            const auto heights = _state->heights.touch(neighbourKey);
+            if(heights)
+                cached = *heights;
+        }
+        if(cached)
+        {
+            tileGathered(gathering, idx, cached);
+            continue;
+        }
+
+        _heightmapProvider->obtainTileDeffered(neighbourId, zoom,
+            [gathering, idx, neighbourKey](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile, bool success)
+            {
+                if(success && elevationTile)
+                {
+                    QMutexLocker scopeLock(&gathering->state->mutex);
+
+                    gathering->state->heights.insert(neighbourKey, elevationTile);
+                }
+                tileGathered(gathering, idx, success ? elevationTile : std::shared_ptr<OsmAnd::IMapTileProvider::Tile>());
+            });
+    }
+}
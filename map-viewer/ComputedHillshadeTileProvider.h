@@ -0,0 +1,135 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __COMPUTED_HILLSHADE_TILE_PROVIDER_H_
+#define __COMPUTED_HILLSHADE_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <array>
+#include <memory>
+
+#include <QMutex>
+#include <QByteArray>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+
+#include "HillshadeKernel.h"
+#include "LruCache.h"
+#include "TileKey.h"
+
+// Hillshade overlay computed at runtime from elevation tiles (e.g. HeightmapTileProvider),
+// instead of pre-baked sqlite tiles. Shading of each tile is kept in LRU cache, so tiles
+// that come back into view are not recomputed. Shading is computed only in deferred path,
+// immediate requests are served from cache. Gradients at tile borders use samples of the 8
+// neighbouring elevation tiles, which are kept in a small LRU cache of their own, so adjacent
+// tiles shade seamlessly.
+class ComputedHillshadeTileProvider : public OsmAnd::IMapBitmapTileProvider
+{
+public:
+    struct Counters
+    {
+        uint64_t computed;
+        uint64_t cacheHits;
+        double lastComputeTime;
+    };
+
+    // Elevation tiles around shaded one, rows going southwards, shaded tile in the middle (index 4).
+    // Neighbours may be missing, their side is then padded with clamped samples of shaded tile.
+    typedef std::array<std::shared_ptr<OsmAnd::IMapTileProvider::Tile>, 9> Neighbourhood;
+
+private:
+    enum
+    {
+        HeightsCacheCapacity = 64,
+    };
+
+    struct Shading
+    {
+        uint32_t size;
+        QByteArray alpha;
+    };
+
+    struct State
+    {
+        State(int cacheCapacity);
+
+        QMutex mutex;
+        LruCache<TileKey, Shading> cache;
+        LruCache< TileKey, std::shared_ptr<OsmAnd::IMapTileProvider::Tile> > heights;
+
+        uint64_t computed;
+        uint64_t cacheHits;
+        double lastComputeTime;
+    };
+
+    // Neighbourhood of one deferred request, shaded once all of its tiles arrived
+    struct Gathering
+    {
+        Gathering();
+
+        std::shared_ptr<State> state;
+        HillshadeKernel::Parameters parameters;
+        TileKey key;
+        OsmAnd::IMapTileProvider::TileReadyCallback readyCallback;
+
+        QMutex mutex;
+        Neighbourhood tiles;
+        int remaining;
+    };
+
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _heightmapProvider;
+    const HillshadeKernel::Parameters _parameters;
+    const std::shared_ptr<State> _state;
+
+    static std::shared_ptr<OsmAnd::IMapTileProvider::Tile> createTile(const Shading& shading);
+    static bool obtainCached(const std::shared_ptr<State>& state, const TileKey& key, Shading& shading);
+    static void computeAndCache(
+        const std::shared_ptr<State>& state, const HillshadeKernel::Parameters& parameters,
+        const TileKey& key, const Neighbourhood& elevationTiles,
+        Shading& shading);
+    static void tileGathered(const std::shared_ptr<Gathering>& gathering, int idx, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile);
+public:
+    ComputedHillshadeTileProvider(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+        const HillshadeKernel::Parameters& parameters = HillshadeKernel::Parameters(),
+        int cacheCapacity = 256);
+    virtual ~ComputedHillshadeTileProvider();
+
+    // Shades middle elevation tile into one alpha byte per sample, size x size
+    static bool shadeElevationTile(
+        const Neighbourhood& elevationTiles,
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        const HillshadeKernel::Parameters& parameters,
+        HillshadeKernel::Implementation implementation,
+        QByteArray& alpha, uint32_t& size);
+
+    Counters getCounters() const;
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __COMPUTED_HILLSHADE_TILE_PROVIDER_H_
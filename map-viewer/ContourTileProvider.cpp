@@ -0,0 +1,173 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "ContourTileProvider.h"
+
+#include <chrono>
+
+#include <QMutexLocker>
+
+#include <SkBitmap.h>
+#include <SkCanvas.h>
+#include <SkDevice.h>
+
+#include <OsmAndCore/Map/IMapElevationDataProvider.h>
+
+ContourTileProvider::State::State(int cacheCapacity_)
+    : cache(cacheCapacity_)
+    , extracted(0)
+    , cacheHits(0)
+    , lastExtractTime(0.0)
+{
+}
+
+ContourTileProvider::ContourTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider, uint32_t tileSize, int cacheCapacity)
+    : _heightmapProvider(heightmapProvider)
+    , _tileSize(tileSize)
+    , _state(new State(cacheCapacity))
+{
+}
+
+ContourTileProvider::~ContourTileProvider()
+{
+}
+
+bool ContourTileProvider::extractFromElevationTile(
+    const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile,
+    const OsmAnd::ZoomLevel& zoom,
+    ContourLines::Isolines& isolines, uint32_t& gridSize)
+{
+    const auto heights = std::dynamic_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(elevationTile);
+    if(!heights || heights->width < 2 || heights->width != heights->height)
+        return false;
+    gridSize = heights->width;
+
+    ContourLines::extract(
+        reinterpret_cast<const float*>(heights->data), heights->rowLength / sizeof(float), gridSize, gridSize,
+        ContourLines::intervalForZoom(static_cast<int>(zoom)),
+        isolines);
+    return true;
+}
+
+bool ContourTileProvider::obtainCached(const std::shared_ptr<State>& state, const TileKey& key, Entry& entry)
+{
+    QMutexLocker scopeLock(&state->mutex);
+
+    const auto cached = state->cache.touch(key);
+    if(!cached)
+        return false;
+
+    entry = *cached;
+    state->cacheHits++;
+    return true;
+}
+
+bool ContourTileProvider::extractAndCache(const std::shared_ptr<State>& state, const TileKey& key, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile, Entry& entry)
+{
+    const auto extractStart = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<ContourLines::Isolines> isolines(new ContourLines::Isolines());
+    if(!extractFromElevationTile(elevationTile, static_cast<OsmAnd::ZoomLevel>(key.zoom), *isolines, entry.gridSize))
+        return false;
+    entry.isolines = isolines;
+    const auto extractFinish = std::chrono::high_resolution_clock::now();
+
+    QMutexLocker scopeLock(&state->mutex);
+
+    state->extracted++;
+    state->lastExtractTime = std::chrono::duration<double, std::milli>(extractFinish - extractStart).count();
+    state->cache.insert(key, entry);
+    return true;
+}
+
+std::shared_ptr<OsmAnd::IMapTileProvider::Tile> ContourTileProvider::createTile(const Entry& entry, uint32_t tileSize)
+{
+    auto bitmap = new SkBitmap();
+    bitmap->setConfig(SkBitmap::kARGB_8888_Config, tileSize, tileSize);
+    if(!bitmap->allocPixels())
+    {
+        delete bitmap;
+        return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>();
+    }
+    bitmap->eraseColor(SK_ColorTRANSPARENT);
+
+    {
+        SkDevice renderTarget(*bitmap);
+        SkCanvas canvas(&renderTarget);
+        ContourLines::draw(canvas, *entry.isolines, static_cast<float>(tileSize) / (entry.gridSize - 1), 0.0f, 0.0f);
+    }
+
+    return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(
+        new OsmAnd::IMapBitmapTileProvider::Tile(bitmap, OsmAnd::IMapBitmapTileProvider::AlphaChannelData::Present));
+}
+
+ContourTileProvider::Counters ContourTileProvider::getCounters() const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    Counters counters;
+    counters.extracted = _state->extracted;
+    counters.cacheHits = _state->cacheHits;
+    counters.lastExtractTime = _state->lastExtractTime;
+    return counters;
+}
+
+uint32_t ContourTileProvider::getTileSize() const
+{
+    return _tileSize;
+}
+
+bool ContourTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    // Only cached isolines are drawn on caller thread
+    Entry entry;
+    if(!obtainCached(_state, TileKey::make(tileId, zoom), entry))
+        return false;
+
+    tile = createTile(entry, _tileSize);
+    return static_cast<bool>(tile);
+}
+
+void ContourTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    Entry entry;
+    if(obtainCached(_state, key, entry))
+    {
+        const auto tile = createTile(entry, _tileSize);
+        readyCallback(tileId, zoom, tile, static_cast<bool>(tile));
+        return;
+    }
+
+    const auto state = _state;
+    const auto tileSize = _tileSize;
+    _heightmapProvider->obtainTileDeffered(tileId, zoom,
+        [state, key, tileSize, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile, bool success)
+        {
+            std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+            Entry entry;
+            if(success && elevationTile && extractAndCache(state, key, elevationTile, entry))
+                tile = createTile(entry, tileSize);
+
+            readyCallback(tileId, zoom, tile, static_cast<bool>(tile));
+        });
+}
@@ -0,0 +1,96 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __CONTOUR_TILE_PROVIDER_H_
+#define __CONTOUR_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <memory>
+
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+
+#include "ContourLines.h"
+#include "LruCache.h"
+#include "TileKey.h"
+
+// Contour lines overlay extracted at runtime from elevation tiles (e.g. HeightmapTileProvider),
+// with interval chosen by zoom. Extracted isolines of each tile are kept in LRU cache and
+// drawn into new bitmap per request.
+class ContourTileProvider : public OsmAnd::IMapBitmapTileProvider
+{
+public:
+    struct Counters
+    {
+        uint64_t extracted;
+        uint64_t cacheHits;
+        double lastExtractTime;
+    };
+
+private:
+    struct Entry
+    {
+        uint32_t gridSize;
+        std::shared_ptr<const ContourLines::Isolines> isolines;
+    };
+
+    struct State
+    {
+        State(int cacheCapacity);
+
+        QMutex mutex;
+        LruCache<TileKey, Entry> cache;
+
+        uint64_t extracted;
+        uint64_t cacheHits;
+        double lastExtractTime;
+    };
+
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _heightmapProvider;
+    const uint32_t _tileSize;
+    const std::shared_ptr<State> _state;
+
+    static bool obtainCached(const std::shared_ptr<State>& state, const TileKey& key, Entry& entry);
+    static bool extractAndCache(const std::shared_ptr<State>& state, const TileKey& key, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile, Entry& entry);
+    static std::shared_ptr<OsmAnd::IMapTileProvider::Tile> createTile(const Entry& entry, uint32_t tileSize);
+public:
+    ContourTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider, uint32_t tileSize = 256, int cacheCapacity = 512);
+    virtual ~ContourTileProvider();
+
+    // Extracts isolines of elevation tile with interval for given zoom
+    static bool extractFromElevationTile(
+        const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& elevationTile,
+        const OsmAnd::ZoomLevel& zoom,
+        ContourLines::Isolines& isolines, uint32_t& gridSize);
+
+    Counters getCounters() const;
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __CONTOUR_TILE_PROVIDER_H_
@@ -0,0 +1,270 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "HillshadeKernel.h"
+#include "HillshadeKernel_P.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define HILLSHADE_KERNEL_SSE2
+#   include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#   include <intrin.h>
+#endif
+
+using namespace HillshadeKernel::Internal;
+
+namespace
+{
+    // AVX kernel is compiled separately, so CPU and OS (saved YMM state) are checked at runtime
+    bool detectAVX()
+    {
+        if(!AVXCompiled)
+            return false;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_cpu_supports("avx");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return false;
+#endif
+    }
+
+    bool cpuSupportsAVX()
+    {
+        static const bool supported = detectAVX();
+        return supported;
+    }
+
+    Constants makeConstants(float cellSizeX, float cellSizeY, const HillshadeKernel::Parameters& parameters)
+    {
+        const auto azimuth = parameters.azimuth * Pi / 180.0f;
+        const auto altitude = parameters.altitude * Pi / 180.0f;
+
+        Constants constants;
+        constants.invCellX8 = 1.0f / (8.0f * cellSizeX);
+        constants.invCellY8 = 1.0f / (8.0f * cellSizeY);
+        constants.zFactor = parameters.zFactor;
+        constants.sinAltitude = std::sin(altitude);
+        constants.cosAltitudeSinAzimuth = std::cos(altitude) * std::sin(azimuth);
+        constants.cosAltitudeCosAzimuth = std::cos(altitude) * std::cos(azimuth);
+        constants.slopeShading = parameters.slopeShading;
+        return constants;
+    }
+
+    inline float atanUnit(float u)
+    {
+        const auto u2 = u * u;
+        return u * (Atan1 + u2 * (Atan3 + u2 * (Atan5 + u2 * (Atan7 + u2 * Atan9))));
+    }
+
+    // Window is
+    //   a b c
+    //   d e f
+    //   g h i
+    // with rows going southwards
+    inline uint8_t shade(const Constants& k, float a, float b, float c, float d, float f, float g, float h, float i)
+    {
+        const auto dx = ((c + 2.0f * f + i) - (a + 2.0f * d + g)) * k.invCellX8;
+        const auto dy = ((g + 2.0f * h + i) - (a + 2.0f * b + c)) * k.invCellY8;
+        const auto zx = k.zFactor * dx;
+        const auto zy = k.zFactor * dy;
+
+        // Cosine between surface normal and light direction
+        const auto cang = (k.sinAltitude - zx * k.cosAltitudeSinAzimuth + zy * k.cosAltitudeCosAzimuth) / std::sqrt(1.0f + zx * zx + zy * zy);
+        auto gray = std::max(1.0f, 1.0f + 254.0f * cang);
+
+        if(k.slopeShading)
+        {
+            const auto t = std::sqrt(dx * dx + dy * dy);
+            const auto slope = t > 1.0f ? Pi / 2.0f - atanUnit(1.0f / t) : atanUnit(t);
+            gray *= 1.0f - slope * (2.0f / Pi);
+        }
+
+        const auto level = std::min(1.0f, std::max(0.0f, (gray - LevelLow) / LevelRange));
+        return static_cast<uint8_t>(255.0f * (1.0f - level) + 0.5f);
+    }
+
+    inline void shadeScalar(const Constants& k, const float* above, const float* row, const float* below, int x, uint8_t* output)
+    {
+        output[x] = shade(k, above[x - 1], above[x], above[x + 1], row[x - 1], row[x + 1], below[x - 1], below[x], below[x + 1]);
+    }
+
+#if defined(HILLSHADE_KERNEL_SSE2)
+    inline __m128 atanUnitSSE2(__m128 u)
+    {
+        const auto u2 = _mm_mul_ps(u, u);
+        auto p = _mm_set1_ps(Atan9);
+        p = _mm_add_ps(_mm_mul_ps(p, u2), _mm_set1_ps(Atan7));
+        p = _mm_add_ps(_mm_mul_ps(p, u2), _mm_set1_ps(Atan5));
+        p = _mm_add_ps(_mm_mul_ps(p, u2), _mm_set1_ps(Atan3));
+        p = _mm_add_ps(_mm_mul_ps(p, u2), _mm_set1_ps(Atan1));
+        return _mm_mul_ps(p, u);
+    }
+
+    // Pixels [x, x + 4) of a row
+    inline void shadeSSE2(const Constants& k, const float* above, const float* row, const float* below, int x, uint8_t* output)
+    {
+        const auto two = _mm_set1_ps(2.0f);
+        const auto one = _mm_set1_ps(1.0f);
+
+        const auto a = _mm_loadu_ps(above + x - 1);
+        const auto b = _mm_loadu_ps(above + x);
+        const auto c = _mm_loadu_ps(above + x + 1);
+        const auto d = _mm_loadu_ps(row + x - 1);
+        const auto f = _mm_loadu_ps(row + x + 1);
+        const auto g = _mm_loadu_ps(below + x - 1);
+        const auto h = _mm_loadu_ps(below + x);
+        const auto i = _mm_loadu_ps(below + x + 1);
+
+        const auto dx = _mm_mul_ps(
+            _mm_sub_ps(_mm_add_ps(_mm_add_ps(c, _mm_mul_ps(two, f)), i), _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(two, d)), g)),
+            _mm_set1_ps(k.invCellX8));
+        const auto dy = _mm_mul_ps(
+            _mm_sub_ps(_mm_add_ps(_mm_add_ps(g, _mm_mul_ps(two, h)), i), _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(two, b)), c)),
+            _mm_set1_ps(k.invCellY8));
+        const auto zx = _mm_mul_ps(_mm_set1_ps(k.zFactor), dx);
+        const auto zy = _mm_mul_ps(_mm_set1_ps(k.zFactor), dy);
+
+        const auto numerator = _mm_add_ps(
+            _mm_sub_ps(_mm_set1_ps(k.sinAltitude), _mm_mul_ps(zx, _mm_set1_ps(k.cosAltitudeSinAzimuth))),
+            _mm_mul_ps(zy, _mm_set1_ps(k.cosAltitudeCosAzimuth)));
+        const auto cang = _mm_div_ps(numerator, _mm_sqrt_ps(_mm_add_ps(one, _mm_add_ps(_mm_mul_ps(zx, zx), _mm_mul_ps(zy, zy)))));
+        auto gray = _mm_max_ps(one, _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(254.0f), cang)));
+
+        if(k.slopeShading)
+        {
+            const auto t = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+            const auto steep = _mm_cmpgt_ps(t, one);
+            const auto u = _mm_min_ps(t, _mm_div_ps(one, t));
+            const auto p = atanUnitSSE2(u);
+            const auto slope = _mm_or_ps(
+                _mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(Pi / 2.0f), p)),
+                _mm_andnot_ps(steep, p));
+            gray = _mm_mul_ps(gray, _mm_sub_ps(one, _mm_mul_ps(slope, _mm_set1_ps(2.0f / Pi))));
+        }
+
+        const auto level = _mm_min_ps(one, _mm_max_ps(_mm_setzero_ps(),
+            _mm_div_ps(_mm_sub_ps(gray, _mm_set1_ps(LevelLow)), _mm_set1_ps(LevelRange))));
+        const auto alpha = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(255.0f), _mm_sub_ps(one, level)), _mm_set1_ps(0.5f)));
+        const auto packed16 = _mm_packs_epi32(alpha, alpha);
+        const auto packed8 = _mm_packus_epi16(packed16, packed16);
+        const auto value = _mm_cvtsi128_si32(packed8);
+        std::copy(reinterpret_cast<const uint8_t*>(&value), reinterpret_cast<const uint8_t*>(&value) + 4, output + x);
+    }
+#endif // defined(HILLSHADE_KERNEL_SSE2)
+
+}
+
+HillshadeKernel::Parameters::Parameters()
+    : azimuth(315.0f)
+    , altitude(45.0f)
+    , zFactor(2.0f)
+    , slopeShading(true)
+{
+}
+
+HillshadeKernel::Implementation HillshadeKernel::bestImplementation()
+{
+    if(cpuSupportsAVX())
+        return Implementation::AVX;
+#if defined(HILLSHADE_KERNEL_SSE2)
+    return Implementation::SSE2;
+#else
+    return Implementation::Scalar;
+#endif
+}
+
+bool HillshadeKernel::isSupported(Implementation implementation)
+{
+    switch(implementation)
+    {
+    case Implementation::Scalar:
+        return true;
+    case Implementation::SSE2:
+#if defined(HILLSHADE_KERNEL_SSE2)
+        return true;
+#else
+        return false;
+#endif
+    case Implementation::AVX:
+        return cpuSupportsAVX();
+    }
+    return false;
+}
+
+const char* HillshadeKernel::getName(Implementation implementation)
+{
+    switch(implementation)
+    {
+    case Implementation::Scalar:
+        return "scalar";
+    case Implementation::SSE2:
+        return "SSE2";
+    case Implementation::AVX:
+        return "AVX";
+    }
+    return "unknown";
+}
+
+void HillshadeKernel::compute(
+    const float* heights, size_t rowStride, int width, int height,
+    float cellSizeX, float cellSizeY,
+    const Parameters& parameters,
+    uint8_t* output, size_t outputStride,
+    Implementation implementation)
+{
+    if(width <= 0 || height <= 0)
+        return;
+    if(!isSupported(implementation))
+        implementation = Implementation::Scalar;
+    const auto constants = makeConstants(cellSizeX, cellSizeY, parameters);
+
+    for(int y = 0; y < height; y++)
+    {
+        // Padding makes every sample an inner one, so whole row goes through the widest implementation
+        const auto row = heights + y * rowStride;
+        const auto above = row - rowStride;
+        const auto below = row + rowStride;
+        const auto outputRow = output + y * outputStride;
+
+        int x = 0;
+        if(implementation == Implementation::AVX)
+            x = shadeRowAVX(constants, above, row, below, x, width, outputRow);
+#if defined(HILLSHADE_KERNEL_SSE2)
+        if(implementation != Implementation::Scalar)
+        {
+            for(; x + 4 <= width; x += 4)
+                shadeSSE2(constants, above, row, below, x, outputRow);
+        }
+#endif
+        for(; x < width; x++)
+            shadeScalar(constants, above, row, below, x, outputRow);
+    }
+}
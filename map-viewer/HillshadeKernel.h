@@ -0,0 +1,73 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __HILLSHADE_KERNEL_H_
+#define __HILLSHADE_KERNEL_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+// Hillshade and slope shading of a heightmap, same look as offline pipeline in
+// obf-generation/hillshade: "gdaldem hillshade -z 2" multiplied by slope color relief
+// (0 degrees white, 90 degrees black), levels 28%..70%, inverted into alpha.
+// Gradients use Horn's method over grid padded by one sample on every side, so that tiles
+// shaded with samples of their neighbours as padding have no seams.
+namespace HillshadeKernel
+{
+    struct Parameters
+    {
+        Parameters();
+
+        // Light source, degrees clockwise from north and above horizon
+        float azimuth;
+        float altitude;
+
+        // Vertical exaggeration
+        float zFactor;
+
+        bool slopeShading;
+    };
+
+    enum class Implementation
+    {
+        Scalar,
+        SSE2,
+        AVX,
+    };
+
+    // Widest implementation this build supports
+    Implementation bestImplementation();
+    bool isSupported(Implementation implementation);
+    const char* getName(Implementation implementation);
+
+    // Heights are in meters, rowStride is in floats. heights points to first inner sample, one
+    // more row above and below and one more sample left and right of each row must be readable.
+    // Output is one alpha byte per inner sample.
+    void compute(
+        const float* heights, size_t rowStride, int width, int height,
+        float cellSizeX, float cellSizeY,
+        const Parameters& parameters,
+        uint8_t* output, size_t outputStride,
+        Implementation implementation = bestImplementation());
+}
+
+#endif // __HILLSHADE_KERNEL_H_
@@ -0,0 +1,109 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "HillshadeKernel_P.h"
+
+// Built with AVX enabled (-mavx or /arch:AVX) and called only after runtime check of CPU.
+// No standard library templates are used here, see HillshadeKernel_P.h.
+#if defined(__AVX__)
+#   include <immintrin.h>
+
+using namespace HillshadeKernel::Internal;
+
+namespace
+{
+    inline __m256 atanUnitAVX(__m256 u)
+    {
+        const auto u2 = _mm256_mul_ps(u, u);
+        auto p = _mm256_set1_ps(Atan9);
+        p = _mm256_add_ps(_mm256_mul_ps(p, u2), _mm256_set1_ps(Atan7));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u2), _mm256_set1_ps(Atan5));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u2), _mm256_set1_ps(Atan3));
+        p = _mm256_add_ps(_mm256_mul_ps(p, u2), _mm256_set1_ps(Atan1));
+        return _mm256_mul_ps(p, u);
+    }
+
+    // Pixels [x, x + 8) of a row
+    inline void shadeAVX(const Constants& k, const float* above, const float* row, const float* below, int x, uint8_t* output)
+    {
+        const auto two = _mm256_set1_ps(2.0f);
+        const auto one = _mm256_set1_ps(1.0f);
+
+        const auto a = _mm256_loadu_ps(above + x - 1);
+        const auto b = _mm256_loadu_ps(above + x);
+        const auto c = _mm256_loadu_ps(above + x + 1);
+        const auto d = _mm256_loadu_ps(row + x - 1);
+        const auto f = _mm256_loadu_ps(row + x + 1);
+        const auto g = _mm256_loadu_ps(below + x - 1);
+        const auto h = _mm256_loadu_ps(below + x);
+        const auto i = _mm256_loadu_ps(below + x + 1);
+
+        const auto dx = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(c, _mm256_mul_ps(two, f)), i), _mm256_add_ps(_mm256_add_ps(a, _mm256_mul_ps(two, d)), g)),
+            _mm256_set1_ps(k.invCellX8));
+        const auto dy = _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(g, _mm256_mul_ps(two, h)), i), _mm256_add_ps(_mm256_add_ps(a, _mm256_mul_ps(two, b)), c)),
+            _mm256_set1_ps(k.invCellY8));
+        const auto zx = _mm256_mul_ps(_mm256_set1_ps(k.zFactor), dx);
+        const auto zy = _mm256_mul_ps(_mm256_set1_ps(k.zFactor), dy);
+
+        const auto numerator = _mm256_add_ps(
+            _mm256_sub_ps(_mm256_set1_ps(k.sinAltitude), _mm256_mul_ps(zx, _mm256_set1_ps(k.cosAltitudeSinAzimuth))),
+            _mm256_mul_ps(zy, _mm256_set1_ps(k.cosAltitudeCosAzimuth)));
+        const auto cang = _mm256_div_ps(numerator, _mm256_sqrt_ps(_mm256_add_ps(one, _mm256_add_ps(_mm256_mul_ps(zx, zx), _mm256_mul_ps(zy, zy)))));
+        auto gray = _mm256_max_ps(one, _mm256_add_ps(one, _mm256_mul_ps(_mm256_set1_ps(254.0f), cang)));
+
+        if(k.slopeShading)
+        {
+            const auto t = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+            const auto steep = _mm256_cmp_ps(t, one, _CMP_GT_OQ);
+            const auto u = _mm256_min_ps(t, _mm256_div_ps(one, t));
+            const auto p = atanUnitAVX(u);
+            const auto slope = _mm256_blendv_ps(p, _mm256_sub_ps(_mm256_set1_ps(Pi / 2.0f), p), steep);
+            gray = _mm256_mul_ps(gray, _mm256_sub_ps(one, _mm256_mul_ps(slope, _mm256_set1_ps(2.0f / Pi))));
+        }
+
+        const auto level = _mm256_min_ps(one, _mm256_max_ps(_mm256_setzero_ps(),
+            _mm256_div_ps(_mm256_sub_ps(gray, _mm256_set1_ps(LevelLow)), _mm256_set1_ps(LevelRange))));
+        const auto alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(255.0f), _mm256_sub_ps(one, level)), _mm256_set1_ps(0.5f)));
+        const auto packed16 = _mm_packs_epi32(_mm256_castsi256_si128(alpha), _mm256_extractf128_si256(alpha, 1));
+        const auto packed8 = _mm_packus_epi16(packed16, packed16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(output + x), packed8);
+    }
+}
+
+const bool HillshadeKernel::Internal::AVXCompiled = true;
+
+int HillshadeKernel::Internal::shadeRowAVX(const Constants& k, const float* above, const float* row, const float* below, int x, int width, uint8_t* output)
+{
+    for(; x + 8 <= width; x += 8)
+        shadeAVX(k, above, row, below, x, output);
+    return x;
+}
+#else
+const bool HillshadeKernel::Internal::AVXCompiled = false;
+
+int HillshadeKernel::Internal::shadeRowAVX(const Constants& k, const float* above, const float* row, const float* below, int x, int width, uint8_t* output)
+{
+    return x;
+}
+#endif // defined(__AVX__)
@@ -0,0 +1,70 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __HILLSHADE_KERNEL_P_H_
+#define __HILLSHADE_KERNEL_P_H_
+
+#include <stdint.h>
+
+#include "HillshadeKernel.h"
+
+// Shared between HillshadeKernel.cpp and HillshadeKernel_AVX.cpp, which is compiled with AVX
+// enabled. Only plain data lives here: inline functions instantiated in both translation units
+// could be merged by linker into the AVX copy and crash on CPUs without AVX.
+namespace HillshadeKernel
+{
+    namespace Internal
+    {
+        const float Pi = 3.14159265358979f;
+
+        // Levels applied to composed image, as "convert -level 28%x70%"
+        const float LevelLow = 0.28f * 255.0f;
+        const float LevelRange = (0.70f - 0.28f) * 255.0f;
+
+        // atan(u) for u in [0, 1], max error about 1e-5 rad
+        const float Atan1 = 0.9998660f;
+        const float Atan3 = -0.3302995f;
+        const float Atan5 = 0.1801410f;
+        const float Atan7 = -0.0851330f;
+        const float Atan9 = 0.0208351f;
+
+        struct Constants
+        {
+            float invCellX8;
+            float invCellY8;
+            float zFactor;
+            float sinAltitude;
+            float cosAltitudeSinAzimuth;
+            float cosAltitudeCosAzimuth;
+            bool slopeShading;
+        };
+
+        // False if compiler could not target AVX, then shadeRowAVX() does nothing
+        extern const bool AVXCompiled;
+
+        // Shades pixels of a row from x while whole 8 pixels fit in width, returns first pixel that
+        // is left for narrower implementation. Rows are padded, see HillshadeKernel::compute().
+        int shadeRowAVX(const Constants& k, const float* above, const float* row, const float* below, int x, int width, uint8_t* output);
+    }
+}
+
+#endif // __HILLSHADE_KERNEL_P_H_
@@ -0,0 +1,95 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "InstrumentedTileProvider.h"
+
+InstrumentedTileProvider::State::State()
+    : requested(0)
+    , immediate(0)
+    , delivered(0)
+    , failed(0)
+    , deliveredSinceFrame(0)
+{
+}
+
+InstrumentedTileProvider::InstrumentedTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider)
+    : OsmAnd::IMapTileProvider(provider->type)
+    , _provider(provider)
+    , _state(new State())
+{
+}
+
+InstrumentedTileProvider::~InstrumentedTileProvider()
+{
+}
+
+InstrumentedTileProvider::Counters InstrumentedTileProvider::getCounters() const
+{
+    Counters counters;
+    counters.requested = _state->requested;
+    counters.immediate = _state->immediate;
+    counters.delivered = _state->delivered;
+    counters.failed = _state->failed;
+    return counters;
+}
+
+uint64_t InstrumentedTileProvider::takeDeliveredSinceFrame()
+{
+    return _state->deliveredSinceFrame.exchange(0);
+}
+
+uint32_t InstrumentedTileProvider::getTileSize() const
+{
+    return _provider->getTileSize();
+}
+
+bool InstrumentedTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    if(!_provider->obtainTileImmediate(tileId, zoom, tile))
+        return false;
+
+    _state->immediate++;
+    _state->deliveredSinceFrame++;
+    return true;
+}
+
+void InstrumentedTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    _state->requested++;
+
+    const auto state = _state;
+    _provider->obtainTileDeffered(tileId, zoom,
+        [state, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            if(success)
+            {
+                state->delivered++;
+                state->deliveredSinceFrame++;
+            }
+            else
+            {
+                state->failed++;
+            }
+
+            readyCallback(tileId, zoom, tile, success);
+        });
+}
@@ -0,0 +1,88 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __INSTRUMENTED_TILE_PROVIDER_H_
+#define __INSTRUMENTED_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <memory>
+#include <atomic>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+
+// Transparent proxy around a tile provider that counts requests and deliveries.
+// Every delivered tile ends up uploaded to GPU by renderer on next processRendering(),
+// so delivered-since-last-frame is used as "tiles uploaded per frame".
+class InstrumentedTileProvider : public OsmAnd::IMapTileProvider
+{
+public:
+    struct Counters
+    {
+        uint64_t requested;
+        uint64_t immediate;
+        uint64_t delivered;
+        uint64_t failed;
+
+        uint64_t pending() const
+        {
+            return requested - delivered - failed;
+        }
+    };
+
+private:
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+
+    // Counters are shared with callbacks of in-flight requests, which may outlive this proxy
+    struct State
+    {
+        State();
+
+        std::atomic<uint64_t> requested;
+        std::atomic<uint64_t> immediate;
+        std::atomic<uint64_t> delivered;
+        std::atomic<uint64_t> failed;
+        std::atomic<uint64_t> deliveredSinceFrame;
+    };
+    const std::shared_ptr<State> _state;
+
+public:
+    InstrumentedTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider);
+    virtual ~InstrumentedTileProvider();
+
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& provider() const
+    {
+        return _provider;
+    }
+
+    Counters getCounters() const;
+
+    // Returns number of tiles delivered since previous call
+    uint64_t takeDeliveredSinceFrame();
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __INSTRUMENTED_TILE_PROVIDER_H_
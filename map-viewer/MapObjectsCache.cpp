@@ -0,0 +1,226 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "MapObjectsCache.h"
+
+#include <limits>
+#include <algorithm>
+
+#include <QMutexLocker>
+
+#include <OsmAndCore/Data/ObfReader.h>
+#include <OsmAndCore/Data/ObfMapSection.h>
+
+uint qHash(const MapObjectsCache::ObjectKey& key)
+{
+    return qHash(key.id) ^ (static_cast<uint>(key.zoom) * 0x9E3779B1u) ^ (static_cast<uint>(key.source) * 0x85EBCA77u);
+}
+
+MapObjectsCache::MapObjectsCache(const std::shared_ptr<ObfHeaderIndex>& source, uint64_t budgetBytes)
+    : _source(source)
+    , _budgetBytes(budgetBytes)
+    , _residentBytes(0)
+    , _hits(0)
+    , _misses(0)
+    , _evictions(0)
+    , _sharedObjects(0)
+{
+}
+
+MapObjectsCache::~MapObjectsCache()
+{
+}
+
+size_t MapObjectsCache::estimateBytes(const std::shared_ptr<OsmAnd::Model::MapObject>& mapObject)
+{
+    size_t bytes = sizeof(OsmAnd::Model::MapObject);
+    bytes += mapObject->points31.size() * sizeof(OsmAnd::PointI);
+    for(auto itPolygon = mapObject->innerPolygonsPoints31.begin(); itPolygon != mapObject->innerPolygonsPoints31.end(); ++itPolygon)
+        bytes += sizeof(*itPolygon) + itPolygon->size() * sizeof(OsmAnd::PointI);
+    bytes += mapObject->types.size() * sizeof(*mapObject->types.begin());
+    for(auto itName = mapObject->names.begin(); itName != mapObject->names.end(); ++itName)
+        bytes += 2 * sizeof(void*) + itName.value().size() * sizeof(QChar);
+    return bytes;
+}
+
+size_t MapObjectsCache::tileOverhead(const TileEntry& tile)
+{
+    return sizeof(TileKey) + sizeof(TileEntry) + tile.mapObjects.size() * (sizeof(std::shared_ptr<OsmAnd::Model::MapObject>) + sizeof(int));
+}
+
+void MapObjectsCache::obtainMapObjects(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, QList< std::shared_ptr<OsmAnd::Model::MapObject> >& mapObjects)
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        const auto cachedTile = _tiles.touch(key);
+        if(cachedTile)
+        {
+            // List is implicitly shared, hit does not copy objects
+            mapObjects = cachedTile->mapObjects;
+            _hits++;
+            return;
+        }
+        _misses++;
+    }
+
+    // Decoding is done without lock, concurrent miss of same tile is resolved on insert
+    const int64_t tileSize31 = static_cast<int64_t>(1) << (31 - key.zoom);
+    const int64_t maxCoordinate31 = std::numeric_limits<int32_t>::max();
+    OsmAnd::AreaI bbox31;
+    bbox31.left = static_cast<int32_t>(std::min(tileId.x * tileSize31, maxCoordinate31));
+    bbox31.top = static_cast<int32_t>(std::min(tileId.y * tileSize31, maxCoordinate31));
+    bbox31.right = static_cast<int32_t>(std::min((tileId.x + 1) * tileSize31, maxCoordinate31));
+    bbox31.bottom = static_cast<int32_t>(std::min((tileId.y + 1) * tileSize31, maxCoordinate31));
+    TileEntry decoded;
+    // Path of each reader and count of objects decoded up to it
+    QList< std::pair<QString, int> > sourceRanges;
+    uint32_t zoom32 = key.zoom;
+    OsmAnd::QueryFilter filter;
+    filter._bbox31 = &bbox31;
+    filter._zoom = &zoom32;
+    const auto readers = _source->obtainReaders(bbox31, ObfHeaderIndex::SectionType::Map, key.zoom);
+    for(auto itReader = readers.begin(); itReader != readers.end(); ++itReader)
+    {
+        const auto& reader = *itReader;
+        QMutexLocker readerLock(reader.mutex.get());
+
+        const auto& mapSections = reader.obfReader->mapSections;
+        for(auto itMapSection = mapSections.begin(); itMapSection != mapSections.end(); ++itMapSection)
+            OsmAnd::ObfMapSection::loadMapObjects(reader.obfReader.get(), itMapSection->get(), &decoded.mapObjects, &filter, nullptr);
+        sourceRanges.push_back(std::make_pair(reader.path, decoded.mapObjects.size()));
+    }
+
+    QMutexLocker scopeLock(&_mutex);
+
+    const auto cachedTile = _tiles.peek(key);
+    if(cachedTile)
+    {
+        mapObjects = cachedTile->mapObjects;
+        return;
+    }
+
+    decoded.sources.reserve(decoded.mapObjects.size());
+    for(auto itRange = sourceRanges.begin(); itRange != sourceRanges.end(); ++itRange)
+    {
+        auto itSourceId = _sourceIds.find(itRange->first);
+        if(itSourceId == _sourceIds.end())
+            itSourceId = _sourceIds.insert(itRange->first, _sourceIds.size());
+        while(decoded.sources.size() < itRange->second)
+            decoded.sources.push_back(*itSourceId);
+    }
+
+    // Replace objects already held by other tiles with the resident instance
+    for(int objectIdx = 0; objectIdx < decoded.mapObjects.size(); objectIdx++)
+    {
+        auto& mapObject = decoded.mapObjects[objectIdx];
+        ObjectKey objectKey;
+        objectKey.id = mapObject->id;
+        objectKey.zoom = key.zoom;
+        objectKey.source = decoded.sources[objectIdx];
+
+        auto itEntry = _objects.find(objectKey);
+        if(itEntry != _objects.end())
+        {
+            mapObject = itEntry->object;
+            itEntry->tilesCount++;
+            _sharedObjects++;
+            continue;
+        }
+
+        ObjectEntry entry;
+        entry.object = mapObject;
+        entry.bytes = estimateBytes(mapObject);
+        entry.tilesCount = 1;
+        _objects.insert(objectKey, entry);
+        _residentBytes += entry.bytes;
+    }
+    _residentBytes += tileOverhead(decoded);
+    _tiles.insert(key, decoded);
+    evictIfNeeded(key);
+
+    mapObjects = decoded.mapObjects;
+}
+
+void MapObjectsCache::releaseTile(const TileKey& key, const TileEntry& tile)
+{
+    for(int objectIdx = 0; objectIdx < tile.mapObjects.size(); objectIdx++)
+    {
+        ObjectKey objectKey;
+        objectKey.id = tile.mapObjects[objectIdx]->id;
+        objectKey.zoom = key.zoom;
+        objectKey.source = tile.sources[objectIdx];
+
+        const auto itEntry = _objects.find(objectKey);
+        if(itEntry == _objects.end())
+            continue;
+        if(--itEntry->tilesCount > 0)
+            continue;
+        _residentBytes -= itEntry->bytes;
+        _objects.erase(itEntry);
+    }
+    _residentBytes -= tileOverhead(tile);
+}
+
+void MapObjectsCache::evictIfNeeded(const TileKey& keep)
+{
+    // Objects still referenced by renderer workers stay alive through their shared pointers,
+    // they are just no longer accounted here
+    while(_residentBytes > _budgetBytes && _tiles.size() > 1)
+    {
+        const auto key = _tiles.leastRecentKey();
+        if(key == keep)
+            break;
+
+        TileEntry tile;
+        _tiles.take(key, &tile);
+        releaseTile(key, tile);
+        _evictions++;
+    }
+}
+
+void MapObjectsCache::clear()
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    _tiles.clear();
+    _objects.clear();
+    _residentBytes = 0;
+}
+
+MapObjectsCache::Counters MapObjectsCache::getCounters() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    Counters counters;
+    counters.hits = _hits;
+    counters.misses = _misses;
+    counters.evictions = _evictions;
+    counters.sharedObjects = _sharedObjects;
+    counters.residentBytes = _residentBytes;
+    counters.budgetBytes = _budgetBytes;
+    counters.residentTiles = _tiles.size();
+    counters.residentObjects = _objects.size();
+    return counters;
+}
@@ -0,0 +1,131 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __MAP_OBJECTS_CACHE_H_
+#define __MAP_OBJECTS_CACHE_H_
+
+#include <stdint.h>
+#include <memory>
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Data/Model/MapObject.h>
+
+#include "ObfHeaderIndex.h"
+#include "LruCache.h"
+#include "TileKey.h"
+
+// Byte-budgeted cache of decoded map objects, keyed by tile and zoom. Misses are decoded from map
+// sections of OBF files whose headers in ObfHeaderIndex intersect the tile, opening them on first use.
+// All layers that draw OBF data share one instance. Object that spans several tiles of the same
+// zoom is stored once (matched by id within its OBF file, since ids of different files may
+// collide), so its memory is counted once. Resident size is bounded by budget given on
+// construction: when it goes over, least recently used tiles are dropped together with objects
+// no other tile uses.
+class MapObjectsCache
+{
+public:
+    struct Counters
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t sharedObjects;
+        uint64_t residentBytes;
+        uint64_t budgetBytes;
+        int residentTiles;
+        int residentObjects;
+
+        double hitRate() const
+        {
+            return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+        }
+    };
+
+private:
+    // Same object is simplified differently per zoom, so zoom is part of identity.
+    // Source is id of OBF file the object was decoded from.
+    struct ObjectKey
+    {
+        uint64_t id;
+        int zoom;
+        int source;
+
+        bool operator==(const ObjectKey& that) const
+        {
+            return id == that.id && zoom == that.zoom && source == that.source;
+        }
+    };
+    friend uint qHash(const ObjectKey& key);
+
+    struct ObjectEntry
+    {
+        std::shared_ptr<OsmAnd::Model::MapObject> object;
+        size_t bytes;
+        int tilesCount;
+    };
+
+    typedef QList< std::shared_ptr<OsmAnd::Model::MapObject> > MapObjectsList;
+
+    // Objects of tile with source of each
+    struct TileEntry
+    {
+        MapObjectsList mapObjects;
+        QVector<int> sources;
+    };
+
+    const std::shared_ptr<ObfHeaderIndex> _source;
+    const uint64_t _budgetBytes;
+
+    mutable QMutex _mutex;
+    // Capacity is unlimited, tiles are evicted by resident bytes
+    LruCache<TileKey, TileEntry> _tiles;
+    QHash<ObjectKey, ObjectEntry> _objects;
+    QHash<QString, int> _sourceIds;
+    uint64_t _residentBytes;
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evictions;
+    uint64_t _sharedObjects;
+
+    static size_t tileOverhead(const TileEntry& tile);
+    void releaseTile(const TileKey& key, const TileEntry& tile);
+    void evictIfNeeded(const TileKey& keep);
+public:
+    MapObjectsCache(const std::shared_ptr<ObfHeaderIndex>& source, uint64_t budgetBytes);
+    virtual ~MapObjectsCache();
+
+    // Approximate heap size of decoded object
+    static size_t estimateBytes(const std::shared_ptr<OsmAnd::Model::MapObject>& mapObject);
+
+    void obtainMapObjects(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, QList< std::shared_ptr<OsmAnd::Model::MapObject> >& mapObjects);
+    void clear();
+
+    Counters getCounters() const;
+};
+
+#endif // __MAP_OBJECTS_CACHE_H_
@@ -0,0 +1,160 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "PackCachedTileProvider.h"
+
+#include <QRunnable>
+#include <QByteArray>
+
+#include <SkBitmap.h>
+#include <SkStream.h>
+#include <SkImageDecoder.h>
+#include <SkImageEncoder.h>
+
+namespace
+{
+    bool encodeTile(const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, QByteArray& data)
+    {
+        const auto bitmapTile = std::dynamic_pointer_cast<OsmAnd::IMapBitmapTileProvider::Tile>(tile);
+        if(!bitmapTile)
+            return false;
+
+        SkDynamicMemoryWStream stream;
+        if(!SkImageEncoder::EncodeStream(&stream, *bitmapTile->bitmap, SkImageEncoder::kPNG_Type, 100))
+            return false;
+
+        data.resize(stream.getOffset());
+        stream.copyTo(data.data());
+        return true;
+    }
+
+    std::shared_ptr<OsmAnd::IMapTileProvider::Tile> decodeTile(const QByteArray& data)
+    {
+        auto bitmap = new SkBitmap();
+        if(!SkImageDecoder::DecodeMemory(data.constData(), data.size(), bitmap, SkBitmap::kARGB_8888_Config, SkImageDecoder::kDecodePixels_Mode))
+        {
+            delete bitmap;
+            return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>();
+        }
+
+        return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(
+            new OsmAnd::IMapBitmapTileProvider::Tile(bitmap, OsmAnd::IMapBitmapTileProvider::AlphaChannelData::Undefined));
+    }
+
+    void fetchAndStore(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+        const std::shared_ptr<TilePackCache>& cache,
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+    {
+        provider->obtainTileDeffered(tileId, zoom,
+            [cache, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+            {
+                if(success && tile)
+                {
+                    QByteArray data;
+                    if(encodeTile(tile, data))
+                        cache->store(static_cast<uint32_t>(zoom), tileId.x, tileId.y, data);
+                }
+
+                readyCallback(tileId, zoom, tile, success);
+            });
+    }
+}
+
+class PackCachedTileProvider::DecodeTask : public QRunnable
+{
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+    const std::shared_ptr<TilePackCache> _cache;
+    const OsmAnd::TileId _tileId;
+    const OsmAnd::ZoomLevel _zoom;
+    const OsmAnd::IMapTileProvider::TileReadyCallback _readyCallback;
+public:
+    DecodeTask(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+        const std::shared_ptr<TilePackCache>& cache,
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+        : _provider(provider)
+        , _cache(cache)
+        , _tileId(tileId)
+        , _zoom(zoom)
+        , _readyCallback(readyCallback)
+    {
+    }
+
+    void run()
+    {
+        QByteArray data;
+        if(_cache->load(static_cast<uint32_t>(_zoom), _tileId.x, _tileId.y, data))
+        {
+            const auto tile = decodeTile(data);
+            if(tile)
+            {
+                _readyCallback(_tileId, _zoom, tile, true);
+                return;
+            }
+        }
+
+        // Not in pack, evicted or broken
+        if(_provider)
+            fetchAndStore(_provider, _cache, _tileId, _zoom, _readyCallback);
+        else
+            _readyCallback(_tileId, _zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(), false);
+    }
+};
+
+PackCachedTileProvider::PackCachedTileProvider(
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+    const std::shared_ptr<TilePackCache>& cache,
+    uint32_t tileSize)
+    : _provider(provider)
+    , _cache(cache)
+    , _tileSize(provider ? provider->getTileSize() : tileSize)
+{
+    _decodeThreadPool.setMaxThreadCount(2);
+}
+
+PackCachedTileProvider::~PackCachedTileProvider()
+{
+    _decodeThreadPool.waitForDone();
+    _cache->flush();
+}
+
+uint32_t PackCachedTileProvider::getTileSize() const
+{
+    return _tileSize;
+}
+
+bool PackCachedTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    // Pack reads and decoding are never done on caller thread
+    if(!_provider)
+        return false;
+    return _provider->obtainTileImmediate(tileId, zoom, tile);
+}
+
+void PackCachedTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    // Pack lookup is done on worker too, misses then go online from there
+    _decodeThreadPool.start(new DecodeTask(_provider, _cache, tileId, zoom, readyCallback));
+}
@@ -0,0 +1,67 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __PACK_CACHED_TILE_PROVIDER_H_
+#define __PACK_CACHED_TILE_PROVIDER_H_
+
+#include <memory>
+
+#include <QThreadPool>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+
+#include "TilePackCache.h"
+
+// Bitmap tile provider backed by TilePackCache. Tiles found in pack are decoded on
+// worker thread, others are requested from wrapped (online) provider and stored to
+// pack as PNG. In offline mode wrapped provider is never used and pack is read-only.
+class PackCachedTileProvider : public OsmAnd::IMapBitmapTileProvider
+{
+private:
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+    const std::shared_ptr<TilePackCache> _cache;
+    const uint32_t _tileSize;
+    QThreadPool _decodeThreadPool;
+
+    class DecodeTask;
+public:
+    // Provider may be empty only if cache is read-only
+    PackCachedTileProvider(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+        const std::shared_ptr<TilePackCache>& cache,
+        uint32_t tileSize = 256);
+    virtual ~PackCachedTileProvider();
+
+    const std::shared_ptr<TilePackCache>& cache() const
+    {
+        return _cache;
+    }
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __PACK_CACHED_TILE_PROVIDER_H_
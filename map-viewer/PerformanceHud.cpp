@@ -0,0 +1,276 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "PerformanceHud.h"
+
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+PerformanceHud::History::History()
+    : _samples(HistoryLength, 0.0f)
+    , _next(0)
+    , _count(0)
+{
+}
+
+void PerformanceHud::History::push(float value)
+{
+    _samples[_next] = value;
+    _next = (_next + 1) % HistoryLength;
+    if(_count < HistoryLength)
+        _count++;
+}
+
+float PerformanceHud::History::at(unsigned int idx) const
+{
+    return _samples[(_next + HistoryLength - _count + idx) % HistoryLength];
+}
+
+float PerformanceHud::History::max() const
+{
+    float result = 0.0f;
+    for(unsigned int idx = 0; idx < _count; idx++)
+        result = std::max(result, at(idx));
+    return result;
+}
+
+float PerformanceHud::History::average() const
+{
+    if(_count == 0)
+        return 0.0f;
+
+    float sum = 0.0f;
+    for(unsigned int idx = 0; idx < _count; idx++)
+        sum += at(idx);
+    return sum / _count;
+}
+
+PerformanceHud::PerformanceHud()
+    : _hasLastFrame(false)
+    , _currentProcessRenderingTime(0.0f)
+    , _currentBusyTime(0.0f)
+    , _currentDrawTime(0.0f)
+    , enabled(false)
+{
+    _vertices.reserve(HistoryLength * 2);
+}
+
+void PerformanceHud::beginFrame()
+{
+    const auto now = Clock::now();
+    if(_hasLastFrame)
+        _frameInterval.push(std::chrono::duration<float, std::milli>(now - _lastFrameStart).count());
+    _lastFrameStart = now;
+    _hasLastFrame = true;
+    _stageStart = now;
+    _currentDrawTime = 0.0f;
+}
+
+void PerformanceHud::processRenderingDone()
+{
+    const auto now = Clock::now();
+    _currentProcessRenderingTime = std::chrono::duration<float, std::milli>(now - _stageStart).count();
+    _stageStart = now;
+}
+
+void PerformanceHud::renderFrameDone(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer)
+{
+    const auto now = Clock::now();
+    _processRenderingTime.push(_currentProcessRenderingTime);
+    _renderFrameTime.push(std::chrono::duration<float, std::milli>(now - _stageStart).count());
+    _visibleTiles.push(renderer->visibleTiles.size());
+    _currentBusyTime = std::chrono::duration<float, std::milli>(now - _lastFrameStart).count();
+}
+
+void PerformanceHud::endFrame()
+{
+    _frameTime.push(_currentBusyTime + _currentDrawTime);
+}
+
+void PerformanceHud::drawGraph(const History& history, float scale, float left, float bottom, float width, float height)
+{
+    if(history.count() < 2 || scale <= 0.0f)
+        return;
+
+    _vertices.clear();
+    const auto step = width / (HistoryLength - 1);
+    for(unsigned int idx = 0; idx < history.count(); idx++)
+    {
+        _vertices.push_back(left + step * (HistoryLength - history.count() + idx));
+        _vertices.push_back(bottom + std::min(history.at(idx) / scale, 1.0f) * height);
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, _vertices.data());
+    glDrawArrays(GL_LINE_STRIP, 0, history.count());
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void PerformanceHud::drawText(float x, float y, const QStringList& lines)
+{
+    // glutBitmapString() moves raster position to next line on '\n'
+    const auto text = lines.join("\n").toStdString();
+    glRasterPos2f(x, y);
+    glutBitmapString(GLUT_BITMAP_8_BY_13, reinterpret_cast<const unsigned char*>(text.c_str()));
+}
+
+static QString layerName(int layerId)
+{
+    switch(layerId)
+    {
+    case OsmAnd::IMapRenderer::TileLayerId::RasterMap:
+        return "raster map";
+    case OsmAnd::IMapRenderer::TileLayerId::MapOverlay0:
+        return "overlay0";
+    case OsmAnd::IMapRenderer::TileLayerId::ElevationData:
+        return "elevation";
+    default:
+        return QString("layer %1").arg(layerId);
+    }
+}
+
+void PerformanceHud::draw(
+    const OsmAnd::AreaI& viewport,
+    const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+    const QMap<int, std::shared_ptr<InstrumentedTileProvider> >& providers,
+    const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& prefetchingProviders)
+{
+    const auto drawStart = Clock::now();
+    const float graphLeft = 8.0f;
+    const float graphWidth = std::min(static_cast<float>(viewport.width() - 16), 480.0f);
+    const float graphHeight = 64.0f;
+    const float graphBottom = 16.0f * 8;
+
+    const auto timeScale = std::max(33.3f, _frameTime.max());
+
+    QStringList lines;
+    lines << QString("frame       : %1 ms avg, %2 ms max (render and HUD)")
+        .arg(_frameTime.average(), 0, 'f', 2)
+        .arg(_frameTime.max(), 0, 'f', 2);
+    lines << QString("interval    : %1 ms avg, %2 ms max (%3 redraws/s, idle time included)")
+        .arg(_frameInterval.average(), 0, 'f', 2)
+        .arg(_frameInterval.max(), 0, 'f', 2)
+        .arg(_frameInterval.average() > 0.0f ? 1000.0f / _frameInterval.average() : 0.0f, 0, 'f', 1);
+    lines << QString("CPU process : %1 ms avg, %2 ms max")
+        .arg(_processRenderingTime.average(), 0, 'f', 2)
+        .arg(_processRenderingTime.max(), 0, 'f', 2);
+    lines << QString("CPU render  : %1 ms avg, %2 ms max")
+        .arg(_renderFrameTime.average(), 0, 'f', 2)
+        .arg(_renderFrameTime.max(), 0, 'f', 2);
+    lines << QString("visible     : %1 tiles (max %2)")
+        .arg(renderer->visibleTiles.size())
+        .arg(_visibleTiles.max());
+
+    // Estimate only: every visible tile of every active layer is assumed to occupy one tile-sized
+    // 4-byte texture (or atlas slot). Renderer does not expose its real allocations, so resident
+    // tiles that are not visible, atlas padding and mipmaps are not counted.
+    uint64_t textureBytes = 0;
+    for(auto itProvider = providers.begin(); itProvider != providers.end(); ++itProvider)
+    {
+        const auto& provider = *itProvider;
+        if(!provider)
+            continue;
+        const auto counters = provider->getCounters();
+        const uint64_t tileSize = provider->getTileSize();
+        textureBytes += renderer->visibleTiles.size() * tileSize * tileSize * 4;
+
+        lines << QString("%1: %2 pending, %3 delivered, %4 failed")
+            .arg(layerName(itProvider.key()), -12)
+            .arg(counters.pending())
+            .arg(counters.delivered + counters.immediate)
+            .arg(counters.failed);
+
+        const auto prefetchingProvider = prefetchingProviders.value(itProvider.key());
+        if(prefetchingProvider)
+        {
+            const auto prefetchCounters = prefetchingProvider->getCounters();
+            lines << QString("%1  prefetch: %2 issued, %3% hit, %4 wasted")
+                .arg("", -12)
+                .arg(prefetchCounters.issued)
+                .arg(prefetchCounters.hitRate() * 100.0, 0, 'f', 1)
+                .arg(prefetchCounters.evictedUnused);
+        }
+    }
+    auto textureLine = QString("textures    : ~%1 MB estimated for visible tiles%2")
+        .arg(textureBytes / (1024.0 * 1024.0), 0, 'f', 1)
+        .arg(renderer->configuration.textureAtlasesAllowed ? " (atlases)" : "");
+    if(GLEW_NVX_gpu_memory_info)
+    {
+        GLint dedicatedKb = 0;
+        GLint availableKb = 0;
+        glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicatedKb);
+        glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableKb);
+        textureLine += QString(", GPU %1/%2 MB used (measured)").arg((dedicatedKb - availableKb) / 1024).arg(dedicatedKb / 1024);
+    }
+    lines << textureLine;
+    if(mapObjectsCache)
+    {
+        const auto counters = mapObjectsCache->getCounters();
+        lines << QString("map data    : %1/%2 MB, %3 tiles, %4 objects, %5% hit, %6 evicted")
+            .arg(counters.residentBytes / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(counters.budgetBytes / (1024 * 1024))
+            .arg(counters.residentTiles)
+            .arg(counters.residentObjects)
+            .arg(counters.hitRate() * 100.0, 0, 'f', 1)
+            .arg(counters.evictions);
+    }
+    if(uploadScheduler)
+    {
+        const auto counters = uploadScheduler->getCounters();
+        lines << QString("uploads     : %1 tiles / %2 KB last frame (~%3 ms), budget %4 KB, backlog %5 tiles / %6 MB%7")
+            .arg(counters.lastFrameTiles)
+            .arg(counters.lastFrameBytes / 1024)
+            .arg(counters.lastFrameUploadTime, 0, 'f', 2)
+            .arg(counters.budgetBytes / 1024)
+            .arg(counters.backlogTiles)
+            .arg(counters.backlogBytes / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(uploadScheduler->enabled ? "" : " (off)");
+    }
+    lines << QString("graph scale : %1 ms (frame white, process yellow, render green), tiles cyan").arg(timeScale, 0, 'f', 1);
+
+    // Graphs: frame time (white), processRendering (yellow), renderFrame (green), visible tiles (cyan)
+    glColor3f(0.3f, 0.3f, 0.3f);
+    const GLfloat frame[] = {
+        graphLeft, graphBottom,
+        graphLeft + graphWidth, graphBottom,
+        graphLeft + graphWidth, graphBottom + graphHeight,
+        graphLeft, graphBottom + graphHeight
+    };
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, frame);
+    glDrawArrays(GL_LINE_LOOP, 0, 4);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    drawGraph(_frameTime, timeScale, graphLeft, graphBottom, graphWidth, graphHeight);
+    glColor3f(1.0f, 1.0f, 0.0f);
+    drawGraph(_processRenderingTime, timeScale, graphLeft, graphBottom, graphWidth, graphHeight);
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawGraph(_renderFrameTime, timeScale, graphLeft, graphBottom, graphWidth, graphHeight);
+    glColor3f(0.0f, 1.0f, 1.0f);
+    drawGraph(_visibleTiles, std::max(1.0f, _visibleTiles.max()), graphLeft, graphBottom + graphHeight + 8.0f, graphWidth, graphHeight / 2);
+
+    glColor3f(0.0f, 1.0f, 0.0f);
+    drawText(8, viewport.height() - 16, lines);
+    _currentDrawTime = std::chrono::duration<float, std::milli>(Clock::now() - drawStart).count();
+}
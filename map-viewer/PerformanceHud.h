@@ -0,0 +1,131 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __PERFORMANCE_HUD_H_
+#define __PERFORMANCE_HUD_H_
+
+#include <stdint.h>
+#include <memory>
+#include <chrono>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+#include "InstrumentedTileProvider.h"
+#include "PrefetchingTileProvider.h"
+#include "MapObjectsCache.h"
+#include "UploadScheduler.h"
+
+// Live performance overlay of bird: frame time graph (time spent producing frame, from
+// beginFrame() to renderFrameDone() plus HUD itself), CPU time split between
+// processRendering() and renderFrame(), tiles pending per provider, texture memory estimated
+// from visible tiles (and GPU memory actually used, where driver reports it) and visible tiles
+// over time. Bird redraws on demand only, so interval between frames (which includes idle time
+// waiting for input) is shown separately and is not a measure of rendering cost. All text is
+// emitted by single glutBitmapString() call and every graph by single glDrawArrays(), so HUD
+// itself costs a handful of draw calls.
+class PerformanceHud
+{
+public:
+    enum
+    {
+        HistoryLength = 240,
+    };
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // Fixed-size ring of samples
+    class History
+    {
+    private:
+        std::vector<float> _samples;
+        unsigned int _next;
+        unsigned int _count;
+    public:
+        History();
+
+        void push(float value);
+        unsigned int count() const
+        {
+            return _count;
+        }
+        // Oldest sample has index 0
+        float at(unsigned int idx) const;
+        float max() const;
+        float average() const;
+    };
+
+    History _frameTime;
+    History _frameInterval;
+    History _processRenderingTime;
+    History _renderFrameTime;
+    History _visibleTiles;
+
+    Clock::time_point _lastFrameStart;
+    Clock::time_point _stageStart;
+    bool _hasLastFrame;
+    float _currentProcessRenderingTime;
+    float _currentBusyTime;
+    float _currentDrawTime;
+
+    std::vector<float> _vertices;
+
+    void drawGraph(const History& history, float scale, float left, float bottom, float width, float height);
+public:
+    PerformanceHud();
+
+    bool enabled;
+
+    // Optional, shown when set
+    std::shared_ptr<MapObjectsCache> mapObjectsCache;
+    std::shared_ptr<UploadScheduler> uploadScheduler;
+
+    // Call order per frame: beginFrame(), processRendering(), processRenderingDone(), renderFrame(), renderFrameDone(),
+    // draw() if enabled, endFrame()
+    void beginFrame();
+    void processRenderingDone();
+    void renderFrameDone(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer);
+    void endFrame();
+
+    // Time of last processRendering(), valid after processRenderingDone()
+    float lastProcessRenderingTime() const
+    {
+        return _currentProcessRenderingTime;
+    }
+
+    void draw(
+        const OsmAnd::AreaI& viewport,
+        const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+        const QMap<int, std::shared_ptr<InstrumentedTileProvider> >& providers,
+        const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& prefetchingProviders);
+
+    static void drawText(float x, float y, const QStringList& lines);
+};
+
+#endif // __PERFORMANCE_HUD_H_
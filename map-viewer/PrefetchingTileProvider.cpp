@@ -0,0 +1,189 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "PrefetchingTileProvider.h"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+PrefetchingTileProvider::State::State(int cacheCapacity_, int maxInFlight_)
+    : maxInFlight(maxInFlight_)
+    , cache(cacheCapacity_)
+    , rendererInFlight(0)
+    , issued(0)
+    , completed(0)
+    , hits(0)
+    , lateHits(0)
+    , evictedUnused(0)
+{
+}
+
+PrefetchingTileProvider::PrefetchingTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, int cacheCapacity, int maxInFlight)
+    : OsmAnd::IMapTileProvider(provider->type)
+    , _provider(provider)
+    , _state(new State(cacheCapacity, maxInFlight))
+{
+}
+
+PrefetchingTileProvider::~PrefetchingTileProvider()
+{
+}
+
+PrefetchingTileProvider::Counters PrefetchingTileProvider::getCounters() const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    Counters counters;
+    counters.issued = _state->issued;
+    counters.completed = _state->completed;
+    counters.hits = _state->hits;
+    counters.lateHits = _state->lateHits;
+    counters.evictedUnused = _state->evictedUnused;
+    return counters;
+}
+
+int PrefetchingTileProvider::availablePrefetchBudget() const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    const auto byPrefetches = _state->maxInFlight - _state->inFlight.size();
+    const auto byRenderer = _state->maxInFlight - _state->rendererInFlight;
+    return std::max(0, std::min(byPrefetches, byRenderer));
+}
+
+bool PrefetchingTileProvider::isCachedOrInFlight(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom) const
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    QMutexLocker scopeLock(&_state->mutex);
+    return _state->cache.contains(key) || _state->inFlight.contains(key);
+}
+
+bool PrefetchingTileProvider::prefetch(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom)
+{
+    const auto key = TileKey::make(tileId, zoom);
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        if(_state->cache.contains(key) || _state->inFlight.contains(key))
+            return false;
+        if(_state->inFlight.size() >= _state->maxInFlight || _state->rendererInFlight >= _state->maxInFlight)
+            return false;
+
+        _state->inFlight.insert(key, QList<OsmAnd::IMapTileProvider::TileReadyCallback>());
+        _state->issued++;
+    }
+
+    const auto state = _state;
+    _provider->obtainTileDeffered(tileId, zoom,
+        [state, key](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            QList<OsmAnd::IMapTileProvider::TileReadyCallback> waiters;
+            {
+                QMutexLocker scopeLock(&state->mutex);
+
+                waiters = state->inFlight.take(key);
+                if(success)
+                    state->completed++;
+
+                // Renderer asked for this tile while it was in flight, hand it over directly
+                if(!waiters.isEmpty())
+                {
+                    if(success)
+                        state->lateHits++;
+                }
+                else if(success && tile)
+                {
+                    state->evictedUnused += state->cache.insert(key, tile);
+                }
+            }
+
+            for(auto itWaiter = waiters.begin(); itWaiter != waiters.end(); ++itWaiter)
+                (*itWaiter)(tileId, zoom, tile, success);
+        });
+    return true;
+}
+
+uint32_t PrefetchingTileProvider::getTileSize() const
+{
+    return _provider->getTileSize();
+}
+
+bool PrefetchingTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    const auto key = TileKey::make(tileId, zoom);
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        // Renderer keeps uploaded tile itself, so cached copy is released on hit
+        if(_state->cache.take(key, &tile))
+        {
+            _state->hits++;
+            return true;
+        }
+    }
+
+    return _provider->obtainTileImmediate(tileId, zoom, tile);
+}
+
+void PrefetchingTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto key = TileKey::make(tileId, zoom);
+    std::shared_ptr<OsmAnd::IMapTileProvider::Tile> cachedTile;
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        if(_state->cache.take(key, &cachedTile))
+        {
+            _state->hits++;
+        }
+        else
+        {
+            const auto itInFlight = _state->inFlight.find(key);
+            if(itInFlight != _state->inFlight.end())
+            {
+                itInFlight->push_back(readyCallback);
+                return;
+            }
+
+            _state->rendererInFlight++;
+        }
+    }
+    if(cachedTile)
+    {
+        readyCallback(tileId, zoom, cachedTile, true);
+        return;
+    }
+
+    const auto state = _state;
+    _provider->obtainTileDeffered(tileId, zoom,
+        [state, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            {
+                QMutexLocker scopeLock(&state->mutex);
+                state->rendererInFlight--;
+            }
+
+            readyCallback(tileId, zoom, tile, success);
+        });
+}
@@ -0,0 +1,102 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __PREFETCHING_TILE_PROVIDER_H_
+#define __PREFETCHING_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <memory>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+
+#include "LruCache.h"
+#include "TileKey.h"
+
+// Tile provider proxy that can fetch tiles before renderer asks for them.
+// Prefetched tiles are held in small LRU cache and handed over to renderer on first request.
+// Prefetches are lower priority than renderer requests: they are only issued while renderer
+// has few requests of its own in flight, and number of in-flight prefetches is bounded.
+class PrefetchingTileProvider : public OsmAnd::IMapTileProvider
+{
+public:
+    struct Counters
+    {
+        uint64_t issued;
+        uint64_t completed;
+        uint64_t hits;
+        uint64_t lateHits;
+        uint64_t evictedUnused;
+
+        // Share of completed prefetches that renderer actually used
+        double hitRate() const
+        {
+            return completed > 0 ? static_cast<double>(hits + lateHits) / completed : 0.0;
+        }
+    };
+
+private:
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+
+    struct State
+    {
+        State(int cacheCapacity, int maxInFlight);
+
+        const int maxInFlight;
+
+        QMutex mutex;
+        LruCache< TileKey, std::shared_ptr<OsmAnd::IMapTileProvider::Tile> > cache;
+        QHash< TileKey, QList<OsmAnd::IMapTileProvider::TileReadyCallback> > inFlight;
+        int rendererInFlight;
+
+        uint64_t issued;
+        uint64_t completed;
+        uint64_t hits;
+        uint64_t lateHits;
+        uint64_t evictedUnused;
+    };
+    const std::shared_ptr<State> _state;
+public:
+    PrefetchingTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, int cacheCapacity = 64, int maxInFlight = 4);
+    virtual ~PrefetchingTileProvider();
+
+    Counters getCounters() const;
+
+    // Number of additional prefetches that may be issued right now, 0 while renderer is busy
+    int availablePrefetchBudget() const;
+
+    bool isCachedOrInFlight(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom) const;
+
+    // Returns false if tile is already cached, in flight or budget is exhausted
+    bool prefetch(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom);
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __PREFETCHING_TILE_PROVIDER_H_
@@ -0,0 +1,394 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "TerrainBenchmark.h"
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <QList>
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <SkBitmap.h>
+#include <SkCanvas.h>
+#include <SkDevice.h>
+#include <SkImageDecoder.h>
+
+#include <OsmAndCore/Utilities.h>
+
+#if defined(OSMAND_BIRD_SQLITE_SUPPORTED)
+#   include <sqlite3.h>
+#endif
+
+#include "HillshadeKernel.h"
+#include "ComputedHillshadeTileProvider.h"
+#include "ContourLines.h"
+#include "ContourTileProvider.h"
+#include "Statistics.h"
+
+namespace TerrainBenchmark
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // Deferred tiles that did not arrive in this time are counted as failed
+    const unsigned long TileWaitTimeout = 30000;
+
+    struct Timings
+    {
+        std::vector<double> samples;
+        double total;
+
+        Timings()
+            : total(0.0)
+        {
+        }
+
+        void add(double sample)
+        {
+            samples.push_back(sample);
+            total += sample;
+        }
+    };
+
+    static double elapsed(const Clock::time_point& from, const Clock::time_point& to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+
+    static void printTimings(std::ostream& output, const char* label, const Timings& timings)
+    {
+        const auto tilesPerSecond = timings.total > 0.0 ? timings.samples.size() * 1000.0 / timings.total : 0.0;
+        output << label << ": " << Statistics::percentile(timings.samples, 50.0) << " / " << Statistics::percentile(timings.samples, 95.0)
+            << " ms p50/p95, " << tilesPerSecond << " tiles/s" << std::endl;
+    }
+
+    struct PendingTile
+    {
+        PendingTile()
+            : delivered(false)
+        {
+        }
+
+        QMutex mutex;
+        QWaitCondition condition;
+        bool delivered;
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+    };
+}
+
+TerrainBenchmark::HillshadeConfiguration::HillshadeConfiguration()
+    : zoom(11)
+    , maxTiles(200)
+    , kernelRepeats(10)
+{
+}
+
+TerrainBenchmark::ContoursConfiguration::ContoursConfiguration()
+    : zoom(13)
+    , maxTiles(500)
+    , tileSize(256)
+{
+    area.left = area.right = area.top = area.bottom = 0.0;
+}
+
+bool TerrainBenchmark::obtainTileSynchronously(
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+    const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+    std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    if(provider->obtainTileImmediate(tileId, zoom, tile) && tile)
+        return true;
+
+    // Pending state is shared with callback, which may arrive after timeout
+    const std::shared_ptr<PendingTile> pending(new PendingTile());
+    provider->obtainTileDeffered(tileId, zoom,
+        [pending](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            QMutexLocker scopeLock(&pending->mutex);
+            if(success)
+                pending->tile = tile;
+            pending->delivered = true;
+            pending->condition.wakeAll();
+        });
+
+    QMutexLocker scopeLock(&pending->mutex);
+    while(!pending->delivered)
+    {
+        if(!pending->condition.wait(&pending->mutex, TileWaitTimeout))
+            return false;
+    }
+    tile = pending->tile;
+    return static_cast<bool>(tile);
+}
+
+bool TerrainBenchmark::runHillshade(
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+    const HillshadeConfiguration& cfg,
+    std::ostream& output)
+{
+#if defined(OSMAND_BIRD_SQLITE_SUPPORTED)
+    sqlite3* db = nullptr;
+    if(sqlite3_open_v2(cfg.sqlitePath.toUtf8().constData(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        output << "Failed to open '" << cfg.sqlitePath.toStdString() << "': " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return false;
+    }
+
+    // OsmAnd sqlitedb keeps zoom as 17 - zoom
+    const auto storedZoom = 17 - cfg.zoom;
+    QList<OsmAnd::TileId> tileIds;
+    sqlite3_stmt* listStatement = nullptr;
+    if(sqlite3_prepare_v2(db, "SELECT x, y FROM tiles WHERE z = ? LIMIT ?", -1, &listStatement, nullptr) == SQLITE_OK)
+    {
+        sqlite3_bind_int(listStatement, 1, storedZoom);
+        sqlite3_bind_int(listStatement, 2, cfg.maxTiles);
+        while(sqlite3_step(listStatement) == SQLITE_ROW)
+        {
+            OsmAnd::TileId tileId;
+            tileId.x = sqlite3_column_int(listStatement, 0);
+            tileId.y = sqlite3_column_int(listStatement, 1);
+            tileIds.push_back(tileId);
+        }
+    }
+    sqlite3_finalize(listStatement);
+
+    sqlite3_stmt* imageStatement = nullptr;
+    if(tileIds.isEmpty() || sqlite3_prepare_v2(db, "SELECT image FROM tiles WHERE x = ? AND y = ? AND z = ?", -1, &imageStatement, nullptr) != SQLITE_OK)
+    {
+        output << "No tiles of zoom " << cfg.zoom << " in '" << cfg.sqlitePath.toStdString() << "'" << std::endl;
+        sqlite3_close(db);
+        return false;
+    }
+
+    const QList<HillshadeKernel::Implementation> implementations = QList<HillshadeKernel::Implementation>()
+        << HillshadeKernel::Implementation::Scalar
+        << HillshadeKernel::Implementation::SSE2
+        << HillshadeKernel::Implementation::AVX;
+    const HillshadeKernel::Parameters parameters;
+
+    Timings bakedTimings;
+    Timings heightmapTimings;
+    Timings runtimeTimings;
+    QList<Timings> kernelTimings;
+    for(int idx = 0; idx < implementations.size(); idx++)
+        kernelTimings.push_back(Timings());
+    uint64_t bakedBytes = 0;
+    int measuredTiles = 0;
+    int missingTiles = 0;
+    int maxDifference = 0;
+    const auto bestImplementation = HillshadeKernel::bestImplementation();
+
+    for(auto itTileId = tileIds.begin(); itTileId != tileIds.end(); ++itTileId)
+    {
+        const auto& tileId = *itTileId;
+        const auto zoom = static_cast<OsmAnd::ZoomLevel>(cfg.zoom);
+
+        // Pre-baked: point lookup and PNG decode, as tile provider would do
+        const auto bakedStart = Clock::now();
+        sqlite3_reset(imageStatement);
+        sqlite3_bind_int(imageStatement, 1, tileId.x);
+        sqlite3_bind_int(imageStatement, 2, tileId.y);
+        sqlite3_bind_int(imageStatement, 3, storedZoom);
+        if(sqlite3_step(imageStatement) != SQLITE_ROW)
+            continue;
+        const QByteArray image(
+            reinterpret_cast<const char*>(sqlite3_column_blob(imageStatement, 0)),
+            sqlite3_column_bytes(imageStatement, 0));
+        SkBitmap bakedBitmap;
+        if(!SkImageDecoder::DecodeMemory(image.constData(), image.size(), &bakedBitmap, SkBitmap::kARGB_8888_Config, SkImageDecoder::kDecodePixels_Mode))
+            continue;
+        const auto bakedFinish = Clock::now();
+
+        // Runtime: elevation tile and shading
+        const auto heightmapStart = Clock::now();
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile> elevationTile;
+        if(!obtainTileSynchronously(heightmapProvider, tileId, zoom, elevationTile))
+        {
+            missingTiles++;
+            continue;
+        }
+        const auto heightmapFinish = Clock::now();
+
+        bakedTimings.add(elapsed(bakedStart, bakedFinish));
+        bakedBytes += image.size();
+        heightmapTimings.add(elapsed(heightmapStart, heightmapFinish));
+        measuredTiles++;
+
+        // Neighbours are not loaded, benchmark measures the kernel on a tile with clamped borders
+        ComputedHillshadeTileProvider::Neighbourhood elevationTiles;
+        elevationTiles[4] = elevationTile;
+
+        QByteArray reference;
+        for(int idx = 0; idx < implementations.size(); idx++)
+        {
+            const auto implementation = implementations[idx];
+            if(!HillshadeKernel::isSupported(implementation))
+                continue;
+
+            QByteArray alpha;
+            uint32_t size = 0;
+            const auto kernelStart = Clock::now();
+            for(int repeat = 0; repeat < cfg.kernelRepeats; repeat++)
+                ComputedHillshadeTileProvider::shadeElevationTile(elevationTiles, tileId, zoom, parameters, implementation, alpha, size);
+            const auto kernelTime = elapsed(kernelStart, Clock::now()) / std::max(1, cfg.kernelRepeats);
+            kernelTimings[idx].add(kernelTime);
+            if(implementation == bestImplementation)
+                runtimeTimings.add(elapsed(heightmapStart, heightmapFinish) + kernelTime);
+
+            // All implementations must produce the same shading
+            if(reference.isEmpty())
+            {
+                reference = alpha;
+            }
+            else
+            {
+                for(int sampleIdx = 0; sampleIdx < std::min(reference.size(), alpha.size()); sampleIdx++)
+                {
+                    const auto difference = std::abs(static_cast<int>(static_cast<uint8_t>(reference[sampleIdx])) - static_cast<uint8_t>(alpha[sampleIdx]));
+                    maxDifference = std::max(maxDifference, difference);
+                }
+            }
+        }
+    }
+    sqlite3_finalize(imageStatement);
+    sqlite3_close(db);
+
+    if(measuredTiles == 0)
+    {
+        output << "None of " << tileIds.size() << " tiles has elevation data" << std::endl;
+        return false;
+    }
+
+    output << "Tiles                  : " << measuredTiles << " at zoom " << cfg.zoom << " (" << missingTiles << " without elevation data)" << std::endl;
+    printTimings(output, "Pre-baked read+decode  ", bakedTimings);
+    output << "Pre-baked size         : " << bakedBytes / measuredTiles << " bytes per tile" << std::endl;
+    printTimings(output, "Elevation tile fetch   ", heightmapTimings);
+    const auto scalarTotal = kernelTimings[0].total;
+    for(int idx = 0; idx < implementations.size(); idx++)
+    {
+        if(!HillshadeKernel::isSupported(implementations[idx]))
+            continue;
+        const auto label = QString("Shading %1").arg(HillshadeKernel::getName(implementations[idx]), -15);
+        const auto speedup = kernelTimings[idx].total > 0.0 ? scalarTotal / kernelTimings[idx].total : 0.0;
+        printTimings(output, qPrintable(label), kernelTimings[idx]);
+        output << "                         " << speedup << "x of scalar" << std::endl;
+    }
+    printTimings(output, "Runtime fetch+shading  ", runtimeTimings);
+    output << "Max difference         : " << maxDifference << " alpha levels between implementations" << std::endl;
+
+    return maxDifference <= 1;
+#else
+    output << "bird was built without SQLite, pre-baked hillshade can not be read" << std::endl;
+    return false;
+#endif // defined(OSMAND_BIRD_SQLITE_SUPPORTED)
+}
+
+bool TerrainBenchmark::runContours(
+    const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+    const ContoursConfiguration& cfg,
+    std::ostream& output)
+{
+    const auto left = static_cast<int32_t>(OsmAnd::Utilities::getTileNumberX(cfg.zoom, cfg.area.left));
+    const auto right = static_cast<int32_t>(OsmAnd::Utilities::getTileNumberX(cfg.zoom, cfg.area.right));
+    const auto top = static_cast<int32_t>(OsmAnd::Utilities::getTileNumberY(cfg.zoom, cfg.area.top));
+    const auto bottom = static_cast<int32_t>(OsmAnd::Utilities::getTileNumberY(cfg.zoom, cfg.area.bottom));
+    const auto zoom = static_cast<OsmAnd::ZoomLevel>(cfg.zoom);
+
+    Timings fetchTimings;
+    Timings extractTimings;
+    Timings drawTimings;
+    uint64_t samplesCount = 0;
+    uint64_t segmentsCount = 0;
+    int requestedTiles = 0;
+    int missingTiles = 0;
+
+    SkBitmap bitmap;
+    bitmap.setConfig(SkBitmap::kARGB_8888_Config, cfg.tileSize, cfg.tileSize);
+    if(!bitmap.allocPixels())
+        return false;
+
+    for(int32_t y = std::min(top, bottom); y <= std::max(top, bottom) && requestedTiles < cfg.maxTiles; y++)
+    {
+        for(int32_t x = std::min(left, right); x <= std::max(left, right) && requestedTiles < cfg.maxTiles; x++)
+        {
+            OsmAnd::TileId tileId;
+            tileId.x = x;
+            tileId.y = y;
+            requestedTiles++;
+
+            const auto fetchStart = Clock::now();
+            std::shared_ptr<OsmAnd::IMapTileProvider::Tile> elevationTile;
+            if(!obtainTileSynchronously(heightmapProvider, tileId, zoom, elevationTile))
+            {
+                missingTiles++;
+                continue;
+            }
+            const auto extractStart = Clock::now();
+            ContourLines::Isolines isolines;
+            uint32_t gridSize = 0;
+            if(!ContourTileProvider::extractFromElevationTile(elevationTile, zoom, isolines, gridSize))
+            {
+                missingTiles++;
+                continue;
+            }
+            const auto extractFinish = Clock::now();
+
+            bitmap.eraseColor(SK_ColorTRANSPARENT);
+            {
+                SkDevice renderTarget(bitmap);
+                SkCanvas canvas(&renderTarget);
+                ContourLines::draw(canvas, isolines, static_cast<float>(cfg.tileSize) / (gridSize - 1), 0.0f, 0.0f);
+            }
+            const auto drawFinish = Clock::now();
+
+            fetchTimings.add(elapsed(fetchStart, extractStart));
+            extractTimings.add(elapsed(extractStart, extractFinish));
+            drawTimings.add(elapsed(extractFinish, drawFinish));
+            samplesCount += gridSize * gridSize;
+            segmentsCount += isolines.segmentsCount();
+        }
+    }
+
+    const auto measuredTiles = extractTimings.samples.size();
+    if(measuredTiles == 0)
+    {
+        output << "None of " << requestedTiles << " tiles has elevation data" << std::endl;
+        return false;
+    }
+
+    output << "Tiles                  : " << measuredTiles << " at zoom " << cfg.zoom << ", interval " << ContourLines::intervalForZoom(cfg.zoom)
+        << " m (" << missingTiles << " without elevation data)" << std::endl;
+    printTimings(output, "Elevation tile fetch   ", fetchTimings);
+    printTimings(output, "Isoline extraction     ", extractTimings);
+    output << "Extraction throughput  : " << (extractTimings.total > 0.0 ? samplesCount / (extractTimings.total * 1000.0) : 0.0)
+        << " Msamples/s, " << segmentsCount / measuredTiles << " segments per tile" << std::endl;
+    printTimings(output, "Drawing                ", drawTimings);
+
+    return true;
+}
@@ -0,0 +1,83 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __TERRAIN_BENCHMARK_H_
+#define __TERRAIN_BENCHMARK_H_
+
+#include <stdint.h>
+#include <memory>
+#include <ostream>
+
+#include <QString>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+
+// Offline measurements of terrain layers computed from elevation tiles, no window is created.
+namespace TerrainBenchmark
+{
+    struct HillshadeConfiguration
+    {
+        HillshadeConfiguration();
+
+        // OsmAnd hillshade sqlitedb (tiles table, z stored as 17 - zoom), tiles present there are measured
+        QString sqlitePath;
+        int zoom;
+        int maxTiles;
+
+        // Kernel is run this many times per tile and averaged, single run is too short to time
+        int kernelRepeats;
+    };
+
+    // Compares reading and decoding pre-baked hillshade tiles with fetching elevation tile
+    // and shading it with every kernel implementation available in this build.
+    bool runHillshade(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+        const HillshadeConfiguration& cfg,
+        std::ostream& output);
+
+    struct ContoursConfiguration
+    {
+        ContoursConfiguration();
+
+        // Tiles of zoom covering area (in degrees) are measured, up to maxTiles
+        OsmAnd::AreaD area;
+        int zoom;
+        int maxTiles;
+        uint32_t tileSize;
+    };
+
+    // Measures isoline extraction throughput per tile, and drawing of extracted lines
+    bool runContours(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& heightmapProvider,
+        const ContoursConfiguration& cfg,
+        std::ostream& output);
+
+    // Fetches tile from provider, waiting for deferred delivery if needed
+    bool obtainTileSynchronously(
+        const std::shared_ptr<OsmAnd::IMapTileProvider>& provider,
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+}
+
+#endif // __TERRAIN_BENCHMARK_H_
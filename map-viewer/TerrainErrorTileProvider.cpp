@@ -0,0 +1,145 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "TerrainErrorTileProvider.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <QMutexLocker>
+
+#include <OsmAndCore/Map/IMapElevationDataProvider.h>
+
+namespace
+{
+    // SRTM voids, not part of surface
+    const float NoData = -32768.0f;
+}
+
+TerrainErrorTileProvider::State::State(int capacity_)
+    : errors(capacity_)
+{
+}
+
+TerrainErrorTileProvider::TerrainErrorTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, int capacity)
+    : OsmAnd::IMapTileProvider(provider->type)
+    , _provider(provider)
+    , _state(new State(capacity))
+{
+}
+
+TerrainErrorTileProvider::~TerrainErrorTileProvider()
+{
+}
+
+void TerrainErrorTileProvider::computeErrors(const float* heights, size_t rowStride, int size, ErrorsTable& errors)
+{
+    errors.clear();
+    const auto cells = size - 1;
+    for(int patches = 1; patches <= cells; patches *= 2)
+    {
+        // Only tessellations whose vertices fall on samples
+        if(cells % patches != 0)
+            break;
+        const auto step = cells / patches;
+
+        float maxError = 0.0f;
+        for(int y = 0; y < size; y++)
+        {
+            const auto cellY = std::min(y / step, patches - 1);
+            const auto fy = static_cast<float>(y - cellY * step) / step;
+            const auto top = heights + cellY * step * rowStride;
+            const auto bottom = top + step * rowStride;
+            const auto row = heights + y * rowStride;
+
+            for(int x = 0; x < size; x++)
+            {
+                const auto cellX = std::min(x / step, patches - 1);
+                const auto fx = static_cast<float>(x - cellX * step) / step;
+                const auto x0 = cellX * step;
+                const auto x1 = x0 + step;
+                if(row[x] <= NoData || top[x0] <= NoData || top[x1] <= NoData || bottom[x0] <= NoData || bottom[x1] <= NoData)
+                    continue;
+
+                const auto upper = top[x0] + (top[x1] - top[x0]) * fx;
+                const auto lower = bottom[x0] + (bottom[x1] - bottom[x0]) * fx;
+                const auto interpolated = upper + (lower - upper) * fy;
+                maxError = std::max(maxError, std::fabs(row[x] - interpolated));
+            }
+        }
+        errors.push_back(maxError);
+    }
+}
+
+void TerrainErrorTileProvider::measure(const std::shared_ptr<State>& state, const TileKey& key, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    const auto heights = std::static_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(tile);
+    if(!heights || heights->width < 2 || heights->width != heights->height)
+        return;
+
+    ErrorsTable errors;
+    computeErrors(reinterpret_cast<const float*>(heights->data), heights->rowLength / sizeof(float), heights->width, errors);
+
+    QMutexLocker scopeLock(&state->mutex);
+
+    state->errors.insert(key, errors);
+}
+
+bool TerrainErrorTileProvider::getErrors(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, ErrorsTable& errors) const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    const auto cached = _state->errors.peek(TileKey::make(tileId, zoom));
+    if(!cached)
+        return false;
+    errors = *cached;
+    return true;
+}
+
+uint32_t TerrainErrorTileProvider::getTileSize() const
+{
+    return _provider->getTileSize();
+}
+
+bool TerrainErrorTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    if(!_provider->obtainTileImmediate(tileId, zoom, tile))
+        return false;
+
+    if(tile)
+        measure(_state, TileKey::make(tileId, zoom), tile);
+    return true;
+}
+
+void TerrainErrorTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto state = _state;
+    const auto key = TileKey::make(tileId, zoom);
+    _provider->obtainTileDeffered(tileId, zoom,
+        [state, key, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            if(success && tile)
+                measure(state, key, tile);
+
+            readyCallback(tileId, zoom, tile, success);
+        });
+}
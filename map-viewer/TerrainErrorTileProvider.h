@@ -0,0 +1,76 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __TERRAIN_ERROR_TILE_PROVIDER_H_
+#define __TERRAIN_ERROR_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+
+#include "LruCache.h"
+#include "TileKey.h"
+
+// Elevation tile provider proxy that measures, for every delivered tile, geometric error of
+// each coarser tessellation: maximal height difference between full-resolution samples and
+// bilinear surface through every step-th sample. Tables are used by TerrainLodController.
+class TerrainErrorTileProvider : public OsmAnd::IMapTileProvider
+{
+public:
+    // Element i is error in meters of tessellation with 2^i patches per tile side
+    typedef std::vector<float> ErrorsTable;
+
+private:
+    struct State
+    {
+        State(int capacity);
+
+        QMutex mutex;
+        LruCache<TileKey, ErrorsTable> errors;
+    };
+
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+    const std::shared_ptr<State> _state;
+
+    static void measure(const std::shared_ptr<State>& state, const TileKey& key, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+public:
+    TerrainErrorTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, int capacity = 1024);
+    virtual ~TerrainErrorTileProvider();
+
+    // Heights are size x size samples, rowStride is in floats
+    static void computeErrors(const float* heights, size_t rowStride, int size, ErrorsTable& errors);
+
+    bool getErrors(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, ErrorsTable& errors) const;
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __TERRAIN_ERROR_TILE_PROVIDER_H_
@@ -0,0 +1,232 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "TerrainLodController.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <QtMath>
+
+#include <OsmAndCore/Utilities.h>
+
+namespace
+{
+    // Frames coarser level must be requested before it is applied
+    const int CoarsenDelay = 15;
+
+    // Below this, vertical error is seen almost edge-on; keeps far tiles from vanishing
+    const double MinVerticalVisibility = 0.05;
+
+    const double EarthCircumference = 40075016.686;
+}
+
+TerrainLodController::TerrainLodController()
+    : enabled(true)
+    , maxScreenError(1.0f)
+    , minPatchesPerSide(1)
+    , maxPatchesPerSide(64)
+{
+    _stats.patchesPerSide = 0;
+    _stats.measuredTiles = 0;
+    _stats.unmeasuredTiles = 0;
+    _stats.maxProjectedError = 0.0f;
+    _stats.vertices = 0;
+    _stats.perTileVertices = 0;
+}
+
+TerrainLodController::~TerrainLodController()
+{
+}
+
+int TerrainLodController::getTileLevel(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom) const
+{
+    const auto itTileLevel = _tileLevels.constFind(TileKey::make(tileId, zoom));
+    if(itTileLevel == _tileLevels.constEnd())
+        return -1;
+    return itTileLevel->level;
+}
+
+void TerrainLodController::balanceLevels()
+{
+    // Raise coarser tile next to much finer one until all neighbours are within one level.
+    // Levels only grow and are bounded, so this ends after few passes.
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(auto itTileLevel = _tileLevels.begin(); itTileLevel != _tileLevels.end(); ++itTileLevel)
+        {
+            const auto& key = itTileLevel.key();
+            const int dx[] = { -1, 1, 0, 0 };
+            const int dy[] = { 0, 0, -1, 1 };
+            for(int side = 0; side < 4; side++)
+            {
+                TileKey neighbourKey = key;
+                neighbourKey.x += dx[side];
+                neighbourKey.y += dy[side];
+                const auto itNeighbour = _tileLevels.constFind(neighbourKey);
+                if(itNeighbour == _tileLevels.constEnd() || itNeighbour->level - 1 <= itTileLevel->level)
+                    continue;
+                itTileLevel->level = itNeighbour->level - 1;
+                changed = true;
+            }
+        }
+    }
+}
+
+void TerrainLodController::update(
+    const OsmAnd::AreaI& viewport,
+    const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+    const std::shared_ptr<TerrainErrorTileProvider>& errorProvider)
+{
+    const auto& visibleTiles = renderer->visibleTiles;
+    const auto& configuration = renderer->configuration;
+
+    _stats.patchesPerSide = configuration.heightmapPatchesPerSide;
+    _stats.vertices = static_cast<uint64_t>(visibleTiles.size()) * (_stats.patchesPerSide + 1) * (_stats.patchesPerSide + 1);
+    if(!enabled || !errorProvider || visibleTiles.size() == 0)
+    {
+        _tileLevels.clear();
+        _stats.perTileVertices = _stats.vertices;
+        return;
+    }
+
+    // Camera model matches the one used by renderer: target in the middle of the screen,
+    // camera pulled back by distance at which one tile takes scaled tile size on screen.
+    // All distances are in tiles of base zoom.
+    const auto halfFov = qDegreesToRadians(static_cast<double>(configuration.fieldOfView)) / 2.0;
+    const auto pixelsPerRadian = viewport.height() / (2.0 * std::tan(halfFov));
+    const auto distanceToTarget = pixelsPerRadian / renderer->getScaledTileSizeOnScreen();
+
+    const int zoomBase = configuration.zoomBase;
+    const auto tileSize31 = std::ldexp(1.0, 31 - zoomBase);
+    const auto targetX = configuration.target31.x / tileSize31;
+    const auto targetY = configuration.target31.y / tileSize31;
+
+    const auto elevation = qDegreesToRadians(static_cast<double>(configuration.elevationAngle));
+    const auto azimuth = qDegreesToRadians(static_cast<double>(configuration.azimuth));
+    const auto groundDistance = distanceToTarget * std::cos(elevation);
+    const auto cameraX = targetX - std::sin(azimuth) * groundDistance;
+    const auto cameraY = targetY + std::cos(azimuth) * groundDistance;
+    const auto cameraHeight = distanceToTarget * std::sin(elevation);
+
+    const auto latitude = qDegreesToRadians(OsmAnd::Utilities::get31LatitudeY(configuration.target31.y));
+    const auto metersPerTile = EarthCircumference * std::cos(latitude) / std::ldexp(1.0, zoomBase);
+    const auto tilesPerMeter = configuration.heightScaleFactor / metersPerTile;
+
+    int minLevel = 0;
+    while((2 << minLevel) <= minPatchesPerSide)
+        minLevel++;
+    int maxLevel = 0;
+    while((2 << maxLevel) <= maxPatchesPerSide)
+        maxLevel++;
+
+    _stats.measuredTiles = 0;
+    _stats.unmeasuredTiles = 0;
+    _stats.maxProjectedError = 0.0f;
+    _stats.tilesPerLevel.fill(0);
+
+    QHash<TileKey, TileLevel> tileLevels;
+    TerrainErrorTileProvider::ErrorsTable errors;
+    for(auto itTile = visibleTiles.begin(); itTile != visibleTiles.end(); ++itTile)
+    {
+        const auto& tileId = *itTile;
+        const auto key = TileKey::make(tileId, static_cast<OsmAnd::ZoomLevel>(zoomBase));
+        if(!errorProvider->getErrors(tileId, static_cast<OsmAnd::ZoomLevel>(zoomBase), errors) || errors.empty())
+        {
+            // Not loaded yet, will be accounted once it arrives
+            _stats.unmeasuredTiles++;
+            continue;
+        }
+        _stats.measuredTiles++;
+
+        const auto dx = tileId.x + 0.5 - cameraX;
+        const auto dy = tileId.y + 0.5 - cameraY;
+        const auto horizontal = std::sqrt(dx*dx + dy*dy);
+        const auto distance = std::max(std::sqrt(horizontal*horizontal + cameraHeight*cameraHeight), 1e-6);
+        // Vertical segment appears shortened by cosine of angle under which it is seen
+        const auto verticalVisibility = std::max(horizontal / distance, MinVerticalVisibility);
+        const auto pixelsPerMeter = tilesPerMeter * verticalVisibility * pixelsPerRadian / distance;
+
+        auto required = static_cast<int>(errors.size()) - 1;
+        for(int candidate = 0; candidate < static_cast<int>(errors.size()); candidate++)
+        {
+            if(errors[candidate] * pixelsPerMeter <= maxScreenError)
+            {
+                required = candidate;
+                break;
+            }
+        }
+        _stats.maxProjectedError = std::max(_stats.maxProjectedError, static_cast<float>(errors[required] * pixelsPerMeter));
+        required = std::min(std::max(required, minLevel), maxLevel);
+
+        // Refine at once, coarsen only to the finest level asked for during several frames in row,
+        // so that zooming or tiles loading does not make terrain flicker between levels
+        TileLevel tileLevel;
+        const auto itPrevious = _tileLevels.constFind(key);
+        if(itPrevious == _tileLevels.constEnd() || required >= itPrevious->level)
+        {
+            tileLevel.level = required;
+            tileLevel.pendingLevel = required;
+            tileLevel.pendingFrames = 0;
+        }
+        else
+        {
+            tileLevel = *itPrevious;
+            tileLevel.pendingLevel = tileLevel.pendingFrames == 0 ? required : std::max(tileLevel.pendingLevel, required);
+            if(++tileLevel.pendingFrames >= CoarsenDelay)
+            {
+                tileLevel.level = tileLevel.pendingLevel;
+                tileLevel.pendingFrames = 0;
+            }
+        }
+        tileLevels.insert(key, tileLevel);
+    }
+    // Tiles that left the view are forgotten
+    _tileLevels.swap(tileLevels);
+    if(_stats.measuredTiles == 0)
+    {
+        _stats.perTileVertices = _stats.vertices;
+        return;
+    }
+    balanceLevels();
+
+    int finestLevel = minLevel;
+    _stats.perTileVertices = 0;
+    for(auto itTileLevel = _tileLevels.constBegin(); itTileLevel != _tileLevels.constEnd(); ++itTileLevel)
+    {
+        const auto level = itTileLevel->level;
+        if(_stats.tilesPerLevel.size() <= level)
+            _stats.tilesPerLevel.resize(level + 1);
+        _stats.tilesPerLevel[level]++;
+        finestLevel = std::max(finestLevel, level);
+        _stats.perTileVertices += static_cast<uint64_t>((1 << level) + 1) * ((1 << level) + 1);
+    }
+    // Tiles without errors yet are counted at the finest level, as renderer draws them so
+    _stats.perTileVertices += static_cast<uint64_t>(_stats.unmeasuredTiles) * ((1 << finestLevel) + 1) * ((1 << finestLevel) + 1);
+
+    // Coarsening delay is already applied per tile
+    const auto patchesPerSide = 1 << finestLevel;
+    if(patchesPerSide != configuration.heightmapPatchesPerSide)
+        renderer->setHeightmapPatchesPerSide(patchesPerSide);
+}
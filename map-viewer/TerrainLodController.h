@@ -0,0 +1,102 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __TERRAIN_LOD_CONTROLLER_H_
+#define __TERRAIN_LOD_CONTROLLER_H_
+
+#include <memory>
+
+#include <QHash>
+#include <QVector>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+#include "TerrainErrorTileProvider.h"
+#include "TileKey.h"
+
+// Chooses heightmap tessellation from screen-space error instead of fixed patches count.
+//
+// For every visible tile the coarsest level whose geometric error (measured by
+// TerrainErrorTileProvider), projected to screen from current camera, stays below
+// maxScreenError pixels is selected. Vertical error seen from above projects to almost
+// nothing, so at steep pitch coarse levels suffice even for mountains.
+//
+// Level is kept per tile: refinement of a tile is applied at once, its coarsening only after
+// it was stable for several frames. Levels are then balanced so that neighbouring tiles differ
+// by at most one level, where edge of finer tile can be stitched to coarser one without cracks.
+// Renderer takes only one patches count for all tiles, so it gets the finest balanced level;
+// per-tile levels are exposed through getTileLevel() and vertices they need are reported.
+class TerrainLodController
+{
+public:
+    struct Stats
+    {
+        int patchesPerSide;
+        int measuredTiles;
+        int unmeasuredTiles;
+        float maxProjectedError;
+        // Vertices of visible tiles with renderer's patches count and with per-tile levels
+        uint64_t vertices;
+        uint64_t perTileVertices;
+        // Count of tiles at 2^i patches per side after balancing
+        QVector<int> tilesPerLevel;
+    };
+
+private:
+    struct TileLevel
+    {
+        int level;
+        int pendingLevel;
+        int pendingFrames;
+    };
+
+    // Visible measured tiles of last update
+    QHash<TileKey, TileLevel> _tileLevels;
+    Stats _stats;
+
+    void balanceLevels();
+public:
+    TerrainLodController();
+    virtual ~TerrainLodController();
+
+    bool enabled;
+    float maxScreenError;
+    int minPatchesPerSide;
+    int maxPatchesPerSide;
+
+    void update(
+        const OsmAnd::AreaI& viewport,
+        const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+        const std::shared_ptr<TerrainErrorTileProvider>& errorProvider);
+
+    // Level (2^level patches per side) chosen for tile of base zoom, -1 if it is not visible or measured
+    int getTileLevel(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom) const;
+
+    const Stats& getStats() const
+    {
+        return _stats;
+    }
+};
+
+#endif // __TERRAIN_LOD_CONTROLLER_H_
@@ -0,0 +1,646 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "TilePackCache.h"
+
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <vector>
+
+#include <QtEndian>
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+
+#include <OsmAndCore/Logging.h>
+
+namespace
+{
+    const uint32_t PackMagic = 0x4B50544F; // "OTPK"
+    const uint32_t RecordMagic = 0x52505444; // "DTPR"
+    const uint32_t IndexMagic = 0x49505444; // "DTPI"
+    const uint32_t FormatVersion = 1;
+
+    // magic, version, generation
+    const qint64 PackHeaderSize = 4 + 4 + 8;
+    // magic, zoom, x, y, length, crc32
+    const qint64 RecordHeaderSize = 6 * 4;
+
+    // Index is snapshot after this many stores, limiting tail scan after crash
+    const int StoresPerIndexSnapshot = 256;
+
+    // Failed compaction is retried after this many stores, doubled on each further failure
+    const int StoresPerCompactionRetry = 256;
+    const int MaxCompactionRetryShift = 8;
+
+    std::array<uint32_t, 256> makeCrc32Table()
+    {
+        std::array<uint32_t, 256> table;
+        for(uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            table[n] = c;
+        }
+        return table;
+    }
+
+    uint32_t crc32(const char* data, size_t length)
+    {
+        static const auto table = makeCrc32Table();
+
+        uint32_t crc = 0xFFFFFFFFu;
+        for(size_t idx = 0; idx < length; idx++)
+            crc = table[(crc ^ static_cast<uint8_t>(data[idx])) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t zoom;
+        uint32_t x;
+        uint32_t y;
+        uint32_t length;
+        uint32_t crc;
+    };
+
+    void writeRecordHeader(char* buffer, const RecordHeader& header)
+    {
+        qToLittleEndian(header.magic, reinterpret_cast<uchar*>(buffer + 0));
+        qToLittleEndian(header.zoom, reinterpret_cast<uchar*>(buffer + 4));
+        qToLittleEndian(header.x, reinterpret_cast<uchar*>(buffer + 8));
+        qToLittleEndian(header.y, reinterpret_cast<uchar*>(buffer + 12));
+        qToLittleEndian(header.length, reinterpret_cast<uchar*>(buffer + 16));
+        qToLittleEndian(header.crc, reinterpret_cast<uchar*>(buffer + 20));
+    }
+
+    RecordHeader readRecordHeader(const char* buffer)
+    {
+        RecordHeader header;
+        header.magic = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 0));
+        header.zoom = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 4));
+        header.x = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 8));
+        header.y = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 12));
+        header.length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 16));
+        header.crc = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 20));
+        return header;
+    }
+
+    bool readPackGeneration(QFile& file, uint64_t& generation)
+    {
+        char buffer[PackHeaderSize];
+        if(!file.seek(0) || file.read(buffer, PackHeaderSize) != PackHeaderSize)
+            return false;
+        if(qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer)) != PackMagic)
+            return false;
+        if(qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(buffer + 4)) != FormatVersion)
+            return false;
+        generation = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(buffer + 8));
+        return true;
+    }
+
+    bool writePackHeader(QFileDevice& file, uint64_t generation)
+    {
+        char buffer[PackHeaderSize];
+        qToLittleEndian(PackMagic, reinterpret_cast<uchar*>(buffer));
+        qToLittleEndian(FormatVersion, reinterpret_cast<uchar*>(buffer + 4));
+        qToLittleEndian(static_cast<quint64>(generation), reinterpret_cast<uchar*>(buffer + 8));
+        return file.seek(0) && file.write(buffer, PackHeaderSize) == PackHeaderSize;
+    }
+}
+
+uint qHash(const TilePackCache::Key& key)
+{
+    return (key.zoom * 0x9E3779B1u) ^ (key.x * 0x85EBCA77u) ^ (key.y * 0xC2B2AE3Du);
+}
+
+class TilePackCache::CompactTask : public QRunnable
+{
+    TilePackCache* const _owner;
+public:
+    CompactTask(TilePackCache* owner)
+        : _owner(owner)
+    {
+    }
+
+    void run()
+    {
+        _owner->compact();
+    }
+};
+
+TilePackCache::TilePackCache(const QString& packPath, uint64_t maxBytes, bool readOnly)
+    : _packPath(packPath)
+    , _indexPath(packPath + ".idx")
+    , _readOnly(readOnly)
+    , _maxBytes(maxBytes)
+    , _pack(packPath)
+    , _accessTick(0)
+    , _liveBytes(0)
+    , _indexDirty(false)
+    , _compacting(false)
+    , _compactionFailures(0)
+    , _compactionRetryStores(0)
+{
+    memset(&_counters, 0, sizeof(_counters));
+    _compactionThreadPool.setMaxThreadCount(1);
+}
+
+TilePackCache::~TilePackCache()
+{
+    close();
+}
+
+bool TilePackCache::open()
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    if(_readOnly)
+    {
+        if(!_pack.open(QIODevice::ReadOnly))
+            return false;
+    }
+    else
+    {
+        if(!_pack.open(QIODevice::ReadWrite))
+            return false;
+        if(_pack.size() < PackHeaderSize)
+        {
+            _pack.resize(0);
+            if(!writePackHeader(_pack, 1))
+                return false;
+            _pack.flush();
+        }
+    }
+
+    qint64 coveredLength = PackHeaderSize;
+    if(!loadIndex(coveredLength))
+    {
+        _index.clear();
+        _liveBytes = 0;
+        _accessTick = 0;
+        coveredLength = PackHeaderSize;
+    }
+    if(!scanRecords(coveredLength))
+        return false;
+
+    _counters.entries = _index.size();
+    if(!_readOnly)
+        evictIfNeeded();
+    return true;
+}
+
+void TilePackCache::close()
+{
+    // Running compaction needs the lock to finish
+    _compactionThreadPool.waitForDone();
+
+    QMutexLocker scopeLock(&_mutex);
+
+    if(!_pack.isOpen())
+        return;
+    if(!_readOnly && _indexDirty)
+        saveIndex();
+    _pack.close();
+    _index.clear();
+}
+
+bool TilePackCache::scanRecords(qint64 from)
+{
+    uint64_t generation;
+    if(!readPackGeneration(_pack, generation))
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "'%s' is not a tile pack\n", qPrintable(_packPath));
+        return false;
+    }
+
+    const auto packSize = _pack.size();
+    qint64 offset = from;
+    QByteArray data;
+    while(offset < packSize)
+    {
+        char headerBuffer[RecordHeaderSize];
+        if(!_pack.seek(offset) || _pack.read(headerBuffer, RecordHeaderSize) != RecordHeaderSize)
+            break;
+        const auto header = readRecordHeader(headerBuffer);
+        if(header.magic != RecordMagic || offset + RecordHeaderSize + header.length > packSize)
+            break;
+        data.resize(header.length);
+        if(_pack.read(data.data(), header.length) != header.length)
+            break;
+        if(crc32(data.constData(), data.size()) != header.crc)
+            break;
+
+        Key key;
+        key.zoom = header.zoom;
+        key.x = header.x;
+        key.y = header.y;
+        const auto itOld = _index.find(key);
+        if(itOld != _index.end())
+            _liveBytes -= RecordHeaderSize + itOld->length;
+
+        Entry entry;
+        entry.offset = offset;
+        entry.length = header.length;
+        entry.lastAccess = ++_accessTick;
+        _index.insert(key, entry);
+        _liveBytes += RecordHeaderSize + header.length;
+
+        offset += RecordHeaderSize + header.length;
+    }
+
+    // Torn tail from interrupted write
+    if(offset < packSize)
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Warning, "Tile pack '%s' has %lld bytes of broken tail\n", qPrintable(_packPath), packSize - offset);
+        if(!_readOnly)
+            _pack.resize(offset);
+    }
+    if(offset != from)
+        _indexDirty = true;
+
+    return true;
+}
+
+bool TilePackCache::loadIndex(qint64& coveredLength)
+{
+    QFile indexFile(_indexPath);
+    if(!indexFile.open(QIODevice::ReadOnly))
+        return false;
+
+    uint64_t packGeneration;
+    if(!readPackGeneration(_pack, packGeneration))
+        return false;
+
+    QDataStream stream(&indexFile);
+    quint32 magic, version, count;
+    quint64 generation, accessTick;
+    qint64 length;
+    stream >> magic >> version >> generation >> length >> accessTick >> count;
+    if(stream.status() != QDataStream::Ok || magic != IndexMagic || version != FormatVersion)
+        return false;
+    if(generation != packGeneration || length > _pack.size())
+        return false;
+
+    QHash<Key, Entry> index;
+    index.reserve(count);
+    uint64_t liveBytes = 0;
+    for(quint32 idx = 0; idx < count; idx++)
+    {
+        Key key;
+        Entry entry;
+        quint64 lastAccess;
+        stream >> key.zoom >> key.x >> key.y >> entry.offset >> entry.length >> lastAccess;
+        entry.lastAccess = lastAccess;
+        if(entry.offset < PackHeaderSize || entry.offset + RecordHeaderSize + entry.length > length)
+            return false;
+        index.insert(key, entry);
+        liveBytes += RecordHeaderSize + entry.length;
+    }
+    if(stream.status() != QDataStream::Ok)
+        return false;
+
+    _index.swap(index);
+    _liveBytes = liveBytes;
+    _accessTick = accessTick;
+    coveredLength = length;
+    return true;
+}
+
+bool TilePackCache::saveIndex()
+{
+    uint64_t generation;
+    if(!readPackGeneration(_pack, generation))
+        return false;
+
+    // Old snapshot stays valid until new one is committed
+    QSaveFile indexFile(_indexPath);
+    if(!indexFile.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&indexFile);
+    stream << static_cast<quint32>(IndexMagic) << static_cast<quint32>(FormatVersion)
+        << static_cast<quint64>(generation) << static_cast<qint64>(_pack.size())
+        << static_cast<quint64>(_accessTick) << static_cast<quint32>(_index.size());
+    for(auto itEntry = _index.begin(); itEntry != _index.end(); ++itEntry)
+    {
+        stream << itEntry.key().zoom << itEntry.key().x << itEntry.key().y
+            << itEntry->offset << itEntry->length << static_cast<quint64>(itEntry->lastAccess);
+    }
+    if(stream.status() != QDataStream::Ok || !indexFile.commit())
+        return false;
+
+    _indexDirty = false;
+    return true;
+}
+
+bool TilePackCache::contains(uint32_t zoom, uint32_t x, uint32_t y) const
+{
+    Key key;
+    key.zoom = zoom;
+    key.x = x;
+    key.y = y;
+
+    QMutexLocker scopeLock(&_mutex);
+    return _index.contains(key);
+}
+
+bool TilePackCache::load(uint32_t zoom, uint32_t x, uint32_t y, QByteArray& data)
+{
+    Key key;
+    key.zoom = zoom;
+    key.x = x;
+    key.y = y;
+
+    QMutexLocker scopeLock(&_mutex);
+
+    const auto itEntry = _index.find(key);
+    if(itEntry == _index.end())
+    {
+        _counters.misses++;
+        return false;
+    }
+
+    // Header and payload in one read
+    QByteArray record(RecordHeaderSize + itEntry->length, Qt::Uninitialized);
+    if(!_pack.seek(itEntry->offset) || _pack.read(record.data(), record.size()) != record.size())
+    {
+        _counters.misses++;
+        return false;
+    }
+    const auto header = readRecordHeader(record.constData());
+    if(header.magic != RecordMagic || header.length != itEntry->length ||
+        crc32(record.constData() + RecordHeaderSize, header.length) != header.crc)
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Warning, "Corrupted tile %d/%d/%d in '%s'\n", zoom, x, y, qPrintable(_packPath));
+        _liveBytes -= RecordHeaderSize + itEntry->length;
+        _index.erase(itEntry);
+        _indexDirty = true;
+        _counters.misses++;
+        return false;
+    }
+
+    itEntry->lastAccess = ++_accessTick;
+    _indexDirty = true;
+    data = record.mid(RecordHeaderSize);
+    _counters.hits++;
+    return true;
+}
+
+bool TilePackCache::store(uint32_t zoom, uint32_t x, uint32_t y, const QByteArray& data)
+{
+    if(_readOnly || data.isEmpty())
+        return false;
+
+    Key key;
+    key.zoom = zoom;
+    key.x = x;
+    key.y = y;
+
+    RecordHeader header;
+    header.magic = RecordMagic;
+    header.zoom = zoom;
+    header.x = x;
+    header.y = y;
+    header.length = data.size();
+    header.crc = crc32(data.constData(), data.size());
+    QByteArray record(RecordHeaderSize, Qt::Uninitialized);
+    writeRecordHeader(record.data(), header);
+    record.append(data);
+
+    QMutexLocker scopeLock(&_mutex);
+
+    // Append and flush as one write, torn record is dropped by CRC on next open
+    const auto offset = _pack.size();
+    if(!_pack.seek(offset) || _pack.write(record) != record.size() || !_pack.flush())
+    {
+        _pack.resize(offset);
+        return false;
+    }
+
+    const auto itOld = _index.find(key);
+    if(itOld != _index.end())
+        _liveBytes -= RecordHeaderSize + itOld->length;
+    Entry entry;
+    entry.offset = offset;
+    entry.length = header.length;
+    entry.lastAccess = ++_accessTick;
+    _index.insert(key, entry);
+    _liveBytes += record.size();
+    _indexDirty = true;
+    _counters.stores++;
+
+    evictIfNeeded();
+    if(_counters.stores % StoresPerIndexSnapshot == 0)
+        saveIndex();
+    return true;
+}
+
+void TilePackCache::evictIfNeeded()
+{
+    if(_liveBytes <= _maxBytes)
+        return;
+
+    // Drop least recently used down to 90% of budget, to not evict on every store
+    std::vector< std::pair<uint64_t, Key> > byAge;
+    byAge.reserve(_index.size());
+    for(auto itEntry = _index.begin(); itEntry != _index.end(); ++itEntry)
+        byAge.push_back(std::make_pair(itEntry->lastAccess, itEntry.key()));
+    std::sort(byAge.begin(), byAge.end(),
+        [](const std::pair<uint64_t, Key>& l, const std::pair<uint64_t, Key>& r)
+        {
+            return l.first < r.first;
+        });
+
+    const auto targetBytes = _maxBytes / 10 * 9;
+    for(auto itAged = byAge.begin(); itAged != byAge.end() && _liveBytes > targetBytes; ++itAged)
+    {
+        const auto itEntry = _index.find(itAged->second);
+        _liveBytes -= RecordHeaderSize + itEntry->length;
+        _index.erase(itEntry);
+        _counters.evictions++;
+    }
+    _indexDirty = true;
+
+    const uint64_t deadBytes = _pack.size() - PackHeaderSize - _liveBytes;
+    if(deadBytes > _liveBytes && !_compacting && _counters.stores >= _compactionRetryStores)
+    {
+        _compacting = true;
+        _compactionThreadPool.start(new CompactTask(this));
+    }
+}
+
+void TilePackCache::compactionFailed()
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Warning, "Failed to compact tile pack '%s'\n", qPrintable(_packPath));
+    _compactionRetryStores = _counters.stores + (static_cast<uint64_t>(StoresPerCompactionRetry) << std::min(_compactionFailures, MaxCompactionRetryShift));
+    _compactionFailures++;
+    _compacting = false;
+}
+
+bool TilePackCache::compact()
+{
+    // Records below snapshot length are never rewritten, so they are copied without lock
+    // from own handle while stores keep appending to the pack
+    uint64_t generation;
+    qint64 snapshotLength;
+    QHash<Key, Entry> snapshot;
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        if(!_pack.isOpen() || !readPackGeneration(_pack, generation))
+        {
+            _compacting = false;
+            return false;
+        }
+        snapshotLength = _pack.size();
+        snapshot = _index;
+    }
+
+    QFile source(_packPath);
+    QSaveFile compacted(_packPath);
+    if(!source.open(QIODevice::ReadOnly) || !compacted.open(QIODevice::WriteOnly) || !writePackHeader(compacted, generation + 1))
+    {
+        compactionFailed();
+        return false;
+    }
+
+    // Oldest first, so after crash scan order still approximates access order
+    std::vector< std::pair<uint64_t, Key> > byAge;
+    byAge.reserve(snapshot.size());
+    for(auto itEntry = snapshot.begin(); itEntry != snapshot.end(); ++itEntry)
+        byAge.push_back(std::make_pair(itEntry->lastAccess, itEntry.key()));
+    std::sort(byAge.begin(), byAge.end(),
+        [](const std::pair<uint64_t, Key>& l, const std::pair<uint64_t, Key>& r)
+        {
+            return l.first < r.first;
+        });
+
+    // New offset by key
+    QHash<Key, qint64> copied;
+    copied.reserve(snapshot.size());
+    QByteArray record;
+    for(auto itAged = byAge.begin(); itAged != byAge.end(); ++itAged)
+    {
+        const auto& entry = snapshot[itAged->second];
+        record.resize(RecordHeaderSize + entry.length);
+        if(!source.seek(entry.offset) || source.read(record.data(), record.size()) != record.size())
+            continue;
+
+        const auto offset = compacted.pos();
+        if(compacted.write(record) != record.size())
+        {
+            compactionFailed();
+            return false;
+        }
+        copied.insert(itAged->second, offset);
+    }
+    source.close();
+
+    QMutexLocker scopeLock(&_mutex);
+
+    // Records stored meanwhile are in the tail, records evicted meanwhile are left out
+    QHash<Key, Entry> index;
+    index.reserve(_index.size());
+    uint64_t liveBytes = 0;
+    bool failed = false;
+    for(auto itEntry = _index.begin(); itEntry != _index.end() && !failed; ++itEntry)
+    {
+        Entry newEntry = *itEntry;
+        if(itEntry->offset >= snapshotLength)
+        {
+            record.resize(RecordHeaderSize + itEntry->length);
+            newEntry.offset = compacted.pos();
+            failed = !_pack.seek(itEntry->offset) || _pack.read(record.data(), record.size()) != record.size() ||
+                compacted.write(record) != record.size();
+        }
+        else
+        {
+            const auto itCopied = copied.constFind(itEntry.key());
+            if(itCopied == copied.constEnd() || snapshot[itEntry.key()].offset != itEntry->offset)
+                continue;
+            newEntry.offset = *itCopied;
+        }
+        index.insert(itEntry.key(), newEntry);
+        liveBytes += RecordHeaderSize + newEntry.length;
+    }
+    if(failed)
+    {
+        scopeLock.unlock();
+        compactionFailed();
+        return false;
+    }
+
+    // New generation makes old index snapshot invalid even if we crash before saving new one.
+    // Pack is closed while replaced, since open file can not be replaced on Windows.
+    _pack.close();
+    const auto committed = compacted.commit();
+    if(!_pack.open(QIODevice::ReadWrite))
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to reopen tile pack '%s'\n", qPrintable(_packPath));
+        _index.clear();
+        _liveBytes = 0;
+        _compacting = false;
+        return false;
+    }
+    if(!committed)
+    {
+        scopeLock.unlock();
+        compactionFailed();
+        return false;
+    }
+
+    _index.swap(index);
+    _liveBytes = liveBytes;
+    _counters.compactions++;
+    _compactionFailures = 0;
+    _compactionRetryStores = 0;
+    _compacting = false;
+    saveIndex();
+    return true;
+}
+
+bool TilePackCache::flush()
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    if(_readOnly || !_indexDirty || !_pack.isOpen())
+        return true;
+    return saveIndex();
+}
+
+TilePackCache::Counters TilePackCache::getCounters() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    auto counters = _counters;
+    counters.liveBytes = _liveBytes;
+    counters.fileBytes = _pack.isOpen() ? _pack.size() : 0;
+    counters.entries = _index.size();
+    return counters;
+}
@@ -0,0 +1,133 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __TILE_PACK_CACHE_H_
+#define __TILE_PACK_CACHE_H_
+
+#include <stdint.h>
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QMutex>
+#include <QThreadPool>
+
+// Size-bounded tile cache kept in single append-only pack file.
+//
+// Pack is sequence of records: fixed header (magic, zoom, x, y, length, CRC32) followed
+// by encoded tile. Records are only appended and flushed, so crash can only leave a torn
+// tail, which is detected by CRC and truncated on next open. Index of live records
+// (with last access ticks) is snapshot to "<pack>.idx" through QSaveFile, together with
+// pack length it covers; on open only records after that length are scanned.
+//
+// Lookup is one hash probe in memory plus one read from pack. When live data exceeds
+// the budget, least recently used records are dropped from the index; once dead records
+// take as much space as live ones, pack is compacted on background thread into new file
+// that replaces the old one through QSaveFile. Failed compaction is retried only after
+// exponentially growing number of stores.
+class TilePackCache
+{
+public:
+    struct Counters
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stores;
+        uint64_t evictions;
+        uint64_t compactions;
+        uint64_t liveBytes;
+        uint64_t fileBytes;
+        int entries;
+    };
+
+private:
+    struct Key
+    {
+        uint32_t zoom;
+        uint32_t x;
+        uint32_t y;
+
+        bool operator==(const Key& that) const
+        {
+            return zoom == that.zoom && x == that.x && y == that.y;
+        }
+    };
+    friend uint qHash(const Key& key);
+
+    struct Entry
+    {
+        qint64 offset;
+        uint32_t length;
+        uint64_t lastAccess;
+    };
+
+    const QString _packPath;
+    const QString _indexPath;
+    const bool _readOnly;
+    const uint64_t _maxBytes;
+
+    mutable QMutex _mutex;
+    QFile _pack;
+    QHash<Key, Entry> _index;
+    uint64_t _accessTick;
+    uint64_t _liveBytes;
+    bool _indexDirty;
+    Counters _counters;
+
+    bool _compacting;
+    int _compactionFailures;
+    // Value of stores counter before which failed compaction is not retried
+    uint64_t _compactionRetryStores;
+    QThreadPool _compactionThreadPool;
+
+    class CompactTask;
+    bool scanRecords(qint64 from);
+    void evictIfNeeded();
+    void compactionFailed();
+    // Runs on compaction thread, takes the lock only to snapshot index and to swap packs
+    bool compact();
+    bool saveIndex();
+    bool loadIndex(qint64& coveredLength);
+public:
+    TilePackCache(const QString& packPath, uint64_t maxBytes, bool readOnly);
+    virtual ~TilePackCache();
+
+    bool open();
+    void close();
+
+    bool isReadOnly() const
+    {
+        return _readOnly;
+    }
+
+    bool contains(uint32_t zoom, uint32_t x, uint32_t y) const;
+    bool load(uint32_t zoom, uint32_t x, uint32_t y, QByteArray& data);
+    bool store(uint32_t zoom, uint32_t x, uint32_t y, const QByteArray& data);
+
+    // Persist index, so next open does not need to scan the pack
+    bool flush();
+
+    Counters getCounters() const;
+};
+
+#endif // __TILE_PACK_CACHE_H_
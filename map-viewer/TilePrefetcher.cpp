@@ -0,0 +1,221 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "TilePrefetcher.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <QSet>
+
+namespace
+{
+    // Weight of newest sample in exponentially smoothed velocity
+    const double VelocitySmoothing = 0.3;
+
+    // Longer pause between frames means camera stopped
+    const double IdleInterval = 0.5;
+
+    const double MinZoomVelocity = 0.2;
+
+    inline quint64 packTile(int32_t x, int32_t y)
+    {
+        return (static_cast<quint64>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+}
+
+TilePrefetcher::TilePrefetcher()
+    : _hasLastSample(false)
+    , _lastZoom(0.0f)
+    , _velocityX(0.0)
+    , _velocityY(0.0)
+    , _zoomVelocity(0.0)
+    , enabled(true)
+    , lookahead(0.5)
+{
+}
+
+void TilePrefetcher::update(
+    const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+    const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& providers)
+{
+    const auto now = Clock::now();
+    const auto target31 = renderer->configuration.target31;
+    const auto zoom = renderer->configuration.requestedZoom;
+
+    if(_hasLastSample)
+    {
+        const auto dt = std::chrono::duration<double>(now - _lastSampleTime).count();
+        if(dt > IdleInterval)
+        {
+            _velocityX = _velocityY = _zoomVelocity = 0.0;
+        }
+        else if(dt > 0.0)
+        {
+            const auto vx = (static_cast<double>(target31.x) - _lastTarget31.x) / dt;
+            const auto vy = (static_cast<double>(target31.y) - _lastTarget31.y) / dt;
+            const auto vz = (zoom - _lastZoom) / dt;
+            _velocityX += (vx - _velocityX) * VelocitySmoothing;
+            _velocityY += (vy - _velocityY) * VelocitySmoothing;
+            _zoomVelocity += (vz - _zoomVelocity) * VelocitySmoothing;
+        }
+    }
+    _hasLastSample = true;
+    _lastSampleTime = now;
+    _lastTarget31 = target31;
+    _lastZoom = zoom;
+
+    if(!enabled || providers.isEmpty())
+        return;
+
+    QList<Candidate> candidates;
+    collectCandidates(renderer, candidates);
+    if(candidates.isEmpty())
+        return;
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Candidate& l, const Candidate& r)
+        {
+            return l.distance < r.distance;
+        });
+
+    for(auto itProvider = providers.begin(); itProvider != providers.end(); ++itProvider)
+    {
+        const auto& provider = *itProvider;
+        if(!provider)
+            continue;
+
+        auto budget = provider->availablePrefetchBudget();
+        for(auto itCandidate = candidates.begin(); budget > 0 && itCandidate != candidates.end(); ++itCandidate)
+        {
+            if(provider->prefetch(itCandidate->tileId, itCandidate->zoom))
+                budget--;
+        }
+    }
+}
+
+void TilePrefetcher::collectCandidates(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer, QList<Candidate>& candidates) const
+{
+    const auto& visibleTiles = renderer->visibleTiles;
+    if(visibleTiles.size() == 0)
+        return;
+
+    const int zoomBase = renderer->configuration.zoomBase;
+    const int32_t tilesPerSide = zoomBase >= 31 ? std::numeric_limits<int32_t>::max() : (1 << zoomBase);
+    const double tileSize31 = zoomBase >= 31 ? 1.0 : static_cast<double>(1u << (31 - zoomBase));
+
+    QSet<quint64> visible;
+    int32_t minX = std::numeric_limits<int32_t>::max();
+    int32_t minY = std::numeric_limits<int32_t>::max();
+    int32_t maxX = std::numeric_limits<int32_t>::min();
+    int32_t maxY = std::numeric_limits<int32_t>::min();
+    for(auto itTile = visibleTiles.begin(); itTile != visibleTiles.end(); ++itTile)
+    {
+        const auto& tileId = *itTile;
+        visible.insert(packTile(tileId.x, tileId.y));
+        minX = std::min(minX, tileId.x);
+        minY = std::min(minY, tileId.y);
+        maxX = std::max(maxX, tileId.x);
+        maxY = std::max(maxY, tileId.y);
+    }
+    const auto width = maxX - minX + 1;
+    const auto height = maxY - minY + 1;
+
+    // Pan: visible area shifted by extrapolated movement, limited to one screen ahead
+    const auto shiftX = static_cast<int32_t>(std::max<double>(-width, std::min<double>(width, std::round(_velocityX * lookahead / tileSize31))));
+    const auto shiftY = static_cast<int32_t>(std::max<double>(-height, std::min<double>(height, std::round(_velocityY * lookahead / tileSize31))));
+    if(shiftX != 0 || shiftY != 0)
+    {
+        const auto centerX = (minX + maxX) / 2.0 + shiftX;
+        const auto centerY = (minY + maxY) / 2.0 + shiftY;
+        for(int32_t y = minY + std::min(shiftY, 0); y <= maxY + std::max(shiftY, 0); y++)
+        {
+            if(y < 0 || y >= tilesPerSide)
+                continue;
+            for(int32_t x = minX + std::min(shiftX, 0); x <= maxX + std::max(shiftX, 0); x++)
+            {
+                if(x < 0 || x >= tilesPerSide || visible.contains(packTile(x, y)))
+                    continue;
+
+                Candidate candidate;
+                candidate.tileId.x = x;
+                candidate.tileId.y = y;
+                candidate.zoom = static_cast<OsmAnd::ZoomLevel>(zoomBase);
+                candidate.distance = std::hypot(x - centerX, y - centerY);
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    // Zoom: tiles of next zoom level around center, after all pan candidates of same distance
+    int nextZoom = zoomBase;
+    if(_zoomVelocity > MinZoomVelocity && zoomBase < 31)
+        nextZoom = zoomBase + 1;
+    else if(_zoomVelocity < -MinZoomVelocity && zoomBase > 0)
+        nextZoom = zoomBase - 1;
+    if(nextZoom != zoomBase)
+    {
+        const auto centerX = (minX + maxX) / 2.0;
+        const auto centerY = (minY + maxY) / 2.0;
+
+        int32_t fromX, toX, fromY, toY;
+        double nextCenterX, nextCenterY;
+        if(nextZoom > zoomBase)
+        {
+            // Zooming in keeps only central half of current view
+            nextCenterX = centerX * 2.0 + 0.5;
+            nextCenterY = centerY * 2.0 + 0.5;
+            fromX = static_cast<int32_t>(nextCenterX - width / 2.0);
+            toX = static_cast<int32_t>(nextCenterX + width / 2.0);
+            fromY = static_cast<int32_t>(nextCenterY - height / 2.0);
+            toY = static_cast<int32_t>(nextCenterY + height / 2.0);
+        }
+        else
+        {
+            nextCenterX = centerX / 2.0;
+            nextCenterY = centerY / 2.0;
+            fromX = (minX >> 1) - 1;
+            toX = (maxX >> 1) + 1;
+            fromY = (minY >> 1) - 1;
+            toY = (maxY >> 1) + 1;
+        }
+
+        const int32_t nextTilesPerSide = nextZoom >= 31 ? std::numeric_limits<int32_t>::max() : (1 << nextZoom);
+        for(int32_t y = fromY; y <= toY; y++)
+        {
+            if(y < 0 || y >= nextTilesPerSide)
+                continue;
+            for(int32_t x = fromX; x <= toX; x++)
+            {
+                if(x < 0 || x >= nextTilesPerSide)
+                    continue;
+
+                Candidate candidate;
+                candidate.tileId.x = x;
+                candidate.tileId.y = y;
+                candidate.zoom = static_cast<OsmAnd::ZoomLevel>(nextZoom);
+                candidate.distance = std::hypot(x - nextCenterX, y - nextCenterY) + 1.0;
+                candidates.push_back(candidate);
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __TILE_PREFETCHER_H_
+#define __TILE_PREFETCHER_H_
+
+#include <memory>
+#include <chrono>
+
+#include <QMap>
+#include <QList>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+#include "PrefetchingTileProvider.h"
+
+// Estimates camera velocity and zoom direction from frame to frame and asks
+// prefetching providers of all layers for tiles that are about to become visible.
+class TilePrefetcher
+{
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    bool _hasLastSample;
+    Clock::time_point _lastSampleTime;
+    OsmAnd::PointI _lastTarget31;
+    float _lastZoom;
+
+    // Smoothed velocity in 31-coordinates per second and zoom levels per second
+    double _velocityX;
+    double _velocityY;
+    double _zoomVelocity;
+
+    struct Candidate
+    {
+        OsmAnd::TileId tileId;
+        OsmAnd::ZoomLevel zoom;
+        double distance;
+    };
+    void collectCandidates(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer, QList<Candidate>& candidates) const;
+public:
+    TilePrefetcher();
+
+    bool enabled;
+
+    // How far ahead (in seconds) camera movement is extrapolated
+    double lookahead;
+
+    // Call once per frame, after renderer has updated visible tiles
+    void update(
+        const std::shared_ptr<OsmAnd::IMapRenderer>& renderer,
+        const QMap<int, std::shared_ptr<PrefetchingTileProvider> >& providers);
+};
+
+#endif // __TILE_PREFETCHER_H_
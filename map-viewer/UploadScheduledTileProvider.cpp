@@ -0,0 +1,55 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "UploadScheduledTileProvider.h"
+
+UploadScheduledTileProvider::UploadScheduledTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, const std::shared_ptr<UploadScheduler>& scheduler)
+    : OsmAnd::IMapTileProvider(provider->type)
+    , _provider(provider)
+    , _scheduler(scheduler)
+{
+}
+
+UploadScheduledTileProvider::~UploadScheduledTileProvider()
+{
+}
+
+uint32_t UploadScheduledTileProvider::getTileSize() const
+{
+    return _provider->getTileSize();
+}
+
+bool UploadScheduledTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    // Renderer asked synchronously and uploads right away, nothing to schedule
+    return _provider->obtainTileImmediate(tileId, zoom, tile);
+}
+
+void UploadScheduledTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto scheduler = _scheduler;
+    _provider->obtainTileDeffered(tileId, zoom,
+        [scheduler, readyCallback](const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success)
+        {
+            scheduler->enqueue(tileId, zoom, tile, success, readyCallback);
+        });
+}
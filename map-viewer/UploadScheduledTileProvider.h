@@ -0,0 +1,50 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __UPLOAD_SCHEDULED_TILE_PROVIDER_H_
+#define __UPLOAD_SCHEDULED_TILE_PROVIDER_H_
+
+#include <memory>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+
+#include "UploadScheduler.h"
+
+// Transparent proxy that routes deferred deliveries through UploadScheduler,
+// so they reach renderer only when there is upload budget left in a frame.
+class UploadScheduledTileProvider : public OsmAnd::IMapTileProvider
+{
+private:
+    const std::shared_ptr<OsmAnd::IMapTileProvider> _provider;
+    const std::shared_ptr<UploadScheduler> _scheduler;
+public:
+    UploadScheduledTileProvider(const std::shared_ptr<OsmAnd::IMapTileProvider>& provider, const std::shared_ptr<UploadScheduler>& scheduler);
+    virtual ~UploadScheduledTileProvider();
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __UPLOAD_SCHEDULED_TILE_PROVIDER_H_
@@ -0,0 +1,230 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "UploadScheduler.h"
+
+#include <limits>
+#include <algorithm>
+
+#include <QSet>
+#include <QMutexLocker>
+
+#include <SkBitmap.h>
+
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+#include <OsmAndCore/Map/IMapElevationDataProvider.h>
+
+namespace
+{
+    // Weight of newest sample in smoothed baseline and upload cost
+    const double Smoothing = 0.1;
+
+    // Uploads below this size are too small to tell their cost from noise
+    const uint64_t MinMeasuredBytes = 64 * 1024;
+
+    inline quint64 packTileId(int32_t x, int32_t y)
+    {
+        return (static_cast<quint64>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+}
+
+UploadScheduler::UploadScheduler()
+    : _backlogBytes(0)
+    , _baselineTime(0.0f)
+    , _bytesPerMillisecond(0.0)
+    , _frameBytes(0)
+    , enabled(true)
+    , targetUploadTime(4.0f)
+    , minBudgetBytes(256 * 1024)
+    , maxBudgetBytes(32 * 1024 * 1024)
+{
+    _counters.backlogTiles = 0;
+    _counters.backlogBytes = 0;
+    _counters.releasedTiles = 0;
+    _counters.releasedBytes = 0;
+    _counters.lastFrameTiles = 0;
+    _counters.lastFrameBytes = 0;
+    _counters.lastFrameUploadTime = 0.0f;
+    _counters.budgetBytes = 4 * 1024 * 1024;
+}
+
+UploadScheduler::~UploadScheduler()
+{
+}
+
+uint64_t UploadScheduler::getTileBytes(const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    if(!tile)
+        return 0;
+
+    const auto bitmapTile = std::dynamic_pointer_cast<OsmAnd::IMapBitmapTileProvider::Tile>(tile);
+    if(bitmapTile)
+        return bitmapTile->bitmap->getSize();
+
+    const auto elevationTile = std::dynamic_pointer_cast<OsmAnd::IMapElevationDataProvider::Tile>(tile);
+    if(elevationTile)
+        return static_cast<uint64_t>(elevationTile->rowLength) * elevationTile->height;
+
+    return 0;
+}
+
+std::shared_ptr<OsmAnd::IMapTileProvider::Tile> UploadScheduler::prepareTile(const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    const auto bitmapTile = std::dynamic_pointer_cast<OsmAnd::IMapBitmapTileProvider::Tile>(tile);
+    if(!bitmapTile || bitmapTile->bitmap->config() == SkBitmap::kARGB_8888_Config)
+        return tile;
+
+    // Palette and 565 images (most online PNGs) would otherwise be expanded on GL thread
+    auto converted = new SkBitmap();
+    if(!bitmapTile->bitmap->copyTo(converted, SkBitmap::kARGB_8888_Config))
+    {
+        delete converted;
+        return tile;
+    }
+
+    // Expansion does not change whether pixels are opaque, so renderer may still skip blending
+    return std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(
+        new OsmAnd::IMapBitmapTileProvider::Tile(converted, bitmapTile->alphaChannelData));
+}
+
+void UploadScheduler::enqueue(
+    const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+    const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success,
+    OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    Entry entry;
+    entry.tileId = tileId;
+    entry.zoom = zoom;
+    entry.tile = success ? prepareTile(tile) : tile;
+    entry.success = success;
+    entry.readyCallback = readyCallback;
+    entry.bytes = success ? getTileBytes(entry.tile) : 0;
+
+    bool parked = false;
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        if(enabled)
+        {
+            _backlog.push_back(entry);
+            _backlogBytes += entry.bytes;
+            parked = true;
+        }
+    }
+
+    if(!parked)
+    {
+        readyCallback(tileId, zoom, entry.tile, success);
+        return;
+    }
+
+    if(frameRequestCallback)
+        frameRequestCallback();
+}
+
+void UploadScheduler::beforeProcessRendering(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer)
+{
+    QSet<quint64> visible;
+    const auto& visibleTiles = renderer->visibleTiles;
+    for(auto itTile = visibleTiles.begin(); itTile != visibleTiles.end(); ++itTile)
+        visible.insert(packTileId(itTile->x, itTile->y));
+    const int zoomBase = renderer->configuration.zoomBase;
+
+    QList<Entry> released;
+    {
+        QMutexLocker scopeLock(&_mutex);
+
+        const auto budget = enabled ? _counters.budgetBytes : std::numeric_limits<uint64_t>::max();
+        uint64_t bytes = 0;
+
+        // Visible tiles first, then the rest in arrival order
+        for(int pass = 0; pass < 2 && bytes < budget; pass++)
+        {
+            for(auto itEntry = _backlog.begin(); itEntry != _backlog.end() && bytes < budget; )
+            {
+                const auto isVisible = static_cast<int>(itEntry->zoom) == zoomBase && visible.contains(packTileId(itEntry->tileId.x, itEntry->tileId.y));
+                if(pass == 0 && !isVisible)
+                {
+                    ++itEntry;
+                    continue;
+                }
+                // Whatever size the first one has, it goes, otherwise huge tiles would starve
+                if(!released.isEmpty() && bytes + itEntry->bytes > budget)
+                    break;
+
+                bytes += itEntry->bytes;
+                _backlogBytes -= itEntry->bytes;
+                released.push_back(*itEntry);
+                itEntry = _backlog.erase(itEntry);
+            }
+        }
+
+        _frameBytes = bytes;
+        _counters.lastFrameTiles = released.size();
+        _counters.lastFrameBytes = bytes;
+        _counters.releasedTiles += released.size();
+        _counters.releasedBytes += bytes;
+    }
+
+    for(auto itEntry = released.begin(); itEntry != released.end(); ++itEntry)
+        itEntry->readyCallback(itEntry->tileId, itEntry->zoom, itEntry->tile, itEntry->success);
+}
+
+void UploadScheduler::processRenderingDone(float milliseconds)
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    if(_frameBytes == 0)
+    {
+        _baselineTime = _baselineTime > 0.0f ? static_cast<float>(_baselineTime + (milliseconds - _baselineTime) * Smoothing) : milliseconds;
+        _counters.lastFrameUploadTime = 0.0f;
+        return;
+    }
+
+    const auto uploadTime = std::max(milliseconds - _baselineTime, 0.01f);
+    _counters.lastFrameUploadTime = uploadTime;
+    if(_frameBytes < MinMeasuredBytes)
+        return;
+
+    const auto bytesPerMillisecond = _frameBytes / static_cast<double>(uploadTime);
+    _bytesPerMillisecond = _bytesPerMillisecond > 0.0 ? _bytesPerMillisecond + (bytesPerMillisecond - _bytesPerMillisecond) * Smoothing : bytesPerMillisecond;
+
+    const auto budget = static_cast<uint64_t>(_bytesPerMillisecond * targetUploadTime);
+    _counters.budgetBytes = std::max(minBudgetBytes, std::min(maxBudgetBytes, budget));
+}
+
+bool UploadScheduler::hasBacklog() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    return !_backlog.isEmpty();
+}
+
+UploadScheduler::Counters UploadScheduler::getCounters() const
+{
+    QMutexLocker scopeLock(&_mutex);
+
+    Counters counters = _counters;
+    counters.backlogTiles = _backlog.size();
+    counters.backlogBytes = _backlogBytes;
+    return counters;
+}
@@ -0,0 +1,113 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __UPLOAD_SCHEDULER_H_
+#define __UPLOAD_SCHEDULER_H_
+
+#include <stdint.h>
+#include <memory>
+#include <functional>
+
+#include <QList>
+#include <QMutex>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+// Spreads texture uploads of delivered tiles over frames.
+//
+// Renderer uploads every tile handed to it by the next processRendering(), so a burst of
+// deliveries (zooming, layer switch) turns into one long frame. Deliveries are instead
+// parked here, already converted on worker thread to the layout renderer uploads as-is,
+// and handed to renderer right before processRendering() within per-frame byte budget.
+// Budget follows measured cost: bytes per millisecond of processRendering() above its
+// no-upload baseline, so that uploads take about targetUploadTime per frame.
+// Tiles that are visible now go first, at least one tile is released every frame.
+class UploadScheduler
+{
+public:
+    struct Counters
+    {
+        int backlogTiles;
+        uint64_t backlogBytes;
+        uint64_t releasedTiles;
+        uint64_t releasedBytes;
+        int lastFrameTiles;
+        uint64_t lastFrameBytes;
+        float lastFrameUploadTime;
+        uint64_t budgetBytes;
+    };
+
+private:
+    struct Entry
+    {
+        OsmAnd::TileId tileId;
+        OsmAnd::ZoomLevel zoom;
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+        bool success;
+        OsmAnd::IMapTileProvider::TileReadyCallback readyCallback;
+        uint64_t bytes;
+    };
+
+    mutable QMutex _mutex;
+    QList<Entry> _backlog;
+    uint64_t _backlogBytes;
+    Counters _counters;
+
+    // Smoothed processRendering() time of frames without uploads, and upload cost
+    float _baselineTime;
+    double _bytesPerMillisecond;
+    uint64_t _frameBytes;
+public:
+    UploadScheduler();
+    virtual ~UploadScheduler();
+
+    bool enabled;
+    float targetUploadTime;
+    uint64_t minBudgetBytes;
+    uint64_t maxBudgetBytes;
+
+    // Called (from any thread) when something was parked, so that next frame gets drawn
+    std::function<void ()> frameRequestCallback;
+
+    // Converts tile on calling (worker) thread and parks it, or delivers at once if disabled
+    void enqueue(
+        const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom,
+        const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile, bool success,
+        OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+
+    // Main thread: beforeProcessRendering(), processRendering(), processRenderingDone()
+    void beforeProcessRendering(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer);
+    void processRenderingDone(float milliseconds);
+
+    bool hasBacklog() const;
+    Counters getCounters() const;
+
+    // Size tile will take on GPU, after conversion
+    static uint64_t getTileBytes(const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    // Converts bitmaps to 32-bit ARGB, which is what renderer uploads without conversion
+    static std::shared_ptr<OsmAnd::IMapTileProvider::Tile> prepareTile(const std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+};
+
+#endif // __UPLOAD_SCHEDULER_H_
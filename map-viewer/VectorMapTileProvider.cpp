@@ -0,0 +1,352 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#include "VectorMapTileProvider.h"
+
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include <SkBitmap.h>
+#include <SkCanvas.h>
+#include <SkDevice.h>
+
+#include <OsmAndCore/Logging.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Map/Rasterizer.h>
+#include <OsmAndCore/Map/RasterizerContext.h>
+
+VectorMapTileProvider::State::State()
+    : hasView(false)
+    , viewCenterX(0.0)
+    , viewCenterY(0.0)
+    , viewZoom(0)
+    , keepRadius(std::numeric_limits<double>::max())
+    , requested(0)
+    , rasterized(0)
+    , cancelled(0)
+    , failed(0)
+    , lastRasterizeTime(0.0)
+{
+}
+
+class VectorMapTileProvider::Worker : public QRunnable
+{
+    const VectorMapTileProvider* const _owner;
+    const std::shared_ptr<State> _state;
+public:
+    Worker(const VectorMapTileProvider* owner, const std::shared_ptr<State>& state)
+        : _owner(owner)
+        , _state(state)
+    {
+    }
+
+    void run()
+    {
+        // One worker is started per queued request, but it serves whichever request is nearest now
+        TileKey key;
+        Request request;
+        {
+            QMutexLocker scopeLock(&_state->mutex);
+
+            if(_state->pending.isEmpty())
+                return;
+
+            auto itBest = _state->pending.begin();
+            if(_state->hasView)
+            {
+                auto bestDistance = distanceToView(*_state, itBest.key());
+                for(auto itRequest = _state->pending.begin(); itRequest != _state->pending.end(); ++itRequest)
+                {
+                    const auto distance = distanceToView(*_state, itRequest.key());
+                    if(distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        itBest = itRequest;
+                    }
+                }
+            }
+            key = itBest.key();
+            request = *itBest;
+            _state->pending.erase(itBest);
+            _state->running.insert(key, request.callbacks);
+        }
+
+        const auto rasterizeStart = std::chrono::high_resolution_clock::now();
+        std::shared_ptr<OsmAnd::IMapTileProvider::Tile> tile;
+        const auto success = _owner->rasterizeTile(request.tileId, request.zoom, tile);
+        const auto rasterizeFinish = std::chrono::high_resolution_clock::now();
+
+        QList<OsmAnd::IMapTileProvider::TileReadyCallback> callbacks;
+        {
+            QMutexLocker scopeLock(&_state->mutex);
+
+            callbacks = _state->running.take(key);
+            if(success)
+                _state->rasterized++;
+            else
+                _state->failed++;
+            _state->lastRasterizeTime = std::chrono::duration<double, std::milli>(rasterizeFinish - rasterizeStart).count();
+        }
+
+        for(auto itCallback = callbacks.begin(); itCallback != callbacks.end(); ++itCallback)
+            (*itCallback)(request.tileId, request.zoom, tile, success);
+    }
+};
+
+VectorMapTileProvider::VectorMapTileProvider(
+    const std::shared_ptr<MapObjectsCache>& objectsCache,
+    const QList< std::shared_ptr<QFileInfo> >& styleFiles,
+    const QString& styleName,
+    uint32_t tileSize,
+    float density,
+    int workersCount)
+    : _objectsCache(objectsCache)
+    , _styleFiles(styleFiles)
+    , _styleName(styleName)
+    , _tileSize(tileSize)
+    , _density(density)
+    , _state(new State())
+{
+    if(workersCount > 0)
+        _workers.setMaxThreadCount(workersCount);
+}
+
+VectorMapTileProvider::~VectorMapTileProvider()
+{
+    // Drop everything that was not started yet, running tiles are finished
+    QList<Request> cancelled;
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        cancelled = _state->pending.values();
+        _state->cancelled += _state->pending.size();
+        _state->pending.clear();
+    }
+    for(auto itRequest = cancelled.begin(); itRequest != cancelled.end(); ++itRequest)
+    {
+        for(auto itCallback = itRequest->callbacks.begin(); itCallback != itRequest->callbacks.end(); ++itCallback)
+            (*itCallback)(itRequest->tileId, itRequest->zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(), false);
+    }
+
+    _workers.waitForDone();
+}
+
+double VectorMapTileProvider::distanceToView(const State& state, const TileKey& key)
+{
+    // Tile center expressed in tiles of view zoom, plus one tile per zoom level of difference
+    const auto zoomDelta = state.viewZoom - key.zoom;
+    const auto scale = std::ldexp(1.0, zoomDelta);
+    const auto centerX = (key.x + 0.5) * scale;
+    const auto centerY = (key.y + 0.5) * scale;
+    return std::hypot(centerX - state.viewCenterX, centerY - state.viewCenterY) + std::abs(zoomDelta);
+}
+
+void VectorMapTileProvider::updateView(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer)
+{
+    const auto& visibleTiles = renderer->visibleTiles;
+    if(visibleTiles.size() == 0)
+        return;
+
+    int32_t minX = std::numeric_limits<int32_t>::max();
+    int32_t minY = std::numeric_limits<int32_t>::max();
+    int32_t maxX = std::numeric_limits<int32_t>::min();
+    int32_t maxY = std::numeric_limits<int32_t>::min();
+    for(auto itTile = visibleTiles.begin(); itTile != visibleTiles.end(); ++itTile)
+    {
+        const auto& tileId = *itTile;
+        minX = std::min(minX, tileId.x);
+        minY = std::min(minY, tileId.y);
+        maxX = std::max(maxX, tileId.x);
+        maxY = std::max(maxY, tileId.y);
+    }
+    const auto width = maxX - minX + 1;
+    const auto height = maxY - minY + 1;
+
+    const int zoomBase = renderer->configuration.zoomBase;
+    const auto tileSize31 = std::ldexp(1.0, 31 - zoomBase);
+    const auto& target31 = renderer->configuration.target31;
+
+    QList<Request> cancelled;
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        _state->hasView = true;
+        _state->viewCenterX = target31.x / tileSize31;
+        _state->viewCenterY = target31.y / tileSize31;
+        _state->viewZoom = zoomBase;
+        // Half of visible area plus one more screen, which is how far prefetcher looks ahead
+        _state->keepRadius = std::hypot(width, height) / 2.0 + std::max(width, height) + 1.0;
+
+        for(auto itRequest = _state->pending.begin(); itRequest != _state->pending.end(); )
+        {
+            const auto& key = itRequest.key();
+            if(std::abs(key.zoom - zoomBase) > 1 || distanceToView(*_state, key) > _state->keepRadius)
+            {
+                cancelled.push_back(*itRequest);
+                itRequest = _state->pending.erase(itRequest);
+                _state->cancelled++;
+            }
+            else
+            {
+                ++itRequest;
+            }
+        }
+    }
+
+    for(auto itRequest = cancelled.begin(); itRequest != cancelled.end(); ++itRequest)
+    {
+        for(auto itCallback = itRequest->callbacks.begin(); itCallback != itRequest->callbacks.end(); ++itCallback)
+            (*itCallback)(itRequest->tileId, itRequest->zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>(), false);
+    }
+}
+
+VectorMapTileProvider::Counters VectorMapTileProvider::getCounters() const
+{
+    QMutexLocker scopeLock(&_state->mutex);
+
+    Counters counters;
+    counters.requested = _state->requested;
+    counters.rasterized = _state->rasterized;
+    counters.cancelled = _state->cancelled;
+    counters.failed = _state->failed;
+    counters.pending = _state->pending.size() + _state->running.size();
+    counters.lastRasterizeTime = _state->lastRasterizeTime;
+    return counters;
+}
+
+bool VectorMapTileProvider::rasterizeTile(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile) const
+{
+    const auto zoomLevel = static_cast<int>(zoom);
+    const int64_t tileSize31 = static_cast<int64_t>(1) << (31 - zoomLevel);
+    const int64_t maxCoordinate31 = std::numeric_limits<int32_t>::max();
+
+    OsmAnd::AreaI bbox31;
+    bbox31.left = static_cast<int32_t>(std::min(tileId.x * tileSize31, maxCoordinate31));
+    bbox31.top = static_cast<int32_t>(std::min(tileId.y * tileSize31, maxCoordinate31));
+    bbox31.right = static_cast<int32_t>(std::min((tileId.x + 1) * tileSize31, maxCoordinate31));
+    bbox31.bottom = static_cast<int32_t>(std::min((tileId.y + 1) * tileSize31, maxCoordinate31));
+
+    QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects;
+    _objectsCache->obtainMapObjects(tileId, zoom, mapObjects);
+
+    OsmAnd::AreaD area;
+    area.left = OsmAnd::Utilities::get31LongitudeX(bbox31.left);
+    area.right = OsmAnd::Utilities::get31LongitudeX(bbox31.right);
+    area.top = OsmAnd::Utilities::get31LatitudeY(bbox31.top);
+    area.bottom = OsmAnd::Utilities::get31LatitudeY(bbox31.bottom);
+
+    const auto bitmapSize = getTileSize();
+    auto bitmap = new SkBitmap();
+    bitmap->setConfig(SkBitmap::kARGB_8888_Config, bitmapSize, bitmapSize);
+    if(!bitmap->allocPixels())
+    {
+        delete bitmap;
+        return false;
+    }
+    {
+        SkDevice renderTarget(*bitmap);
+        SkCanvas canvas(&renderTarget);
+        canvas.scale(_density, _density);
+
+        const auto style = obtainStyle();
+        if(!style)
+        {
+            delete bitmap;
+            return false;
+        }
+        OsmAnd::RasterizerContext rasterizerContext(style);
+        if(!OsmAnd::Rasterizer::rasterize(rasterizerContext, true, canvas, area, zoomLevel, _tileSize, mapObjects, OsmAnd::PointI(), nullptr))
+        {
+            delete bitmap;
+            return false;
+        }
+    }
+
+    tile.reset(new OsmAnd::IMapBitmapTileProvider::Tile(bitmap, OsmAnd::IMapBitmapTileProvider::AlphaChannelData::Undefined));
+    return true;
+}
+
+std::shared_ptr<OsmAnd::RasterizationStyle> VectorMapTileProvider::obtainStyle() const
+{
+    // Called from worker threads only
+    if(!_threadStyles.hasLocalData())
+    {
+        auto threadStyle = new ThreadStyle();
+        for(auto itStyleFile = _styleFiles.begin(); itStyleFile != _styleFiles.end(); ++itStyleFile)
+            threadStyle->collection.registerStyle(**itStyleFile);
+        if(!threadStyle->collection.obtainStyle(_styleName, threadStyle->style))
+        {
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to resolve style '%s'\n", qPrintable(_styleName));
+            threadStyle->style.reset();
+        }
+        _threadStyles.setLocalData(threadStyle);
+    }
+    return _threadStyles.localData()->style;
+}
+
+uint32_t VectorMapTileProvider::getTileSize() const
+{
+    return static_cast<uint32_t>(std::ceil(_tileSize * _density));
+}
+
+bool VectorMapTileProvider::obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile)
+{
+    // Rasterization is never done on render thread
+    return false;
+}
+
+void VectorMapTileProvider::obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback)
+{
+    const auto key = TileKey::make(tileId, zoom);
+
+    {
+        QMutexLocker scopeLock(&_state->mutex);
+
+        _state->requested++;
+
+        const auto itRunning = _state->running.find(key);
+        if(itRunning != _state->running.end())
+        {
+            itRunning->push_back(readyCallback);
+            return;
+        }
+        const auto itPending = _state->pending.find(key);
+        if(itPending != _state->pending.end())
+        {
+            itPending->callbacks.push_back(readyCallback);
+            return;
+        }
+
+        Request request;
+        request.tileId = tileId;
+        request.zoom = zoom;
+        request.callbacks.push_back(readyCallback);
+        _state->pending.insert(key, request);
+    }
+
+    _workers.start(new Worker(this, _state));
+}
@@ -0,0 +1,137 @@
+/**
+  * @file
+  *
+  * @section LICENSE
+  *
+  * OsmAnd - Android navigation software based on OSM maps.
+  * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * (at your option) any later version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+  */
+
+#ifndef __VECTOR_MAP_TILE_PROVIDER_H_
+#define __VECTOR_MAP_TILE_PROVIDER_H_
+
+#include <stdint.h>
+#include <memory>
+
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QThreadStorage>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IMapTileProvider.h>
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+#include <OsmAndCore/Map/RasterizationStyle.h>
+#include <OsmAndCore/Map/RasterizationStyles.h>
+
+#include "MapObjectsCache.h"
+#include "TileKey.h"
+
+// Bitmap tile provider that rasterizes map objects from MapObjectsCache with named style.
+// Requests are queued and served by worker pool nearest-to-view-center first. View is
+// updated by owner each frame; queued requests for tiles that left the view (with a margin
+// that keeps prefetched tiles) are cancelled and reported as failed.
+class VectorMapTileProvider : public OsmAnd::IMapBitmapTileProvider
+{
+public:
+    struct Counters
+    {
+        uint64_t requested;
+        uint64_t rasterized;
+        uint64_t cancelled;
+        uint64_t failed;
+        int pending;
+        double lastRasterizeTime;
+    };
+
+private:
+    struct Request
+    {
+        OsmAnd::TileId tileId;
+        OsmAnd::ZoomLevel zoom;
+        QList<OsmAnd::IMapTileProvider::TileReadyCallback> callbacks;
+    };
+
+    struct State
+    {
+        State();
+
+        QMutex mutex;
+        QHash<TileKey, Request> pending;
+        QHash< TileKey, QList<OsmAnd::IMapTileProvider::TileReadyCallback> > running;
+
+        // View center in tiles of view zoom, and radius (in same tiles) beyond which requests are cancelled
+        bool hasView;
+        double viewCenterX;
+        double viewCenterY;
+        int viewZoom;
+        double keepRadius;
+
+        uint64_t requested;
+        uint64_t rasterized;
+        uint64_t cancelled;
+        uint64_t failed;
+        double lastRasterizeTime;
+    };
+
+    // Resolved style keeps evaluation state, so each worker thread resolves and uses its own.
+    // Collection owns its styles and has to outlive them.
+    struct ThreadStyle
+    {
+        OsmAnd::RasterizationStyles collection;
+        std::shared_ptr<OsmAnd::RasterizationStyle> style;
+    };
+
+    const std::shared_ptr<MapObjectsCache> _objectsCache;
+    const QList< std::shared_ptr<QFileInfo> > _styleFiles;
+    const QString _styleName;
+    const uint32_t _tileSize;
+    const float _density;
+    const std::shared_ptr<State> _state;
+    // Per-thread data is deleted when worker thread exits, so it is declared before the pool
+    mutable QThreadStorage<ThreadStyle*> _threadStyles;
+    QThreadPool _workers;
+
+    class Worker;
+    static double distanceToView(const State& state, const TileKey& key);
+    std::shared_ptr<OsmAnd::RasterizationStyle> obtainStyle() const;
+    bool rasterizeTile(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile) const;
+public:
+    VectorMapTileProvider(
+        const std::shared_ptr<MapObjectsCache>& objectsCache,
+        const QList< std::shared_ptr<QFileInfo> >& styleFiles,
+        const QString& styleName,
+        uint32_t tileSize = 256,
+        float density = 1.0f,
+        int workersCount = 0);
+    virtual ~VectorMapTileProvider();
+
+    // Call once per frame, after renderer has updated visible tiles
+    void updateView(const std::shared_ptr<OsmAnd::IMapRenderer>& renderer);
+
+    Counters getCounters() const;
+
+    virtual uint32_t getTileSize() const;
+    virtual bool obtainTileImmediate(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, std::shared_ptr<OsmAnd::IMapTileProvider::Tile>& tile);
+    virtual void obtainTileDeffered(const OsmAnd::TileId& tileId, const OsmAnd::ZoomLevel& zoom, OsmAnd::IMapTileProvider::TileReadyCallback readyCallback);
+};
+
+#endif // __VECTOR_MAP_TILE_PROVIDER_H_
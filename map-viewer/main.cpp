@@ -28,6 +28,7 @@
 
 #include <QString>
 #include <QList>
+#include <QMap>
 #include <QFile>
 
 #include <OsmAndCore.h>
@@ -38,13 +39,30 @@
 #include <OsmAndCore/Map/RasterizerContext.h>
 #include <OsmAndCore/Map/RasterizationStyles.h>
 #include <OsmAndCore/Map/RasterizationStyleEvaluator.h>
-#include <OsmAndCore/Map/MapDataCache.h>
 #include <OsmAndCore/Map/IMapRenderer.h>
 #include <OsmAndCore/Map/OnlineMapRasterTileProvider.h>
 #include <OsmAndCore/Map/HillshadeTileProvider.h>
 #include <OsmAndCore/Map/IMapElevationDataProvider.h>
 #include <OsmAndCore/Map/HeightmapTileProvider.h>
 
+#include "InstrumentedTileProvider.h"
+#include "Benchmark.h"
+#include "PerformanceHud.h"
+#include "PrefetchingTileProvider.h"
+#include "TilePrefetcher.h"
+#include "TilePackCache.h"
+#include "PackCachedTileProvider.h"
+#include "ObfHeaderIndex.h"
+#include "MapObjectsCache.h"
+#include "VectorMapTileProvider.h"
+#include "ComputedHillshadeTileProvider.h"
+#include "ContourTileProvider.h"
+#include "TerrainErrorTileProvider.h"
+#include "TerrainLodController.h"
+#include "UploadScheduler.h"
+#include "UploadScheduledTileProvider.h"
+#include "TerrainBenchmark.h"
+
 OsmAnd::AreaI viewport;
 std::shared_ptr<OsmAnd::IMapRenderer> renderer;
 
@@ -54,9 +72,32 @@ bool wasHeightsDirSpecified = false;
 QList< std::shared_ptr<QFileInfo> > styleFiles;
 QList< std::shared_ptr<QFileInfo> > obfFiles;
 QString styleName;
+std::shared_ptr<ObfHeaderIndex> obfHeaderIndex;
+uint64_t mapObjectsCacheSize = 128 * 1024 * 1024;
+std::shared_ptr<MapObjectsCache> mapObjectsCache;
 bool wasObfRootSpecified = false;
+QString benchmarkScriptPath;
+QString benchmarkReportPath;
+QString hillshadeDbPath;
+int hillshadeBenchmarkZoom = -1;
+int contoursBenchmarkZoom = -1;
+QString benchmarkArea;
+QMap<int, std::shared_ptr<InstrumentedTileProvider> > instrumentedProviders;
+QMap<int, std::shared_ptr<PrefetchingTileProvider> > prefetchingProviders;
+TilePrefetcher prefetcher;
+QDir tilesCacheDir;
+bool wasTilesCacheDirSpecified = false;
+uint64_t tilesCacheSize = 256 * 1024 * 1024;
+bool tilesOffline = false;
+QMap<QString, std::shared_ptr<TilePackCache> > tilePackCaches;
+QMap<int, std::shared_ptr<VectorMapTileProvider> > vectorProviders;
+std::shared_ptr<TerrainErrorTileProvider> terrainErrorProvider;
+TerrainLodController terrainLod;
+std::shared_ptr<UploadScheduler> uploadScheduler;
+float uploadBudgetTime = 4.0f;
 
 bool renderWireframe = false;
+PerformanceHud hud;
 void reshapeHandler(int newWidth, int newHeight);
 void mouseHandler(int button, int state, int x, int y);
 void mouseMotion(int x, int y);
@@ -65,6 +106,8 @@ void keyboardHandler(unsigned char key, int x, int y);
 void specialHandler(int key, int x, int y);
 void displayHandler(void);
 void activateProvider(OsmAnd::IMapRenderer::TileLayerId layerId, int idx);
+void setTileProvider(OsmAnd::IMapRenderer::TileLayerId layerId, const std::shared_ptr<OsmAnd::IMapTileProvider>& tileProvider);
+std::shared_ptr<OsmAnd::IMapTileProvider> createPackCachedProvider(const QString& name, const std::shared_ptr<OsmAnd::IMapTileProvider>& onlineProvider);
 void verifyOpenGL();
 
 int main(int argc, char** argv)
@@ -114,15 +157,86 @@ int main(int argc, char** argv)
             heightsDir = QDir(arg.mid(strlen("-heightsDir=")));
             wasHeightsDirSpecified = true;
         }
+        else if (arg.startsWith("-benchmark="))
+        {
+            benchmarkScriptPath = arg.mid(strlen("-benchmark="));
+        }
+        else if (arg.startsWith("-benchmarkReport="))
+        {
+            benchmarkReportPath = arg.mid(strlen("-benchmarkReport="));
+        }
+        else if (arg.startsWith("-hillshadeDb="))
+        {
+            hillshadeDbPath = arg.mid(strlen("-hillshadeDb="));
+        }
+        else if (arg.startsWith("-benchmarkHillshade="))
+        {
+            hillshadeBenchmarkZoom = arg.mid(strlen("-benchmarkHillshade=")).toInt();
+        }
+        else if (arg.startsWith("-benchmarkContours="))
+        {
+            contoursBenchmarkZoom = arg.mid(strlen("-benchmarkContours=")).toInt();
+        }
+        else if (arg.startsWith("-benchmarkArea="))
+        {
+            benchmarkArea = arg.mid(strlen("-benchmarkArea="));
+        }
+        else if (arg.startsWith("-tilesCacheDir="))
+        {
+            tilesCacheDir = QDir(arg.mid(strlen("-tilesCacheDir=")));
+            wasTilesCacheDirSpecified = true;
+        }
+        else if (arg.startsWith("-tilesCacheSize="))
+        {
+            bool ok = false;
+            const auto megabytes = arg.mid(strlen("-tilesCacheSize=")).toUInt(&ok);
+            if(!ok || megabytes == 0)
+            {
+                std::cerr << "Tiles cache size must be positive number of megabytes" << std::endl;
+                OsmAnd::ReleaseCore();
+                return EXIT_FAILURE;
+            }
+            tilesCacheSize = static_cast<uint64_t>(megabytes) * 1024 * 1024;
+        }
+        else if (arg.startsWith("-mapDataCacheSize="))
+        {
+            bool ok = false;
+            const auto megabytes = arg.mid(strlen("-mapDataCacheSize=")).toUInt(&ok);
+            if(!ok || megabytes == 0)
+            {
+                std::cerr << "Map data cache size must be positive number of megabytes" << std::endl;
+                OsmAnd::ReleaseCore();
+                return EXIT_FAILURE;
+            }
+            mapObjectsCacheSize = static_cast<uint64_t>(megabytes) * 1024 * 1024;
+        }
+        else if (arg.startsWith("-uploadBudget="))
+        {
+            // Milliseconds per frame, 0 disables scheduling
+            bool ok = false;
+            uploadBudgetTime = arg.mid(strlen("-uploadBudget=")).toFloat(&ok);
+            if(!ok || uploadBudgetTime < 0.0f)
+            {
+                std::cerr << "Upload budget must be non-negative number of milliseconds" << std::endl;
+                OsmAnd::ReleaseCore();
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-tilesOffline")
+        {
+            tilesOffline = true;
+        }
     }
     if(!wasObfRootSpecified)
         OsmAnd::Utilities::findFiles(QDir::current(), QStringList() << "*.obf", obfFiles);
+    if(!wasTilesCacheDirSpecified)
+        tilesCacheDir = cacheDir;
     
-    // Obtain and configure rasterization style context
-    std::shared_ptr<OsmAnd::RasterizationStyle> style;
+    // Style is only checked here, vector tile workers resolve their own instances of it
     if(!styleName.isEmpty())
     {
         OsmAnd::RasterizationStyles stylesCollection;
+        std::shared_ptr<OsmAnd::RasterizationStyle> style;
         for(auto itStyleFile = styleFiles.begin(); itStyleFile != styleFiles.end(); ++itStyleFile)
         {
             auto styleFile = *itStyleFile;
@@ -138,14 +252,21 @@ int main(int argc, char** argv)
         }
     }
     
-    std::shared_ptr<OsmAnd::MapDataCache> mapDataCache(new OsmAnd::MapDataCache());
+    // Only headers are read here (or taken from index of previous run), files are opened on first query
+    QStringList obfPaths;
     for(auto itObf = obfFiles.begin(); itObf != obfFiles.end(); ++itObf)
-    {
-        auto obf = *itObf;
-        std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(obf->absoluteFilePath()))));
-
-        mapDataCache->addSource(obfReader);
-    }
+        obfPaths.push_back((*itObf)->absoluteFilePath());
+    obfHeaderIndex.reset(new ObfHeaderIndex(cacheDir.absoluteFilePath(ObfHeaderIndex::defaultIndexFilename)));
+    obfHeaderIndex->refresh(obfPaths);
+    const auto obfCounters = obfHeaderIndex->getCounters();
+    OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Info, "Indexed %d OBF files (%d scanned, %d from index, %d broken) in %.1f ms\n",
+        obfCounters.files, obfCounters.scannedOnRefresh, obfCounters.reusedOnRefresh, obfCounters.failedFiles, obfCounters.lastRefreshTime);
+    mapObjectsCache.reset(new MapObjectsCache(obfHeaderIndex, mapObjectsCacheSize));
+    hud.mapObjectsCache = mapObjectsCache;
+    uploadScheduler.reset(new UploadScheduler());
+    uploadScheduler->enabled = uploadBudgetTime > 0.0f;
+    uploadScheduler->targetUploadTime = uploadBudgetTime;
+    hud.uploadScheduler = uploadScheduler;
 
 #if defined(OSMAND_OPENGL_RENDERER_SUPPORTED)
     renderer = OsmAnd::createAtlasMapRenderer_OpenGL();
@@ -159,6 +280,83 @@ int main(int argc, char** argv)
 
     //////////////////////////////////////////////////////////////////////////
 
+    // Runtime hillshade against pre-baked sqlite tiles, no window is created
+    if(hillshadeBenchmarkZoom >= 0)
+    {
+        if(!wasHeightsDirSpecified || hillshadeDbPath.isEmpty())
+        {
+            std::cerr << "Hillshade benchmark needs -heightsDir= and -hillshadeDb=" << std::endl;
+            OsmAnd::ReleaseCore();
+            return EXIT_FAILURE;
+        }
+
+        TerrainBenchmark::HillshadeConfiguration hillshadeCfg;
+        hillshadeCfg.sqlitePath = hillshadeDbPath;
+        hillshadeCfg.zoom = hillshadeBenchmarkZoom;
+        std::shared_ptr<OsmAnd::IMapTileProvider> heightmapProvider(
+            new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+        const auto ok = TerrainBenchmark::runHillshade(heightmapProvider, hillshadeCfg, std::cout);
+
+        OsmAnd::ReleaseCore();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Contour lines extraction throughput, no window is created
+    if(contoursBenchmarkZoom >= 0)
+    {
+        const auto values = benchmarkArea.split(",");
+        if(!wasHeightsDirSpecified || values.size() != 4)
+        {
+            std::cerr << "Contours benchmark needs -heightsDir= and -benchmarkArea=LeftLon,TopLat,RightLon,BottomLat" << std::endl;
+            OsmAnd::ReleaseCore();
+            return EXIT_FAILURE;
+        }
+
+        TerrainBenchmark::ContoursConfiguration contoursCfg;
+        contoursCfg.zoom = contoursBenchmarkZoom;
+        contoursCfg.area.left = values[0].toDouble();
+        contoursCfg.area.top = values[1].toDouble();
+        contoursCfg.area.right = values[2].toDouble();
+        contoursCfg.area.bottom = values[3].toDouble();
+        std::shared_ptr<OsmAnd::IMapTileProvider> heightmapProvider(
+            new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+        const auto ok = TerrainBenchmark::runContours(heightmapProvider, contoursCfg, std::cout);
+
+        OsmAnd::ReleaseCore();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Headless scripted fly-through, no window is created
+    if(!benchmarkScriptPath.isEmpty())
+    {
+        Benchmark::Script script;
+        QString error;
+        if(!Benchmark::loadScript(benchmarkScriptPath, script, error))
+        {
+            std::cerr << error.toStdString() << std::endl;
+            OsmAnd::ReleaseCore();
+            return EXIT_FAILURE;
+        }
+
+        // Online tiles would make results depend on network, so only packed ones are used
+        tilesOffline = true;
+        activateProvider(OsmAnd::IMapRenderer::TileLayerId::RasterMap, script.rasterProvider);
+        if(!instrumentedProviders.contains(OsmAnd::IMapRenderer::TileLayerId::RasterMap))
+        {
+            std::cerr << "Raster provider " << script.rasterProvider << " of benchmark script is not available" << std::endl;
+            OsmAnd::ReleaseCore();
+            return EXIT_FAILURE;
+        }
+        const auto ok = Benchmark::run(renderer, script, instrumentedProviders, prefetchingProviders, prefetcher, mapObjectsCache, uploadScheduler, std::cout, benchmarkReportPath);
+        setTileProvider(OsmAnd::IMapRenderer::TileLayerId::RasterMap, std::shared_ptr<OsmAnd::IMapTileProvider>());
+        tilePackCaches.clear();
+
+        OsmAnd::ReleaseCore();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
     assert(glutInit != nullptr);
     glutInit(&argc, argv);
 
@@ -185,6 +383,10 @@ int main(int argc, char** argv)
     {
         glutPostRedisplay();
     };
+    uploadScheduler->frameRequestCallback = []()
+    {
+        glutPostRedisplay();
+    };
     viewport.top = 0;
     viewport.left = 0;
     viewport.bottom = 600;
@@ -225,6 +427,8 @@ int main(int argc, char** argv)
 
     //////////////////////////////////////////////////////////////////////////
     renderer->releaseRendering();
+    for(auto itCache = tilePackCaches.begin(); itCache != tilePackCaches.end(); ++itCache)
+        (*itCache)->flush();
     //////////////////////////////////////////////////////////////////////////
 
     OsmAnd::ReleaseCore();
@@ -367,19 +571,34 @@ void keyboardHandler(unsigned char key, int x, int y)
             glutPostRedisplay();
         }
         break;
+    case 'p':
+        {
+            hud.enabled = !hud.enabled;
+            glutPostRedisplay();
+        }
+        break;
+    case 'c':
+        {
+            prefetcher.enabled = !prefetcher.enabled;
+            glutPostRedisplay();
+        }
+        break;
     case 'e':
         {
             if(renderer->configuration.tileProviders[OsmAnd::IMapRenderer::ElevationData])
             {
-                renderer->setTileProvider(OsmAnd::IMapRenderer::ElevationData, std::shared_ptr<OsmAnd::IMapTileProvider>());
+                setTileProvider(OsmAnd::IMapRenderer::ElevationData, std::shared_ptr<OsmAnd::IMapTileProvider>());
+                terrainErrorProvider.reset();
             }
             else
             {
                 if(wasHeightsDirSpecified)
                 {
-                    auto provider = new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename));
-                    //renderer->setHeightmapPatchesPerSide(provider->getMaxResolutionPatchesCount());
-                    renderer->setTileProvider(OsmAnd::IMapRenderer::TileLayerId::ElevationData, std::shared_ptr<OsmAnd::IMapTileProvider>(provider));
+                    std::shared_ptr<OsmAnd::IMapTileProvider> provider(
+                        new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+                    // Patches count is then chosen by terrainLod from errors measured on delivered tiles
+                    terrainErrorProvider.reset(new TerrainErrorTileProvider(provider));
+                    setTileProvider(OsmAnd::IMapRenderer::TileLayerId::ElevationData, terrainErrorProvider);
                 }
             }
         }
@@ -391,14 +610,28 @@ void keyboardHandler(unsigned char key, int x, int y)
         break;
     case 'y':
         {
+            terrainLod.enabled = false;
             renderer->setHeightmapPatchesPerSide(renderer->configuration.heightmapPatchesPerSide + 1);
         }
         break;
     case 'h':
         {
+            terrainLod.enabled = false;
             renderer->setHeightmapPatchesPerSide(renderer->configuration.heightmapPatchesPerSide - 1);
         }
         break;
+    case 'v':
+        {
+            terrainLod.enabled = !terrainLod.enabled;
+            glutPostRedisplay();
+        }
+        break;
+    case 'b':
+        {
+            uploadScheduler->enabled = !uploadScheduler->enabled;
+            glutPostRedisplay();
+        }
+        break;
     case 't':
         {
             renderer->setFogDensity(renderer->configuration.fogDensity + 0.01f);
@@ -463,6 +696,18 @@ void keyboardHandler(unsigned char key, int x, int y)
             activateProvider(layerId, 3);
         }
         break;
+    case '4':
+        {
+            auto layerId = (modifiers & GLUT_ACTIVE_ALT) ? OsmAnd::IMapRenderer::TileLayerId::MapOverlay0 : OsmAnd::IMapRenderer::TileLayerId::RasterMap;
+            activateProvider(layerId, 4);
+        }
+        break;
+    case '5':
+        {
+            auto layerId = (modifiers & GLUT_ACTIVE_ALT) ? OsmAnd::IMapRenderer::TileLayerId::MapOverlay0 : OsmAnd::IMapRenderer::TileLayerId::RasterMap;
+            activateProvider(layerId, 5);
+        }
+        break;
     }
 }
 
@@ -496,28 +741,98 @@ void specialHandler(int key, int x, int y)
     }
 }
 
+void setTileProvider(OsmAnd::IMapRenderer::TileLayerId layerId, const std::shared_ptr<OsmAnd::IMapTileProvider>& tileProvider)
+{
+    // Vector provider of this layer (if any) is registered again by caller
+    vectorProviders.remove(layerId);
+
+    if(!tileProvider)
+    {
+        instrumentedProviders.remove(layerId);
+        prefetchingProviders.remove(layerId);
+        renderer->setTileProvider(layerId, tileProvider);
+        return;
+    }
+
+    std::shared_ptr<PrefetchingTileProvider> prefetchingProvider(new PrefetchingTileProvider(tileProvider));
+    prefetchingProviders.insert(layerId, prefetchingProvider);
+    // Instrumented proxy is outermost, so its deliveries are the tiles actually handed to renderer
+    std::shared_ptr<OsmAnd::IMapTileProvider> scheduledProvider(new UploadScheduledTileProvider(prefetchingProvider, uploadScheduler));
+    std::shared_ptr<InstrumentedTileProvider> instrumentedProvider(new InstrumentedTileProvider(scheduledProvider));
+    instrumentedProviders.insert(layerId, instrumentedProvider);
+    renderer->setTileProvider(layerId, instrumentedProvider);
+}
+
+std::shared_ptr<OsmAnd::IMapTileProvider> createPackCachedProvider(const QString& name, const std::shared_ptr<OsmAnd::IMapTileProvider>& onlineProvider)
+{
+    // One pack per online source, shared by all layers showing it
+    auto itCache = tilePackCaches.find(name);
+    if(itCache == tilePackCaches.end())
+    {
+        std::shared_ptr<TilePackCache> cache(new TilePackCache(tilesCacheDir.absoluteFilePath(name + ".tilepack"), tilesCacheSize, tilesOffline));
+        if(!cache->open())
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Failed to open tiles pack '%s'\n", qPrintable(tilesCacheDir.absoluteFilePath(name + ".tilepack")));
+        itCache = tilePackCaches.insert(name, cache);
+    }
+
+    return std::shared_ptr<OsmAnd::IMapTileProvider>(new PackCachedTileProvider(onlineProvider, *itCache));
+}
+
 void activateProvider(OsmAnd::IMapRenderer::TileLayerId layerId, int idx)
 {
     if(idx == 0)
     {
-        renderer->setTileProvider(layerId, std::shared_ptr<OsmAnd::IMapTileProvider>());
+        setTileProvider(layerId, std::shared_ptr<OsmAnd::IMapTileProvider>());
     }
     else if(idx == 1)
     {
-        auto tileProvider = OsmAnd::OnlineMapRasterTileProvider::createCycleMapProvider();
-        static_cast<OsmAnd::OnlineMapRasterTileProvider*>(tileProvider.get())->setLocalCachePath(QDir::current());
-        renderer->setTileProvider(layerId, tileProvider);
+        std::shared_ptr<OsmAnd::IMapTileProvider> onlineProvider;
+        if(!tilesOffline)
+            onlineProvider = OsmAnd::OnlineMapRasterTileProvider::createCycleMapProvider();
+        setTileProvider(layerId, createPackCachedProvider("cyclemap", onlineProvider));
     }
     else if(idx == 2)
     {
-        auto tileProvider = OsmAnd::OnlineMapRasterTileProvider::createMapnikProvider();
-        static_cast<OsmAnd::OnlineMapRasterTileProvider*>(tileProvider.get())->setLocalCachePath(QDir::current());
-        renderer->setTileProvider(layerId, tileProvider);
+        std::shared_ptr<OsmAnd::IMapTileProvider> onlineProvider;
+        if(!tilesOffline)
+            onlineProvider = OsmAnd::OnlineMapRasterTileProvider::createMapnikProvider();
+        setTileProvider(layerId, createPackCachedProvider("mapnik", onlineProvider));
     }
     else if(idx == 3)
     {
-//        auto hillshadeTileProvider = new OsmAnd::HillshadeTileProvider();
-//        renderer->setTileProvider(layerId, hillshadeTileProvider);
+        if(styleName.isEmpty())
+        {
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Vector maps need style, specify -stylesPath= and -style=\n");
+            return;
+        }
+
+        std::shared_ptr<VectorMapTileProvider> tileProvider(new VectorMapTileProvider(mapObjectsCache, styleFiles, styleName));
+        setTileProvider(layerId, tileProvider);
+        vectorProviders.insert(layerId, tileProvider);
+    }
+    else if(idx == 4)
+    {
+        if(!wasHeightsDirSpecified)
+        {
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Hillshade needs -heightsDir=\n");
+            return;
+        }
+
+        std::shared_ptr<OsmAnd::IMapTileProvider> heightmapProvider(
+            new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+        setTileProvider(layerId, std::shared_ptr<OsmAnd::IMapTileProvider>(new ComputedHillshadeTileProvider(heightmapProvider)));
+    }
+    else if(idx == 5)
+    {
+        if(!wasHeightsDirSpecified)
+        {
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Contour lines need -heightsDir=\n");
+            return;
+        }
+
+        std::shared_ptr<OsmAnd::IMapTileProvider> heightmapProvider(
+            new OsmAnd::HeightmapTileProvider(heightsDir, cacheDir.absoluteFilePath(OsmAnd::HeightmapTileProvider::defaultIndexFilename)));
+        setTileProvider(layerId, std::shared_ptr<OsmAnd::IMapTileProvider>(new ContourTileProvider(heightmapProvider)));
     }
 }
 
@@ -531,9 +846,22 @@ void displayHandler()
     //OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Debug, "-FS{-\n");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     verifyOpenGL();
+    hud.beginFrame();
+    uploadScheduler->beforeProcessRendering(renderer);
     renderer->processRendering();
+    hud.processRenderingDone();
+    uploadScheduler->processRenderingDone(hud.lastProcessRenderingTime());
     renderer->renderFrame();
+    hud.renderFrameDone(renderer);
     verifyOpenGL();
+    prefetcher.update(renderer, prefetchingProviders);
+    for(auto itProvider = vectorProviders.begin(); itProvider != vectorProviders.end(); ++itProvider)
+        (*itProvider)->updateView(renderer);
+    if(terrainErrorProvider)
+        terrainLod.update(viewport, renderer, terrainErrorProvider);
+    // Rest of backlog goes in following frames
+    if(uploadScheduler->hasBacklog())
+        glutPostRedisplay();
     //OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Debug, "-}FS-\n");
     
     //////////////////////////////////////////////////////////////////////////
@@ -544,95 +872,76 @@ void displayHandler()
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
-    glColor3f(0.0f, 1.0f, 0.0f);
-    glRasterPos2f(8, viewport.height() - 16 * 1);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("fov (keys i,k)         : %1").arg(renderer->configuration.fieldOfView).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 2);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("fog distance (keys r,f): %1").arg(renderer->configuration.fogDistance).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 3);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("azimuth (arrows l,r)   : %1").arg(renderer->configuration.azimuth).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 4);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("pitch (arrows u,d)     : %1").arg(renderer->configuration.elevationAngle).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 5);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("target (keys w,a,s,d)  : %1 %2").arg(renderer->configuration.target31.x).arg(renderer->configuration.target31.y).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 6);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("zoom (mouse wheel)     : %1").arg(renderer->configuration.requestedZoom).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 7);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("zoom base              : %1").arg(renderer->configuration.zoomBase).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 8);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("zoom fraction          : %1").arg(renderer->configuration.zoomFraction).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 9);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("visible tiles          : %1").arg(renderer->visibleTiles.size()).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 10);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("wireframe (key x)      : %1").arg(renderWireframe).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 11);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("elevation data (key e) : %1").arg((bool)renderer->configuration.tileProviders[OsmAnd::IMapRenderer::ElevationData]).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 12);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("use atlases (key z)    : %1").arg(renderer->configuration.textureAtlasesAllowed).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 13);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("DEM-patches# (keys y,h): %1").arg(renderer->configuration.heightmapPatchesPerSide).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 14);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("fog density (keys t,g) : %1").arg(renderer->configuration.fogDensity).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 15);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("fog origin F (keys u,j): %1").arg(renderer->configuration.fogOriginFactor).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, viewport.height() - 16 * 16);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("height scale (keys o,l): %1").arg(renderer->configuration.heightScaleFactor).toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, 16 * 6);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("Tile providers (holding alt controls overlay0):").toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, 16 * 5);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("0 - disable").toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, 16 * 4);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("1 - Mapnik").toStdString().c_str());
-    verifyOpenGL();
-
-    glRasterPos2f(8, 16 * 3);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("2 - CycleMap").toStdString().c_str());
-    verifyOpenGL();
+    if(hud.enabled)
+    {
+        hud.draw(viewport, renderer, instrumentedProviders, prefetchingProviders);
+    }
+    else
+    {
+        QStringList settings;
+        settings << QString("fov (keys i,k)         : %1").arg(renderer->configuration.fieldOfView);
+        settings << QString("fog distance (keys r,f): %1").arg(renderer->configuration.fogDistance);
+        settings << QString("azimuth (arrows l,r)   : %1").arg(renderer->configuration.azimuth);
+        settings << QString("pitch (arrows u,d)     : %1").arg(renderer->configuration.elevationAngle);
+        settings << QString("target (keys w,a,s,d)  : %1 %2").arg(renderer->configuration.target31.x).arg(renderer->configuration.target31.y);
+        settings << QString("zoom (mouse wheel)     : %1").arg(renderer->configuration.requestedZoom);
+        settings << QString("zoom base              : %1").arg(renderer->configuration.zoomBase);
+        settings << QString("zoom fraction          : %1").arg(renderer->configuration.zoomFraction);
+        settings << QString("visible tiles          : %1").arg(renderer->visibleTiles.size());
+        settings << QString("wireframe (key x)      : %1").arg(renderWireframe);
+        settings << QString("elevation data (key e) : %1").arg((bool)renderer->configuration.tileProviders[OsmAnd::IMapRenderer::ElevationData]);
+        settings << QString("use atlases (key z)    : %1").arg(renderer->configuration.textureAtlasesAllowed);
+        settings << QString("DEM-patches# (keys y,h): %1").arg(renderer->configuration.heightmapPatchesPerSide);
+        settings << QString("adaptive DEM (key v)   : %1").arg(terrainLod.enabled);
+        if(terrainErrorProvider)
+        {
+            const auto& stats = terrainLod.getStats();
+            QStringList levels;
+            for(int level = 0; level < stats.tilesPerLevel.size(); level++)
+                levels << QString("%1:%2").arg(1 << level).arg(stats.tilesPerLevel[level]);
+            settings << QString("terrain LOD            : %1 vertices (%2 with per-tile levels), max error %3 px, tiles per patches# %4")
+                .arg(stats.vertices).arg(stats.perTileVertices).arg(stats.maxProjectedError, 0, 'f', 2).arg(levels.join(" "));
+        }
+        settings << QString("fog density (keys t,g) : %1").arg(renderer->configuration.fogDensity);
+        settings << QString("fog origin F (keys u,j): %1").arg(renderer->configuration.fogOriginFactor);
+        settings << QString("height scale (keys o,l): %1").arg(renderer->configuration.heightScaleFactor);
+        settings << QString("performance HUD (key p): %1").arg(hud.enabled);
+        settings << QString("prefetching (key c)    : %1").arg(prefetcher.enabled);
+        const auto uploadCounters = uploadScheduler->getCounters();
+        settings << QString("upload budget (key b)  : %1, %2 KB/frame, backlog %3 tiles").arg(uploadScheduler->enabled)
+            .arg(uploadCounters.budgetBytes / 1024).arg(uploadCounters.backlogTiles);
+        for(auto itCache = tilePackCaches.begin(); itCache != tilePackCaches.end(); ++itCache)
+        {
+            const auto counters = (*itCache)->getCounters();
+            settings << QString("%1 pack%2: %3 tiles, %4/%5 MB, %6 hits, %7 misses").arg(itCache.key(), -15).arg(tilesOffline ? " (offline)" : "")
+                .arg(counters.entries).arg(counters.liveBytes / (1024 * 1024)).arg(counters.fileBytes / (1024 * 1024))
+                .arg(counters.hits).arg(counters.misses);
+        }
+        for(auto itProvider = vectorProviders.begin(); itProvider != vectorProviders.end(); ++itProvider)
+        {
+            const auto counters = (*itProvider)->getCounters();
+            settings << QString("vector tiles           : %1 rasterized, %2 queued, %3 cancelled, last %4 ms")
+                .arg(counters.rasterized).arg(counters.pending).arg(counters.cancelled).arg(counters.lastRasterizeTime, 0, 'f', 1);
+        }
+
+        glColor3f(0.0f, 1.0f, 0.0f);
+        PerformanceHud::drawText(8, viewport.height() - 16, settings);
+        verifyOpenGL();
+    }
 
-    glRasterPos2f(8, 16 * 2);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("3 - Vector maps").toStdString().c_str());
+    QStringList providers;
+    providers << QString("Tile providers (holding alt controls overlay0):");
+    providers << QString("0 - disable");
+    providers << QString("1 - Mapnik");
+    providers << QString("2 - CycleMap");
+    providers << QString("3 - Vector maps");
+    providers << QString("4 - Hillshade");
+    providers << QString("5 - Contour lines");
+    glColor3f(0.0f, 1.0f, 0.0f);
+    PerformanceHud::drawText(8, 16 * 7, providers);
     verifyOpenGL();
+    hud.endFrame();
 
-    glRasterPos2f(8, 16 * 1);
-    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)QString("4 - Hillshade").toStdString().c_str());
-    verifyOpenGL();
-    
     glFlush();
     glutSwapBuffers();
 }
@@ -0,0 +1,626 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObfDelta.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QHash>
+#include <QPair>
+
+#include "ObfBlocks.h"
+
+namespace
+{
+    const quint32 DeltaMagic = 0x44464230; // "0BFD"
+    const quint32 FormatVersion = 1;
+    const qint64 ChunkSize = 1024 * 1024;
+
+    enum
+    {
+        OperationEnd = 0,
+        OperationCopy = 1,
+        OperationData = 2,
+    };
+
+    // Contiguous range of file: data block or whatever lies between blocks
+    struct Segment
+    {
+        qint64 offset;
+        qint64 length;
+        bool isBlock;
+        // Place of non-block segment in structure, e.g. "map:World:3"
+        QString key;
+    };
+
+    // 4 bytes of new file to overwrite after all operations
+    struct Fixup
+    {
+        qint64 position;
+        quint32 value;
+    };
+
+    struct Counters
+    {
+        Counters()
+            : copiedBlocks(0)
+            , literalBlocks(0)
+            , copiedBytes(0)
+            , literalBytes(0)
+        {
+        }
+
+        qint64 copiedBlocks;
+        qint64 literalBlocks;
+        qint64 copiedBytes;
+        qint64 literalBytes;
+    };
+
+    QByteArray checksum(QIODevice& device, QString& error)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        if(!device.seek(0))
+        {
+            error = "Failed to read file";
+            return QByteArray();
+        }
+        while(!device.atEnd())
+        {
+            const auto chunk = device.read(ChunkSize);
+            if(chunk.isEmpty())
+            {
+                error = "Failed to read file";
+                return QByteArray();
+            }
+            hash.addData(chunk);
+        }
+        return hash.result();
+    }
+
+    // Walks file as segments in order, blocks of map, routing and POI sections are separate
+    // segments, everything else is split only at block boundaries
+    bool readSegments(QFile& file, const std::function<bool (const Segment& segment)>& callback, QString& error)
+    {
+        std::vector<ObfBlocks::Section> sections;
+        if(!ObfBlocks::readStructure(file, sections, error))
+            return false;
+
+        QHash<QString, int> occurrences;
+        qint64 position = 0;
+        int topLevelGap = 0;
+        const auto emitGap = [&callback](qint64 offset, qint64 end, const QString& key)
+        {
+            if(end <= offset)
+                return true;
+            Segment segment;
+            segment.offset = offset;
+            segment.length = end - offset;
+            segment.isBlock = false;
+            segment.key = key;
+            return callback(segment);
+        };
+
+        for(auto itSection = sections.begin(); itSection != sections.end(); ++itSection)
+        {
+            const auto& section = *itSection;
+            if(!emitGap(position, section.offset, QString("top:%1").arg(topLevelGap++)))
+                return false;
+
+            const QString sectionKey = QString("%1:%2:%3").arg(section.field).arg(section.name)
+                .arg(occurrences[QString("%1:%2").arg(section.field).arg(section.name)]++);
+            ObfBlocks::SectionBlocks blocks;
+            QString sectionError;
+            if(section.type == ObfBlocks::SectionType::Other ||
+                !ObfBlocks::readSectionBlocks(file, section, blocks, sectionError))
+            {
+                blocks.blocks.clear();
+            }
+
+            qint64 gapStart = section.offset;
+            int gapIdx = 0;
+            for(auto itBlock = blocks.blocks.begin(); itBlock != blocks.blocks.end(); ++itBlock)
+            {
+                if(!emitGap(gapStart, itBlock->offset, QString("%1:%2").arg(sectionKey).arg(gapIdx++)))
+                    return false;
+                Segment segment;
+                segment.offset = itBlock->offset;
+                segment.length = itBlock->length;
+                segment.isBlock = true;
+                if(!callback(segment))
+                    return false;
+                gapStart = itBlock->offset + itBlock->length;
+            }
+            if(!emitGap(gapStart, section.end, QString("%1:%2").arg(sectionKey).arg(gapIdx)))
+                return false;
+            position = section.end;
+        }
+        return emitGap(position, file.size(), QString("top:%1").arg(topLevelGap));
+    }
+
+    QByteArray blockHash(QFile& file, const Segment& segment)
+    {
+        if(!file.seek(segment.offset))
+            return QByteArray();
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        qint64 left = segment.length;
+        while(left > 0)
+        {
+            const auto chunk = file.read(std::min(left, ChunkSize));
+            if(chunk.isEmpty())
+                return QByteArray();
+            hash.addData(chunk);
+            left -= chunk.size();
+        }
+        return hash.result();
+    }
+
+    // Streams operations to delta, adjacent copies and literals are merged
+    class OperationsWriter
+    {
+    public:
+        explicit OperationsWriter(QDataStream& stream)
+            : _stream(stream)
+            , _copyOffset(0)
+            , _copyLength(0)
+        {
+        }
+
+        void copy(qint64 offset, qint64 length)
+        {
+            flushData();
+            if(_copyLength > 0 && _copyOffset + _copyLength == offset)
+            {
+                _copyLength += length;
+                return;
+            }
+            flushCopy();
+            _copyOffset = offset;
+            _copyLength = length;
+        }
+
+        void data(const QByteArray& bytes)
+        {
+            flushCopy();
+            _data.append(bytes);
+            if(_data.size() >= ChunkSize)
+                flushData();
+        }
+
+        void finish()
+        {
+            flushCopy();
+            flushData();
+            _stream << static_cast<quint8>(OperationEnd);
+        }
+
+    private:
+        QDataStream& _stream;
+        qint64 _copyOffset;
+        qint64 _copyLength;
+        QByteArray _data;
+
+        void flushCopy()
+        {
+            if(_copyLength == 0)
+                return;
+            _stream << static_cast<quint8>(OperationCopy) << _copyOffset << _copyLength;
+            _copyLength = 0;
+        }
+
+        void flushData()
+        {
+            if(_data.isEmpty())
+                return;
+            _stream << static_cast<quint8>(OperationData) << _data;
+            _data.clear();
+        }
+    };
+
+    // Compares segment of new file with its counterpart in old one. Returns false if they differ
+    // too much for fixups to be worth it.
+    bool collectFixups(QFile& oldFile, qint64 oldOffset, QFile& newFile, const Segment& segment, std::vector<Fixup>& fixups)
+    {
+        const auto fixupsCount = fixups.size();
+        // Fixup costs 12 bytes in delta, beyond this literal copy is smaller
+        const auto maxFixups = static_cast<size_t>(segment.length / 24);
+        qint64 done = 0;
+        qint64 lastFixupEnd = -1;
+        while(done < segment.length)
+        {
+            const auto size = std::min(segment.length - done, ChunkSize);
+            if(!oldFile.seek(oldOffset + done) || !newFile.seek(segment.offset + done))
+                return false;
+            const auto oldChunk = oldFile.read(size);
+            const auto newChunk = newFile.read(size);
+            if(oldChunk.size() != size || newChunk.size() != size)
+                return false;
+            for(qint64 idx = 0; idx < size; idx++)
+            {
+                const auto position = segment.offset + done + idx;
+                if(oldChunk[static_cast<int>(idx)] == newChunk[static_cast<int>(idx)] || position < lastFixupEnd)
+                    continue;
+                // Word starting at first changed byte, kept inside of segment
+                const auto start = std::min(position, segment.offset + segment.length - 4);
+                Fixup fixup;
+                fixup.position = start;
+                fixup.value = 0;
+                if(!newFile.seek(start))
+                    return false;
+                if(!ObfBlocks::readFixed32(newFile, fixup.value))
+                    return false;
+                fixups.push_back(fixup);
+                lastFixupEnd = start + 4;
+                if(fixups.size() - fixupsCount > maxFixups)
+                {
+                    fixups.resize(fixupsCount);
+                    return false;
+                }
+            }
+            done += size;
+        }
+        return true;
+    }
+
+    bool writeLiteral(QFile& file, const Segment& segment, OperationsWriter& writer)
+    {
+        if(!file.seek(segment.offset))
+            return false;
+        qint64 left = segment.length;
+        while(left > 0)
+        {
+            const auto chunk = file.read(std::min(left, ChunkSize));
+            if(chunk.isEmpty())
+                return false;
+            writer.data(chunk);
+            left -= chunk.size();
+        }
+        return true;
+    }
+
+    bool checkFile(std::ostream& output, QFile& file, qint64 size, const QByteArray& expected, const char* what)
+    {
+        QString error;
+        if(file.size() != size || checksum(file, error) != expected)
+        {
+            output << what << " '" << file.fileName().toStdString() << "' does not match checksum of delta" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+ObfDelta::Configuration::Configuration()
+    : mode(Mode::None)
+    , verbose(false)
+{
+}
+
+bool ObfDelta::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg == "-diff")
+        {
+            cfg.mode = Configuration::Mode::Diff;
+        }
+        else if(arg == "-patch")
+        {
+            cfg.mode = Configuration::Mode::Patch;
+        }
+        else if(arg.startsWith("-old="))
+        {
+            cfg.oldFile = arg.mid(strlen("-old="));
+        }
+        else if(arg.startsWith("-new="))
+        {
+            cfg.newFile = arg.mid(strlen("-new="));
+        }
+        else if(arg.startsWith("-delta="))
+        {
+            cfg.deltaFile = arg.mid(strlen("-delta="));
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.output = arg.mid(strlen("-output="));
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else
+        {
+            error = "Unknown argument '" + arg + "'";
+            return false;
+        }
+    }
+    if(cfg.mode == Configuration::Mode::None)
+    {
+        error = "Either '-diff' or '-patch' is required";
+        return false;
+    }
+    if(cfg.oldFile.isEmpty() || !QFile::exists(cfg.oldFile))
+    {
+        error = "Old OBF file does not exist";
+        return false;
+    }
+    if(cfg.mode == Configuration::Mode::Diff && (cfg.newFile.isEmpty() || !QFile::exists(cfg.newFile)))
+    {
+        error = "New OBF file does not exist";
+        return false;
+    }
+    if(cfg.mode == Configuration::Mode::Patch && (cfg.deltaFile.isEmpty() || !QFile::exists(cfg.deltaFile)))
+    {
+        error = "Delta file does not exist";
+        return false;
+    }
+    if(cfg.output.isEmpty())
+    {
+        error = "Output file is required";
+        return false;
+    }
+    const auto outputPath = QFileInfo(cfg.output).absoluteFilePath();
+    if(outputPath == QFileInfo(cfg.oldFile).absoluteFilePath() ||
+        (!cfg.newFile.isEmpty() && outputPath == QFileInfo(cfg.newFile).absoluteFilePath()) ||
+        (!cfg.deltaFile.isEmpty() && outputPath == QFileInfo(cfg.deltaFile).absoluteFilePath()))
+    {
+        error = "Output has to differ from inputs";
+        return false;
+    }
+    return true;
+}
+
+bool ObfDelta::diff(std::ostream& output, const Configuration& cfg)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    QFile oldFile(cfg.oldFile);
+    QFile newFile(cfg.newFile);
+    if(!oldFile.open(QIODevice::ReadOnly) || !newFile.open(QIODevice::ReadOnly))
+    {
+        output << "Failed to open input files" << std::endl;
+        return false;
+    }
+    QString error;
+    const auto oldChecksum = checksum(oldFile, error);
+    const auto newChecksum = checksum(newFile, error);
+    if(oldChecksum.isEmpty() || newChecksum.isEmpty())
+    {
+        output << error.toStdString() << std::endl;
+        return false;
+    }
+
+    // Index of old file: blocks by contents, other segments by their place in structure
+    QHash<QByteArray, qint64> oldBlocks;
+    QHash<QString, QPair<qint64, qint64> > oldGaps;
+    const auto indexed = readSegments(oldFile, [&oldFile, &oldBlocks, &oldGaps](const Segment& segment)
+    {
+        if(!segment.isBlock)
+        {
+            oldGaps.insert(segment.key, qMakePair(segment.offset, segment.length));
+            return true;
+        }
+        const auto hash = blockHash(oldFile, segment);
+        if(hash.isEmpty())
+            return false;
+        if(!oldBlocks.contains(hash))
+            oldBlocks.insert(hash, segment.offset);
+        return true;
+    }, error);
+    if(!indexed)
+    {
+        output << "'" << cfg.oldFile.toStdString() << "': " << error.toStdString() << std::endl;
+        return false;
+    }
+
+    // Old output stays in place until delta is complete
+    QSaveFile deltaFile(cfg.output);
+    if(!deltaFile.open(QIODevice::WriteOnly))
+    {
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+    QDataStream stream(&deltaFile);
+    stream << DeltaMagic << FormatVersion;
+    stream << oldFile.size() << oldChecksum << newFile.size() << newChecksum;
+
+    OperationsWriter writer(stream);
+    std::vector<Fixup> fixups;
+    Counters counters;
+    const auto described = readSegments(newFile, [&](const Segment& segment)
+    {
+        if(segment.isBlock)
+        {
+            const auto hash = blockHash(newFile, segment);
+            if(hash.isEmpty())
+                return false;
+            const auto itOldBlock = oldBlocks.constFind(hash);
+            if(itOldBlock != oldBlocks.constEnd())
+            {
+                writer.copy(*itOldBlock, segment.length);
+                counters.copiedBlocks++;
+                counters.copiedBytes += segment.length;
+                return true;
+            }
+            counters.literalBlocks++;
+            counters.literalBytes += segment.length;
+            return writeLiteral(newFile, segment, writer);
+        }
+
+        const auto itOldGap = oldGaps.constFind(segment.key);
+        if(itOldGap != oldGaps.constEnd() && itOldGap->second == segment.length && segment.length >= 4 &&
+            collectFixups(oldFile, itOldGap->first, newFile, segment, fixups))
+        {
+            writer.copy(itOldGap->first, segment.length);
+            counters.copiedBytes += segment.length;
+            return true;
+        }
+        counters.literalBytes += segment.length;
+        return writeLiteral(newFile, segment, writer);
+    }, error);
+    if(!described)
+    {
+        output << "'" << cfg.newFile.toStdString() << "': " << error.toStdString() << std::endl;
+        deltaFile.cancelWriting();
+        return false;
+    }
+    writer.finish();
+
+    stream << static_cast<quint32>(fixups.size());
+    for(auto itFixup = fixups.begin(); itFixup != fixups.end(); ++itFixup)
+        stream << itFixup->position << itFixup->value;
+    if(stream.status() != QDataStream::Ok)
+    {
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        deltaFile.cancelWriting();
+        return false;
+    }
+    const auto deltaSize = deltaFile.size();
+    if(!deltaFile.commit())
+    {
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    output << "Written '" << cfg.output.toStdString() << "': " << deltaSize << " bytes for " << newFile.size()
+        << " bytes of new file (" << 100.0 * deltaSize / std::max<qint64>(1, newFile.size()) << "%) in "
+        << std::chrono::duration<double, std::milli>(finish - start).count() << " ms" << std::endl;
+    if(cfg.verbose)
+    {
+        output << "\tBlocks: " << counters.copiedBlocks << " copied from old file, " << counters.literalBlocks << " changed" << std::endl;
+        output << "\tBytes: " << counters.copiedBytes << " copied, " << counters.literalBytes << " literal" << std::endl;
+        output << "\tOffset fixups: " << fixups.size() << std::endl;
+    }
+    return true;
+}
+
+bool ObfDelta::patch(std::ostream& output, const Configuration& cfg)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    QFile oldFile(cfg.oldFile);
+    QFile deltaFile(cfg.deltaFile);
+    if(!oldFile.open(QIODevice::ReadOnly) || !deltaFile.open(QIODevice::ReadOnly))
+    {
+        output << "Failed to open input files" << std::endl;
+        return false;
+    }
+    QDataStream stream(&deltaFile);
+    quint32 magic, version;
+    stream >> magic >> version;
+    if(stream.status() != QDataStream::Ok || magic != DeltaMagic || version != FormatVersion)
+    {
+        output << "'" << cfg.deltaFile.toStdString() << "' is not OBF delta" << std::endl;
+        return false;
+    }
+    qint64 oldSize, newSize;
+    QByteArray oldChecksum, newChecksum;
+    stream >> oldSize >> oldChecksum >> newSize >> newChecksum;
+    if(!checkFile(output, oldFile, oldSize, oldChecksum, "Old file"))
+        return false;
+
+    const QString temporaryPath = cfg.output + ".tmp";
+    QFile outputFile(temporaryPath);
+    if(!outputFile.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        output << "Failed to write '" << temporaryPath.toStdString() << "'" << std::endl;
+        return false;
+    }
+    const auto fail = [&](const char* message)
+    {
+        output << message << std::endl;
+        outputFile.close();
+        QFile::remove(temporaryPath);
+        return false;
+    };
+
+    for(;;)
+    {
+        quint8 operation;
+        stream >> operation;
+        if(stream.status() != QDataStream::Ok)
+            return fail("Delta is truncated");
+        if(operation == OperationEnd)
+            break;
+        if(operation == OperationCopy)
+        {
+            qint64 offset, length;
+            stream >> offset >> length;
+            if(stream.status() != QDataStream::Ok || offset < 0 || length < 0 || offset + length > oldFile.size() ||
+                !ObfBlocks::copyRange(oldFile, offset, outputFile, outputFile.pos(), length))
+                return fail("Failed to copy from old file");
+        }
+        else if(operation == OperationData)
+        {
+            QByteArray data;
+            stream >> data;
+            if(stream.status() != QDataStream::Ok || outputFile.write(data) != data.size())
+                return fail("Failed to write literal data");
+        }
+        else
+        {
+            return fail("Delta has unknown operation");
+        }
+    }
+
+    quint32 fixupsCount;
+    stream >> fixupsCount;
+    for(quint32 idx = 0; idx < fixupsCount; idx++)
+    {
+        Fixup fixup;
+        stream >> fixup.position >> fixup.value;
+        if(stream.status() != QDataStream::Ok || fixup.position < 0 || fixup.position + 4 > outputFile.size() ||
+            !outputFile.seek(fixup.position) || !ObfBlocks::writeFixed32(outputFile, fixup.value))
+            return fail("Failed to apply offset fixup");
+    }
+
+    if(!checkFile(output, outputFile, newSize, newChecksum, "Patched file"))
+    {
+        outputFile.close();
+        QFile::remove(temporaryPath);
+        return false;
+    }
+    outputFile.close();
+    // Patched file is read back for checksum, so it can't be written through QSaveFile
+    if(!ObfBlocks::replaceFile(temporaryPath, cfg.output))
+    {
+        QFile::remove(temporaryPath);
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    output << "Written '" << cfg.output.toStdString() << "' (" << newSize << " bytes, " << fixupsCount
+        << " offset fixups) in " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms" << std::endl;
+    return true;
+}
@@ -0,0 +1,66 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBF_DELTA_H_
+#define __OBF_DELTA_H_
+
+#include <ostream>
+
+#include <QString>
+#include <QStringList>
+
+// Delta between two versions of OBF. New file is described as sequence of operations: copy of
+// range of old file or literal bytes. Data blocks are matched by contents wherever they moved to,
+// the rest of sections (headers, box trees) is matched by its place in structure and copied if
+// it differs only in few words, those words are then listed in offset-fixup table. Delta carries
+// size and SHA-1 of both files, patch is applied only to the right old file and its result is
+// checked before it replaces anything.
+namespace ObfDelta
+{
+    struct Configuration
+    {
+        Configuration();
+
+        enum class Mode
+        {
+            None,
+            Diff,
+            Patch,
+        };
+        Mode mode;
+        QString oldFile;
+        QString newFile;
+        QString deltaFile;
+        QString output;
+        bool verbose;
+    };
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Writes delta that turns oldFile into newFile
+    bool diff(std::ostream& output, const Configuration& cfg);
+
+    // Rebuilds new file from oldFile and deltaFile into output
+    bool patch(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __OBF_DELTA_H_
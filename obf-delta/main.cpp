@@ -0,0 +1,76 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <memory>
+#if (defined(UNICODE) || defined(_UNICODE)) && defined(_WIN32)
+#   include <io.h>
+#   include <fcntl.h>
+#endif
+
+#include <QFile>
+#include <QStringList>
+
+#include "ObfDelta.h"
+
+void printUsage(const std::string& warning = std::string());
+int main(int argc, char* argv[])
+{
+#if defined(UNICODE) || defined(_UNICODE)
+#   if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_U16TEXT);
+#   else
+    std::locale::global(std::locale(""));
+#   endif
+#endif
+    ObfDelta::Configuration cfg;
+
+    QString error;
+    QStringList args;
+    for (int idx = 1; idx < argc; idx++)
+        args.push_back(argv[idx]);
+
+    if(!ObfDelta::parseCommandLineArguments(args, cfg, error))
+    {
+        printUsage(error.toStdString());
+        return -1;
+    }
+    if(cfg.mode == ObfDelta::Configuration::Mode::Diff)
+        return ObfDelta::diff(std::cout, cfg) ? 0 : -1;
+    return ObfDelta::patch(std::cout, cfg) ? 0 : -1;
+}
+
+void printUsage(const std::string& warning)
+{
+    if(!warning.empty())
+        std::cout << warning << std::endl;
+    std::cout << "Delta is console utility that updates OsmAnd binary index by changed blocks only." << std::endl;
+    std::cout << std::endl << "Usage: delta -diff -old=path -new=path -output=path/to/delta [-verbose]" << std::endl;
+    std::cout << "       delta -patch -old=path -delta=path -output=path" << std::endl;
+    std::cout << "\tDiff matches data blocks of new file with identical blocks of old one wherever they are, other" << std::endl;
+    std::cout << "\tparts are copied from old file with offset fixups or included as they are." << std::endl;
+    std::cout << "\tPatch checks old file against checksum stored in delta and writes output only if rebuilt file" << std::endl;
+    std::cout << "\tmatches checksum of new one." << std::endl;
+}
@@ -0,0 +1,899 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObfExtract.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <OsmAndCore/Utilities.h>
+
+#include "ObfBlocks.h"
+
+namespace
+{
+    // Shift written to output before block it points to, patched once block is copied
+    struct PendingShift
+    {
+        qint64 inputTarget;
+        qint64 outputPosition;
+        qint64 outputBase;
+        qint64 outputTarget;
+
+        bool operator<(const PendingShift& other) const
+        {
+            return inputTarget < other.inputTarget;
+        }
+    };
+
+    // Message whose length is known only after its contents are written
+    struct Container
+    {
+        qint64 start;
+        qint64 lengthPosition;
+        qint64 contentStart;
+        int wireType;
+    };
+
+    struct Counters
+    {
+        Counters()
+            : keptBlocks(0)
+            , keptBytes(0)
+        {
+        }
+
+        qint64 keptBlocks;
+        qint64 keptBytes;
+    };
+
+    bool segmentsIntersect(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy)
+    {
+        const auto cross = [](double ox, double oy, double px, double py, double qx, double qy)
+        {
+            return (px - ox) * (qy - oy) - (py - oy) * (qx - ox);
+        };
+        const auto d1 = cross(cx, cy, dx, dy, ax, ay);
+        const auto d2 = cross(cx, cy, dx, dy, bx, by);
+        const auto d3 = cross(ax, ay, bx, by, cx, cy);
+        const auto d4 = cross(ax, ay, bx, by, dx, dy);
+        return ((d1 > 0) != (d2 > 0) || d1 == 0 || d2 == 0) && ((d3 > 0) != (d4 > 0) || d3 == 0 || d4 == 0);
+    }
+
+    bool ringContains(const std::vector<OsmAnd::PointI>& ring, double x, double y)
+    {
+        bool inside = false;
+        for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+        {
+            const double xi = ring[i].x, yi = ring[i].y;
+            const double xj = ring[j].x, yj = ring[j].y;
+            if((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi)
+                inside = !inside;
+        }
+        return inside;
+    }
+
+    inline bool bboxesIntersect(const OsmAnd::AreaI& a, const OsmAnd::AreaI& b)
+    {
+        return !(a.right < b.left || b.right < a.left || a.bottom < b.top || b.bottom < a.top);
+    }
+
+    class Extractor
+    {
+    public:
+        Extractor(std::ostream& log, const ObfExtract::Configuration& cfg, QFile& input, QFileDevice& output)
+            : _log(log)
+            , _cfg(cfg)
+            , _input(input)
+            , _output(output)
+        {
+        }
+
+        bool extract();
+
+    private:
+        std::ostream& _log;
+        const ObfExtract::Configuration& _cfg;
+        QFile& _input;
+        QFileDevice& _output;
+        // Shifts of map level or section being written
+        std::vector<PendingShift> _shifts;
+        Counters _counters;
+
+        bool copyField(qint64 tagOffset);
+        bool beginContainer(int field, int wireType, Container& container);
+        bool endContainer(const Container& container);
+        void rewind(const Container& container, size_t shiftsCount);
+        bool addShift(qint64 tagOffset, qint64 inputBase, qint64 outputBase);
+
+        bool copyBox(int field, int wireType, const OsmAnd::AreaI& parent, int shiftField, int boxesField, bool& kept);
+        bool copyPoiBox(int field, int wireType, uint32_t parentX, uint32_t parentY, uint32_t parentZoom,
+            qint64 inputBase, qint64 outputBase, bool& kept);
+        bool copyBlocks(qint64 contentStart, qint64 end, int blockField);
+
+        bool copyMapSection(const ObfBlocks::Section& section);
+        bool copyMapLevel(int field, int wireType);
+        bool copyRoutingSection(const ObfBlocks::Section& section);
+        bool copyPoiSection(const ObfBlocks::Section& section);
+        bool copySection(const ObfBlocks::Section& section, bool& kept);
+    };
+
+    bool Extractor::copyField(qint64 tagOffset)
+    {
+        int field, wireType;
+        if(!_input.seek(tagOffset) || !ObfBlocks::readTag(_input, field, wireType) || !ObfBlocks::skipField(_input, wireType))
+            return false;
+        const auto end = _input.pos();
+        return ObfBlocks::copyRange(_input, tagOffset, _output, _output.pos(), end - tagOffset);
+    }
+
+    // Varint length is reserved as 5 padded bytes, protobuf readers accept such encoding
+    bool Extractor::beginContainer(int field, int wireType, Container& container)
+    {
+        container.start = _output.pos();
+        container.wireType = wireType;
+        if(!ObfBlocks::writeVarint(_output, (static_cast<uint64_t>(field) << 3) | wireType))
+            return false;
+        container.lengthPosition = _output.pos();
+        const char placeholder[5] = { 0, 0, 0, 0, 0 };
+        const int size = wireType == ObfBlocks::WireFixed32LengthDelimited ? 4 : 5;
+        if(_output.write(placeholder, size) != size)
+            return false;
+        container.contentStart = _output.pos();
+        return true;
+    }
+
+    bool Extractor::endContainer(const Container& container)
+    {
+        const auto end = _output.pos();
+        const auto length = end - container.contentStart;
+        if(!_output.seek(container.lengthPosition))
+            return false;
+        if(container.wireType == ObfBlocks::WireFixed32LengthDelimited)
+        {
+            if(length > std::numeric_limits<uint32_t>::max() || !ObfBlocks::writeFixed32(_output, static_cast<uint32_t>(length)))
+                return false;
+        }
+        else
+        {
+            char bytes[5];
+            for(int i = 0; i < 5; i++)
+                bytes[i] = static_cast<char>(((length >> (7 * i)) & 0x7F) | (i < 4 ? 0x80 : 0));
+            if(_output.write(bytes, 5) != 5)
+                return false;
+        }
+        return _output.seek(end);
+    }
+
+    // Drops what was written for container, following writes overwrite it
+    void Extractor::rewind(const Container& container, size_t shiftsCount)
+    {
+        _output.seek(container.start);
+        _shifts.resize(shiftsCount);
+    }
+
+    // Tag of shift field was just read, it is copied and value is replaced by placeholder
+    bool Extractor::addShift(qint64 tagOffset, qint64 inputBase, qint64 outputBase)
+    {
+        const auto valueOffset = _input.pos();
+        uint32_t value;
+        if(!ObfBlocks::copyRange(_input, tagOffset, _output, _output.pos(), valueOffset - tagOffset) ||
+            !ObfBlocks::readFixed32(_input, value))
+            return false;
+        PendingShift shift;
+        shift.inputTarget = inputBase + value;
+        shift.outputPosition = _output.pos();
+        shift.outputBase = outputBase;
+        shift.outputTarget = -1;
+        _shifts.push_back(shift);
+        return ObfBlocks::writeFixed32(_output, 0);
+    }
+
+    // Map and routing box: bounds relative to parent are copied as they are, since parents are kept
+    bool Extractor::copyBox(int field, int wireType, const OsmAnd::AreaI& parent, int shiftField, int boxesField, bool& kept)
+    {
+        kept = false;
+        qint64 length;
+        if(!ObfBlocks::readLength(_input, wireType, length))
+            return false;
+        const auto inputBase = _input.pos();
+        const auto end = inputBase + length;
+        const auto shiftsCount = _shifts.size();
+        Container box;
+        if(!beginContainer(field, wireType, box))
+            return false;
+
+        OsmAnd::AreaI bbox31 = parent;
+        bool boundsChecked = false;
+        bool hasContent = false;
+        while(_input.pos() < end)
+        {
+            const auto fieldOffset = _input.pos();
+            int boxField, boxWireType;
+            if(!ObfBlocks::readTag(_input, boxField, boxWireType))
+                return false;
+            if(boxField >= 1 && boxField <= 4 && boxWireType == ObfBlocks::WireVarint)
+            {
+                uint64_t value;
+                if(!ObfBlocks::readVarint(_input, value))
+                    return false;
+                const auto delta = ObfBlocks::decodeZigZag(value);
+                if(boxField == 1)
+                    bbox31.left = parent.left + delta;
+                else if(boxField == 2)
+                    bbox31.right = parent.right + delta;
+                else if(boxField == 3)
+                    bbox31.top = parent.top + delta;
+                else
+                    bbox31.bottom = parent.bottom + delta;
+                if(!copyField(fieldOffset))
+                    return false;
+                continue;
+            }
+            if(!boundsChecked)
+            {
+                boundsChecked = true;
+                if(!_cfg.area.intersects(bbox31))
+                    break;
+            }
+            if(boxField == shiftField && boxWireType == ObfBlocks::WireFixed32)
+            {
+                if(!addShift(fieldOffset, inputBase, box.contentStart))
+                    return false;
+                hasContent = true;
+            }
+            else if(boxField == boxesField && ObfBlocks::isLengthDelimited(boxWireType))
+            {
+                bool childKept;
+                if(!copyBox(boxField, boxWireType, bbox31, shiftField, boxesField, childKept))
+                    return false;
+                hasContent = hasContent || childKept;
+            }
+            else if(!copyField(fieldOffset))
+            {
+                return false;
+            }
+        }
+
+        if(!hasContent)
+        {
+            rewind(box, shiftsCount);
+            return _input.seek(end);
+        }
+        kept = true;
+        return endContainer(box);
+    }
+
+    // POI box: tile relative to parent tile, shift relative to section contents
+    bool Extractor::copyPoiBox(int field, int wireType, uint32_t parentX, uint32_t parentY, uint32_t parentZoom,
+        qint64 inputBase, qint64 outputBase, bool& kept)
+    {
+        kept = false;
+        qint64 length;
+        if(!ObfBlocks::readLength(_input, wireType, length))
+            return false;
+        const auto end = _input.pos() + length;
+        const auto shiftsCount = _shifts.size();
+        Container box;
+        if(!beginContainer(field, wireType, box))
+            return false;
+
+        uint32_t zoom = parentZoom;
+        int32_t left = 0, top = 0;
+        uint32_t x = 0, y = 0;
+        bool boundsChecked = false;
+        bool hasContent = false;
+        while(_input.pos() < end)
+        {
+            const auto fieldOffset = _input.pos();
+            int boxField, boxWireType;
+            if(!ObfBlocks::readTag(_input, boxField, boxWireType))
+                return false;
+            if(boxField >= 1 && boxField <= 3 && boxWireType == ObfBlocks::WireVarint)
+            {
+                uint64_t value;
+                if(!ObfBlocks::readVarint(_input, value))
+                    return false;
+                if(boxField == 1)
+                    zoom = static_cast<uint32_t>(value);
+                else if(boxField == 2)
+                    left = ObfBlocks::decodeZigZag(value);
+                else
+                    top = ObfBlocks::decodeZigZag(value);
+                if(!copyField(fieldOffset))
+                    return false;
+                continue;
+            }
+            if(!boundsChecked)
+            {
+                boundsChecked = true;
+                if(zoom < parentZoom || zoom > 31)
+                    return false;
+                x = (parentX << (zoom - parentZoom)) + left;
+                y = (parentY << (zoom - parentZoom)) + top;
+                const auto shift = 31 - zoom;
+                OsmAnd::AreaI bbox31;
+                bbox31.left = static_cast<int32_t>(x << shift);
+                bbox31.top = static_cast<int32_t>(y << shift);
+                bbox31.right = static_cast<int32_t>(((x + 1) << shift) - 1);
+                bbox31.bottom = static_cast<int32_t>(((y + 1) << shift) - 1);
+                if(!_cfg.area.intersects(bbox31))
+                    break;
+            }
+            if(boxField == ObfBlocks::PoiBoxShiftToData && boxWireType == ObfBlocks::WireFixed32)
+            {
+                if(!addShift(fieldOffset, inputBase, outputBase))
+                    return false;
+                hasContent = true;
+            }
+            else if(boxField == ObfBlocks::PoiBoxSubBoxes && ObfBlocks::isLengthDelimited(boxWireType))
+            {
+                bool childKept;
+                if(!copyPoiBox(boxField, boxWireType, x, y, zoom, inputBase, outputBase, childKept))
+                    return false;
+                hasContent = hasContent || childKept;
+            }
+            else if(!copyField(fieldOffset))
+            {
+                return false;
+            }
+        }
+
+        if(!hasContent)
+        {
+            rewind(box, shiftsCount);
+            return _input.seek(end);
+        }
+        kept = true;
+        return endContainer(box);
+    }
+
+    // Second pass over container: blocks targeted by kept shifts are copied, then shifts are patched
+    bool Extractor::copyBlocks(qint64 contentStart, qint64 end, int blockField)
+    {
+        std::sort(_shifts.begin(), _shifts.end());
+        if(!_input.seek(contentStart))
+            return false;
+        while(_input.pos() < end)
+        {
+            const auto tagOffset = _input.pos();
+            int field, wireType;
+            if(!ObfBlocks::readTag(_input, field, wireType))
+                return false;
+            if(field != blockField || !ObfBlocks::isLengthDelimited(wireType))
+            {
+                if(!ObfBlocks::skipField(_input, wireType))
+                    return false;
+                continue;
+            }
+            qint64 length;
+            if(!ObfBlocks::readLength(_input, wireType, length))
+                return false;
+            const auto blockEnd = _input.pos() + length;
+
+            PendingShift key;
+            key.inputTarget = tagOffset;
+            auto itShift = std::lower_bound(_shifts.begin(), _shifts.end(), key);
+            if(itShift == _shifts.end() || itShift->inputTarget >= blockEnd)
+            {
+                if(!_input.seek(blockEnd))
+                    return false;
+                continue;
+            }
+            const auto outputOffset = _output.pos();
+            if(!ObfBlocks::copyRange(_input, tagOffset, _output, outputOffset, blockEnd - tagOffset))
+                return false;
+            for(; itShift != _shifts.end() && itShift->inputTarget < blockEnd; ++itShift)
+                itShift->outputTarget = outputOffset + (itShift->inputTarget - tagOffset);
+            _counters.keptBlocks++;
+            _counters.keptBytes += blockEnd - tagOffset;
+        }
+
+        const auto outputEnd = _output.pos();
+        for(auto itShift = _shifts.begin(); itShift != _shifts.end(); ++itShift)
+        {
+            if(itShift->outputTarget < 0)
+            {
+                _log << "Shift at " << itShift->inputTarget << " points outside of data blocks" << std::endl;
+                return false;
+            }
+            const auto value = itShift->outputTarget - itShift->outputBase;
+            if(value < 0 || value > std::numeric_limits<uint32_t>::max() ||
+                !_output.seek(itShift->outputPosition) || !ObfBlocks::writeFixed32(_output, static_cast<uint32_t>(value)))
+                return false;
+        }
+        _shifts.clear();
+        return _output.seek(outputEnd);
+    }
+
+    bool Extractor::copyMapLevel(int field, int wireType)
+    {
+        qint64 length;
+        if(!ObfBlocks::readLength(_input, wireType, length))
+            return false;
+        const auto contentStart = _input.pos();
+        const auto end = contentStart + length;
+        Container level;
+        if(!beginContainer(field, wireType, level))
+            return false;
+
+        OsmAnd::AreaI bbox31;
+        bbox31.left = bbox31.right = bbox31.top = bbox31.bottom = 0;
+        while(_input.pos() < end)
+        {
+            const auto tagOffset = _input.pos();
+            int levelField, levelWireType;
+            if(!ObfBlocks::readTag(_input, levelField, levelWireType))
+                return false;
+            if(levelField >= ObfBlocks::MapLevelLeft && levelField <= ObfBlocks::MapLevelBottom && levelWireType == ObfBlocks::WireVarint)
+            {
+                uint64_t value;
+                if(!ObfBlocks::readVarint(_input, value))
+                    return false;
+                const auto coordinate = static_cast<int32_t>(value);
+                if(levelField == ObfBlocks::MapLevelLeft)
+                    bbox31.left = coordinate;
+                else if(levelField == ObfBlocks::MapLevelRight)
+                    bbox31.right = coordinate;
+                else if(levelField == ObfBlocks::MapLevelTop)
+                    bbox31.top = coordinate;
+                else
+                    bbox31.bottom = coordinate;
+                if(!copyField(tagOffset))
+                    return false;
+            }
+            else if(levelField == ObfBlocks::MapLevelBoxes && ObfBlocks::isLengthDelimited(levelWireType))
+            {
+                bool kept;
+                if(!copyBox(levelField, levelWireType, bbox31, ObfBlocks::MapBoxShiftToData, ObfBlocks::MapBoxBoxes, kept))
+                    return false;
+            }
+            else if(levelField == ObfBlocks::MapLevelBlocks)
+            {
+                if(!ObfBlocks::skipField(_input, levelWireType))
+                    return false;
+            }
+            else if(!copyField(tagOffset))
+            {
+                return false;
+            }
+        }
+
+        // Level without boxes in area is left out
+        if(_shifts.empty())
+        {
+            rewind(level, 0);
+            return _input.seek(end);
+        }
+        if(!copyBlocks(contentStart, end, ObfBlocks::MapLevelBlocks))
+            return false;
+        return endContainer(level) && _input.seek(end);
+    }
+
+    bool Extractor::copyMapSection(const ObfBlocks::Section& section)
+    {
+        while(_input.pos() < section.end)
+        {
+            const auto tagOffset = _input.pos();
+            int field, wireType;
+            if(!ObfBlocks::readTag(_input, field, wireType))
+                return false;
+            if(field == ObfBlocks::MapIndexLevels && ObfBlocks::isLengthDelimited(wireType))
+            {
+                if(!copyMapLevel(field, wireType))
+                    return false;
+            }
+            else if(!copyField(tagOffset))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Extractor::copyRoutingSection(const ObfBlocks::Section& section)
+    {
+        while(_input.pos() < section.end)
+        {
+            const auto tagOffset = _input.pos();
+            int field, wireType;
+            if(!ObfBlocks::readTag(_input, field, wireType))
+                return false;
+            if((field == ObfBlocks::RoutingIndexRootBoxes || field == ObfBlocks::RoutingIndexBasemapBoxes) &&
+                ObfBlocks::isLengthDelimited(wireType))
+            {
+                // Root boxes have no parent, so their deltas are absolute
+                OsmAnd::AreaI origin;
+                origin.left = origin.right = origin.top = origin.bottom = 0;
+                bool kept;
+                if(!copyBox(field, wireType, origin, ObfBlocks::RouteBoxShiftToData, ObfBlocks::RouteBoxBoxes, kept))
+                    return false;
+            }
+            else if(field == ObfBlocks::RoutingIndexBlocks)
+            {
+                if(!ObfBlocks::skipField(_input, wireType))
+                    return false;
+            }
+            else if(!copyField(tagOffset))
+            {
+                return false;
+            }
+        }
+        if(_shifts.empty())
+            return true;
+        return copyBlocks(section.contentOffset, section.end, ObfBlocks::RoutingIndexBlocks);
+    }
+
+    bool Extractor::copyPoiSection(const ObfBlocks::Section& section)
+    {
+        // Section contents start right after length written by copySection
+        const auto outputBase = _output.pos();
+        bool nameIndexSkipped = false;
+        while(_input.pos() < section.end)
+        {
+            const auto tagOffset = _input.pos();
+            int field, wireType;
+            if(!ObfBlocks::readTag(_input, field, wireType))
+                return false;
+            if(field == ObfBlocks::PoiIndexBoxes && ObfBlocks::isLengthDelimited(wireType))
+            {
+                bool kept;
+                if(!copyPoiBox(field, wireType, 0, 0, 0, section.contentOffset, outputBase, kept))
+                    return false;
+            }
+            else if(field == ObfBlocks::PoiIndexData || field == ObfBlocks::PoiIndexNameIndex)
+            {
+                // Name index refers to blocks of whole section from string table with its own
+                // offsets, it is left out rather than rebuilt
+                nameIndexSkipped = nameIndexSkipped || field == ObfBlocks::PoiIndexNameIndex;
+                if(!ObfBlocks::skipField(_input, wireType))
+                    return false;
+            }
+            else if(!copyField(tagOffset))
+            {
+                return false;
+            }
+        }
+        if(nameIndexSkipped && _cfg.verbose)
+            _log << "\tPOI name index of '" << section.name.toStdString() << "' is left out" << std::endl;
+        if(_shifts.empty())
+            return true;
+        return copyBlocks(section.contentOffset, section.end, ObfBlocks::PoiIndexData);
+    }
+
+    bool Extractor::copySection(const ObfBlocks::Section& section, bool& kept)
+    {
+        kept = false;
+        const auto keptBlocks = _counters.keptBlocks;
+        Container container;
+        if(!_input.seek(section.contentOffset) || !beginContainer(section.field, section.wireType, container))
+            return false;
+
+        bool ok = false;
+        if(section.type == ObfBlocks::SectionType::Map)
+            ok = copyMapSection(section);
+        else if(section.type == ObfBlocks::SectionType::Routing)
+            ok = copyRoutingSection(section);
+        else if(section.type == ObfBlocks::SectionType::Poi)
+            ok = copyPoiSection(section);
+        if(!ok)
+        {
+            _log << "Broken " << ObfBlocks::sectionTypeName(section.type) << " section '" << section.name.toStdString()
+                << "' at " << section.offset << std::endl;
+            return false;
+        }
+
+        // Section with no data in area would be just an empty shell
+        if(_counters.keptBlocks == keptBlocks)
+        {
+            rewind(container, 0);
+            return true;
+        }
+        kept = true;
+        return endContainer(container);
+    }
+
+    bool Extractor::extract()
+    {
+        QString error;
+        std::vector<ObfBlocks::Section> sections;
+        if(!ObfBlocks::readStructure(_input, sections, error))
+        {
+            _log << error.toStdString() << std::endl;
+            return false;
+        }
+
+        // Fields between sections are version, creation date and version confirmation
+        qint64 position = 0;
+        auto itSection = sections.begin();
+        while(position < _input.size())
+        {
+            if(itSection != sections.end() && itSection->offset == position)
+            {
+                const auto& section = *itSection;
+                if(section.type == ObfBlocks::SectionType::Other)
+                {
+                    _log << "Left out section #" << section.field << " at " << section.offset << std::endl;
+                }
+                else
+                {
+                    const auto keptBlocks = _counters.keptBlocks;
+                    const auto keptBytes = _counters.keptBytes;
+                    bool kept;
+                    if(!copySection(section, kept))
+                        return false;
+                    if(kept)
+                    {
+                        _log << "Extracted " << ObfBlocks::sectionTypeName(section.type) << " section '" << section.name.toStdString()
+                            << "': " << (_counters.keptBlocks - keptBlocks) << " blocks, " << (_counters.keptBytes - keptBytes)
+                            << " bytes" << std::endl;
+                    }
+                    else
+                    {
+                        _log << "Left out " << ObfBlocks::sectionTypeName(section.type) << " section '" << section.name.toStdString()
+                            << "': no data in area" << std::endl;
+                    }
+                }
+                position = section.end;
+                ++itSection;
+                continue;
+            }
+            if(!_input.seek(position) || !copyField(position))
+                return false;
+            position = _input.pos();
+        }
+        return _output.resize(_output.pos());
+    }
+}
+
+ObfExtract::Area::Area()
+{
+    bbox31.left = bbox31.top = 0;
+    bbox31.right = bbox31.bottom = std::numeric_limits<int32_t>::max();
+}
+
+bool ObfExtract::Area::intersects(const OsmAnd::AreaI& box) const
+{
+    if(!bboxesIntersect(bbox31, box))
+        return false;
+    if(rings.empty())
+        return true;
+
+    const double left = box.left, right = box.right, top = box.top, bottom = box.bottom;
+    for(auto itRing = rings.begin(); itRing != rings.end(); ++itRing)
+    {
+        const auto& ring = *itRing;
+        if(ring.size() < 3)
+            continue;
+        // Box inside polygon
+        if(ringContains(ring, (left + right) / 2, (top + bottom) / 2))
+            return true;
+        for(size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+        {
+            const double ax = ring[j].x, ay = ring[j].y;
+            const double bx = ring[i].x, by = ring[i].y;
+            // Polygon vertex inside box
+            if(bx >= left && bx <= right && by >= top && by <= bottom)
+                return true;
+            // Polygon edge crossing box edge
+            if(segmentsIntersect(ax, ay, bx, by, left, top, right, top) ||
+                segmentsIntersect(ax, ay, bx, by, right, top, right, bottom) ||
+                segmentsIntersect(ax, ay, bx, by, right, bottom, left, bottom) ||
+                segmentsIntersect(ax, ay, bx, by, left, bottom, left, top))
+                return true;
+        }
+    }
+    return false;
+}
+
+ObfExtract::Configuration::Configuration()
+    : verbose(false)
+{
+}
+
+bool ObfExtract::loadPolygon(const QString& path, Area& area, QString& error)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        error = "Failed to open polygon '" + path + "'";
+        return false;
+    }
+
+    // Osmosis format: name, then rings of "lon lat" lines each closed by END, holes start with '!'
+    area.rings.clear();
+    std::vector<OsmAnd::PointI> ring;
+    bool inRing = false;
+    bool isHole = false;
+    bool nameRead = false;
+    while(!file.atEnd())
+    {
+        const auto line = QString::fromUtf8(file.readLine()).trimmed();
+        if(line.isEmpty())
+            continue;
+        if(!nameRead)
+        {
+            nameRead = true;
+            continue;
+        }
+        if(!inRing)
+        {
+            if(line == "END")
+                break;
+            inRing = true;
+            isHole = line.startsWith("!");
+            ring.clear();
+            continue;
+        }
+        if(line == "END")
+        {
+            // Holes can only make area smaller, keeping them out only keeps a bit more data
+            if(!isHole && ring.size() >= 3)
+                area.rings.push_back(ring);
+            inRing = false;
+            continue;
+        }
+        const auto values = line.split(' ', QString::SkipEmptyParts);
+        bool okLon = false, okLat = false;
+        const auto lon = values.size() == 2 ? values[0].toDouble(&okLon) : 0.0;
+        const auto lat = values.size() == 2 ? values[1].toDouble(&okLat) : 0.0;
+        if(!okLon || !okLat)
+        {
+            error = "Invalid polygon line '" + line + "'";
+            return false;
+        }
+        OsmAnd::PointI point;
+        point.x = OsmAnd::Utilities::get31TileNumberX(lon);
+        point.y = OsmAnd::Utilities::get31TileNumberY(lat);
+        ring.push_back(point);
+    }
+    if(area.rings.empty())
+    {
+        error = "Polygon '" + path + "' has no rings";
+        return false;
+    }
+
+    area.bbox31.left = area.bbox31.top = std::numeric_limits<int32_t>::max();
+    area.bbox31.right = area.bbox31.bottom = 0;
+    for(auto itRing = area.rings.begin(); itRing != area.rings.end(); ++itRing)
+    {
+        for(auto itPoint = itRing->begin(); itPoint != itRing->end(); ++itPoint)
+        {
+            area.bbox31.left = std::min(area.bbox31.left, itPoint->x);
+            area.bbox31.right = std::max(area.bbox31.right, itPoint->x);
+            area.bbox31.top = std::min(area.bbox31.top, itPoint->y);
+            area.bbox31.bottom = std::max(area.bbox31.bottom, itPoint->y);
+        }
+    }
+    return true;
+}
+
+bool ObfExtract::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    bool wasAreaSpecified = false;
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-obf="))
+        {
+            cfg.input = arg.mid(strlen("-obf="));
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.output = arg.mid(strlen("-output="));
+        }
+        else if(arg.startsWith("-bbox="))
+        {
+            auto values = arg.mid(strlen("-bbox=")).split(",");
+            if(values.size() != 4)
+            {
+                error = "Invalid bbox '" + arg.mid(strlen("-bbox=")) + "'";
+                return false;
+            }
+            cfg.area.bbox31.left = OsmAnd::Utilities::get31TileNumberX(values[0].toDouble());
+            cfg.area.bbox31.top = OsmAnd::Utilities::get31TileNumberY(values[1].toDouble());
+            cfg.area.bbox31.right = OsmAnd::Utilities::get31TileNumberX(values[2].toDouble());
+            cfg.area.bbox31.bottom = OsmAnd::Utilities::get31TileNumberY(values[3].toDouble());
+            cfg.area.rings.clear();
+            wasAreaSpecified = true;
+        }
+        else if(arg.startsWith("-poly="))
+        {
+            if(!loadPolygon(arg.mid(strlen("-poly=")), cfg.area, error))
+                return false;
+            wasAreaSpecified = true;
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else
+        {
+            error = "Unknown argument '" + arg + "'";
+            return false;
+        }
+    }
+    if(cfg.input.isEmpty() || !QFile::exists(cfg.input))
+    {
+        error = "Input OBF file does not exist";
+        return false;
+    }
+    if(cfg.output.isEmpty())
+    {
+        error = "Output OBF file is required";
+        return false;
+    }
+    if(QFileInfo(cfg.input).absoluteFilePath() == QFileInfo(cfg.output).absoluteFilePath())
+    {
+        error = "Output has to differ from input";
+        return false;
+    }
+    if(!wasAreaSpecified)
+    {
+        error = "Either bbox or polygon is required";
+        return false;
+    }
+    return true;
+}
+
+bool ObfExtract::extract(std::ostream& output, const Configuration& cfg)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    QFile inputFile(cfg.input);
+    if(!inputFile.open(QIODevice::ReadOnly))
+    {
+        output << "Failed to open '" << cfg.input.toStdString() << "'" << std::endl;
+        return false;
+    }
+    // Old output stays in place until extract is complete
+    QSaveFile outputFile(cfg.output);
+    if(!outputFile.open(QIODevice::WriteOnly))
+    {
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+
+    Extractor extractor(output, cfg, inputFile, outputFile);
+    if(!extractor.extract())
+    {
+        outputFile.cancelWriting();
+        return false;
+    }
+    const auto size = outputFile.size();
+    if(!outputFile.commit())
+    {
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    output << "Written '" << cfg.output.toStdString() << "' (" << size << " of " << inputFile.size() << " bytes) in "
+        << std::chrono::duration<double, std::milli>(finish - start).count() << " ms" << std::endl;
+    return true;
+}
@@ -0,0 +1,69 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBF_EXTRACT_H_
+#define __OBF_EXTRACT_H_
+
+#include <ostream>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Common.h>
+
+namespace ObfExtract
+{
+    // Bbox, optionally narrowed by polygon rings (outer rings of Osmosis .poly file)
+    struct Area
+    {
+        Area();
+
+        OsmAnd::AreaI bbox31;
+        std::vector< std::vector<OsmAnd::PointI> > rings;
+
+        bool intersects(const OsmAnd::AreaI& bbox31) const;
+    };
+
+    struct Configuration
+    {
+        Configuration();
+
+        QString input;
+        QString output;
+        Area area;
+        bool verbose;
+    };
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    bool loadPolygon(const QString& path, Area& area, QString& error);
+
+    // Writes OBF with map levels, routing trees and POI boxes reduced to boxes intersecting area,
+    // followed by encoded blocks of those boxes copied as they are. Input is read in one pass per
+    // section and output is written sequentially, so memory depends only on the number of kept
+    // blocks of one map level or section.
+    bool extract(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __OBF_EXTRACT_H_
@@ -0,0 +1,583 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AddressIndex.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <QByteArray>
+#include <QFile>
+
+#include "ObfBlocks.h"
+#include "TextNormalization.h"
+
+namespace
+{
+    using namespace ObfBlocks;
+
+    typedef AddressIndex::PendingBuilding PendingBuilding;
+    typedef AddressIndex::PendingStreet PendingStreet;
+    typedef AddressIndex::PendingCity PendingCity;
+
+    // Street and building coordinates are deltas of 24-bit tiles from city and street
+    inline int32_t addDelta(int32_t base31, uint64_t zigZag)
+    {
+        const int64_t value = base31 + (static_cast<int64_t>(decodeZigZag(zigZag)) << 7);
+        return static_cast<int32_t>(std::min<int64_t>(INT32_MAX, std::max<int64_t>(0, value)));
+    }
+
+    bool readBuilding(MessageReader& message, int32_t streetX31, int32_t streetY31, PendingBuilding& building)
+    {
+        building.x31 = building.x231 = streetX31;
+        building.y31 = building.y231 = streetY31;
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            uint64_t value;
+            if(field == BuildingName && isLengthDelimited(wireType))
+            {
+                if(!message.readString(building.name, wireType))
+                    return false;
+            }
+            else if(field == BuildingName2 && isLengthDelimited(wireType))
+            {
+                if(!message.readString(building.name2, wireType))
+                    return false;
+            }
+            else if((field == BuildingX || field == BuildingY || field == BuildingX2 || field == BuildingY2) && wireType == WireVarint)
+            {
+                if(!message.readVarint(value))
+                    return false;
+                if(field == BuildingX)
+                    building.x31 = addDelta(streetX31, value);
+                else if(field == BuildingY)
+                    building.y31 = addDelta(streetY31, value);
+                else if(field == BuildingX2)
+                    building.x231 = addDelta(streetX31, value);
+                else
+                    building.y231 = addDelta(streetY31, value);
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Coordinates come before buildings in street message, but that is not relied upon
+    bool readStreet(MessageReader& message, const PendingCity& city, PendingStreet& street)
+    {
+        street.x31 = city.x31;
+        street.y31 = city.y31;
+        std::vector<MessageReader> buildings;
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            uint64_t value;
+            if(field == StreetName && isLengthDelimited(wireType))
+            {
+                if(!message.readString(street.name, wireType))
+                    return false;
+            }
+            else if(field == StreetNameEn && isLengthDelimited(wireType))
+            {
+                if(!message.readString(street.nameEn, wireType))
+                    return false;
+            }
+            else if((field == StreetX || field == StreetY) && wireType == WireVarint)
+            {
+                if(!message.readVarint(value))
+                    return false;
+                if(field == StreetX)
+                    street.x31 = addDelta(city.x31, value);
+                else
+                    street.y31 = addDelta(city.y31, value);
+            }
+            else if(field == StreetBuildings && isLengthDelimited(wireType))
+            {
+                MessageReader building;
+                if(!message.readMessage(building, wireType))
+                    return false;
+                buildings.push_back(building);
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+
+        street.buildings.resize(buildings.size());
+        for(size_t idx = 0; idx < buildings.size(); idx++)
+        {
+            if(!readBuilding(buildings[idx], street.x31, street.y31, street.buildings[idx]))
+                return false;
+        }
+        return true;
+    }
+
+    bool readCity(MessageReader& message, PendingCity& city)
+    {
+        city.x31 = city.y31 = 0;
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            uint64_t value;
+            if(field == CityName && isLengthDelimited(wireType))
+            {
+                if(!message.readString(city.name, wireType))
+                    return false;
+            }
+            else if(field == CityNameEn && isLengthDelimited(wireType))
+            {
+                if(!message.readString(city.nameEn, wireType))
+                    return false;
+            }
+            else if((field == CityX || field == CityY) && wireType == WireVarint)
+            {
+                // City coordinates are plain 31-coordinates
+                if(!message.readVarint(value))
+                    return false;
+                if(field == CityX)
+                    city.x31 = static_cast<int32_t>(value);
+                else
+                    city.y31 = static_cast<int32_t>(value);
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readCityBlock(MessageReader& message, PendingCity& city)
+    {
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            if(field == CityBlockStreets && isLengthDelimited(wireType))
+            {
+                MessageReader streetMessage;
+                if(!message.readMessage(streetMessage, wireType))
+                    return false;
+                PendingStreet street;
+                if(!readStreet(streetMessage, city, street))
+                    return false;
+                city.streets.push_back(std::move(street));
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // City headers come first, each followed later by block of its streets, which refers back
+    // to header by shift between positions right after their tags
+    bool readCities(QFile& file, qint64 end, std::vector<PendingCity>& cities, QString& error)
+    {
+        uint64_t type = 0;
+        QHash<qint64, size_t> cityByOffset;
+        while(file.pos() < end)
+        {
+            int field, wireType;
+            if(!readTag(file, field, wireType))
+            {
+                error = "Failed to read cities";
+                return false;
+            }
+            const auto messageOffset = file.pos();
+            if(field == CitiesIndexType && wireType == WireVarint)
+            {
+                if(!readVarint(file, type))
+                {
+                    error = "Failed to read cities";
+                    return false;
+                }
+            }
+            else if((field == CitiesIndexCities || field == CitiesIndexBlocks) && isLengthDelimited(wireType) &&
+                type != CitiesTypePostcodes)
+            {
+                qint64 length;
+                if(!readLength(file, wireType, length) || file.pos() + length > end)
+                {
+                    error = "Broken cities";
+                    return false;
+                }
+                const auto bytes = file.read(length);
+                MessageReader message(bytes.constData(), bytes.size());
+                if(bytes.size() != length)
+                {
+                    error = "Failed to read cities";
+                    return false;
+                }
+                if(field == CitiesIndexCities)
+                {
+                    PendingCity city;
+                    if(!readCity(message, city))
+                    {
+                        error = "Broken city";
+                        return false;
+                    }
+                    cityByOffset.insert(messageOffset, cities.size());
+                    cities.push_back(std::move(city));
+                    continue;
+                }
+
+                // Shift to city is the first field of block
+                int blockField, blockWireType;
+                uint32_t shift;
+                if(!message.readTag(blockField, blockWireType) || blockField != CityBlockShiftToCity ||
+                    blockWireType != WireFixed32 || !message.readFixed32(shift))
+                {
+                    error = "City block has no shift to its city";
+                    return false;
+                }
+                const auto itCity = cityByOffset.constFind(messageOffset - shift);
+                if(itCity == cityByOffset.constEnd())
+                    continue;
+                if(!readCityBlock(message, cities[*itCity]))
+                {
+                    error = "Broken city block";
+                    return false;
+                }
+            }
+            else if(!skipField(file, wireType))
+            {
+                error = "Failed to read cities";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readAddressSection(QFile& file, const Section& section, std::vector<PendingCity>& cities, QString& error)
+    {
+        if(!file.seek(section.contentOffset))
+        {
+            error = "Failed to read address section";
+            return false;
+        }
+        while(file.pos() < section.end)
+        {
+            int field, wireType;
+            if(!readTag(file, field, wireType))
+            {
+                error = "Failed to read address section";
+                return false;
+            }
+            if(field == AddressIndexCities && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(file, wireType, length) || file.pos() + length > section.end)
+                {
+                    error = "Broken address section";
+                    return false;
+                }
+                const auto end = file.pos() + length;
+                if(!readCities(file, end, cities, error) || !file.seek(end))
+                    return false;
+            }
+            else if(!skipField(file, wireType))
+            {
+                error = "Failed to read address section";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline uint64_t combine(uint64_t scope, uint64_t hash)
+    {
+        return hash ^ (scope * 0x9e3779b97f4a7c15ULL + 0x7f4a7c159e3779b9ULL + (hash << 6) + (hash >> 2));
+    }
+
+    // Leading number of house, -1 if there is none
+    int houseNumber(const QString& house)
+    {
+        int value = -1;
+        for(auto itChar = house.begin(); itChar != house.end() && itChar->isDigit() && value < 100000000; ++itChar)
+            value = std::max(value, 0) * 10 + itChar->digitValue();
+        return value;
+    }
+}
+
+AddressIndex::Match::Match()
+    : level(Level::None)
+    , x31(0)
+    , y31(0)
+{
+}
+
+AddressIndex::LoadStats::LoadStats()
+    : bytes(0)
+    , cities(0)
+    , streets(0)
+    , buildings(0)
+    , decodeSeconds(0)
+    , indexSeconds(0)
+{
+}
+
+bool AddressIndex::decode(const QString& obfPath, std::vector<PendingCity>& cities, LoadStats& stats, QString& error)
+{
+    const auto start = std::chrono::steady_clock::now();
+    QFile file(obfPath);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        error = "Failed to open '" + obfPath + "'";
+        return false;
+    }
+    std::vector<Section> sections;
+    if(!readStructure(file, sections, error))
+        return false;
+    for(auto itSection = sections.begin(); itSection != sections.end(); ++itSection)
+    {
+        if(itSection->field != StructureAddressIndex)
+            continue;
+        if(!readAddressSection(file, *itSection, cities, error))
+            return false;
+        stats.bytes += itSection->end - itSection->offset;
+    }
+    stats.decodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void AddressIndex::add(const std::vector<PendingCity>& cities, LoadStats& stats)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for(auto itCity = cities.begin(); itCity != cities.end(); ++itCity)
+    {
+        const auto cityIdx = static_cast<uint32_t>(_cities.size());
+        Point cityPoint;
+        cityPoint.x31 = itCity->x31;
+        cityPoint.y31 = itCity->y31;
+        _cities.push_back(cityPoint);
+        const auto cityName = TextNormalization::normalize(itCity->name);
+        _citiesByName.insert(hash(cityName), addKey(cityIdx, 0, cityName));
+        if(!itCity->nameEn.isEmpty())
+        {
+            const auto cityNameEn = TextNormalization::normalize(itCity->nameEn);
+            if(cityNameEn != cityName)
+                _citiesByName.insert(hash(cityNameEn), addKey(cityIdx, 0, cityNameEn));
+        }
+        stats.cities++;
+
+        for(auto itStreet = itCity->streets.begin(); itStreet != itCity->streets.end(); ++itStreet)
+        {
+            const auto streetIdx = static_cast<uint32_t>(_streets.size());
+            Point streetPoint;
+            streetPoint.x31 = itStreet->x31;
+            streetPoint.y31 = itStreet->y31;
+            _streets.push_back(streetPoint);
+            const auto streetName = TextNormalization::normalize(itStreet->name);
+            _streetsByName.insert(combine(cityIdx, hash(streetName)), addKey(streetIdx, cityIdx, streetName));
+            if(!itStreet->nameEn.isEmpty())
+            {
+                const auto streetNameEn = TextNormalization::normalize(itStreet->nameEn);
+                if(streetNameEn != streetName)
+                    _streetsByName.insert(combine(cityIdx, hash(streetNameEn)), addKey(streetIdx, cityIdx, streetNameEn));
+            }
+            stats.streets++;
+
+            for(auto itBuilding = itStreet->buildings.begin(); itBuilding != itStreet->buildings.end(); ++itBuilding)
+            {
+                const auto house = normalizeHouse(itBuilding->name);
+                Point buildingPoint;
+                buildingPoint.x31 = itBuilding->x31;
+                buildingPoint.y31 = itBuilding->y31;
+                const auto key = combine(streetIdx, hash(house));
+                bool known = false;
+                for(auto itKnown = _buildingsByNumber.constFind(key); !known && itKnown != _buildingsByNumber.constEnd() && itKnown.key() == key; ++itKnown)
+                    known = isKey(*itKnown, streetIdx, house);
+                if(!known)
+                {
+                    _buildingsByNumber.insert(key, addKey(static_cast<uint32_t>(_buildings.size()), streetIdx, house));
+                    _buildings.push_back(buildingPoint);
+                }
+                stats.buildings++;
+
+                // Building with second number is range of interpolated house numbers
+                if(itBuilding->name2.isEmpty())
+                    continue;
+                Range range;
+                range.from = buildingPoint;
+                range.to.x31 = itBuilding->x231;
+                range.to.y31 = itBuilding->y231;
+                range.first = houseNumber(house);
+                range.last = houseNumber(normalizeHouse(itBuilding->name2));
+                if(range.first < 0 || range.last < 0 || range.first == range.last)
+                    continue;
+                _streetRanges.insert(streetIdx, static_cast<uint32_t>(_ranges.size()));
+                _ranges.push_back(range);
+            }
+        }
+    }
+    stats.indexSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool AddressIndex::load(const QString& obfPath, LoadStats& stats, QString& error)
+{
+    std::vector<PendingCity> cities;
+    if(!decode(obfPath, cities, stats, error))
+        return false;
+    add(cities, stats);
+    return true;
+}
+
+AddressIndex::Match AddressIndex::resolve(const Address& address) const
+{
+    Match match;
+    const auto cityName = TextNormalization::normalize(address.city);
+    const auto cityHash = hash(cityName);
+    const auto streetName = TextNormalization::normalize(address.street);
+    const auto streetHash = hash(streetName);
+    const auto house = normalizeHouse(address.house);
+    const auto houseHash = hash(house);
+    const auto number = houseNumber(house);
+
+    const auto setMatch = [&match](Level level, const Point& point)
+    {
+        if(level <= match.level)
+            return;
+        match.level = level;
+        match.x31 = point.x31;
+        match.y31 = point.y31;
+    };
+
+    // Same name may belong to several cities, the one with the most detailed match wins
+    for(auto itCity = _citiesByName.constFind(cityHash); itCity != _citiesByName.constEnd() && itCity.key() == cityHash; ++itCity)
+    {
+        if(!isKey(*itCity, 0, cityName))
+            continue;
+        const auto cityIdx = _keys[*itCity].target;
+        setMatch(Level::City, _cities[cityIdx]);
+        if(streetName.isEmpty())
+            continue;
+
+        const auto streetKey = combine(cityIdx, streetHash);
+        for(auto itStreet = _streetsByName.constFind(streetKey); itStreet != _streetsByName.constEnd() && itStreet.key() == streetKey; ++itStreet)
+        {
+            if(!isKey(*itStreet, cityIdx, streetName))
+                continue;
+            const auto streetIdx = _keys[*itStreet].target;
+            setMatch(Level::Street, _streets[streetIdx]);
+            if(house.isEmpty())
+                continue;
+
+            const auto buildingKey = combine(streetIdx, houseHash);
+            for(auto itBuilding = _buildingsByNumber.constFind(buildingKey); itBuilding != _buildingsByNumber.constEnd() && itBuilding.key() == buildingKey; ++itBuilding)
+            {
+                if(!isKey(*itBuilding, streetIdx, house))
+                    continue;
+                setMatch(Level::Building, _buildings[_keys[*itBuilding].target]);
+                return match;
+            }
+            if(number < 0 || match.level >= Level::Interpolated)
+                continue;
+            for(auto itRange = _streetRanges.constFind(streetIdx); itRange != _streetRanges.constEnd() && itRange.key() == streetIdx; ++itRange)
+            {
+                const auto& range = _ranges[*itRange];
+                if(number < std::min(range.first, range.last) || number > std::max(range.first, range.last))
+                    continue;
+                const double t = static_cast<double>(number - range.first) / (range.last - range.first);
+                Point point;
+                point.x31 = static_cast<int32_t>(range.from.x31 + t * (static_cast<double>(range.to.x31) - range.from.x31));
+                point.y31 = static_cast<int32_t>(range.from.y31 + t * (static_cast<double>(range.to.y31) - range.from.y31));
+                setMatch(Level::Interpolated, point);
+                break;
+            }
+        }
+    }
+    return match;
+}
+
+uint32_t AddressIndex::addKey(uint32_t target, uint32_t scope, const QString& name)
+{
+    Key key;
+    key.target = target;
+    key.scope = scope;
+    key.nameOffset = _names.size();
+    key.nameSize = static_cast<uint32_t>(name.size());
+    _names.insert(_names.end(), name.constData(), name.constData() + name.size());
+    _keys.push_back(key);
+    return static_cast<uint32_t>(_keys.size() - 1);
+}
+
+bool AddressIndex::isKey(uint32_t keyIdx, uint32_t scope, const QString& name) const
+{
+    const auto& key = _keys[keyIdx];
+    return key.scope == scope && key.nameSize == static_cast<uint32_t>(name.size()) &&
+        std::equal(name.constData(), name.constData() + name.size(), _names.begin() + key.nameOffset);
+}
+
+QString AddressIndex::normalizeHouse(const QString& text)
+{
+    QString result;
+    result.reserve(text.size());
+    for(auto itChar = text.begin(); itChar != text.end(); ++itChar)
+    {
+        if(itChar->isLetterOrNumber() || *itChar == '/')
+            result.append(itChar->toLower());
+    }
+    return result;
+}
+
+// FNV-1a of UTF-16 code units
+uint64_t AddressIndex::hash(const QString& normalized)
+{
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for(auto itChar = normalized.begin(); itChar != normalized.end(); ++itChar)
+    {
+        value ^= itChar->unicode();
+        value *= 0x100000001b3ULL;
+    }
+    return value;
+}
+
+const char* AddressIndex::levelName(Level level)
+{
+    switch(level)
+    {
+    case Level::City:
+        return "city";
+    case Level::Street:
+        return "street";
+    case Level::Interpolated:
+        return "interpolated";
+    case Level::Building:
+        return "building";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,168 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ADDRESS_INDEX_H_
+#define __ADDRESS_INDEX_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <QHash>
+#include <QMultiHash>
+#include <QString>
+
+// City -> street -> building index of address sections of OBFs, decoded once and kept in
+// memory. Names are normalized and looked up by 64-bit hash, each hit is then checked against
+// the stored normalized name, so colliding hashes never match. Street keys include their city
+// and building keys include their street, so resolving an address is one lookup per level for
+// each city of that name.
+class AddressIndex
+{
+public:
+    enum class Level
+    {
+        None,
+        City,
+        Street,
+        // Position between ends of interpolated range of house numbers
+        Interpolated,
+        Building,
+    };
+
+    struct Address
+    {
+        QString city;
+        QString street;
+        QString house;
+    };
+
+    struct Match
+    {
+        Match();
+
+        Level level;
+        int32_t x31;
+        int32_t y31;
+    };
+
+    struct LoadStats
+    {
+        LoadStats();
+
+        // Bytes of address sections
+        qint64 bytes;
+        uint32_t cities;
+        uint32_t streets;
+        uint32_t buildings;
+        double decodeSeconds;
+        double indexSeconds;
+    };
+
+    struct PendingBuilding
+    {
+        QString name;
+        QString name2;
+        int32_t x31;
+        int32_t y31;
+        int32_t x231;
+        int32_t y231;
+    };
+
+    struct PendingStreet
+    {
+        QString name;
+        QString nameEn;
+        int32_t x31;
+        int32_t y31;
+        std::vector<PendingBuilding> buildings;
+    };
+
+    struct PendingCity
+    {
+        QString name;
+        QString nameEn;
+        int32_t x31;
+        int32_t y31;
+        std::vector<PendingStreet> streets;
+    };
+
+    // Decodes address sections of OBF without touching any index, so several files can be decoded
+    // in parallel. Postcode lists are skipped since they repeat streets of cities.
+    static bool decode(const QString& obfPath, std::vector<PendingCity>& cities, LoadStats& stats, QString& error);
+    // Adds decoded cities, files have to be added one at a time
+    void add(const std::vector<PendingCity>& cities, LoadStats& stats);
+    // Decodes and adds address sections of OBF
+    bool load(const QString& obfPath, LoadStats& stats, QString& error);
+
+    // Most detailed match of address, safe to call from several threads once loading is done
+    Match resolve(const Address& address) const;
+
+    // Letters, digits and '/' of house number, so that "12 A" and "12a" are the same
+    static QString normalizeHouse(const QString& text);
+    static uint64_t hash(const QString& normalized);
+
+    static const char* levelName(Level level);
+
+private:
+    struct Point
+    {
+        int32_t x31;
+        int32_t y31;
+    };
+
+    struct Range
+    {
+        Point from;
+        Point to;
+        int first;
+        int last;
+    };
+
+    // What hash entry points to: city, street or building, with city of street or street of
+    // building as scope, and normalized name it was inserted under
+    struct Key
+    {
+        uint32_t target;
+        uint32_t scope;
+        uint64_t nameOffset;
+        uint32_t nameSize;
+    };
+
+    uint32_t addKey(uint32_t target, uint32_t scope, const QString& name);
+    bool isKey(uint32_t keyIdx, uint32_t scope, const QString& name) const;
+
+    std::vector<Point> _cities;
+    std::vector<Point> _streets;
+    std::vector<Point> _buildings;
+    std::vector<Range> _ranges;
+    std::vector<Key> _keys;
+    // Normalized names of keys one after another
+    std::vector<QChar> _names;
+    // Hashes of names to keys
+    QMultiHash<uint64_t, uint32_t> _citiesByName;
+    QMultiHash<uint64_t, uint32_t> _streetsByName;
+    QMultiHash<uint64_t, uint32_t> _buildingsByNumber;
+    // Interpolated ranges of street
+    QMultiHash<uint32_t, uint32_t> _streetRanges;
+};
+
+#endif // __ADDRESS_INDEX_H_
@@ -0,0 +1,360 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Geocoder.h"
+
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Utilities.h>
+
+#include "AddressIndex.h"
+
+namespace
+{
+    enum
+    {
+        // Lines taken by worker at once
+        ChunkSize = 1024,
+        // Lines read, resolved and written at once
+        BatchSize = 64 * ChunkSize,
+    };
+
+    double perSecond(double count, double seconds)
+    {
+        return count / std::max(seconds, 1e-9);
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point& start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    AddressIndex::Match resolveLine(const AddressIndex& index, const QByteArray& line, QChar separator)
+    {
+        const auto parts = QString::fromUtf8(line).split(separator);
+        AddressIndex::Address address;
+        address.city = parts[0].trimmed();
+        if(parts.size() > 1)
+            address.street = parts[1].trimmed();
+        if(parts.size() > 2)
+            address.house = parts[2].trimmed();
+        return index.resolve(address);
+    }
+
+    // Runs worker on given count of threads, calling thread being one of them
+    template<typename Worker>
+    void runWorkers(int threadsCount, const Worker& worker)
+    {
+        std::vector<std::thread> threads;
+        for(int threadIdx = 1; threadIdx < threadsCount; threadIdx++)
+            threads.push_back(std::thread(worker));
+        worker();
+        for(auto itThread = threads.begin(); itThread != threads.end(); ++itThread)
+            itThread->join();
+    }
+
+    // Next batch of lines without line breaks, empty at end of input
+    void readBatch(QFile& file, std::vector<QByteArray>& lines, qint64& bytes)
+    {
+        lines.clear();
+        while(lines.size() < static_cast<size_t>(BatchSize) && !file.atEnd())
+        {
+            auto line = file.readLine();
+            bytes += line.size();
+            if(line.endsWith('\n'))
+                line.chop(1);
+            if(line.endsWith('\r'))
+                line.chop(1);
+            lines.push_back(line);
+        }
+    }
+
+    void appendResult(QByteArray& buffer, const QByteArray& line, const AddressIndex::Match& match)
+    {
+        buffer.append(line);
+        buffer.append('\t');
+        if(match.level != AddressIndex::Level::None)
+        {
+            buffer.append(QByteArray::number(OsmAnd::Utilities::get31LatitudeY(match.y31), 'f', 7));
+            buffer.append('\t');
+            buffer.append(QByteArray::number(OsmAnd::Utilities::get31LongitudeX(match.x31), 'f', 7));
+        }
+        else
+        {
+            buffer.append('\t');
+        }
+        buffer.append('\t');
+        buffer.append(AddressIndex::levelName(match.level));
+        buffer.append('\n');
+    }
+}
+
+Geocoder::Configuration::Configuration()
+    : separator(',')
+    , threads(0)
+    , verbose(false)
+{
+}
+
+bool Geocoder::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-obf="))
+        {
+            const auto path = arg.mid(strlen("-obf="));
+            if(!QFile::exists(path))
+            {
+                error = "OBF file '" + path + "' does not exist";
+                return false;
+            }
+            cfg.obfFiles.push_back(path);
+        }
+        else if(arg.startsWith("-obfsDir="))
+        {
+            const QDir obfsDir(arg.mid(strlen("-obfsDir=")));
+            if(!obfsDir.exists())
+            {
+                error = "OBFs directory does not exist";
+                return false;
+            }
+            const auto fileNames = obfsDir.entryList(QStringList() << "*.obf", QDir::Files, QDir::Name);
+            for(auto itFileName = fileNames.begin(); itFileName != fileNames.end(); ++itFileName)
+                cfg.obfFiles.push_back(obfsDir.filePath(*itFileName));
+        }
+        else if(arg.startsWith("-input="))
+        {
+            cfg.inputFile = arg.mid(strlen("-input="));
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.outputFile = arg.mid(strlen("-output="));
+        }
+        else if(arg.startsWith("-separator="))
+        {
+            const auto separator = arg.mid(strlen("-separator="));
+            if(separator.size() != 1)
+            {
+                error = "Separator has to be single character";
+                return false;
+            }
+            cfg.separator = separator[0];
+        }
+        else if(arg.startsWith("-threads="))
+        {
+            cfg.threads = arg.mid(strlen("-threads=")).toInt();
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else
+        {
+            error = "Unknown argument '" + arg + "'";
+            return false;
+        }
+    }
+    if(cfg.obfFiles.isEmpty())
+    {
+        error = "At least one OBF file is required";
+        return false;
+    }
+    if(cfg.inputFile.isEmpty() || !QFile::exists(cfg.inputFile))
+    {
+        error = "Input file is required";
+        return false;
+    }
+    if(cfg.outputFile.isEmpty())
+    {
+        error = "Output file is required";
+        return false;
+    }
+    if(cfg.threads < 0)
+    {
+        error = "Invalid number of threads";
+        return false;
+    }
+    return true;
+}
+
+bool Geocoder::run(std::ostream& output, const Configuration& cfg)
+{
+    auto threadsCount = cfg.threads > 0 ? cfg.threads : static_cast<int>(std::thread::hardware_concurrency());
+    if(threadsCount <= 0)
+        threadsCount = 1;
+
+    // Decode address sections of as many files at once as there are threads, then add them to
+    // index in order of files, so index does not depend on which file was decoded first
+    AddressIndex index;
+    AddressIndex::LoadStats total;
+    double decodeSeconds = 0.0;
+    for(int batchBegin = 0; batchBegin < cfg.obfFiles.size(); batchBegin += threadsCount)
+    {
+        const auto batchEnd = std::min(batchBegin + threadsCount, cfg.obfFiles.size());
+        std::vector< std::vector<AddressIndex::PendingCity> > decoded(batchEnd - batchBegin);
+        std::vector<AddressIndex::LoadStats> stats(batchEnd - batchBegin);
+        std::vector<QString> errors(batchEnd - batchBegin);
+        std::vector<char> decodedOk(batchEnd - batchBegin, 0);
+        std::atomic<int> nextFileIdx(batchBegin);
+        const auto decodeStart = std::chrono::steady_clock::now();
+        runWorkers(batchEnd - batchBegin, [&]()
+        {
+            for(;;)
+            {
+                const auto fileIdx = nextFileIdx.fetch_add(1);
+                if(fileIdx >= batchEnd)
+                    return;
+                const auto idx = fileIdx - batchBegin;
+                decodedOk[idx] = AddressIndex::decode(cfg.obfFiles[fileIdx], decoded[idx], stats[idx], errors[idx]);
+            }
+        });
+        decodeSeconds += secondsSince(decodeStart);
+
+        for(int fileIdx = batchBegin; fileIdx < batchEnd; fileIdx++)
+        {
+            const auto idx = fileIdx - batchBegin;
+            const auto& path = cfg.obfFiles[fileIdx];
+            if(!decodedOk[idx])
+            {
+                output << "'" << path.toStdString() << "': " << errors[idx].toStdString() << std::endl;
+                return false;
+            }
+            index.add(decoded[idx], stats[idx]);
+            std::vector<AddressIndex::PendingCity>().swap(decoded[idx]);
+            if(cfg.verbose)
+            {
+                output << "Loaded '" << path.toStdString() << "': " << stats[idx].cities << " cities, " << stats[idx].streets
+                    << " streets, " << stats[idx].buildings << " buildings in " << (stats[idx].decodeSeconds + stats[idx].indexSeconds) * 1000.0
+                    << " ms" << std::endl;
+            }
+            total.bytes += stats[idx].bytes;
+            total.cities += stats[idx].cities;
+            total.streets += stats[idx].streets;
+            total.buildings += stats[idx].buildings;
+            total.decodeSeconds += stats[idx].decodeSeconds;
+            total.indexSeconds += stats[idx].indexSeconds;
+        }
+    }
+    const double entries = static_cast<double>(total.cities) + total.streets + total.buildings;
+    output << "Decoded " << total.bytes / (1024.0 * 1024.0) << " MB of address sections of " << cfg.obfFiles.size()
+        << " files using " << std::min(threadsCount, cfg.obfFiles.size()) << " threads in " << decodeSeconds << " s ("
+        << perSecond(total.bytes / (1024.0 * 1024.0), decodeSeconds) << " MB/s, " << perSecond(total.buildings, decodeSeconds)
+        << " buildings/s)" << std::endl;
+    output << "Indexed " << total.cities << " cities, " << total.streets << " streets, " << total.buildings
+        << " buildings in " << total.indexSeconds << " s (" << perSecond(entries, total.indexSeconds) << " entries/s)" << std::endl;
+
+    // Input is streamed in batches: each is read, resolved in parallel and written in order
+    // before next one is read, so memory does not grow with input
+    QFile inputFile(cfg.inputFile);
+    if(!inputFile.open(QIODevice::ReadOnly))
+    {
+        output << "Failed to open '" << cfg.inputFile.toStdString() << "'" << std::endl;
+        return false;
+    }
+    QFile outputFile(cfg.outputFile);
+    if(!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        output << "Failed to open '" << cfg.outputFile.toStdString() << "' for writing" << std::endl;
+        return false;
+    }
+
+    qint64 linesCount = 0;
+    qint64 inputBytes = 0;
+    double readSeconds = 0.0;
+    double resolveSeconds = 0.0;
+    double writeSeconds = 0.0;
+    int levels[static_cast<int>(AddressIndex::Level::Building) + 1] = {};
+    std::vector<QByteArray> lines;
+    std::vector<AddressIndex::Match> matches;
+    QByteArray buffer;
+    for(;;)
+    {
+        auto start = std::chrono::steady_clock::now();
+        readBatch(inputFile, lines, inputBytes);
+        readSeconds += secondsSince(start);
+        if(lines.empty())
+            break;
+        linesCount += lines.size();
+
+        start = std::chrono::steady_clock::now();
+        const auto chunksCount = static_cast<int>((lines.size() + ChunkSize - 1) / ChunkSize);
+        matches.assign(lines.size(), AddressIndex::Match());
+        std::atomic<int> nextChunkIdx(0);
+        runWorkers(std::min(threadsCount, chunksCount), [&]()
+        {
+            for(;;)
+            {
+                const auto first = static_cast<size_t>(nextChunkIdx.fetch_add(1)) * ChunkSize;
+                if(first >= lines.size())
+                    return;
+                const auto last = std::min<size_t>(first + ChunkSize, lines.size());
+                for(auto lineIdx = first; lineIdx < last; lineIdx++)
+                    matches[lineIdx] = resolveLine(index, lines[lineIdx], cfg.separator);
+            }
+        });
+        resolveSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        buffer.clear();
+        for(size_t lineIdx = 0; lineIdx < lines.size(); lineIdx++)
+        {
+            levels[static_cast<int>(matches[lineIdx].level)]++;
+            appendResult(buffer, lines[lineIdx], matches[lineIdx]);
+        }
+        if(outputFile.write(buffer) != buffer.size())
+        {
+            output << "Failed to write '" << cfg.outputFile.toStdString() << "'" << std::endl;
+            return false;
+        }
+        writeSeconds += secondsSince(start);
+    }
+    inputFile.close();
+    const auto closeStart = std::chrono::steady_clock::now();
+    outputFile.close();
+    writeSeconds += secondsSince(closeStart);
+
+    output << "Read " << linesCount << " lines in " << readSeconds << " s (" << perSecond(linesCount, readSeconds)
+        << " lines/s, " << perSecond(inputBytes / (1024.0 * 1024.0), readSeconds) << " MB/s)" << std::endl;
+    output << "Resolved " << linesCount << " lines using " << threadsCount << " threads in " << resolveSeconds << " s ("
+        << perSecond(linesCount, resolveSeconds) << " lines/s)" << std::endl;
+    output << "\t";
+    for(int level = static_cast<int>(AddressIndex::Level::Building); level >= 0; level--)
+    {
+        output << AddressIndex::levelName(static_cast<AddressIndex::Level>(level)) << ": " << levels[level]
+            << (level > 0 ? ", " : "");
+    }
+    output << std::endl;
+    output << "Wrote " << linesCount << " lines in " << writeSeconds << " s (" << perSecond(linesCount, writeSeconds)
+        << " lines/s)" << std::endl;
+    return true;
+}
@@ -0,0 +1,56 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __GEOCODER_H_
+#define __GEOCODER_H_
+
+#include <ostream>
+
+#include <QChar>
+#include <QString>
+#include <QStringList>
+
+namespace Geocoder
+{
+    struct Configuration
+    {
+        Configuration();
+
+        QStringList obfFiles;
+        // Lines of 'city<separator>street<separator>house', street and house are optional
+        QString inputFile;
+        // Lines of input followed by tab separated latitude, longitude and match level
+        QString outputFile;
+        QChar separator;
+        // All cores if 0
+        int threads;
+        bool verbose;
+    };
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Decodes address sections of OBFs in parallel into one index, then streams input through it
+    // in batches of lines resolved in parallel, reporting time and throughput of each stage
+    bool run(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __GEOCODER_H_
@@ -0,0 +1,460 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "QueryBenchmark.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#if !defined(_WIN32)
+#   include <fcntl.h>
+#   include <sys/resource.h>
+#endif
+
+#include <QFile>
+#include <QIODevice>
+#include <QSet>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Common.h>
+#include <OsmAndCore/Data/ObfReader.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Data/ObfMapSection.h>
+#include <OsmAndCore/Data/ObfPoiSection.h>
+#include <OsmAndCore/Routing/RoutePlanner.h>
+#include <OsmAndCore/Routing/RoutePlannerContext.h>
+#include <OsmAndCore/Routing/RoutingConfiguration.h>
+
+#include "Statistics.h"
+
+namespace
+{
+    const qint64 PageSize = 4096;
+
+    // File device that counts what reader really asks from file. Opened unbuffered, so each
+    // read of reader is one read of file.
+    class CountingDevice : public QIODevice
+    {
+    public:
+        explicit CountingDevice(const QString& path)
+            : _file(path)
+            , _lastEnd(0)
+        {
+            resetCounters();
+        }
+
+        virtual bool open(OpenMode mode)
+        {
+            if(!_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+                return false;
+            return QIODevice::open(mode | QIODevice::Unbuffered);
+        }
+
+        virtual void close()
+        {
+            QIODevice::close();
+            _file.close();
+        }
+
+        virtual bool isSequential() const
+        {
+            return false;
+        }
+
+        virtual qint64 size() const
+        {
+            return _file.size();
+        }
+
+        virtual bool seek(qint64 pos)
+        {
+            return QIODevice::seek(pos) && _file.seek(pos);
+        }
+
+        int handle() const
+        {
+            return _file.handle();
+        }
+
+        void resetCounters()
+        {
+            bytesRead = 0;
+            reads = 0;
+            seeks = 0;
+            pages.clear();
+        }
+
+        qint64 bytesRead;
+        qint64 reads;
+        qint64 seeks;
+        QSet<qint64> pages;
+
+    protected:
+        virtual qint64 readData(char* data, qint64 maxSize)
+        {
+            const auto position = _file.pos();
+            const auto read = _file.read(data, maxSize);
+            if(read <= 0)
+                return read;
+            if(position != _lastEnd)
+                seeks++;
+            reads++;
+            bytesRead += read;
+            for(auto page = position / PageSize; page <= (position + read - 1) / PageSize; page++)
+                pages.insert(page);
+            _lastEnd = position + read;
+            return read;
+        }
+
+        virtual qint64 writeData(const char* data, qint64 maxSize)
+        {
+            Q_UNUSED(data);
+            Q_UNUSED(maxSize);
+            return -1;
+        }
+
+    private:
+        QFile _file;
+        qint64 _lastEnd;
+    };
+
+    struct Counters
+    {
+        Counters()
+            : objects(0)
+            , bytesRead(0)
+            , reads(0)
+            , seeks(0)
+            , pages(0)
+            , blocksIn(0)
+            , majorFaults(0)
+            , minorFaults(0)
+        {
+        }
+
+        qint64 objects;
+        qint64 bytesRead;
+        qint64 reads;
+        qint64 seeks;
+        qint64 pages;
+        qint64 blocksIn;
+        qint64 majorFaults;
+        qint64 minorFaults;
+        std::vector<double> times;
+    };
+
+    void sampleUsage(qint64& blocksIn, qint64& majorFaults, qint64& minorFaults)
+    {
+        blocksIn = majorFaults = minorFaults = 0;
+#if !defined(_WIN32)
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            blocksIn = usage.ru_inblock;
+            majorFaults = usage.ru_majflt;
+            minorFaults = usage.ru_minflt;
+        }
+#endif
+    }
+
+    void dropPageCache(const CountingDevice& device)
+    {
+#if defined(__linux__)
+        posix_fadvise(device.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#else
+        Q_UNUSED(device);
+#endif
+    }
+
+    // Query centers are spread over levels of first file that cover zoom
+    bool generateQueries(std::ostream& output, const QueryBenchmark::Configuration& cfg, std::vector<OsmAnd::AreaI>& queries)
+    {
+        OsmAnd::ObfReader obfReader(std::shared_ptr<QIODevice>(new QFile(cfg.obfFiles.first())));
+        std::vector<OsmAnd::AreaI> areas;
+        for(auto itMapSection = obfReader.mapSections.begin(); itMapSection != obfReader.mapSections.end(); ++itMapSection)
+        {
+            const auto& mapLevels = (*itMapSection)->mapLevels;
+            for(auto itLevel = mapLevels.begin(); itLevel != mapLevels.end(); ++itLevel)
+            {
+                const auto& level = *itLevel;
+                if(level->minZoom <= cfg.zoom && cfg.zoom <= level->maxZoom)
+                    areas.push_back(level->area31);
+            }
+        }
+        if(areas.empty())
+        {
+            output << "'" << cfg.obfFiles.first().toStdString() << "' has no map data for zoom " << cfg.zoom << std::endl;
+            return false;
+        }
+
+        std::mt19937 generator(cfg.seed);
+        const auto halfSide = static_cast<int64_t>(cfg.tiles) << (31 - cfg.zoom) >> 1;
+        for(int idx = 0; idx < cfg.queries; idx++)
+        {
+            const auto& area = areas[generator() % areas.size()];
+            std::uniform_int_distribution<int64_t> xs(area.left, std::max(area.left, area.right));
+            std::uniform_int_distribution<int64_t> ys(area.top, std::max(area.top, area.bottom));
+            const auto x = xs(generator);
+            const auto y = ys(generator);
+            OsmAnd::AreaI query;
+            query.left = static_cast<int32_t>(std::max<int64_t>(0, x - halfSide));
+            query.right = static_cast<int32_t>(std::min<int64_t>(INT32_MAX, x + halfSide));
+            query.top = static_cast<int32_t>(std::max<int64_t>(0, y - halfSide));
+            query.bottom = static_cast<int32_t>(std::min<int64_t>(INT32_MAX, y + halfSide));
+            queries.push_back(query);
+        }
+        return true;
+    }
+
+    // Objects found by one query of type. Routing query gets fresh planner context, so roads
+    // loaded by previous queries don't make it cheaper.
+    qint64 runQuery(QueryBenchmark::QueryType type, const std::shared_ptr<OsmAnd::ObfReader>& obfReader,
+        const std::shared_ptr<OsmAnd::RoutingConfiguration>& routingConfig, const OsmAnd::AreaI& query, uint32_t zoom)
+    {
+        auto bbox31 = query;
+        OsmAnd::QueryFilter filter;
+        filter._bbox31 = &bbox31;
+        filter._zoom = &zoom;
+
+        switch(type)
+        {
+        case QueryBenchmark::QueryType::Map:
+            {
+                QList< std::shared_ptr<OsmAnd::Model::MapObject> > mapObjects;
+                for(auto itMapSection = obfReader->mapSections.begin(); itMapSection != obfReader->mapSections.end(); ++itMapSection)
+                    OsmAnd::ObfMapSection::loadMapObjects(obfReader.get(), itMapSection->get(), &mapObjects, &filter, nullptr);
+                return mapObjects.size();
+            }
+        case QueryBenchmark::QueryType::Routing:
+            {
+                QList< std::shared_ptr<OsmAnd::ObfReader> > sources;
+                sources.push_back(obfReader);
+                OsmAnd::RoutePlannerContext plannerContext(sources, routingConfig, QString("car"), false);
+                const auto latitude = OsmAnd::Utilities::get31LatitudeY(query.top + (query.bottom - query.top) / 2);
+                const auto longitude = OsmAnd::Utilities::get31LongitudeX(query.left + (query.right - query.left) / 2);
+                std::shared_ptr<OsmAnd::Model::Road> road;
+                return OsmAnd::RoutePlanner::findClosestRoadPoint(&plannerContext, latitude, longitude, &road) ? 1 : 0;
+            }
+        case QueryBenchmark::QueryType::Poi:
+            {
+                QList< std::shared_ptr<OsmAnd::Model::Amenity> > amenities;
+                for(auto itPoiSection = obfReader->poiSections.begin(); itPoiSection != obfReader->poiSections.end(); ++itPoiSection)
+                    OsmAnd::ObfPoiSection::loadAmenities(obfReader.get(), itPoiSection->get(), nullptr, &amenities, &filter);
+                return amenities.size();
+            }
+        }
+        return 0;
+    }
+
+    bool runQueries(std::ostream& output, const QueryBenchmark::Configuration& cfg, QueryBenchmark::QueryType type,
+        const QString& path, const std::vector<OsmAnd::AreaI>& queries, Counters& counters)
+    {
+        std::shared_ptr<CountingDevice> device(new CountingDevice(path));
+        if(!device->open(QIODevice::ReadOnly))
+        {
+            output << "Failed to open '" << path.toStdString() << "'" << std::endl;
+            return false;
+        }
+        std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(device));
+        std::shared_ptr<OsmAnd::RoutingConfiguration> routingConfig(new OsmAnd::RoutingConfiguration);
+        OsmAnd::RoutingConfiguration::loadDefault(*routingConfig);
+
+        for(auto itQuery = queries.begin(); itQuery != queries.end(); ++itQuery)
+        {
+            if(cfg.cold)
+                dropPageCache(*device);
+            device->resetCounters();
+            qint64 blocksIn, majorFaults, minorFaults;
+            sampleUsage(blocksIn, majorFaults, minorFaults);
+            const auto start = std::chrono::steady_clock::now();
+
+            const auto objects = runQuery(type, obfReader, routingConfig, *itQuery, cfg.zoom);
+
+            const auto finish = std::chrono::steady_clock::now();
+            qint64 blocksInAfter, majorFaultsAfter, minorFaultsAfter;
+            sampleUsage(blocksInAfter, majorFaultsAfter, minorFaultsAfter);
+
+            counters.objects += objects;
+            counters.bytesRead += device->bytesRead;
+            counters.reads += device->reads;
+            counters.seeks += device->seeks;
+            counters.pages += device->pages.size();
+            counters.blocksIn += blocksInAfter - blocksIn;
+            counters.majorFaults += majorFaultsAfter - majorFaults;
+            counters.minorFaults += minorFaultsAfter - minorFaults;
+            counters.times.push_back(std::chrono::duration<double, std::milli>(finish - start).count());
+        }
+        return true;
+    }
+
+    void printCounters(std::ostream& output, const QString& path, const Counters& counters, size_t queries, const Counters* baseline)
+    {
+        const auto perQuery = [queries](qint64 value) { return static_cast<double>(value) / queries; };
+        output << "'" << path.toStdString() << "'" << std::endl;
+        output << "\tObjects per query:         " << perQuery(counters.objects) << std::endl;
+        output << "\tBytes read per query:      " << perQuery(counters.bytesRead) << std::endl;
+        output << "\tPages touched per query:   " << perQuery(counters.pages) << std::endl;
+        output << "\tReads per query:           " << perQuery(counters.reads) << std::endl;
+        output << "\tSeeks per query:           " << perQuery(counters.seeks) << std::endl;
+        output << "\tDisk blocks in per query:  " << perQuery(counters.blocksIn) << std::endl;
+        output << "\tPage faults per query:     " << perQuery(counters.majorFaults) << " major, "
+            << perQuery(counters.minorFaults) << " minor" << std::endl;
+        output << "\tQuery time:                " << Statistics::percentile(counters.times, 50.0) << " ms median, "
+            << Statistics::percentile(counters.times, 95.0) << " ms p95" << std::endl;
+        if(baseline && baseline->pages > 0 && baseline->bytesRead > 0)
+        {
+            output << "\tAgainst first file:        " << 100.0 * counters.pages / baseline->pages << "% pages, "
+                << 100.0 * counters.bytesRead / baseline->bytesRead << "% bytes";
+            if(baseline->blocksIn > 0)
+                output << ", " << 100.0 * counters.blocksIn / baseline->blocksIn << "% disk blocks";
+            output << std::endl;
+        }
+    }
+}
+
+const char* QueryBenchmark::queryTypeName(QueryType type)
+{
+    switch(type)
+    {
+    case QueryType::Map:
+        return "map";
+    case QueryType::Routing:
+        return "routing";
+    case QueryType::Poi:
+        return "poi";
+    }
+    return "unknown";
+}
+
+QueryBenchmark::Configuration::Configuration()
+    : queries(200)
+    , zoom(15)
+    , tiles(4)
+    , seed(1)
+    , cold(true)
+{
+    for(int type = 0; type < QueryTypesCount; type++)
+        types[type] = false;
+}
+
+bool QueryBenchmark::isBenchmarkRequest(const QStringList& args)
+{
+    return args.contains("-benchmark");
+}
+
+bool QueryBenchmark::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-obf="))
+        {
+            const auto path = arg.mid(strlen("-obf="));
+            if(!QFile::exists(path))
+            {
+                error = "OBF file '" + path + "' does not exist";
+                return false;
+            }
+            cfg.obfFiles.push_back(path);
+        }
+        else if(arg.startsWith("-queries="))
+        {
+            cfg.queries = arg.mid(strlen("-queries=")).toInt();
+        }
+        else if(arg.startsWith("-zoom="))
+        {
+            cfg.zoom = arg.mid(strlen("-zoom=")).toUInt();
+        }
+        else if(arg.startsWith("-tiles="))
+        {
+            cfg.tiles = arg.mid(strlen("-tiles=")).toUInt();
+        }
+        else if(arg.startsWith("-seed="))
+        {
+            cfg.seed = arg.mid(strlen("-seed=")).toUInt();
+        }
+        else if(arg.startsWith("-types="))
+        {
+            const auto names = arg.mid(strlen("-types=")).split(',');
+            for(auto itName = names.begin(); itName != names.end(); ++itName)
+            {
+                int type = 0;
+                while(type < QueryTypesCount && *itName != queryTypeName(static_cast<QueryType>(type)))
+                    type++;
+                if(type == QueryTypesCount)
+                {
+                    error = "Unknown query type '" + *itName + "'";
+                    return false;
+                }
+                cfg.types[type] = true;
+            }
+        }
+        else if(arg == "-warm")
+        {
+            cfg.cold = false;
+        }
+    }
+    if(std::find(cfg.types, cfg.types + QueryTypesCount, true) == cfg.types + QueryTypesCount)
+    {
+        for(int type = 0; type < QueryTypesCount; type++)
+            cfg.types[type] = true;
+    }
+    if(cfg.obfFiles.isEmpty())
+    {
+        error = "At least one OBF file is required";
+        return false;
+    }
+    if(cfg.queries <= 0 || cfg.tiles == 0 || cfg.zoom > 31)
+    {
+        error = "Invalid benchmark parameters";
+        return false;
+    }
+    return true;
+}
+
+bool QueryBenchmark::run(std::ostream& output, const Configuration& cfg)
+{
+    std::vector<OsmAnd::AreaI> queries;
+    if(!generateQueries(output, cfg, queries))
+        return false;
+    output << queries.size() << " random " << cfg.tiles << "x" << cfg.tiles << " tile queries at zoom " << cfg.zoom
+        << (cfg.cold ? ", page cache dropped before each" : "") << std::endl;
+
+    for(int type = 0; type < QueryTypesCount; type++)
+    {
+        if(!cfg.types[type])
+            continue;
+        const auto queryType = static_cast<QueryType>(type);
+        output << "Query type '" << queryTypeName(queryType) << "'" << std::endl;
+        std::vector<Counters> results(cfg.obfFiles.size());
+        for(int idx = 0; idx < cfg.obfFiles.size(); idx++)
+        {
+            if(!runQueries(output, cfg, queryType, cfg.obfFiles[idx], queries, results[idx]))
+                return false;
+            printCounters(output, cfg.obfFiles[idx], results[idx], queries.size(), idx > 0 ? &results[0] : nullptr);
+        }
+    }
+    return true;
+}
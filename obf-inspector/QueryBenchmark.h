@@ -0,0 +1,76 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __QUERY_BENCHMARK_H_
+#define __QUERY_BENCHMARK_H_
+
+#include <stdint.h>
+#include <ostream>
+
+#include <QString>
+#include <QStringList>
+
+namespace QueryBenchmark
+{
+    enum class QueryType
+    {
+        // Map objects in bbox
+        Map,
+        // Closest road to bbox center, through planner context of its own
+        Routing,
+        // Amenities in bbox
+        Poi,
+    };
+    enum
+    {
+        QueryTypesCount = static_cast<int>(QueryType::Poi) + 1
+    };
+
+    const char* queryTypeName(QueryType type);
+
+    // Random bbox queries run against one or more OBFs of the same area, e.g. original file
+    // and its copy from relayout tool. Every file gets the same queries of each type.
+    struct Configuration
+    {
+        Configuration();
+
+        QStringList obfFiles;
+        // All types if not set
+        bool types[QueryTypesCount];
+        int queries;
+        uint32_t zoom;
+        // Side of query bbox in tiles of zoom
+        uint32_t tiles;
+        uint32_t seed;
+        // Page cache of file is dropped before each query, so reads really go to disk
+        bool cold;
+    };
+
+    bool isBenchmarkRequest(const QStringList& args);
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Reports bytes read, pages touched, seeks, disk reads and page faults per query type and file
+    bool run(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __QUERY_BENCHMARK_H_
@@ -35,6 +35,8 @@
 
 #include <OsmAndCoreUtils/Inspector.h>
 
+#include "QueryBenchmark.h"
+
 void printUsage(const std::string& warning = std::string());
 
 int main(int argc, char* argv[])
@@ -53,6 +55,17 @@ int main(int argc, char* argv[])
     for (int idx = 1; idx < argc; idx++)
         args.push_back(argv[idx]);
 
+    if(QueryBenchmark::isBenchmarkRequest(args))
+    {
+        QueryBenchmark::Configuration benchmarkCfg;
+        if(!QueryBenchmark::parseCommandLineArguments(args, benchmarkCfg, error))
+        {
+            printUsage(error.toStdString());
+            return -1;
+        }
+        return QueryBenchmark::run(std::cout, benchmarkCfg) ? 0 : -1;
+    }
+
     if(!OsmAnd::Inspector::parseCommandLineArguments(args, cfg, error))
     {
         printUsage(error.toStdString());
@@ -68,5 +81,8 @@ void printUsage(const std::string& warning)
         std::cout << warning << std::endl;
     std::cout << "Inspector is console utility for working with binary indexes of OsmAnd." << std::endl;
     std::cout << std::endl << "Usage: inspector -obf=path [-vaddress] [-vstreetgroups] [-vstreets] [-vbuildings] [-vintersections] [-vmap] [-vmapObjects] [-vpoi] [-vtransport] [-zoom=Zoom] [-bbox=LeftLon,TopLat,RightLon,BottomLan]" << std::endl;
+    std::cout << "   or: inspector -benchmark -obf=path [-obf=path2] [-queries=200] [-zoom=15] [-tiles=4] [-seed=1] [-types=map,routing,poi] [-warm]" << std::endl;
+    std::cout << "\tRuns the same random bbox map, closest road and POI queries against each file and reports bytes read," << std::endl;
+    std::cout << "\tpages touched, seeks, disk reads and page faults per query; page cache is dropped before each query unless '-warm'." << std::endl;
 }
 
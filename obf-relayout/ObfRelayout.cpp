@@ -0,0 +1,401 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObfRelayout.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+
+#include "ObfBlocks.h"
+
+namespace
+{
+    struct SortKey
+    {
+        int missingBbox;
+        int group;
+        uint64_t hilbert;
+        size_t index;
+
+        bool operator<(const SortKey& other) const
+        {
+            if(missingBbox != other.missingBbox)
+                return missingBbox < other.missingBbox;
+            if(group != other.group)
+                return group < other.group;
+            if(hilbert != other.hilbert)
+                return hilbert < other.hilbert;
+            return index < other.index;
+        }
+    };
+
+    SortKey sortKey(const ObfBlocks::Block& block, size_t index)
+    {
+        SortKey key;
+        key.missingBbox = block.hasBbox ? 0 : 1;
+        key.group = block.group;
+        key.hilbert = 0;
+        key.index = index;
+        if(block.hasBbox)
+        {
+            const auto x = static_cast<uint32_t>((static_cast<int64_t>(block.bbox31.left) + block.bbox31.right) / 2);
+            const auto y = static_cast<uint32_t>((static_cast<int64_t>(block.bbox31.top) + block.bbox31.bottom) / 2);
+            key.hilbert = ObfBlocks::hilbertIndex(x, y);
+        }
+        return key;
+    }
+
+    // Bytes skipped between blocks that are neighbours along curve, how far reader has to seek
+    // when it reads adjacent boxes
+    double meanCurveGap(const ObfBlocks::SectionBlocks& blocks, const std::vector<size_t>& curveOrder,
+        const std::vector<qint64>& offsets)
+    {
+        if(curveOrder.size() < 2)
+            return 0.0;
+        double sum = 0.0;
+        for(size_t i = 1; i < curveOrder.size(); i++)
+        {
+            const auto& previous = blocks.blocks[curveOrder[i - 1]];
+            const auto previousEnd = offsets[curveOrder[i - 1]] + previous.length;
+            sum += std::abs(static_cast<double>(offsets[curveOrder[i]] - previousEnd));
+        }
+        return sum / (curveOrder.size() - 1);
+    }
+
+    struct SectionResult
+    {
+        bool relaid;
+        size_t blocksCount;
+        size_t referencesCount;
+        qint64 targetOffset;
+        // Hashes of all blocks (sorted) and of block each reference points to (in file order)
+        std::vector<QByteArray> blockHashes;
+        std::vector<QByteArray> referenceHashes;
+    };
+
+    bool hashBlocks(QFile& file, const ObfBlocks::SectionBlocks& blocks, std::vector<QByteArray>& hashes)
+    {
+        hashes.clear();
+        hashes.reserve(blocks.blocks.size());
+        for(auto itBlock = blocks.blocks.begin(); itBlock != blocks.blocks.end(); ++itBlock)
+        {
+            if(!file.seek(itBlock->offset))
+                return false;
+            QCryptographicHash hash(QCryptographicHash::Md5);
+            qint64 left = itBlock->length;
+            while(left > 0)
+            {
+                const auto chunk = file.read(std::min<qint64>(left, 1024 * 1024));
+                if(chunk.isEmpty())
+                    return false;
+                hash.addData(chunk);
+                left -= chunk.size();
+            }
+            hashes.push_back(hash.result());
+        }
+        return true;
+    }
+
+    // Hash of block each reference points to, references that miss blocks fail
+    bool hashReferences(const ObfBlocks::SectionBlocks& blocks, const std::vector<QByteArray>& blockHashes,
+        std::vector<QByteArray>& hashes)
+    {
+        hashes.clear();
+        hashes.reserve(blocks.references.size());
+        for(auto itReference = blocks.references.begin(); itReference != blocks.references.end(); ++itReference)
+        {
+            const auto blockIdx = ObfBlocks::findBlock(blocks.blocks, itReference->target());
+            if(blockIdx < 0)
+                return false;
+            hashes.push_back(blockHashes[blockIdx]);
+        }
+        return true;
+    }
+
+    bool relayoutSection(std::ostream& output, const ObfRelayout::Configuration& cfg, QFile& inputFile, QFile& outputFile,
+        const ObfBlocks::Section& section, SectionResult& result)
+    {
+        result.relaid = false;
+        ObfBlocks::SectionBlocks blocks;
+        QString error;
+        if(!ObfBlocks::readSectionBlocks(inputFile, section, blocks, error))
+        {
+            output << error.toStdString() << std::endl;
+            return false;
+        }
+        result.blocksCount = blocks.blocks.size();
+        result.referencesCount = blocks.references.size();
+        if(blocks.blocks.size() < 2)
+            return true;
+        if(!ObfBlocks::resolveTargetOffset(blocks, result.targetOffset, error))
+        {
+            // Not an error of file, just a layout this tool does not know, section is kept as is
+            output << "Skipped " << ObfBlocks::sectionTypeName(section.type) << " section '" << section.name.toStdString()
+                << "': " << error.toStdString() << std::endl;
+            return true;
+        }
+
+        // Blocks are checked in output by content, not only by count
+        if(!hashBlocks(inputFile, blocks, result.blockHashes) ||
+            !hashReferences(blocks, result.blockHashes, result.referenceHashes))
+        {
+            output << "Failed to read blocks of " << ObfBlocks::sectionTypeName(section.type) << " section '"
+                << section.name.toStdString() << "'" << std::endl;
+            return false;
+        }
+        std::sort(result.blockHashes.begin(), result.blockHashes.end());
+
+        // New offsets, runs keep their place and size
+        std::vector<qint64> oldOffsets(blocks.blocks.size());
+        std::vector<qint64> newOffsets(blocks.blocks.size());
+        std::vector<size_t> curveOrder;
+        curveOrder.reserve(blocks.blocks.size());
+        size_t runBegin = 0;
+        while(runBegin < blocks.blocks.size())
+        {
+            size_t runEnd = runBegin;
+            while(runEnd < blocks.blocks.size() && blocks.blocks[runEnd].run == blocks.blocks[runBegin].run)
+                runEnd++;
+
+            std::vector<SortKey> keys;
+            keys.reserve(runEnd - runBegin);
+            for(size_t idx = runBegin; idx < runEnd; idx++)
+            {
+                oldOffsets[idx] = blocks.blocks[idx].offset;
+                keys.push_back(sortKey(blocks.blocks[idx], idx));
+            }
+            std::sort(keys.begin(), keys.end());
+
+            auto position = blocks.blocks[runBegin].offset;
+            for(auto itKey = keys.begin(); itKey != keys.end(); ++itKey)
+            {
+                newOffsets[itKey->index] = position;
+                position += blocks.blocks[itKey->index].length;
+                curveOrder.push_back(itKey->index);
+            }
+            runBegin = runEnd;
+        }
+
+        size_t movedCount = 0;
+        qint64 movedBytes = 0;
+        for(size_t idx = 0; idx < blocks.blocks.size(); idx++)
+        {
+            const auto& block = blocks.blocks[idx];
+            if(newOffsets[idx] == block.offset)
+                continue;
+            if(!ObfBlocks::copyRange(inputFile, block.offset, outputFile, newOffsets[idx], block.length))
+            {
+                output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+                return false;
+            }
+            movedCount++;
+            movedBytes += block.length;
+        }
+
+        for(auto itReference = blocks.references.begin(); itReference != blocks.references.end(); ++itReference)
+        {
+            const auto blockIdx = ObfBlocks::findBlock(blocks.blocks, itReference->target());
+            const auto delta = newOffsets[blockIdx] - blocks.blocks[blockIdx].offset;
+            if(delta == 0)
+                continue;
+            const auto value = static_cast<qint64>(itReference->value) + delta;
+            if(value < 0 || value > std::numeric_limits<uint32_t>::max() ||
+                !outputFile.seek(itReference->position) || !ObfBlocks::writeFixed32(outputFile, static_cast<uint32_t>(value)))
+            {
+                output << "Failed to update shift at " << itReference->position << std::endl;
+                return false;
+            }
+        }
+
+        result.relaid = true;
+        output << "Relaid out " << ObfBlocks::sectionTypeName(section.type) << " section '" << section.name.toStdString() << "': "
+            << blocks.blocks.size() << " blocks in " << blocks.runsCount << " run(s), "
+            << blocks.references.size() << " shifts, " << movedCount << " blocks (" << movedBytes << " bytes) moved" << std::endl;
+        if(cfg.verbose)
+        {
+            output << "\tMean gap between blocks adjacent along curve: " << meanCurveGap(blocks, curveOrder, oldOffsets)
+                << " bytes before, " << meanCurveGap(blocks, curveOrder, newOffsets) << " bytes after" << std::endl;
+        }
+        return true;
+    }
+
+    // Reads structure of output back, each relaid section has to have blocks of the same content,
+    // and each of its shifts has to point to block with the same content as before
+    bool verify(std::ostream& output, const QString& path, const std::vector<ObfBlocks::Section>& sections,
+        const std::vector<SectionResult>& results)
+    {
+        QFile file(path);
+        if(!file.open(QIODevice::ReadOnly))
+            return false;
+        QString error;
+        std::vector<ObfBlocks::Section> writtenSections;
+        if(!ObfBlocks::readStructure(file, writtenSections, error) || writtenSections.size() != sections.size())
+        {
+            output << "Verification failed: " << error.toStdString() << std::endl;
+            return false;
+        }
+        for(size_t idx = 0; idx < sections.size(); idx++)
+        {
+            if(!results[idx].relaid)
+                continue;
+            ObfBlocks::SectionBlocks blocks;
+            qint64 targetOffset;
+            if(!ObfBlocks::readSectionBlocks(file, writtenSections[idx], blocks, error) ||
+                !ObfBlocks::resolveTargetOffset(blocks, targetOffset, error))
+            {
+                output << "Verification failed: " << error.toStdString() << std::endl;
+                return false;
+            }
+            std::vector<QByteArray> blockHashes;
+            std::vector<QByteArray> referenceHashes;
+            const auto hashed = hashBlocks(file, blocks, blockHashes) && hashReferences(blocks, blockHashes, referenceHashes);
+            std::sort(blockHashes.begin(), blockHashes.end());
+            if(!hashed || blocks.blocks.size() != results[idx].blocksCount || blocks.references.size() != results[idx].referencesCount ||
+                targetOffset != results[idx].targetOffset || blockHashes != results[idx].blockHashes ||
+                referenceHashes != results[idx].referenceHashes)
+            {
+                output << "Verification failed: blocks of " << ObfBlocks::sectionTypeName(sections[idx].type)
+                    << " section '" << sections[idx].name.toStdString() << "' differ" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+ObfRelayout::Configuration::Configuration()
+    : verbose(false)
+{
+}
+
+bool ObfRelayout::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-obf="))
+        {
+            cfg.input = arg.mid(strlen("-obf="));
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.output = arg.mid(strlen("-output="));
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else
+        {
+            error = "Unknown argument '" + arg + "'";
+            return false;
+        }
+    }
+    if(cfg.input.isEmpty() || !QFile::exists(cfg.input))
+    {
+        error = "Input OBF file does not exist";
+        return false;
+    }
+    if(cfg.output.isEmpty())
+    {
+        error = "Output OBF file is required";
+        return false;
+    }
+    if(QFileInfo(cfg.input).absoluteFilePath() == QFileInfo(cfg.output).absoluteFilePath())
+    {
+        error = "Output has to differ from input";
+        return false;
+    }
+    return true;
+}
+
+bool ObfRelayout::relayout(std::ostream& output, const Configuration& cfg)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    QFile inputFile(cfg.input);
+    if(!inputFile.open(QIODevice::ReadOnly))
+    {
+        output << "Failed to open '" << cfg.input.toStdString() << "'" << std::endl;
+        return false;
+    }
+    QString error;
+    std::vector<ObfBlocks::Section> sections;
+    if(!ObfBlocks::readStructure(inputFile, sections, error))
+    {
+        output << error.toStdString() << std::endl;
+        return false;
+    }
+
+    // Everything but blocks stays in place, so file is copied first and blocks are moved over it
+    const QString temporaryPath = cfg.output + ".tmp";
+    QFile outputFile(temporaryPath);
+    if(!outputFile.open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+        !ObfBlocks::copyRange(inputFile, 0, outputFile, 0, inputFile.size()))
+    {
+        output << "Failed to write '" << temporaryPath.toStdString() << "'" << std::endl;
+        QFile::remove(temporaryPath);
+        return false;
+    }
+
+    std::vector<SectionResult> results(sections.size());
+    for(size_t idx = 0; idx < sections.size(); idx++)
+    {
+        results[idx].relaid = false;
+        if(sections[idx].type == ObfBlocks::SectionType::Other)
+            continue;
+        if(!relayoutSection(output, cfg, inputFile, outputFile, sections[idx], results[idx]))
+        {
+            outputFile.close();
+            QFile::remove(temporaryPath);
+            return false;
+        }
+    }
+    outputFile.close();
+
+    if(!verify(output, temporaryPath, sections, results))
+    {
+        QFile::remove(temporaryPath);
+        return false;
+    }
+    // Output is read back for verification, so it can't be written through QSaveFile
+    if(!ObfBlocks::replaceFile(temporaryPath, cfg.output))
+    {
+        QFile::remove(temporaryPath);
+        output << "Failed to write '" << cfg.output.toStdString() << "'" << std::endl;
+        return false;
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    output << "Written '" << cfg.output.toStdString() << "' in "
+        << std::chrono::duration<double, std::milli>(finish - start).count() << " ms" << std::endl;
+    return true;
+}
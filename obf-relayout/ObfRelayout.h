@@ -0,0 +1,51 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBF_RELAYOUT_H_
+#define __OBF_RELAYOUT_H_
+
+#include <ostream>
+
+#include <QString>
+#include <QStringList>
+
+namespace ObfRelayout
+{
+    struct Configuration
+    {
+        Configuration();
+
+        QString input;
+        QString output;
+        bool verbose;
+    };
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Rewrites OBF with data blocks of every map level, routing tree and POI zoom ordered along
+    // Hilbert curve, so blocks of nearby boxes are near in file too. Blocks are only permuted
+    // within runs of adjacent blocks, so every size in file stays the same and only fixed32 shifts
+    // to blocks are changed. Output is verified by reading its structure back.
+    bool relayout(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __OBF_RELAYOUT_H_
@@ -0,0 +1,74 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <memory>
+#if (defined(UNICODE) || defined(_UNICODE)) && defined(_WIN32)
+#   include <io.h>
+#   include <fcntl.h>
+#endif
+
+#include <QFile>
+#include <QStringList>
+
+#include "ObfRelayout.h"
+
+void printUsage(const std::string& warning = std::string());
+
+int main(int argc, char* argv[])
+{
+#if defined(UNICODE) || defined(_UNICODE)
+#   if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_U16TEXT);
+#   else
+    std::locale::global(std::locale(""));
+#   endif
+#endif
+    ObfRelayout::Configuration cfg;
+
+    QString error;
+    QStringList args;
+    for (int idx = 1; idx < argc; idx++)
+        args.push_back(argv[idx]);
+
+    if(!ObfRelayout::parseCommandLineArguments(args, cfg, error))
+    {
+        printUsage(error.toStdString());
+        return -1;
+    }
+    return ObfRelayout::relayout(std::cout, cfg) ? 0 : -1;
+}
+
+void printUsage(const std::string& warning)
+{
+    if(!warning.empty())
+        std::cout << warning << std::endl;
+    std::cout << "Relayout is console utility that orders data blocks of OsmAnd binary index along Hilbert curve." << std::endl;
+    std::cout << std::endl << "Usage: relayout -obf=path -output=path [-verbose]" << std::endl;
+    std::cout << "\tBlocks of each map level, routing tree and POI zoom are reordered so that blocks of nearby boxes" << std::endl;
+    std::cout << "\tare near in file, bbox queries then read fewer scattered pages. Sizes of everything stay the same," << std::endl;
+    std::cout << "\tonly shifts to blocks are changed, output is readable by any OBF reader." << std::endl;
+    std::cout << "\tCompare with 'inspector -benchmark -obf=original.obf -obf=relaid.obf'." << std::endl;
+}
@@ -0,0 +1,369 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ObfSearch.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/Utilities.h>
+
+#include "Statistics.h"
+
+namespace
+{
+    struct Match
+    {
+        size_t index;
+        PoiIndex::Result result;
+    };
+
+    QString indexPathFor(const ObfSearch::Configuration& cfg, const QString& obfPath)
+    {
+        const QString fileName = QFileInfo(obfPath).fileName() + ".poi.idx";
+        if(cfg.indexDir.isEmpty())
+            return QFileInfo(obfPath).absoluteDir().filePath(fileName);
+        return QDir(cfg.indexDir).filePath(fileName);
+    }
+
+    bool loadIndexes(std::ostream& output, const ObfSearch::Configuration& cfg, std::vector< std::unique_ptr<PoiIndex> >& indexes)
+    {
+        PoiIndex::BuildStats total;
+        int built = 0;
+        for(auto itObf = cfg.obfFiles.begin(); itObf != cfg.obfFiles.end(); ++itObf)
+        {
+            const auto indexPath = indexPathFor(cfg, *itObf);
+            QString error;
+            std::unique_ptr<PoiIndex> index;
+            if(!cfg.rebuild)
+                index = PoiIndex::open(*itObf, indexPath, error);
+            if(!index)
+            {
+                PoiIndex::BuildStats stats;
+                if(!PoiIndex::build(*itObf, indexPath, stats, error))
+                {
+                    output << "'" << itObf->toStdString() << "': " << error.toStdString() << std::endl;
+                    return false;
+                }
+                if(cfg.verbose)
+                {
+                    output << "Indexed '" << itObf->toStdString() << "': " << stats.pois << " POIs, " << stats.terms
+                        << " words, " << stats.indexBytes << " bytes of index in " << stats.seconds * 1000.0 << " ms" << std::endl;
+                }
+                total.obfBytes += stats.obfBytes;
+                total.indexBytes += stats.indexBytes;
+                total.pois += stats.pois;
+                total.terms += stats.terms;
+                total.seconds += stats.seconds;
+                built++;
+                index = PoiIndex::open(*itObf, indexPath, error);
+                if(!index)
+                {
+                    output << "'" << indexPath.toStdString() << "': " << error.toStdString() << std::endl;
+                    return false;
+                }
+            }
+            indexes.push_back(std::move(index));
+        }
+
+        if(built > 0)
+        {
+            const double seconds = std::max(total.seconds, 1e-9);
+            output << "Indexed " << built << " of " << cfg.obfFiles.size() << " files: " << total.pois << " POIs from "
+                << total.obfBytes / (1024.0 * 1024.0) << " MB in " << total.seconds << " s ("
+                << total.pois / seconds << " POIs/s, " << total.obfBytes / (1024.0 * 1024.0) / seconds << " MB/s), index "
+                << 100.0 * total.indexBytes / std::max<qint64>(1, total.obfBytes) << "% of OBF size" << std::endl;
+        }
+        return true;
+    }
+
+    void search(const std::vector< std::unique_ptr<PoiIndex> >& indexes, const PoiIndex::Query& query, std::vector<Match>& matches)
+    {
+        std::vector<PoiIndex::Result> results;
+        for(size_t idx = 0; idx < indexes.size(); idx++)
+        {
+            results.clear();
+            indexes[idx]->query(query, results);
+            for(auto itResult = results.begin(); itResult != results.end(); ++itResult)
+            {
+                Match match;
+                match.index = idx;
+                match.result = *itResult;
+                matches.push_back(match);
+            }
+        }
+        if(query.hasPoint)
+        {
+            std::stable_sort(matches.begin(), matches.end(), [](const Match& l, const Match& r)
+            {
+                return l.result.distance < r.result.distance;
+            });
+        }
+        if(matches.size() > static_cast<size_t>(query.limit))
+            matches.resize(query.limit);
+    }
+
+    // Query is prefix of word of random POI, near it within radius of configuration, and half of
+    // the time also in category of that POI
+    bool makeQueries(const ObfSearch::Configuration& cfg, const std::vector< std::unique_ptr<PoiIndex> >& indexes,
+        std::vector<PoiIndex::Query>& queries)
+    {
+        std::vector<size_t> candidates;
+        for(size_t idx = 0; idx < indexes.size(); idx++)
+        {
+            if(indexes[idx]->poisCount() > 0)
+                candidates.push_back(idx);
+        }
+        if(candidates.empty())
+            return false;
+
+        std::mt19937 generator(cfg.seed);
+        const double radius = cfg.query.radius > 0 ? cfg.query.radius : 5000.0;
+        for(int idx = 0; idx < cfg.benchmarkQueries; idx++)
+        {
+            const auto& index = *indexes[candidates[generator() % candidates.size()]];
+            const auto poi = static_cast<uint32_t>(generator() % index.poisCount());
+
+            PoiIndex::Query query;
+            query.limit = cfg.query.limit;
+            query.radius = radius;
+            query.hasPoint = true;
+            // Point is up to half of radius away from POI
+            const auto offset31 = static_cast<int64_t>(radius / 2 / PoiIndex::metersPer31(index.y31(poi)));
+            std::uniform_int_distribution<int64_t> offsets(-offset31, offset31);
+            query.x31 = static_cast<int32_t>(std::min<int64_t>(INT32_MAX, std::max<int64_t>(0, index.x31(poi) + offsets(generator))));
+            query.y31 = static_cast<int32_t>(std::min<int64_t>(INT32_MAX, std::max<int64_t>(0, index.y31(poi) + offsets(generator))));
+
+            const auto words = QString::fromUtf8(index.normalizedName(poi)).split(' ', QString::SkipEmptyParts);
+            if(!words.isEmpty())
+            {
+                const auto& word = words[generator() % words.size()];
+                query.text = word.left(1 + generator() % std::min(4, word.size()));
+            }
+            if(generator() % 2 == 0)
+            {
+                const auto categories = index.categories();
+                for(int category = 0; category < categories.size(); category++)
+                {
+                    if(index.hasCategory(poi, category))
+                    {
+                        query.category = categories[category];
+                        break;
+                    }
+                }
+            }
+            queries.push_back(query);
+        }
+        return true;
+    }
+}
+
+ObfSearch::Configuration::Configuration()
+    : rebuild(false)
+    , hasQuery(false)
+    , benchmarkQueries(0)
+    , seed(1)
+    , verbose(false)
+{
+    query.radius = 5000.0;
+}
+
+bool ObfSearch::parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error)
+{
+    for(auto itArg = args.begin(); itArg != args.end(); ++itArg)
+    {
+        const auto& arg = *itArg;
+        if(arg.startsWith("-obf="))
+        {
+            const auto path = arg.mid(strlen("-obf="));
+            if(!QFile::exists(path))
+            {
+                error = "OBF file '" + path + "' does not exist";
+                return false;
+            }
+            cfg.obfFiles.push_back(path);
+        }
+        else if(arg.startsWith("-obfsDir="))
+        {
+            const QDir obfsDir(arg.mid(strlen("-obfsDir=")));
+            if(!obfsDir.exists())
+            {
+                error = "OBFs directory does not exist";
+                return false;
+            }
+            const auto fileNames = obfsDir.entryList(QStringList() << "*.obf", QDir::Files, QDir::Name);
+            for(auto itFileName = fileNames.begin(); itFileName != fileNames.end(); ++itFileName)
+                cfg.obfFiles.push_back(obfsDir.filePath(*itFileName));
+        }
+        else if(arg.startsWith("-indexDir="))
+        {
+            cfg.indexDir = arg.mid(strlen("-indexDir="));
+        }
+        else if(arg == "-rebuild")
+        {
+            cfg.rebuild = true;
+        }
+        else if(arg.startsWith("-query="))
+        {
+            cfg.query.text = arg.mid(strlen("-query="));
+            cfg.hasQuery = true;
+        }
+        else if(arg.startsWith("-category="))
+        {
+            cfg.query.category = arg.mid(strlen("-category="));
+            cfg.hasQuery = true;
+        }
+        else if(arg.startsWith("-near="))
+        {
+            const auto values = arg.mid(strlen("-near=")).split(';');
+            bool latOk = false, lonOk = false;
+            const auto lat = values.size() == 2 ? values[0].toDouble(&latOk) : 0.0;
+            const auto lon = values.size() == 2 ? values[1].toDouble(&lonOk) : 0.0;
+            if(!latOk || !lonOk)
+            {
+                error = "Point has to be given as lat;lon";
+                return false;
+            }
+            cfg.query.hasPoint = true;
+            cfg.query.x31 = OsmAnd::Utilities::get31TileNumberX(lon);
+            cfg.query.y31 = OsmAnd::Utilities::get31TileNumberY(lat);
+            cfg.hasQuery = true;
+        }
+        else if(arg.startsWith("-radius="))
+        {
+            cfg.query.radius = arg.mid(strlen("-radius=")).toDouble();
+        }
+        else if(arg.startsWith("-limit="))
+        {
+            cfg.query.limit = arg.mid(strlen("-limit=")).toInt();
+        }
+        else if(arg.startsWith("-benchmark="))
+        {
+            cfg.benchmarkQueries = arg.mid(strlen("-benchmark=")).toInt();
+        }
+        else if(arg.startsWith("-seed="))
+        {
+            cfg.seed = arg.mid(strlen("-seed=")).toUInt();
+        }
+        else if(arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else
+        {
+            error = "Unknown argument '" + arg + "'";
+            return false;
+        }
+    }
+    if(cfg.obfFiles.isEmpty())
+    {
+        error = "At least one OBF file is required";
+        return false;
+    }
+    if(!cfg.indexDir.isEmpty() && !QDir(cfg.indexDir).exists())
+    {
+        error = "Index directory does not exist";
+        return false;
+    }
+    if(cfg.query.limit <= 0 || cfg.query.radius < 0 || cfg.benchmarkQueries < 0)
+    {
+        error = "Invalid search parameters";
+        return false;
+    }
+    return true;
+}
+
+bool ObfSearch::run(std::ostream& output, const Configuration& cfg)
+{
+    const auto loadStart = std::chrono::steady_clock::now();
+    std::vector< std::unique_ptr<PoiIndex> > indexes;
+    if(!loadIndexes(output, cfg, indexes))
+        return false;
+    uint64_t poisCount = 0;
+    for(auto itIndex = indexes.begin(); itIndex != indexes.end(); ++itIndex)
+        poisCount += (*itIndex)->poisCount();
+    const auto loadFinish = std::chrono::steady_clock::now();
+    output << "Ready to search " << poisCount << " POIs of " << indexes.size() << " files in "
+        << std::chrono::duration<double, std::milli>(loadFinish - loadStart).count() << " ms" << std::endl;
+
+    if(cfg.hasQuery)
+    {
+        std::vector<Match> matches;
+        const auto start = std::chrono::steady_clock::now();
+        search(indexes, cfg.query, matches);
+        const auto finish = std::chrono::steady_clock::now();
+        for(auto itMatch = matches.begin(); itMatch != matches.end(); ++itMatch)
+        {
+            const auto& index = *indexes[itMatch->index];
+            const auto poi = itMatch->result.poi;
+            output << index.name(poi) << " [" << index.type(poi) << "] "
+                << OsmAnd::Utilities::get31LatitudeY(index.y31(poi)) << " " << OsmAnd::Utilities::get31LongitudeX(index.x31(poi));
+            if(cfg.query.hasPoint)
+                output << " " << static_cast<int>(itMatch->result.distance) << " m";
+            if(cfg.verbose)
+                output << " (" << cfg.obfFiles[static_cast<int>(itMatch->index)].toStdString() << ")";
+            output << std::endl;
+        }
+        output << matches.size() << " found in " << std::chrono::duration<double, std::micro>(finish - start).count() << " us" << std::endl;
+    }
+
+    if(cfg.benchmarkQueries > 0)
+    {
+        std::vector<PoiIndex::Query> queries;
+        if(!makeQueries(cfg, indexes, queries))
+        {
+            output << "No POIs to make benchmark queries of" << std::endl;
+            return false;
+        }
+        std::vector<double> times;
+        std::vector<Match> matches;
+        uint64_t found = 0;
+        times.reserve(queries.size());
+        for(auto itQuery = queries.begin(); itQuery != queries.end(); ++itQuery)
+        {
+            matches.clear();
+            const auto start = std::chrono::steady_clock::now();
+            search(indexes, *itQuery, matches);
+            const auto finish = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::micro>(finish - start).count());
+            found += matches.size();
+        }
+        double total = 0;
+        for(auto itTime = times.begin(); itTime != times.end(); ++itTime)
+            total += *itTime;
+        output << queries.size() << " random prefix queries within " << queries.front().radius << " m across "
+            << indexes.size() << " files, " << static_cast<double>(found) / queries.size() << " results per query" << std::endl;
+        output << "\tLatency: " << Statistics::percentile(times, 50.0) << " us p50, " << Statistics::percentile(times, 90.0) << " us p90, "
+            << Statistics::percentile(times, 99.0) << " us p99, " << Statistics::percentile(times, 100.0) << " us max" << std::endl;
+        output << "\tThroughput: " << queries.size() / std::max(total / 1e6, 1e-9) << " queries/s" << std::endl;
+    }
+    return true;
+}
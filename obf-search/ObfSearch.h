@@ -0,0 +1,59 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OBF_SEARCH_H_
+#define __OBF_SEARCH_H_
+
+#include <stdint.h>
+#include <ostream>
+
+#include <QString>
+#include <QStringList>
+
+#include "PoiIndex.h"
+
+namespace ObfSearch
+{
+    struct Configuration
+    {
+        Configuration();
+
+        QStringList obfFiles;
+        // Indexes are stored next to OBFs unless set
+        QString indexDir;
+        bool rebuild;
+        bool hasQuery;
+        PoiIndex::Query query;
+        // Random queries made from indexed POIs, 0 to skip benchmark
+        int benchmarkQueries;
+        uint32_t seed;
+        bool verbose;
+    };
+
+    bool parseCommandLineArguments(const QStringList& args, Configuration& cfg, QString& error);
+
+    // Builds missing or stale indexes reporting indexing throughput, then answers query across all
+    // files and reports latency percentiles of random queries
+    bool run(std::ostream& output, const Configuration& cfg);
+}
+
+#endif // __OBF_SEARCH_H_
@@ -0,0 +1,904 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoiIndex.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QHash>
+
+#include <OsmAndCore/Utilities.h>
+
+#include "ObfBlocks.h"
+#include "TextNormalization.h"
+
+// Index file is array of structures below in host byte order. Index built on host with other
+// byte order fails magic check and is rebuilt.
+struct PoiIndex::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t obfSize;
+    int64_t obfModified;
+    uint32_t cellZoom;
+    uint32_t poisCount;
+    uint32_t termsCount;
+    uint32_t postingsCount;
+    uint32_t cellsCount;
+    uint32_t categoriesCount;
+    uint64_t poisOffset;
+    uint64_t termsOffset;
+    uint64_t postingsOffset;
+    uint64_t cellsOffset;
+    uint64_t categoriesOffset;
+    uint64_t bitmapsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+// Strings are offsets of NUL-terminated UTF-8 in strings pool
+struct PoiIndex::Poi
+{
+    int32_t x31;
+    int32_t y31;
+    uint32_t name;
+    uint32_t normalizedName;
+    uint32_t type;
+};
+
+// Terms and cells end with sentinel, so that range of entry i is [i].first .. [i + 1].first
+struct PoiIndex::Term
+{
+    uint32_t text;
+    uint32_t firstPosting;
+};
+
+struct PoiIndex::Cell
+{
+    uint32_t key;
+    uint32_t firstPoi;
+};
+
+namespace
+{
+    using namespace ObfBlocks;
+
+    const uint32_t IndexMagic = 0x58444950; // "PIDX"
+    const uint32_t FormatVersion = 1;
+    // Category of POI atom is (subcategory << 7) | category
+    const int CategoryBits = 7;
+    const double EarthCircumference = 40075016.686;
+
+    inline uint32_t cellKey(int32_t x31, int32_t y31)
+    {
+        const int shift = 31 - PoiIndex::CellZoom;
+        return (static_cast<uint32_t>(y31) >> shift << PoiIndex::CellZoom) | (static_cast<uint32_t>(x31) >> shift);
+    }
+
+    inline uint32_t bitmapWords(uint32_t poisCount)
+    {
+        return (poisCount + 63) / 64;
+    }
+
+    struct Category
+    {
+        QString name;
+        QStringList subcategories;
+    };
+
+    struct PendingPoi
+    {
+        int32_t x31;
+        int32_t y31;
+        uint32_t cell;
+        QString name;
+        QString normalizedName;
+        QString type;
+        std::vector<uint16_t> categories;
+    };
+
+    bool readCategory(MessageReader& message, Category& category)
+    {
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            QString value;
+            if(field == PoiCategoryTableCategory && isLengthDelimited(wireType))
+            {
+                if(!message.readString(category.name, wireType))
+                    return false;
+            }
+            else if(field == PoiCategoryTableSubcategories && isLengthDelimited(wireType))
+            {
+                if(!message.readString(value, wireType))
+                    return false;
+                category.subcategories.push_back(value);
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Atom stores category index of its section, it is turned into index global for file
+    bool readAtom(MessageReader& message, uint32_t zoom, uint32_t x, uint32_t y, const std::vector<Category>& categories,
+        const std::vector<uint16_t>& categoryIds, PendingPoi& poi)
+    {
+        int32_t dx = 0, dy = 0;
+        QString nameEn;
+        std::vector<uint64_t> values;
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            uint64_t value;
+            if(field == PoiAtomDx && wireType == WireVarint)
+            {
+                if(!message.readVarint(value))
+                    return false;
+                dx = decodeZigZag(value);
+            }
+            else if(field == PoiAtomDy && wireType == WireVarint)
+            {
+                if(!message.readVarint(value))
+                    return false;
+                dy = decodeZigZag(value);
+            }
+            else if(field == PoiAtomCategories && wireType == WireVarint)
+            {
+                if(!message.readVarint(value))
+                    return false;
+                values.push_back(value);
+            }
+            else if(field == PoiAtomCategories && wireType == WireLengthDelimited)
+            {
+                MessageReader packed;
+                if(!message.readMessage(packed, wireType))
+                    return false;
+                while(!packed.atEnd())
+                {
+                    if(!packed.readVarint(value))
+                        return false;
+                    values.push_back(value);
+                }
+            }
+            else if(field == PoiAtomName && isLengthDelimited(wireType))
+            {
+                if(!message.readString(poi.name, wireType))
+                    return false;
+            }
+            else if(field == PoiAtomNameEn && isLengthDelimited(wireType))
+            {
+                if(!message.readString(nameEn, wireType))
+                    return false;
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+
+        // Atom offsets are in 24-bit tiles
+        poi.x31 = static_cast<int32_t>(((static_cast<int64_t>(x) << (24 - zoom)) + dx) << 7);
+        poi.y31 = static_cast<int32_t>(((static_cast<int64_t>(y) << (24 - zoom)) + dy) << 7);
+        poi.cell = cellKey(poi.x31, poi.y31);
+
+        // Words of both names, each once
+        QStringList words;
+        const auto allWords = TextNormalization::normalize(poi.name + ' ' + nameEn).split(' ', QString::SkipEmptyParts);
+        for(auto itWord = allWords.begin(); itWord != allWords.end(); ++itWord)
+        {
+            if(!words.contains(*itWord))
+                words.push_back(*itWord);
+        }
+        poi.normalizedName = words.join(" ");
+        if(poi.name.isEmpty())
+            poi.name = nameEn;
+
+        for(auto itValue = values.begin(); itValue != values.end(); ++itValue)
+        {
+            const auto categoryIdx = static_cast<size_t>(*itValue & ((1 << CategoryBits) - 1));
+            const auto subcategoryIdx = static_cast<int>(*itValue >> CategoryBits);
+            if(categoryIdx >= categories.size())
+                continue;
+            const auto& category = categories[categoryIdx];
+            if(poi.type.isEmpty())
+            {
+                poi.type = category.name;
+                if(subcategoryIdx < category.subcategories.size())
+                    poi.type += ':' + category.subcategories[subcategoryIdx];
+            }
+            if(std::find(poi.categories.begin(), poi.categories.end(), categoryIds[categoryIdx]) == poi.categories.end())
+                poi.categories.push_back(categoryIds[categoryIdx]);
+        }
+        return true;
+    }
+
+    bool readData(MessageReader& message, const std::vector<Category>& categories, const std::vector<uint16_t>& categoryIds,
+        std::vector<PendingPoi>& pois)
+    {
+        uint64_t zoom = 0, x = 0, y = 0;
+        while(!message.atEnd())
+        {
+            int field, wireType;
+            if(!message.readTag(field, wireType))
+                return false;
+            if(field == PoiDataZoom && wireType == WireVarint)
+            {
+                if(!message.readVarint(zoom))
+                    return false;
+            }
+            else if(field == PoiDataX && wireType == WireVarint)
+            {
+                if(!message.readVarint(x))
+                    return false;
+            }
+            else if(field == PoiDataY && wireType == WireVarint)
+            {
+                if(!message.readVarint(y))
+                    return false;
+            }
+            else if(field == PoiDataAtoms && isLengthDelimited(wireType))
+            {
+                MessageReader atom;
+                if(zoom > 24 || !message.readMessage(atom, wireType))
+                    return false;
+                PendingPoi poi;
+                if(!readAtom(atom, static_cast<uint32_t>(zoom), static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                    categories, categoryIds, poi))
+                    return false;
+                pois.push_back(std::move(poi));
+            }
+            else if(!message.skip(wireType))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Reads categories table and data blocks of POI section, box tree and name index are skipped
+    bool readPoiSection(QFile& file, const Section& section, QHash<QString, uint16_t>& globalCategories,
+        QStringList& categoryNames, std::vector<PendingPoi>& pois, QString& error)
+    {
+        std::vector<Category> categories;
+        std::vector<uint16_t> categoryIds;
+        if(!file.seek(section.contentOffset))
+        {
+            error = "Failed to read POI section";
+            return false;
+        }
+        while(file.pos() < section.end)
+        {
+            int field, wireType;
+            if(!readTag(file, field, wireType))
+            {
+                error = "Failed to read POI section";
+                return false;
+            }
+            if((field == PoiIndexCategoriesTable || field == PoiIndexData) && isLengthDelimited(wireType))
+            {
+                qint64 length;
+                if(!readLength(file, wireType, length) || file.pos() + length > section.end)
+                {
+                    error = "Broken POI section";
+                    return false;
+                }
+                const auto bytes = file.read(length);
+                MessageReader message(bytes.constData(), bytes.size());
+                if(field == PoiIndexCategoriesTable)
+                {
+                    Category category;
+                    if(bytes.size() != length || !readCategory(message, category))
+                    {
+                        error = "Broken POI categories table";
+                        return false;
+                    }
+                    auto itId = globalCategories.constFind(category.name);
+                    if(itId == globalCategories.constEnd())
+                    {
+                        itId = globalCategories.insert(category.name, static_cast<uint16_t>(categoryNames.size()));
+                        categoryNames.push_back(category.name);
+                    }
+                    categoryIds.push_back(*itId);
+                    categories.push_back(category);
+                }
+                else if(bytes.size() != length || !readData(message, categories, categoryIds, pois))
+                {
+                    error = "Broken POI data block";
+                    return false;
+                }
+            }
+            else if(!skipField(file, wireType))
+            {
+                error = "Failed to read POI section";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    class StringPool
+    {
+    public:
+        StringPool()
+        {
+            // Offset 0 is empty string
+            _data.append('\0');
+            _offsets.insert(QByteArray(), 0);
+        }
+
+        // Shared copy for values that repeat a lot, like types and words
+        uint32_t add(const QByteArray& value)
+        {
+            const auto itOffset = _offsets.constFind(value);
+            if(itOffset != _offsets.constEnd())
+                return *itOffset;
+            const auto offset = append(value);
+            _offsets.insert(value, offset);
+            return offset;
+        }
+
+        // Names are mostly unique, looking them up would only cost time
+        uint32_t append(const QByteArray& value)
+        {
+            if(value.isEmpty())
+                return 0;
+            const auto offset = static_cast<uint32_t>(_data.size());
+            _data.append(value);
+            _data.append('\0');
+            return offset;
+        }
+
+        const QByteArray& data() const
+        {
+            return _data;
+        }
+
+    private:
+        QByteArray _data;
+        QHash<QByteArray, uint32_t> _offsets;
+    };
+
+    template<typename T>
+    uint64_t appendArray(QByteArray& output, const std::vector<T>& values)
+    {
+        while(output.size() % 8 != 0)
+            output.append('\0');
+        const auto offset = static_cast<uint64_t>(output.size());
+        if(!values.empty())
+            output.append(reinterpret_cast<const char*>(values.data()), static_cast<int>(values.size() * sizeof(T)));
+        return offset;
+    }
+
+    bool hasWordWithPrefix(const char* words, const QByteArray& prefix)
+    {
+        for(const char* word = words; word != nullptr; )
+        {
+            if(strncmp(word, prefix.constData(), prefix.size()) == 0)
+                return true;
+            word = strchr(word, ' ');
+            if(word != nullptr)
+                word++;
+        }
+        return false;
+    }
+}
+
+PoiIndex::BuildStats::BuildStats()
+    : obfBytes(0)
+    , indexBytes(0)
+    , pois(0)
+    , terms(0)
+    , seconds(0)
+{
+}
+
+PoiIndex::Query::Query()
+    : hasPoint(false)
+    , x31(0)
+    , y31(0)
+    , radius(0)
+    , limit(10)
+{
+}
+
+PoiIndex::PoiIndex()
+    : _data(nullptr)
+    , _header(nullptr)
+    , _pois(nullptr)
+    , _terms(nullptr)
+    , _postings(nullptr)
+    , _cells(nullptr)
+    , _categoryNames(nullptr)
+    , _bitmaps(nullptr)
+    , _strings(nullptr)
+{
+}
+
+PoiIndex::~PoiIndex()
+{
+    if(_data != nullptr)
+        _file.unmap(const_cast<uchar*>(_data));
+}
+
+double PoiIndex::metersPer31(int32_t y31)
+{
+    const double latitude = OsmAnd::Utilities::get31LatitudeY(y31);
+    return EarthCircumference * std::cos(latitude * M_PI / 180.0) / 2147483648.0;
+}
+
+bool PoiIndex::build(const QString& obfPath, const QString& indexPath, BuildStats& stats, QString& error)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    QFile obfFile(obfPath);
+    if(!obfFile.open(QIODevice::ReadOnly))
+    {
+        error = "Failed to open '" + obfPath + "'";
+        return false;
+    }
+    std::vector<Section> sections;
+    if(!readStructure(obfFile, sections, error))
+        return false;
+
+    QHash<QString, uint16_t> globalCategories;
+    QStringList categoryNames;
+    std::vector<PendingPoi> pendingPois;
+    for(auto itSection = sections.begin(); itSection != sections.end(); ++itSection)
+    {
+        if(itSection->type != SectionType::Poi)
+            continue;
+        if(!readPoiSection(obfFile, *itSection, globalCategories, categoryNames, pendingPois, error))
+            return false;
+    }
+    std::sort(pendingPois.begin(), pendingPois.end(), [](const PendingPoi& l, const PendingPoi& r)
+    {
+        if(l.cell != r.cell)
+            return l.cell < r.cell;
+        if(l.x31 != r.x31)
+            return l.x31 < r.x31;
+        return l.y31 < r.y31;
+    });
+
+    StringPool strings;
+    const auto poisCount = static_cast<uint32_t>(pendingPois.size());
+    std::vector<Poi> pois;
+    std::vector<Cell> cells;
+    std::vector<uint64_t> bitmaps(static_cast<size_t>(categoryNames.size()) * bitmapWords(poisCount), 0);
+    QHash<QByteArray, std::vector<uint32_t> > postingsByWord;
+    pois.reserve(pendingPois.size());
+    for(uint32_t idx = 0; idx < poisCount; idx++)
+    {
+        const auto& pending = pendingPois[idx];
+        if(cells.empty() || cells.back().key != pending.cell)
+        {
+            Cell cell;
+            cell.key = pending.cell;
+            cell.firstPoi = idx;
+            cells.push_back(cell);
+        }
+
+        Poi poi;
+        poi.x31 = pending.x31;
+        poi.y31 = pending.y31;
+        poi.name = strings.append(pending.name.toUtf8());
+        poi.normalizedName = strings.append(pending.normalizedName.toUtf8());
+        poi.type = strings.add(pending.type.toUtf8());
+        pois.push_back(poi);
+
+        const auto words = pending.normalizedName.split(' ', QString::SkipEmptyParts);
+        for(auto itWord = words.begin(); itWord != words.end(); ++itWord)
+            postingsByWord[itWord->toUtf8()].push_back(idx);
+        for(auto itCategory = pending.categories.begin(); itCategory != pending.categories.end(); ++itCategory)
+            bitmaps[*itCategory * bitmapWords(poisCount) + idx / 64] |= static_cast<uint64_t>(1) << (idx % 64);
+    }
+    Cell cellsEnd;
+    cellsEnd.key = UINT32_MAX;
+    cellsEnd.firstPoi = poisCount;
+    cells.push_back(cellsEnd);
+
+    std::vector<QByteArray> words;
+    words.reserve(postingsByWord.size());
+    for(auto itWord = postingsByWord.constBegin(); itWord != postingsByWord.constEnd(); ++itWord)
+        words.push_back(itWord.key());
+    std::sort(words.begin(), words.end());
+    std::vector<Term> terms;
+    std::vector<uint32_t> postings;
+    terms.reserve(words.size() + 1);
+    for(auto itWord = words.begin(); itWord != words.end(); ++itWord)
+    {
+        Term term;
+        term.text = strings.add(*itWord);
+        term.firstPosting = static_cast<uint32_t>(postings.size());
+        terms.push_back(term);
+        const auto& wordPostings = postingsByWord[*itWord];
+        postings.insert(postings.end(), wordPostings.begin(), wordPostings.end());
+    }
+    Term termsEnd;
+    termsEnd.text = 0;
+    termsEnd.firstPosting = static_cast<uint32_t>(postings.size());
+    terms.push_back(termsEnd);
+
+    std::vector<uint32_t> categoryOffsets;
+    for(auto itName = categoryNames.begin(); itName != categoryNames.end(); ++itName)
+        categoryOffsets.push_back(strings.add(itName->toUtf8()));
+
+    const QFileInfo obfInfo(obfPath);
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IndexMagic;
+    header.version = FormatVersion;
+    header.obfSize = obfInfo.size();
+    header.obfModified = obfInfo.lastModified().toMSecsSinceEpoch();
+    header.cellZoom = CellZoom;
+    header.poisCount = poisCount;
+    header.termsCount = static_cast<uint32_t>(terms.size() - 1);
+    header.postingsCount = static_cast<uint32_t>(postings.size());
+    header.cellsCount = static_cast<uint32_t>(cells.size() - 1);
+    header.categoriesCount = static_cast<uint32_t>(categoryOffsets.size());
+
+    QByteArray output(static_cast<int>(sizeof(Header)), '\0');
+    header.poisOffset = appendArray(output, pois);
+    header.termsOffset = appendArray(output, terms);
+    header.postingsOffset = appendArray(output, postings);
+    header.cellsOffset = appendArray(output, cells);
+    header.categoriesOffset = appendArray(output, categoryOffsets);
+    header.bitmapsOffset = appendArray(output, bitmaps);
+    header.stringsOffset = appendArray(output, std::vector<char>(strings.data().constData(), strings.data().constData() + strings.data().size()));
+    header.stringsSize = static_cast<uint64_t>(strings.data().size());
+    memcpy(output.data(), &header, sizeof(header));
+
+    // Old index stays in place until new one is complete
+    QSaveFile indexFile(indexPath);
+    if(!indexFile.open(QIODevice::WriteOnly) || indexFile.write(output) != output.size() || !indexFile.commit())
+    {
+        error = "Failed to write '" + indexPath + "'";
+        return false;
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    stats.obfBytes = obfInfo.size();
+    stats.indexBytes = output.size();
+    stats.pois = poisCount;
+    stats.terms = header.termsCount;
+    stats.seconds = std::chrono::duration<double>(finish - start).count();
+    return true;
+}
+
+std::unique_ptr<PoiIndex> PoiIndex::open(const QString& obfPath, const QString& indexPath, QString& error)
+{
+    std::unique_ptr<PoiIndex> index(new PoiIndex());
+    index->_file.setFileName(indexPath);
+    if(!index->_file.open(QIODevice::ReadOnly))
+    {
+        error = "No index";
+        return nullptr;
+    }
+    const auto size = index->_file.size();
+    if(size < static_cast<qint64>(sizeof(Header)))
+    {
+        error = "Index is truncated";
+        return nullptr;
+    }
+    index->_data = index->_file.map(0, size);
+    if(index->_data == nullptr)
+    {
+        error = "Failed to map index";
+        return nullptr;
+    }
+
+    const auto header = reinterpret_cast<const Header*>(index->_data);
+    const QFileInfo obfInfo(obfPath);
+    if(header->magic != IndexMagic || header->version != FormatVersion || header->cellZoom != CellZoom)
+    {
+        error = "Index has other format";
+        return nullptr;
+    }
+    if(header->obfSize != obfInfo.size() || header->obfModified != obfInfo.lastModified().toMSecsSinceEpoch())
+    {
+        error = "Index was built for other version of OBF";
+        return nullptr;
+    }
+    const auto fits = [size](uint64_t offset, uint64_t count, uint64_t itemSize)
+    {
+        return offset <= static_cast<uint64_t>(size) && count * itemSize <= static_cast<uint64_t>(size) - offset;
+    };
+    if(!fits(header->poisOffset, header->poisCount, sizeof(Poi)) ||
+        !fits(header->termsOffset, header->termsCount + 1, sizeof(Term)) ||
+        !fits(header->postingsOffset, header->postingsCount, sizeof(uint32_t)) ||
+        !fits(header->cellsOffset, header->cellsCount + 1, sizeof(Cell)) ||
+        !fits(header->categoriesOffset, header->categoriesCount, sizeof(uint32_t)) ||
+        !fits(header->bitmapsOffset, static_cast<uint64_t>(header->categoriesCount) * bitmapWords(header->poisCount), sizeof(uint64_t)) ||
+        !fits(header->stringsOffset, header->stringsSize, 1) || header->stringsSize == 0 ||
+        index->_data[header->stringsOffset + header->stringsSize - 1] != '\0')
+    {
+        error = "Index is broken";
+        return nullptr;
+    }
+
+    index->_header = header;
+    index->_pois = reinterpret_cast<const Poi*>(index->_data + header->poisOffset);
+    index->_terms = reinterpret_cast<const Term*>(index->_data + header->termsOffset);
+    index->_postings = reinterpret_cast<const uint32_t*>(index->_data + header->postingsOffset);
+    index->_cells = reinterpret_cast<const Cell*>(index->_data + header->cellsOffset);
+    index->_categoryNames = reinterpret_cast<const uint32_t*>(index->_data + header->categoriesOffset);
+    index->_bitmaps = reinterpret_cast<const uint64_t*>(index->_data + header->bitmapsOffset);
+    index->_strings = reinterpret_cast<const char*>(index->_data + header->stringsOffset);
+    return index;
+}
+
+void PoiIndex::query(const Query& query, std::vector<Result>& results) const
+{
+    int category = -1;
+    if(!query.category.isEmpty())
+    {
+        category = findCategory(query.category);
+        if(category < 0)
+            return;
+    }
+
+    // Candidates are taken from postings of the most selective word
+    std::vector<QByteArray> words;
+    const auto normalizedWords = TextNormalization::normalize(query.text).split(' ', QString::SkipEmptyParts);
+    for(auto itWord = normalizedWords.begin(); itWord != normalizedWords.end(); ++itWord)
+        words.push_back(itWord->toUtf8());
+    int postingsWord = -1;
+    uint32_t firstTerm = 0, lastTerm = 0;
+    uint32_t postingsCost = 0;
+    for(int idx = 0; idx < static_cast<int>(words.size()); idx++)
+    {
+        uint32_t first, last;
+        findTerms(words[idx], first, last);
+        const auto cost = _terms[last].firstPosting - _terms[first].firstPosting;
+        if(cost == 0)
+            return;
+        if(postingsWord < 0 || cost < postingsCost)
+        {
+            postingsWord = idx;
+            firstTerm = first;
+            lastTerm = last;
+            postingsCost = cost;
+        }
+    }
+
+    // Or from rows of cells around point, each row is contiguous range of POIs
+    const bool isNear = query.hasPoint && query.radius > 0;
+    const double scale = query.hasPoint ? metersPer31(query.y31) : 0;
+    int64_t radius31 = 0;
+    std::vector< std::pair<uint32_t, uint32_t> > rows;
+    uint64_t cellsCost = _header->poisCount;
+    if(isNear)
+    {
+        radius31 = static_cast<int64_t>(std::ceil(query.radius / scale));
+        const int shift = 31 - CellZoom;
+        const auto clamp = [](int64_t value)
+        {
+            return static_cast<uint32_t>(std::min<int64_t>(INT32_MAX, std::max<int64_t>(0, value)));
+        };
+        const auto left = clamp(query.x31 - radius31) >> shift;
+        const auto right = clamp(query.x31 + radius31) >> shift;
+        const auto top = clamp(query.y31 - radius31) >> shift;
+        const auto bottom = clamp(query.y31 + radius31) >> shift;
+        const auto cellsEnd = _cells + _header->cellsCount;
+        cellsCost = 0;
+        for(uint32_t row = top; row <= bottom; row++)
+        {
+            const auto keyLess = [](const Cell& cell, uint32_t key)
+            {
+                return cell.key < key;
+            };
+            const auto first = std::lower_bound(_cells, cellsEnd, (row << CellZoom) | left, keyLess);
+            const auto last = std::lower_bound(first, cellsEnd, ((row << CellZoom) | right) + 1, keyLess);
+            if(first == last)
+                continue;
+            rows.push_back(std::make_pair(first->firstPoi, last->firstPoi));
+            cellsCost += last->firstPoi - first->firstPoi;
+        }
+    }
+
+    // Word of postings holds for every candidate taken from them
+    const bool fromPostings = postingsWord >= 0 && postingsCost <= cellsCost;
+    const int matchedWord = fromPostings ? postingsWord : -1;
+    std::vector<Result> matches;
+    const auto limit = static_cast<size_t>(std::max(query.limit, 0));
+    const auto check = [&](uint32_t poi)
+    {
+        if(category >= 0 && !hasCategory(poi, category))
+            return;
+        double distance = 0;
+        if(query.hasPoint)
+        {
+            const double dx = static_cast<double>(_pois[poi].x31 - static_cast<int64_t>(query.x31));
+            const double dy = static_cast<double>(_pois[poi].y31 - static_cast<int64_t>(query.y31));
+            distance = std::sqrt(dx * dx + dy * dy) * scale;
+            if(isNear && distance > query.radius)
+                return;
+        }
+        const char* normalized = _strings + _pois[poi].normalizedName;
+        for(int idx = 0; idx < static_cast<int>(words.size()); idx++)
+        {
+            if(idx != matchedWord && !hasWordWithPrefix(normalized, words[idx]))
+                return;
+        }
+        Result result;
+        result.poi = poi;
+        result.distance = distance;
+        matches.push_back(result);
+    };
+    // Without point first matches are as good as any
+    const auto isDone = [&]()
+    {
+        return !query.hasPoint && matches.size() >= limit;
+    };
+
+    if(fromPostings)
+    {
+        const auto first = _postings + _terms[firstTerm].firstPosting;
+        const auto last = _postings + _terms[lastTerm].firstPosting;
+        if(lastTerm - firstTerm == 1)
+        {
+            for(auto itPoi = first; itPoi != last && !isDone(); ++itPoi)
+                check(*itPoi);
+        }
+        else
+        {
+            // POI with several words of prefix is in postings of each of them
+            std::vector<uint32_t> candidates(first, last);
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+            for(auto itPoi = candidates.begin(); itPoi != candidates.end() && !isDone(); ++itPoi)
+                check(*itPoi);
+        }
+    }
+    else if(isNear)
+    {
+        for(auto itRow = rows.begin(); itRow != rows.end(); ++itRow)
+        {
+            for(uint32_t poi = itRow->first; poi < itRow->second; poi++)
+                check(poi);
+        }
+    }
+    else if(category >= 0)
+    {
+        const auto words64 = bitmapWords(_header->poisCount);
+        const auto bitmap = _bitmaps + static_cast<size_t>(category) * words64;
+        for(uint32_t wordIdx = 0; wordIdx < words64 && !isDone(); wordIdx++)
+        {
+            for(auto bits = bitmap[wordIdx]; bits != 0 && !isDone(); bits &= bits - 1)
+            {
+                int bit = 0;
+                while(((bits >> bit) & 1) == 0)
+                    bit++;
+                check(wordIdx * 64 + bit);
+            }
+        }
+    }
+    else
+    {
+        for(uint32_t poi = 0; poi < _header->poisCount && !isDone(); poi++)
+            check(poi);
+    }
+
+    if(query.hasPoint && matches.size() > limit)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), [](const Result& l, const Result& r)
+        {
+            return l.distance < r.distance;
+        });
+        matches.resize(limit);
+    }
+    else if(query.hasPoint)
+    {
+        std::sort(matches.begin(), matches.end(), [](const Result& l, const Result& r)
+        {
+            return l.distance < r.distance;
+        });
+    }
+    else if(matches.size() > limit)
+    {
+        matches.resize(limit);
+    }
+    results.insert(results.end(), matches.begin(), matches.end());
+}
+
+uint32_t PoiIndex::poisCount() const
+{
+    return _header->poisCount;
+}
+
+const char* PoiIndex::name(uint32_t poi) const
+{
+    return _strings + _pois[poi].name;
+}
+
+const char* PoiIndex::normalizedName(uint32_t poi) const
+{
+    return _strings + _pois[poi].normalizedName;
+}
+
+const char* PoiIndex::type(uint32_t poi) const
+{
+    return _strings + _pois[poi].type;
+}
+
+int32_t PoiIndex::x31(uint32_t poi) const
+{
+    return _pois[poi].x31;
+}
+
+int32_t PoiIndex::y31(uint32_t poi) const
+{
+    return _pois[poi].y31;
+}
+
+QStringList PoiIndex::categories() const
+{
+    QStringList result;
+    for(uint32_t idx = 0; idx < _header->categoriesCount; idx++)
+        result.push_back(QString::fromUtf8(_strings + _categoryNames[idx]));
+    return result;
+}
+
+bool PoiIndex::hasCategory(uint32_t poi, int category) const
+{
+    const auto bitmap = _bitmaps + static_cast<size_t>(category) * bitmapWords(_header->poisCount);
+    return ((bitmap[poi / 64] >> (poi % 64)) & 1) != 0;
+}
+
+int PoiIndex::findCategory(const QString& name) const
+{
+    for(uint32_t idx = 0; idx < _header->categoriesCount; idx++)
+    {
+        if(QString::fromUtf8(_strings + _categoryNames[idx]).compare(name, Qt::CaseInsensitive) == 0)
+            return static_cast<int>(idx);
+    }
+    return -1;
+}
+
+// Terms are sorted bytewise, those starting with prefix are before prefix followed by 0xff,
+// which never occurs in UTF-8
+void PoiIndex::findTerms(const QByteArray& prefix, uint32_t& first, uint32_t& last) const
+{
+    const auto termsEnd = _terms + _header->termsCount;
+    const auto termLess = [this](const Term& term, const QByteArray& value)
+    {
+        return strcmp(_strings + term.text, value.constData()) < 0;
+    };
+    const auto itFirst = std::lower_bound(_terms, termsEnd, prefix, termLess);
+    const auto itLast = std::lower_bound(itFirst, termsEnd, prefix + '\xff', termLess);
+    first = static_cast<uint32_t>(itFirst - _terms);
+    last = static_cast<uint32_t>(itLast - _terms);
+}
@@ -0,0 +1,127 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __POI_INDEX_H_
+#define __POI_INDEX_H_
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+// Sidecar search index of POIs of one OBF. File is mapped into memory as is and holds
+//  - POIs sorted by tile of CellZoom, with table of cells pointing to first POI of each one;
+//  - sorted words of normalized names, each with list of POIs, so that words sharing prefix
+//    form one contiguous range of terms and of postings;
+//  - bitmap of POIs per category.
+// Query takes the cheaper of postings of query word and POIs of cells around point, and checks
+// the rest of conditions on each candidate.
+class PoiIndex
+{
+public:
+    enum
+    {
+        CellZoom = 14,
+    };
+
+    struct BuildStats
+    {
+        BuildStats();
+
+        qint64 obfBytes;
+        qint64 indexBytes;
+        uint32_t pois;
+        uint32_t terms;
+        double seconds;
+    };
+
+    struct Query
+    {
+        Query();
+
+        // Words to be prefixes of words of name, any name if empty
+        QString text;
+        // Category name as in OBF categories table, any if empty
+        QString category;
+        bool hasPoint;
+        int32_t x31;
+        int32_t y31;
+        // Meters around point, unlimited if 0
+        double radius;
+        int limit;
+    };
+
+    struct Result
+    {
+        uint32_t poi;
+        // Meters to query point, 0 if query has no point
+        double distance;
+    };
+
+    ~PoiIndex();
+
+    // Length of unit of 31-coordinates around given latitude
+    static double metersPer31(int32_t y31);
+
+    static bool build(const QString& obfPath, const QString& indexPath, BuildStats& stats, QString& error);
+    // Maps index, fails if it is missing or was built for other version of OBF
+    static std::unique_ptr<PoiIndex> open(const QString& obfPath, const QString& indexPath, QString& error);
+
+    // Appends matches ordered by distance (or index order without point), at most query.limit
+    void query(const Query& query, std::vector<Result>& results) const;
+
+    uint32_t poisCount() const;
+    const char* name(uint32_t poi) const;
+    const char* normalizedName(uint32_t poi) const;
+    const char* type(uint32_t poi) const;
+    int32_t x31(uint32_t poi) const;
+    int32_t y31(uint32_t poi) const;
+    QStringList categories() const;
+    bool hasCategory(uint32_t poi, int category) const;
+
+private:
+    PoiIndex();
+
+    struct Header;
+    struct Poi;
+    struct Term;
+    struct Cell;
+
+    QFile _file;
+    const uchar* _data;
+    const Header* _header;
+    const Poi* _pois;
+    const Term* _terms;
+    const uint32_t* _postings;
+    const Cell* _cells;
+    const uint32_t* _categoryNames;
+    const uint64_t* _bitmaps;
+    const char* _strings;
+
+    int findCategory(const QString& name) const;
+    void findTerms(const QByteArray& prefix, uint32_t& first, uint32_t& last) const;
+};
+
+#endif // __POI_INDEX_H_
@@ -0,0 +1,72 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <memory>
+#if (defined(UNICODE) || defined(_UNICODE)) && defined(_WIN32)
+#   include <io.h>
+#   include <fcntl.h>
+#endif
+
+#include <QFile>
+#include <QStringList>
+
+#include "ObfSearch.h"
+
+void printUsage(const std::string& warning = std::string());
+int main(int argc, char* argv[])
+{
+#if defined(UNICODE) || defined(_UNICODE)
+#   if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_U16TEXT);
+#   else
+    std::locale::global(std::locale(""));
+#   endif
+#endif
+    ObfSearch::Configuration cfg;
+
+    QString error;
+    QStringList args;
+    for (int idx = 1; idx < argc; idx++)
+        args.push_back(argv[idx]);
+
+    if(!ObfSearch::parseCommandLineArguments(args, cfg, error))
+    {
+        printUsage(error.toStdString());
+        return -1;
+    }
+    return ObfSearch::run(std::cout, cfg) ? 0 : -1;
+}
+
+void printUsage(const std::string& warning)
+{
+    if(!warning.empty())
+        std::cout << warning << std::endl;
+    std::cout << "Search is console utility that finds POIs of OsmAnd binary indexes by name prefix, place and category." << std::endl;
+    std::cout << std::endl << "Usage: search (-obf=path | -obfsDir=path)... [-indexDir=path] [-rebuild] [-query=text] [-category=name] [-near=lat;lon] [-radius=5000] [-limit=10] [-benchmark=queries] [-seed=1] [-verbose]" << std::endl;
+    std::cout << "\tIndex of each OBF is built once into sidecar '<obf>.poi.idx' and rebuilt when OBF changes." << std::endl;
+    std::cout << "\tquery - Prefixes of words of POI name, radius applies only together with near point" << std::endl;
+    std::cout << "\tbenchmark - Number of random queries to report latency percentiles of" << std::endl;
+}
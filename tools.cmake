@@ -1,6 +1,24 @@
+# Code shared by tools
+add_subdirectory("${OSMAND_ROOT}/tools/common" "tools/common")
+
 # OBF inspector tool
 add_subdirectory("${OSMAND_ROOT}/tools/obf-inspector" "tools/obf-inspector")
 
+# OBF blocks relayout tool
+add_subdirectory("${OSMAND_ROOT}/tools/obf-relayout" "tools/obf-relayout")
+
+# OBF region extract tool
+add_subdirectory("${OSMAND_ROOT}/tools/obf-extract" "tools/obf-extract")
+
+# OBF block delta tool
+add_subdirectory("${OSMAND_ROOT}/tools/obf-delta" "tools/obf-delta")
+
+# OBF POI search tool
+add_subdirectory("${OSMAND_ROOT}/tools/obf-search" "tools/obf-search")
+
+# OBF batch geocoder tool
+add_subdirectory("${OSMAND_ROOT}/tools/obf-geocoder" "tools/obf-geocoder")
+
 # Route tester
 add_subdirectory("${OSMAND_ROOT}/tools/route-tester" "tools/route-tester")
 